@@ -20,14 +20,19 @@
 #include <stm32++/timeutl.hpp>
 #include <stm32++/common.hpp>
 #include <stm32++/xassert.hpp>
+#include <stm32++/log.hpp>
 
 //#define ADC_ENABLE_DEBUG
-#ifdef ADC_ENABLE_DEBUG
-#define ADC_LOG_DEBUG(fmt,...) tprintf("adc: " fmt "\n", ##__VA_ARGS__)
-#else
-#define ADC_LOG_DEBUG(fmt,...)
+#ifndef STM32PP_LOG_LEVEL_ADC
+    #ifdef ADC_ENABLE_DEBUG
+        #define STM32PP_LOG_LEVEL_ADC kLogLevelDebug
+    #else
+        #define STM32PP_LOG_LEVEL_ADC STM32PP_LOG_LEVEL
+    #endif
 #endif
 
+#define ADC_LOG_DEBUG(fmt,...) STM32PP_LOG(ADC, Debug, fmt, ##__VA_ARGS__)
+
 namespace nsadc
 {
 enum: uint16_t {
@@ -405,7 +410,7 @@ class Adc: public dma::Rx<AdcNoDma<ADC>, dma::kAllMaxPrio>
 STM32PP_PERIPH_INFO(ADC1)
     static constexpr rcc_periph_clken kClockId = RCC_ADC1;
     enum: uint32_t { kDmaRxId = DMA1 };
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&ADC1_DR); }
+    static const uint32_t dmaRxDataRegister() { return busAddr(&ADC1_DR); }
     enum: uint8_t { kDmaRxChannel = DMA_CHANNEL1, kDmaWordSize = 2 };
     static constexpr rcc_periph_rst kResetBit = RST_ADC1;
 };
@@ -419,7 +424,7 @@ STM32PP_PERIPH_INFO(ADC2)
 STM32PP_PERIPH_INFO(ADC3)
     static constexpr rcc_periph_clken kClockId = RCC_ADC3;
     enum: uint32_t { kDmaRxId = DMA2 };
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&ADC3_DR); }
+    static const uint32_t dmaRxDataRegister() { return busAddr(&ADC3_DR); }
     enum: uint8_t { kDmaRxChannel = DMA_CHANNEL5, kDmaWordSize = 2 };
     static constexpr rcc_periph_rst kResetBit = RST_ADC3;
 };
@@ -0,0 +1,84 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_ATOMIC_HPP
+#define STM32PP_ATOMIC_HPP
+
+/** @brief Lock-free operations on 32-bit words, for sharing data between the
+ * main loop and interrupts without disabling interrupts.
+ * On the target, they are implemented with LDREX/STREX. An exception entry or
+ * return clears the exclusive monitor, so a STREX fails if an interrupt that
+ * preempted the sequence modified the word, and the operation is retried.
+ * On the host, they are implemented with the same compiler builtins that
+ * \c std::atomic uses, so that host tests can exercise them from multiple threads.
+ * Loads have acquire, and stores and successful compare-exchanges have release
+ * semantics
+ */
+
+#include <stdint.h>
+
+#ifdef STM32PP_NOT_EMBEDDED
+static inline uint32_t atomicLoad(const volatile uint32_t* ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomicStore(volatile uint32_t* ptr, uint32_t val)
+{
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+
+/** @brief If \c *ptr equals \c expected, sets it to \c desired and returns true.
+ * Otherwise loads the current value in \c expected and returns false
+ */
+static inline bool atomicCas(volatile uint32_t* ptr, uint32_t& expected, uint32_t desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#else
+static inline void memoryBarrier()
+{
+    asm volatile("dmb" ::: "memory");
+}
+
+static inline uint32_t atomicLoad(const volatile uint32_t* ptr)
+{
+    uint32_t val = *ptr;
+    memoryBarrier();
+    return val;
+}
+
+static inline void atomicStore(volatile uint32_t* ptr, uint32_t val)
+{
+    memoryBarrier();
+    *ptr = val;
+}
+
+static inline bool atomicCas(volatile uint32_t* ptr, uint32_t& expected, uint32_t desired)
+{
+    memoryBarrier();
+    for (;;)
+    {
+        uint32_t current;
+        asm volatile("ldrex %0, [%1]" : "=r"(current) : "r"(ptr) : "memory");
+        if (current != expected)
+        {
+            asm volatile("clrex" ::: "memory");
+            expected = current;
+            return false;
+        }
+        uint32_t failed;
+        asm volatile("strex %0, %2, [%1]" : "=&r"(failed) : "r"(ptr), "r"(desired) : "memory");
+        if (!failed)
+        {
+            memoryBarrier();
+            return true;
+        }
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,313 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_BINLOG_HPP
+#define STM32PP_BINLOG_HPP
+
+/** @brief Deferred binary logging.
+ * Instead of formatting the message on the MCU, \c BINLOG() sends a binary
+ * record, containing the id of the format string and the raw argument values
+ * with their formatting options. The text is rendered on the host by the decoder
+ * in tools/binlog, which reads the format strings from the ELF file of the
+ * firmware.
+ * The format strings are placed in the \c binlog_fmt section, and the id of a
+ * format string is its offset in that section. To keep the strings out of the
+ * flash image, the linker script should declare the section as non-loaded:
+ * \code
+ * binlog_fmt 0 (INFO) :
+ * {
+ *     __start_binlog_fmt = .;
+ *     KEEP(*(binlog_fmt))
+ * }
+ * \endcode
+ * Otherwise, the linker places it in flash as an orphan section, which still
+ * works, but takes space.
+ * Records are sent via the current print sink (\c gPrintSink), the same way as
+ * \c tprintf() output. Record format:
+ * [varint payload length][varint format id][arguments...]
+ * Each argument is a type tag, followed by formatting options (for the
+ * formatter types) and the value in little-endian byte order.
+ * Usage:
+ * \code
+ * BINLOG("temp = %, press = %\n", fmtScaled<100>(temp), fmtHex(status));
+ * \endcode
+ */
+
+#include "tostring.hpp"
+#include "printSink.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <alloca.h>
+#include <assert.h>
+
+extern "C" const char __start_binlog_fmt[];
+extern IPrintSink* gPrintSink;
+
+#define BINLOG_FD(fd, fmt, ...)                                                   \
+    do {                                                                          \
+        __attribute__((section("binlog_fmt"), used))                              \
+        static const char _binlogFmtStr[] = fmt;                                  \
+        binlog::write(fd, _binlogFmtStr - __start_binlog_fmt, ##__VA_ARGS__);     \
+    } while(0)
+
+#define BINLOG(fmt, ...) BINLOG_FD(1, fmt, ##__VA_ARGS__)
+
+namespace binlog
+{
+/** Argument type tags */
+enum: uint8_t
+{
+    kTagU8 = 1, kTagU16, kTagU32, kTagU64,
+    kTagI8, kTagI16, kTagI32, kTagI64,
+    kTagChar, kTagFloat, kTagDouble,
+    kTagStr,     //< varint length, followed by the chars
+    kTagIntFmt,  //< flags(2), minDigits(1), minLen(1), integer argument
+    kTagFpFmt,   //< flags(2), minDigits(1), minLen(1), float or double argument
+    kTagRptChar, //< char(1), count(2)
+    kTagQ,       //< fracBits(1), prec(1), integer argument
+    kTagScaled   //< divisor(4), prec(1), integer argument
+};
+
+static inline uint8_t varintSize(uint32_t val)
+{
+    uint8_t size = 1;
+    while (val >= 0x80)
+    {
+        val >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static inline uint8_t* putVarint(uint8_t* ptr, uint32_t val)
+{
+    while (val >= 0x80)
+    {
+        *(ptr++) = (val & 0x7f) | 0x80;
+        val >>= 7;
+    }
+    *(ptr++) = val;
+    return ptr;
+}
+
+template <typename T>
+uint8_t* putRaw(uint8_t* ptr, T val)
+{
+    memcpy(ptr, &val, sizeof(T));
+    return ptr + sizeof(T);
+}
+
+template <typename T, class Enabled=void>
+struct IntTag;
+
+template <typename T>
+struct IntTag<T, typename std::enable_if<std::is_integral<T>::value
+    && !std::is_same<T, char>::value>::type>
+{
+    enum: uint8_t {
+        value = (std::is_signed<T>::value ? kTagI8 : kTagU8)
+        + (sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3)
+    };
+};
+
+/** Encoders for each argument type that toString() supports. \c size() returns
+ * the number of bytes that \c put() writes */
+template <typename T>
+typename std::enable_if<IntTag<T>::value != 0, size_t>::type
+size(T) { return 1 + sizeof(T); }
+
+template <typename T>
+typename std::enable_if<IntTag<T>::value != 0, uint8_t*>::type
+put(uint8_t* ptr, T val)
+{
+    *(ptr++) = IntTag<T>::value;
+    return putRaw(ptr, val);
+}
+
+static inline size_t size(char) { return 2; }
+static inline uint8_t* put(uint8_t* ptr, char val)
+{
+    *(ptr++) = kTagChar;
+    *(ptr++) = val;
+    return ptr;
+}
+
+static inline size_t size(float) { return 1 + sizeof(float); }
+static inline uint8_t* put(uint8_t* ptr, float val)
+{
+    *(ptr++) = kTagFloat;
+    return putRaw(ptr, val);
+}
+
+static inline size_t size(double) { return 1 + sizeof(double); }
+static inline uint8_t* put(uint8_t* ptr, double val)
+{
+    *(ptr++) = kTagDouble;
+    return putRaw(ptr, val);
+}
+
+/** long double is recorded as a double, as toString() formats it with double precision */
+static inline size_t size(long double) { return size(0.0); }
+static inline uint8_t* put(uint8_t* ptr, long double val)
+{
+    return put(ptr, (double)val);
+}
+
+static inline size_t size(const char* str)
+{
+    size_t len = strlen(str);
+    return 1 + varintSize(len) + len;
+}
+static inline uint8_t* put(uint8_t* ptr, const char* str)
+{
+    size_t len = strlen(str);
+    *(ptr++) = kTagStr;
+    ptr = putVarint(ptr, len);
+    memcpy(ptr, str, len);
+    return ptr + len;
+}
+
+template <typename T, Flags flags>
+size_t size(IntFmt<T, flags> val) { return 5 + size(val.value); }
+
+template <typename T, Flags flags>
+uint8_t* put(uint8_t* ptr, IntFmt<T, flags> val)
+{
+    *(ptr++) = kTagIntFmt;
+    ptr = putRaw<uint16_t>(ptr, val.flags);
+    *(ptr++) = val.minDigits;
+    *(ptr++) = val.minLen;
+    return put(ptr, val.value);
+}
+
+template <class P>
+typename std::enable_if<std::is_pointer<P>::value && !is_char_ptr<P>::value, size_t>::type
+size(P ptr) { return size(fmtPtr(ptr)); }
+
+template <class P>
+typename std::enable_if<std::is_pointer<P>::value && !is_char_ptr<P>::value, uint8_t*>::type
+put(uint8_t* ptr, P val) { return put(ptr, fmtPtr(val)); }
+
+template <typename T, Flags flags>
+size_t size(FpFmt<T, flags> val) { return 5 + size(val.value); }
+
+template <typename T, Flags flags>
+uint8_t* put(uint8_t* ptr, FpFmt<T, flags> val)
+{
+    *(ptr++) = kTagFpFmt;
+    ptr = putRaw<uint16_t>(ptr, val.flags);
+    *(ptr++) = val.minDigits;
+    *(ptr++) = val.minLen;
+    return put(ptr, val.value);
+}
+
+template <uint8_t flags>
+size_t size(RptChar<flags>) { return 4; }
+
+template <uint8_t flags>
+uint8_t* put(uint8_t* ptr, RptChar<flags> val)
+{
+    *(ptr++) = kTagRptChar;
+    *(ptr++) = val.ch();
+    return putRaw<uint16_t>(ptr, val.count());
+}
+
+template <typename T, uint8_t fracBits>
+size_t size(QFmt<T, fracBits> val) { return 3 + size(val.value); }
+
+template <typename T, uint8_t fracBits>
+uint8_t* put(uint8_t* ptr, QFmt<T, fracBits> val)
+{
+    *(ptr++) = kTagQ;
+    *(ptr++) = fracBits;
+    *(ptr++) = val.prec;
+    return put(ptr, val.value);
+}
+
+template <typename T, uint32_t divisor>
+size_t size(ScaledFmt<T, divisor> val) { return 6 + size(val.value); }
+
+template <typename T, uint32_t divisor>
+uint8_t* put(uint8_t* ptr, ScaledFmt<T, divisor> val)
+{
+    *(ptr++) = kTagScaled;
+    ptr = putRaw<uint32_t>(ptr, divisor);
+    *(ptr++) = val.prec;
+    return put(ptr, val.value);
+}
+
+static inline size_t argsSize() { return 0; }
+
+template <typename Val, typename... Args>
+size_t argsSize(Val val, Args... args)
+{
+    return size(val) + argsSize(args...);
+}
+
+static inline uint8_t* putArgs(uint8_t* ptr) { return ptr; }
+
+template <typename Val, typename... Args>
+uint8_t* putArgs(uint8_t* ptr, Val val, Args... args)
+{
+    return putArgs(put(ptr, val), args...);
+}
+
+/** @brief Encodes a binary log record and sends it to the current print sink.
+ * Normally called via the \c BINLOG() macro.
+ * @return The size of the record, or 0 if a buffer could not be allocated. With
+ * the print buffer pool, records longer than a pool block are dropped
+ */
+template <typename... Args>
+size_t write(uint8_t fd, uint32_t fmtId, Args... args)
+{
+    size_t payloadSize = varintSize(fmtId) + argsSize(args...);
+    size_t size = varintSize(payloadSize) + payloadSize;
+    uint8_t* buf;
+    auto async = gPrintSink->waitReady();
+    if (async)
+    {
+        buf = (uint8_t*)async->buf;
+#ifdef STM32PP_PRINT_BUF_POOL
+        if (!buf)
+        {
+            buf = (uint8_t*)gPrintBufPool.alloc();
+            if (!buf)
+            {
+                return 0;
+            }
+            async->buf = (const char*)buf;
+            async->bufSize = DefaultPrintBufPool::kBlockSize;
+        }
+        if (async->bufSize < size)
+        {
+            return 0; // records can't be truncated
+        }
+#else
+        if (!buf || async->bufSize < size)
+        {
+            buf = (uint8_t*)realloc(buf, size);
+            if (!buf)
+            {
+                return 0;
+            }
+            async->buf = (const char*)buf;
+            async->bufSize = size;
+        }
+#endif
+    }
+    else
+    {
+        buf = (uint8_t*)alloca(size);
+    }
+    uint8_t* ptr = putVarint(buf, payloadSize);
+    ptr = putVarint(ptr, fmtId);
+    ptr = putArgs(ptr, args...);
+    assert(ptr == buf + size);
+    gPrintSink->print((const char*)buf, size, async ? async->bufSize : fd);
+    return size;
+}
+}
+
+#endif
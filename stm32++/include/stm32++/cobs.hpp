@@ -0,0 +1,195 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_COBS_HPP
+#define STM32PP_COBS_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/** @brief Consistent Overhead Byte Stuffing (COBS) packet framing.
+ * An encoded packet contains no zero bytes, and is terminated by a single zero
+ * delimiter, so that a receiver can find the packet boundaries in a byte
+ * stream, and resynchronize after an error at the next delimiter. The overhead
+ * is one byte per 254 bytes of payload, plus the delimiter.
+ * An optional CRC-16/CCITT is appended to the payload before encoding, and
+ * checked by the decoder
+ */
+namespace cobs
+{
+/** Size of the encoded packet, including the delimiter, for the worst case */
+constexpr size_t maxEncodedSize(size_t len) { return len + 1 + len / 254 + 1; }
+
+/** CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xffff), computed a
+ * nibble at a time, which is a good tradeoff for a Cortex-M3. Appended in big
+ * endian order, the CRC of the data and the CRC is zero */
+static inline uint16_t crc16(const void* data, size_t len, uint16_t crc=0xffff)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+    };
+    for (const uint8_t* ptr = (const uint8_t*)data; len--; ptr++)
+    {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (*ptr >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (*ptr & 0x0f)];
+    }
+    return crc;
+}
+
+/** @brief Encodes in place the \c len bytes of payload at \c buf+1, and appends
+ * the delimiter. \c buf[0] is reserved for the first code byte, so the encoded
+ * packet starts at \c buf. The buffer must have space for \c maxEncodedSize(len)
+ * bytes. Zero bytes of the payload are replaced by code bytes, so no data is
+ * moved, except when a run of more than 254 non-zero bytes needs an additional
+ * code byte - then the rest of the payload is shifted by one byte.
+ * @return The size of the encoded packet, including the delimiter
+ */
+static inline size_t encodeInPlace(uint8_t* buf, size_t len)
+{
+    size_t end = len + 1;
+    size_t codePos = 0;
+    uint8_t code = 1;
+    for (size_t i = 1; i < end; i++)
+    {
+        if (buf[i] == 0)
+        {
+            buf[codePos] = code;
+            codePos = i;
+            code = 1;
+        }
+        else if (++code == 0xff)
+        {
+            // A full group of 254 bytes - insert a code byte for the next one
+            buf[codePos] = code;
+            codePos = ++i;
+            memmove(buf + i + 1, buf + i, end - i);
+            end++;
+            code = 1;
+        }
+    }
+    buf[codePos] = code;
+    buf[end] = 0;
+    return end + 1;
+}
+
+/** @brief Incremental decoder of a stream of COBS packets, e.g. as received by
+ * DMA. The stream is fed in chunks of any size, and \c Callback is called for
+ * each complete and valid packet, with the decoded payload (without the CRC).
+ * Packets longer than \c MaxPacket, packets that are truncated by a delimiter,
+ * and packets with a bad CRC are dropped and counted. Empty packets, i.e.
+ * consecutive delimiters, are ignored - a sender can use them to flush out
+ * a partial packet after a reset
+ */
+template <size_t MaxPacket, bool Crc=true>
+class Decoder
+{
+public:
+    typedef void(*Callback)(const uint8_t* data, size_t size, void* userp);
+    enum: size_t { kCrcSize = Crc ? 2 : 0 };
+protected:
+    uint8_t mBuf[MaxPacket + kCrcSize];
+    size_t mLen = 0;
+    uint8_t mRemaining = 0; // data bytes left in the current group
+    bool mZeroPending = false; // the current group ends with an implicit zero
+    bool mInFrame = false;
+    bool mDiscard = false; // skip till the next delimiter
+    Callback mCallback;
+    void* mUserp;
+    uint32_t mPacketCount = 0;
+    uint32_t mErrorCount = 0;
+    uint32_t mCrcErrorCount = 0;
+    void put(uint8_t byte)
+    {
+        if (mLen >= sizeof(mBuf))
+        {
+            mDiscard = true;
+            return;
+        }
+        mBuf[mLen++] = byte;
+    }
+    void endFrame()
+    {
+        if (mInFrame)
+        {
+            if (mDiscard || mRemaining || mLen < kCrcSize)
+            {
+                mErrorCount++;
+            }
+            else if (Crc && crc16(mBuf, mLen) != 0)
+            {
+                mCrcErrorCount++;
+            }
+            else
+            {
+                mPacketCount++;
+                if (mCallback)
+                {
+                    mCallback(mBuf, mLen - kCrcSize, mUserp);
+                }
+            }
+        }
+        reset();
+    }
+public:
+    Decoder(Callback cb=nullptr, void* userp=nullptr): mCallback(cb), mUserp(userp) {}
+    void setCallback(Callback cb, void* userp)
+    {
+        mCallback = cb;
+        mUserp = userp;
+    }
+    /** Drops the partially received packet */
+    void reset()
+    {
+        mLen = 0;
+        mRemaining = 0;
+        mZeroPending = mInFrame = mDiscard = false;
+    }
+    /** Drops the data till the next delimiter, e.g. after data was lost.
+     * The dropped packet is counted as an error */
+    void resync()
+    {
+        mInFrame = mDiscard = true;
+    }
+    void feed(const void* data, size_t len)
+    {
+        for (const uint8_t* ptr = (const uint8_t*)data; len--; ptr++)
+        {
+            uint8_t byte = *ptr;
+            if (byte == 0)
+            {
+                endFrame();
+                continue;
+            }
+            mInFrame = true;
+            if (mDiscard)
+            {
+                continue;
+            }
+            if (mRemaining)
+            {
+                put(byte);
+                mRemaining--;
+                continue;
+            }
+            // code byte
+            if (mZeroPending)
+            {
+                put(0);
+            }
+            mRemaining = byte - 1;
+            mZeroPending = (byte != 0xff);
+        }
+    }
+    /** Number of valid packets received */
+    uint32_t packetCount() const { return mPacketCount; }
+    /** Number of packets dropped because they were malformed or too long */
+    uint32_t errorCount() const { return mErrorCount; }
+    uint32_t crcErrorCount() const { return mCrcErrorCount; }
+};
+}
+
+#endif
@@ -8,6 +8,9 @@
 */
 
 #include <stdint.h>
+#ifdef STM32PP_SIM
+    #include <stm32++/sim/sim.hpp>
+#endif
 
 // Define a class to check whether a class has a member
 #define TYPE_SUPPORTS(ClassName, Expr)                                 \
@@ -18,6 +21,13 @@ template <typename C> struct ClassName {                               \
 };
 
 
+/** The address of a buffer or a register, as the DMA sees it */
+#ifdef STM32PP_SIM
+using sim::busAddr; // a single function, also found by ADL for the simulated registers
+#else
+static inline uint32_t busAddr(const volatile void* ptr) { return (uint32_t)(uintptr_t)ptr; }
+#endif
+
 // Unspecialized template for peripheral info classes
 // Peripheral headers specialize this (in the global namespace)
 // for every peripheral and fill in various
@@ -27,18 +37,14 @@ template <uint32_t id, bool remap=false>
 struct PeriphInfo;
 
 
-#define __STM32PP_PERIPH_INFO(periphId)               \
+// periphName() is defined in release builds too, as log calls that are
+// compiled out still reference it. If unused, the name is not emitted
+#define STM32PP_PERIPH_INFO(periphId)                 \
     template<bool Remap>                              \
     struct PeriphInfo<periphId, Remap>                \
     {                                                 \
         enum: uint32_t { kPeriphId = periphId };      \
-        static constexpr bool kPinsRemapped = Remap;
-
-#ifndef NDEBUG
-    #define STM32PP_PERIPH_INFO(periphId) __STM32PP_PERIPH_INFO(periphId) \
+        static constexpr bool kPinsRemapped = Remap;  \
         static constexpr const char* periphName() { return #periphId; }
-#else
-    #define STM32PP_PERIPH_INFO(periphId) __STM32PP_PERIPH_INFO(periphId);
-#endif
 
 #endif // COMMON_HPP
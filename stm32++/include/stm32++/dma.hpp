@@ -10,16 +10,23 @@
 #include <libopencm3/stm32/dma.h>
 #include "xassert.hpp"
 #include "common.hpp"
+#include "log.hpp"
+#include "dmaStream.hpp"
+#include "dmaChannel.hpp"
+#include "utils.hpp"
 
 //#define DMA_ENABLE_DEBUG
 
-#if defined(DMA_ENABLE_DEBUG) || !defined(NDEBUG)
-    #include "tprintf.hpp"
-    #define DMA_LOG_DEBUG(fmt,...) tprintf("%(%): " fmt "\n", Base::periphName(), DmaInfo::periphName(), ##__VA_ARGS__)
-#else
-   #define DMA_LOG_DEBUG(fmt,...)
+#ifndef STM32PP_LOG_LEVEL_DMA
+    #ifdef DMA_ENABLE_DEBUG
+        #define STM32PP_LOG_LEVEL_DMA kLogLevelDebug
+    #else
+        #define STM32PP_LOG_LEVEL_DMA STM32PP_LOG_LEVEL
+    #endif
 #endif
 
+#define DMA_LOG_DEBUG(fmt,...) STM32PP_LOG(DMA, Debug, "%(%): " fmt, Base::periphName(), DmaInfo::periphName(), ##__VA_ARGS__)
+
 TYPE_SUPPORTS(HasTxDma, &std::remove_reference<T>::type::dmaTxStop);
 TYPE_SUPPORTS(HasRxDma, &std::remove_reference<T>::type::dmaRxStop);
 
@@ -63,6 +70,7 @@ enum: uint8_t {
     kDmaDontEnableClock = 0x10, // In case the DMA controller clock is already enabled
     kDmaNoDoneIntr      = 0x20, // Disable dma complete interrupt
     kDmaCircularMode    = 0x40,
+    kDmaShared          = 0x80, // Time-share the channel with other peripherals, see ChannelArbiter
     kDefaultOpts = kIrqPrioMedium | kPrioMedium,
     kAllMaxPrio = kPrioVeryHigh | kIrqPrioVeryHigh
 };
@@ -74,25 +82,83 @@ bool dmaChannelIsBusy(uint32_t dma, uint8_t chan)
 
 /** Mixin to support Tx DMA. Base is a peripheral, which is derived from
  *  PeriphInfo<Periph>, where Periph is the actual peripheral id (such as ADC1)
- *  for which DMA is to be supported. No method should conflict with one in dma::Rx
+ *  for which DMA is to be supported. No method should conflict with one in dma::Rx.
+ *  Up to \c QueueLen transfers can be queued with \c dmaTxEnqueue() while
+ *  one is in progress, and are started one after the other from the DMA interrupt.
+ *  With \c kDmaShared, the channel is acquired and reprogrammed for each
+ *  transfer (including the queued ones that follow it), see \c ChannelArbiter
  */
-template <class Base, uint8_t Opts=kDefaultOpts>
+template <class Base, uint8_t Opts=kDefaultOpts, uint8_t QueueLen=4>
 class Tx: public Base
 {
+public:
+    typedef void(*FreeFunc)(void*);
 private:
-    typedef Tx<Base, Opts> Self;
+    typedef Tx<Base, Opts, QueueLen> Self;
     typedef PeriphInfo<Base::kDmaTxId> DmaInfo;
-    typedef void(*FreeFunc)(void*);
+    struct TxDesc
+    {
+        const void* data;
+        uint16_t size;
+        FreeFunc freeFunc;
+    };
     volatile bool mTxBusy = false;
+    // The transfer in progress
+    const void* mTxData = nullptr;
+    FreeFunc mTxFreeFunc = nullptr;
+    // Queued transfers, added by dmaTxEnqueue() and removed by the interrupt
+    TxDesc mTxQueue[QueueLen ? QueueLen : 1];
+    volatile uint8_t mTxQueueHead = 0;
+    volatile uint8_t mTxQueueCount = 0;
+    void dmaTxConfigChannel()
+    {
+        enum: uint8_t { chan = Self::kDmaTxChannel };
+        enum: uint32_t { dma = Self::kDmaTxId };
+        dma_channel_reset(dma, chan);
+        dma_set_peripheral_address(dma, chan, Base::dmaTxDataRegister());
+        dma_set_peripheral_size(dma, chan, periphSizeCode(Base::kDmaWordSize));
+        dma_disable_peripheral_increment_mode(dma, chan);
+
+        dma_set_read_from_memory(dma, chan);
+        dma_enable_memory_increment_mode(dma, chan);
+        dma_set_priority(dma, chan, ((Opts & kPrioMask) >> kPrioShift) << DMA_CCR_PL_SHIFT);
+    }
+    /** In shared mode, acquires the channel and configures it for us.
+     * Must be called with interrupts enabled, after \c mTxBusy is set */
+    void dmaTxAcquireChannel()
+    {
+        if (Opts & kDmaShared)
+        {
+            ChannelArbiter::acquire(Self::kDmaTxId, Self::kDmaTxChannel, kDmaTxOwnerId);
+            dmaTxConfigChannel();
+        }
+    }
+    void dmaTxProgram(const void* data, uint16_t size, FreeFunc freeFunc)
+    {
+        enum: uint8_t { chan = Self::kDmaTxChannel };
+        enum: uint32_t { dma = Self::kDmaTxId };
+        xassert(size % Base::kDmaWordSize == 0);
+        mTxData = data;
+        mTxFreeFunc = freeFunc;
+        dma_set_memory_address(dma, chan, busAddr(data));
+        dma_set_number_of_data(dma, chan, size / Base::kDmaWordSize);
+        dma_set_memory_size(dma, chan, memSizeCode(Base::kDmaWordSize));
+        if ((Opts & kDmaNoDoneIntr) == 0)
+        {
+            dma_enable_transfer_complete_interrupt(dma, chan);
+            nvic_enable_irq(kDmaTxIrq);
+        }
+        dma_enable_channel(dma, chan);
+    }
 protected:
     enum: uint8_t { kDmaTxIrq = DmaInfo::dmaIrqForChannel(Base::kDmaTxChannel) };
 public:
+    enum: uint8_t { kDmaTxOpts = Opts };
+    /** Owner id of the channel in the \c ChannelArbiter */
+    enum: uint32_t { kDmaTxOwnerId = Base::kPeriphId };
     template <typename... Args>
     void init(Args... args)
     {
-        enum: uint8_t { chan = Self::kDmaTxChannel };
-        enum: uint32_t { dma = Self::kDmaTxId };
-
         Base::init(args...);
         DMA_LOG_DEBUG("Tx: Initializing channel %, irq %, opts: %",
             (int)Base::kDmaTxChannel, (int)kDmaTxIrq, fmtHex(Opts));
@@ -103,14 +169,16 @@ public:
             DMA_LOG_DEBUG("Tx: Enabled clock");
         }
 
-        dma_channel_reset(dma, chan);
-        dma_set_peripheral_address(dma, chan, Base::dmaTxDataRegister());
-        dma_set_peripheral_size(dma, chan, periphSizeCode(Base::kDmaWordSize));
-        dma_disable_peripheral_increment_mode(dma, chan);
-
-        dma_set_read_from_memory(dma, chan);
-        dma_enable_memory_increment_mode(dma, chan);
-        dma_set_priority(dma, chan, ((Opts & kPrioMask) >> kPrioShift) << DMA_CCR_PL_SHIFT);
+        if ((Opts & kDmaShared) == 0)
+        {
+            // Claim the channel for good, this catches conflicts with
+            // peripherals that are not in the STM32PP_DMA_REGISTRY
+            bool claimed = ChannelArbiter::claim(
+                Self::kDmaTxId, Self::kDmaTxChannel, kDmaTxOwnerId);
+            xassert(claimed, "Tx DMA channel is used by another peripheral");
+            (void)claimed;
+            dmaTxConfigChannel();
+        }
         if ((Opts & kDmaNoDoneIntr) == 0)
         {
             nvic_set_priority(kDmaTxIrq, (Opts & kIrqPrioMask) >> kIrqPrioShift);
@@ -119,37 +187,81 @@ public:
     }
     /** @brief Initiates a DMA transfer of the buffer specified
      * by the \c data and \c size paremeters.
+     * If there is already a transfer in progress, \c dmaTxStart() blocks until
+     * it and all queued transfers complete. To free the buffer or get a
+     * completion callback, use \c dmaTxEnqueue(). In shared mode, it also
+     * waits for the channel to be released by the other peripherals
+     */
+    template <typename... Args>
+    void dmaTxStart(const void* data, uint16_t size, Args... args)
+    {
+        while(mTxBusy) { STM32PP_BUSY_WAIT(); }
+        mTxBusy = true;
+        dmaTxAcquireChannel();
+        dmaTxProgram(data, size, nullptr);
+        //have to enable DMA for peripheral at the upper level and the transfer should start
+        Base::dmaStartPeripheralTx(args...);
+    }
+    /** @brief Queues a DMA transfer of the buffer specified by the \c data and
+     * \c size parameters, and returns immediately. If no transfer is in progress,
+     * it's started right away, otherwise it's started from the DMA interrupt
+     * after the previous one completes.
      * When the transfer is complete and the specified \c freeFunc
      * is not \c nullptr, that function will be called with the \c data
      * param to free it. It can be used also as a completion callback.
      * @note Note that \c freeFunc will be called from an interrupt.
-     * If there is already a transfer in progress, \c dmaWrite() blocks until
-     * the previous transfer completes (and the previous buffer is freed,
-     * in case \c freeFunc was provided for the previous transfer).
+     * In shared mode, if the channel is used by another peripheral, waits
+     * for it to be released, so this must not be called with interrupts disabled.
+     * @return \c false if the queue is full. The buffer is not freed in that case
      */
-    template <typename... Args>
-    void dmaTxStart(const void* data, uint16_t size, Args... args)
+    bool dmaTxEnqueue(const void* data, uint16_t size, FreeFunc freeFunc=nullptr)
     {
-        enum: uint8_t { chan = Self::kDmaTxChannel };
-        enum: uint32_t { dma = Self::kDmaTxId };
-        xassert(size % Base::kDmaWordSize == 0);
-
-        while(mTxBusy);
-        mTxBusy = true;
-
-        dma_set_memory_address(dma, chan, (uint32_t)data);
-        dma_set_number_of_data(dma, chan, size / Base::kDmaWordSize);
-        dma_set_memory_size(dma, chan, memSizeCode(Base::kDmaWordSize));
-        if ((Opts & kDmaNoDoneIntr) == 0)
+        static_assert(QueueLen > 0, "The Tx queue is disabled");
+        static_assert((Opts & kDmaNoDoneIntr) == 0, "The Tx queue requires the DMA interrupt");
+        for (;;)
         {
-            dma_enable_transfer_complete_interrupt(dma, chan);
-            nvic_enable_irq(kDmaTxIrq);
+            if (Opts & kDmaShared)
+            {
+                // Wait for the channel with interrupts enabled. If we are busy,
+                // we already own it and this returns immediately
+                ChannelArbiter::acquire(Self::kDmaTxId, Self::kDmaTxChannel, kDmaTxOwnerId);
+            }
+            IntrDisable noIntr;
+            if (mTxBusy)
+            {
+                if (mTxQueueCount >= QueueLen)
+                {
+                    return false;
+                }
+                mTxQueue[(mTxQueueHead + mTxQueueCount) % QueueLen] = TxDesc{data, size, freeFunc};
+                mTxQueueCount = mTxQueueCount + 1;
+                return true;
+            }
+            // Our last transfer may have completed and released the channel
+            // after we acquired it, and an interrupt may have taken it
+            if ((Opts & kDmaShared) &&
+                !ChannelArbiter::tryAcquire(Self::kDmaTxId, Self::kDmaTxChannel, kDmaTxOwnerId))
+            {
+                continue;
+            }
+            mTxBusy = true;
+            if (Opts & kDmaShared)
+            {
+                dmaTxConfigChannel();
+            }
+            dmaTxProgram(data, size, freeFunc);
+            Base::dmaStartPeripheralTx();
+            return true;
         }
-        dma_enable_channel(dma, chan);
-        //have to enable DMA for peripheral at the upper level and the transfer should start
-        Base::dmaStartPeripheralTx(args...);
     }
     volatile bool txBusy() const { return mTxBusy; }
+    /** Number of transfers waiting in the queue, excluding the one in progress */
+    uint8_t txQueued() const { return mTxQueueCount; }
+    /** Whether the channel is owned by us, to dispatch the interrupt of a shared channel */
+    bool dmaTxOwnsChannel() const
+    {
+        return ChannelArbiter::owner(Self::kDmaTxId, Self::kDmaTxChannel) == kDmaTxOwnerId;
+    }
     void dmaTxIsr()
     {
         // check if transfer complete flag is set
@@ -162,29 +274,117 @@ public:
 
         // Clear transfer-complete interrupt flag
         DMA_IFCR(Base::kDmaTxId) |= DMA_IFCR_CTCIF(Base::kDmaTxChannel);
-        dmaTxStop();
+        const void* data = mTxData;
+        FreeFunc freeFunc = mTxFreeFunc;
+        if (mTxQueueCount)
+        {
+            // Start the next transfer right away, the peripheral stays in DMA mode
+            dma_disable_channel(Base::kDmaTxId, Base::kDmaTxChannel);
+            const TxDesc& next = mTxQueue[mTxQueueHead];
+            mTxQueueHead = (mTxQueueHead + 1) % QueueLen;
+            mTxQueueCount = mTxQueueCount - 1;
+            dmaTxProgram(next.data, next.size, next.freeFunc);
+        }
+        else
+        {
+            dmaTxHalt();
+        }
+        if (freeFunc)
+        {
+            freeFunc((void*)data);
+        }
+    }
+    /** Stops the current transfer and drops the queued ones. The \c freeFunc
+     * of the aborted transfer and of each dropped one is called, so that their
+     * buffers are not leaked */
+    void dmaTxStop()
+    {
+        TxDesc dropped[QueueLen + 1];
+        uint8_t count = 0;
+        {
+            IntrDisable noIntr;
+            if (!mTxBusy)
+            {
+                return;
+            }
+            dropped[count++] = TxDesc{mTxData, 0, mTxFreeFunc};
+            for (; mTxQueueCount; mTxQueueCount = mTxQueueCount - 1)
+            {
+                dropped[count++] = mTxQueue[mTxQueueHead];
+                mTxQueueHead = (mTxQueueHead + 1) % QueueLen;
+            }
+            dmaTxHalt();
+        }
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (dropped[i].freeFunc)
+            {
+                dropped[i].freeFunc((void*)dropped[i].data);
+            }
+        }
     }
-    void dmaTxStop() // this is called from an ISR
+protected:
+    /** Stops the channel and the peripheral's DMA requests, and releases a
+     * shared channel. Called from the ISR when the last transfer completes */
+    void dmaTxHalt()
     {
         dma_disable_transfer_complete_interrupt(Base::kDmaTxId, Base::kDmaTxChannel);
         Base::dmaStopPeripheralTx();
         dma_disable_channel(Base::kDmaTxId, Base::kDmaTxChannel);
+        mTxQueueCount = 0;
+        mTxFreeFunc = nullptr;
+        if (Opts & kDmaShared)
+        {
+            ChannelArbiter::release(Self::kDmaTxId, Self::kDmaTxChannel, kDmaTxOwnerId);
+        }
         mTxBusy = false;
     }
 };
 /** Mixin to support Rx DMA. Base is derived from DmaInfo<Periph>,
- * where Periph is the actual peripheral for which DMA is to be supported
+ * where Periph is the actual peripheral for which DMA is to be supported.
+ * With \c kDmaCircularMode, the receive buffer can be streamed in two halves,
+ * see \c dmaRxStreamStart(). With \c kDmaShared, the channel is acquired and
+ * reprogrammed by \c dmaRxStart(), and released by \c dmaRxStop(), see
+ * \c ChannelArbiter
  */
 template <class Base, uint8_t Opts=kDefaultOpts>
 class Rx: public Base
 {
 private:
     volatile bool mRxBusy = false;
+    bool mRxStreaming = false;
+    RxStream mRxStream;
     typedef Rx<Base, Opts> Self;
     typedef PeriphInfo<Base::kDmaRxId> DmaInfo;
+    void dmaRxConfigChannel()
+    {
+        enum: uint8_t { chan = Base::kDmaRxChannel };
+        enum: uint32_t { dma = Base::kDmaRxId };
+        dma_disable_channel(dma, chan);
+        dma_channel_reset(dma, chan);
+        dma_set_peripheral_address(dma, chan, Base::dmaRxDataRegister());
+        dma_set_peripheral_size(dma, chan, periphSizeCode(Base::kDmaWordSize));
+        dma_disable_peripheral_increment_mode(dma, chan);
+
+        dma_enable_memory_increment_mode(dma, chan);
+        dma_set_read_from_peripheral(dma, chan);
+        dma_set_priority(dma, chan, ((Opts & kPrioMask) >> kPrioShift) << DMA_CCR_PL_SHIFT);
+        if (Opts & kDmaCircularMode)
+        {
+            dma_enable_circular_mode(dma, chan);
+        }
+    }
 public:
     enum: uint8_t { kDmaRxIrq = DmaInfo::dmaIrqForChannel(Self::kDmaRxChannel) };
+    enum: uint8_t { kDmaRxOpts = Opts };
+    /** Owner id of the channel in the \c ChannelArbiter */
+    enum: uint32_t { kDmaRxOwnerId = Base::kPeriphId | 1 };
     volatile bool dmaRxBusy() const { return mRxBusy; }
+    /** Whether the channel is owned by us, to dispatch the interrupt of a shared channel */
+    bool dmaRxOwnsChannel() const
+    {
+        return ChannelArbiter::owner(Base::kDmaRxId, Base::kDmaRxChannel) == kDmaRxOwnerId;
+    }
     template<typename... Args>
     void init(Args... args)
     {
@@ -192,44 +392,50 @@ public:
         DMA_LOG_DEBUG("Rx: Initializing channel %, irq %, opts: %",
             (int)Base::kDmaRxChannel, (int)kDmaRxIrq, fmtHex(Opts));
 
-        enum: uint8_t { chan = Base::kDmaRxChannel };
-        enum: uint32_t { dma = Base::kDmaRxId };
-
         if (!HasTxDma<Base>::value)
         {
             rcc_periph_clock_enable(DmaInfo::kClockId);
             DMA_LOG_DEBUG("Rx: Enabled clock");
         }
-
-        dma_disable_channel(dma, chan);
-        dma_channel_reset(dma, chan);
-        dma_set_peripheral_address(dma, chan, (uint32_t)Base::dmaRxDataRegister());
-        dma_set_peripheral_size(dma, chan, periphSizeCode(Base::kDmaWordSize));
-        dma_disable_peripheral_increment_mode(dma, chan);
-
-        dma_enable_memory_increment_mode(dma, chan);
-        dma_set_read_from_peripheral(dma, chan);
-        dma_set_priority(dma, chan, ((Opts & kPrioMask) >> kPrioShift) << DMA_CCR_PL_SHIFT);
-        if (Opts & kDmaCircularMode)
+        if ((Opts & kDmaShared) == 0)
         {
-            dma_enable_circular_mode(dma, chan);
+            // Claim the channel for good, this catches conflicts with
+            // peripherals that are not in the STM32PP_DMA_REGISTRY
+            bool claimed = ChannelArbiter::claim(
+                Base::kDmaRxId, Base::kDmaRxChannel, kDmaRxOwnerId);
+            xassert(claimed, "Rx DMA channel is used by another peripheral");
+            (void)claimed;
+            dmaRxConfigChannel();
         }
-        else if ((Opts & kDmaNoDoneIntr) == 0) // Interrupt when transfer complete
+        if ((Opts & kDmaNoDoneIntr) == 0) // Interrupt when transfer complete
         {
             nvic_set_priority(kDmaRxIrq, (Opts & kIrqPrioMask) >> kIrqPrioShift);
             DMA_LOG_DEBUG("Rx: Enabled transfer complete interrupt");
         }
     }
+    /** @brief Starts receiving \c size bytes into \c data. If a reception is
+     * in progress, waits for it to complete. In shared mode, it also waits for
+     * the channel to be released by the other peripherals
+     */
     template <typename... Args>
     void dmaRxStart(const void* data, uint16_t size, Args... args)
     {
         xassert(size % Base::kDmaWordSize == 0);
         enum: uint32_t { dma = Base::kDmaRxId };
         enum: uint8_t { chan = Base::kDmaRxChannel };
-        while(mRxBusy);
+        while(mRxBusy) { STM32PP_BUSY_WAIT(); }
         mRxBusy = true;
+        if (Opts & kDmaShared)
+        {
+            ChannelArbiter::acquire(dma, chan, kDmaRxOwnerId);
+            dmaRxConfigChannel();
+        }
+        if (mRxStreaming)
+        {
+            dma_enable_half_transfer_interrupt(dma, chan);
+        }
 
-        dma_set_memory_address(dma, chan, (uint32_t)data);
+        dma_set_memory_address(dma, chan, busAddr(data));
         dma_set_memory_size(dma, chan, memSizeCode(Base::kDmaWordSize));
         dma_set_number_of_data(dma, chan, size / Base::kDmaWordSize);
         dma_enable_channel(dma, chan);
@@ -240,26 +446,155 @@ public:
         }
         Base::dmaStartPeripheralRx(args...);
     }
+    /** @brief Starts continuous reception into the circular buffer \c data.
+     * When the DMA has filled the first half of the buffer, \c halfCb is called
+     * with it, and when it has filled the second half, \c fullCb is called with
+     * that, both from the DMA interrupt. See \c RxStream for the details and
+     * the meaning of \c deferredRelease. Runs till \c dmaRxStop() is called
+     */
+    template <typename... Args>
+    void dmaRxStreamStart(void* data, uint16_t size, RxStream::Callback halfCb,
+        RxStream::Callback fullCb, void* userp, bool deferredRelease, Args... args)
+    {
+        static_assert(Opts & kDmaCircularMode, "Streaming requires kDmaCircularMode");
+        static_assert((Opts & kDmaNoDoneIntr) == 0, "Streaming requires the DMA interrupt");
+        xassert(size % (2 * Base::kDmaWordSize) == 0);
+        // The completion of a previous one-shot transfer must not be handled
+        // as a stream event
+        while(mRxBusy) { STM32PP_BUSY_WAIT(); }
+        mRxStream.start(data, size, halfCb, fullCb, userp, deferredRelease);
+        mRxStreaming = true;
+        dmaRxStart(data, size, args...);
+    }
+    /** With deferred release, called by the consumer when it's done with a half */
+    void dmaRxStreamRelease(const void* data) { mRxStream.release(data); }
+    uint32_t dmaRxOverrunCount() const { return mRxStream.overrunCount(); }
     void dmaRxIsr()
     {
-        if ((DMA_ISR(Base::kDmaRxId) & DMA_ISR_TCIF(Self::kDmaRxChannel)) == 0)
+        enum: uint32_t { dma = Base::kDmaRxId };
+        enum: uint8_t { chan = Base::kDmaRxChannel };
+        uint32_t flags = DMA_ISR(dma);
+        if (mRxStreaming)
         {
+            bool half = flags & DMA_ISR_HTIF(chan);
+            bool full = flags & DMA_ISR_TCIF(chan);
+            DMA_IFCR(dma) = (half ? DMA_IFCR_CHTIF(chan) : 0) | (full ? DMA_IFCR_CTCIF(chan) : 0);
+            mRxStream.onDmaEvents(half, full);
             return;
         }
-        DMA_IFCR(Base::kDmaRxId) |= DMA_IFCR_CTCIF(Self::kDmaRxChannel);
+        if ((flags & DMA_ISR_TCIF(chan)) == 0)
+        {
+            return;
+        }
+        DMA_IFCR(dma) |= DMA_IFCR_CTCIF(chan);
         dmaRxStop();
     }
     void dmaRxStop()
     {
         nvic_disable_irq(kDmaRxIrq);
         dma_disable_transfer_complete_interrupt(Base::kDmaRxId, Base::kDmaRxChannel);
+        if (mRxStreaming)
+        {
+            dma_disable_half_transfer_interrupt(Base::kDmaRxId, Base::kDmaRxChannel);
+            mRxStreaming = false;
+        }
         Base::dmaStopPeripheralRx();
         dma_disable_channel(Base::kDmaRxId, Base::kDmaRxChannel);
+        if (Opts & kDmaShared)
+        {
+            ChannelArbiter::release(Base::kDmaRxId, Base::kDmaRxChannel, kDmaRxOwnerId);
+        }
         mRxBusy = false;
     }
 };
+
+/** @brief Compile-time registry of the DMA channels used in a firmware.
+ * List all DMA-enabled peripherals once, at namespace scope:
+ * \code
+ * typedef dma::Tx<nsusart::Usart<USART1>> Console;
+ * typedef dma::Rx<dma::Tx<SpiMaster<SPI2>>> Flash;
+ * STM32PP_DMA_REGISTRY(Console, Flash);
+ * \endcode
+ * If two of them use the same channel, compilation fails in
+ * \c dma::NoChannelConflict<A, B>, whose arguments are the two peripherals.
+ * Peripherals that use a channel with \c kDmaShared on both sides can share it,
+ * see \c ChannelArbiter. The Tx and Rx channels are detected by the presence
+ * of the \c dma::Tx and \c dma::Rx mixins. Peripherals that are not registered
+ * are still caught at runtime, by the assert in \c init()
+ */
+constexpr uint8_t channelCode(uint32_t dma, uint8_t chan)
+{
+    return ((dma == DMA1) ? 0x10 : 0x20) | chan;
+}
+
+template <class T, bool Enabled=HasTxDma<T>::value>
+struct TxClaim
+{
+    static constexpr uint8_t code = 0;
+    static constexpr bool shared = false;
+};
+
+template <class T>
+struct TxClaim<T, true>
+{
+    static constexpr uint8_t code = channelCode(T::kDmaTxId, T::kDmaTxChannel);
+    static constexpr bool shared = (T::kDmaTxOpts & kDmaShared) != 0;
+};
+
+template <class T, bool Enabled=HasRxDma<T>::value>
+struct RxClaim
+{
+    static constexpr uint8_t code = 0;
+    static constexpr bool shared = false;
+};
+
+template <class T>
+struct RxClaim<T, true>
+{
+    static constexpr uint8_t code = channelCode(T::kDmaRxId, T::kDmaRxChannel);
+    static constexpr bool shared = (T::kDmaRxOpts & kDmaShared) != 0;
+};
+
+template <class A, class B>
+constexpr bool claimsConflict()
+{
+    return A::code && A::code == B::code && !(A::shared && B::shared);
 }
 
+template <class A, class B>
+struct NoChannelConflict
+{
+    static constexpr bool value =
+        !claimsConflict<TxClaim<A>, TxClaim<B>>() && !claimsConflict<TxClaim<A>, RxClaim<B>>() &&
+        !claimsConflict<RxClaim<A>, TxClaim<B>>() && !claimsConflict<RxClaim<A>, RxClaim<B>>();
+    static_assert(value, "Two peripherals use the same DMA channel, see the template "
+        "arguments. Use kDmaShared on both to time-share it");
+};
+
+constexpr bool allOf() { return true; }
+
+template <typename... Rest>
+constexpr bool allOf(bool first, Rest... rest) { return first && allOf(rest...); }
+
+template <class... Periphs>
+struct ChannelRegistry
+{
+    static constexpr bool value = true;
+};
+
+template <class First, class... Rest>
+struct ChannelRegistry<First, Rest...>
+{
+    static_assert(!claimsConflict<TxClaim<First>, RxClaim<First>>(),
+        "The Tx and Rx of a peripheral use the same DMA channel");
+    static constexpr bool value = allOf(NoChannelConflict<First, Rest>::value...)
+        && ChannelRegistry<Rest...>::value;
+};
+}
+
+#define STM32PP_DMA_REGISTRY(...) \
+    static_assert(dma::ChannelRegistry<__VA_ARGS__>::value, "DMA channel conflict")
+
 /** Peripheral definitions */
 STM32PP_PERIPH_INFO(DMA1)
     static constexpr rcc_periph_clken kClockId = RCC_DMA1;
@@ -0,0 +1,163 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_DMA_CHANNEL_HPP
+#define STM32PP_DMA_CHANNEL_HPP
+
+#include <libopencm3/stm32/dma.h>
+#include "atomic.hpp"
+#include "utils.hpp"
+#include "xassert.hpp"
+
+namespace dma
+{
+/** @brief Runtime ownership of the DMA channels. Each channel has an owner id,
+ * 0 if free. A \c dma::Tx or \c dma::Rx claims its channel permanently in
+ * \c init() with \c claim(), unless it's created with \c kDmaShared - then
+ * it acquires the channel when a transfer starts, reprograms it, and releases
+ * it when the transfer completes, so that several peripherals can time-share
+ * it. The owner id of a peripheral is its \c kPeriphId, with bit 0 set for
+ * the Rx direction (the ids are register block addresses, so bit 0 is free).
+ * Acquiring is lock-free and can be done from interrupts, but waiting for a
+ * channel with interrupts disabled would deadlock, as it's released from the
+ * DMA interrupt of the current owner. Code that can't wait registers a
+ * callback with \c notifyOnRelease() instead, and retries from it.
+ * The peripherals that share a channel share its interrupt too, the handler
+ * has to dispatch to the current owner:
+ * \code
+ * void dma1_channel4_isr()
+ * {
+ *     if (usart1.dmaTxOwnsChannel())
+ *         usart1.dmaTxIsr();
+ *     else if (spi2.dmaRxOwnsChannel())
+ *         spi2.dmaRxIsr();
+ * }
+ * \endcode
+ */
+class ChannelArbiter
+{
+protected:
+    enum: uint8_t { kDma1Channels = 7, kDma2Channels = 5 };
+    static uint8_t index(uint32_t dma, uint8_t chan)
+    {
+        return (dma == DMA1 ? 0 : kDma1Channels) + chan - 1;
+    }
+    static volatile uint32_t* ownerPtr(uint32_t dma, uint8_t chan)
+    {
+        static volatile uint32_t owners[kDma1Channels + kDma2Channels] = {};
+        return &owners[index(dma, chan)];
+    }
+    /** Bit N set - channel with index N is claimed permanently */
+    static volatile uint32_t* claimedPtr()
+    {
+        static volatile uint32_t claimed = 0;
+        return &claimed;
+    }
+    static void setClaimed(uint32_t dma, uint8_t chan, bool claimed)
+    {
+        uint32_t bit = 1u << index(dma, chan);
+        uint32_t val = atomicLoad(claimedPtr());
+        while (!atomicCas(claimedPtr(), val, claimed ? (val | bit) : (val & ~bit)));
+    }
+public:
+    typedef void(*ReleaseCallback)(void* userp);
+protected:
+    struct Waiter
+    {
+        ReleaseCallback cb;
+        void* userp;
+    };
+    static Waiter& waiter(uint32_t dma, uint8_t chan)
+    {
+        static Waiter waiters[kDma1Channels + kDma2Channels] = {};
+        return waiters[index(dma, chan)];
+    }
+public:
+    enum: uint32_t
+    {
+        kNoOwner = 0,
+        kOwnerMemCopy = 2 // dma::MemCopy
+    };
+    static uint32_t owner(uint32_t dma, uint8_t chan)
+    {
+        return atomicLoad(ownerPtr(dma, chan));
+    }
+    /** @brief Acquires the channel for \c id if it's free
+     * @return \c true if the channel is now owned by \c id, including when it
+     * already was
+     */
+    static bool tryAcquire(uint32_t dma, uint8_t chan, uint32_t id)
+    {
+        uint32_t expected = kNoOwner;
+        return atomicCas(ownerPtr(dma, chan), expected, id) || expected == id;
+    }
+    /** Waits till the channel is free and acquires it for \c id */
+    static void acquire(uint32_t dma, uint8_t chan, uint32_t id)
+    {
+        while (!tryAcquire(dma, chan, id))
+        {
+            STM32PP_BUSY_WAIT();
+        }
+    }
+    /** @brief Acquires the channel for good, for a peripheral that doesn't
+     * share it
+     * @return \c false if the channel is owned by another peripheral
+     */
+    static bool claim(uint32_t dma, uint8_t chan, uint32_t id)
+    {
+        if (!tryAcquire(dma, chan, id))
+        {
+            return false;
+        }
+        setClaimed(dma, chan, true);
+        return true;
+    }
+    /** Whether the channel is owned by a peripheral that doesn't share it, i.e.
+     * waiting for it would never end */
+    static bool isClaimed(uint32_t dma, uint8_t chan)
+    {
+        return (atomicLoad(claimedPtr()) & (1u << index(dma, chan))) != 0;
+    }
+    /** @brief Registers \c cb to be called once, by the next \c release() of
+     * the channel - i.e. from the context of its current owner, usually its
+     * DMA interrupt. A channel has a single waiter, registering the same one
+     * again has no effect. Must be called with interrupts disabled.
+     * @return \c false if the channel is free, then \c cb is not registered
+     */
+    static bool notifyOnRelease(uint32_t dma, uint8_t chan, ReleaseCallback cb, void* userp)
+    {
+        Waiter& w = waiter(dma, chan);
+        xassert(!w.cb || (w.cb == cb && w.userp == userp),
+            "Another waiter is registered for the DMA channel");
+        if (owner(dma, chan) == kNoOwner)
+        {
+            return false;
+        }
+        w.userp = userp;
+        w.cb = cb;
+        return true;
+    }
+    /** Releases the channel, if it's owned by \c id, and calls the callback
+     * registered by \c notifyOnRelease(), if any */
+    static void release(uint32_t dma, uint8_t chan, uint32_t id)
+    {
+        uint32_t expected = id;
+        if (!atomicCas(ownerPtr(dma, chan), expected, kNoOwner))
+        {
+            return;
+        }
+        setClaimed(dma, chan, false);
+        Waiter& w = waiter(dma, chan);
+        ReleaseCallback cb = w.cb;
+        if (cb)
+        {
+            w.cb = nullptr;
+            cb(w.userp);
+        }
+    }
+};
+}
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_DMA_MEMCOPY_HPP
+#define STM32PP_DMA_MEMCOPY_HPP
+
+#include "dma.hpp"
+#include <string.h>
+
+namespace dma
+{
+/** @brief Copies and fills memory blocks with a DMA channel in memory-to-memory
+ * mode, in the background. \c copy() and \c fill() start the operation and
+ * return, \c wait() waits for it to complete. Starting an operation while
+ * another one is in progress waits for the previous one first.
+ * The operation is done on the CPU, synchronously, when:
+ * - the channel is in use by a peripheral - it's enabled, or it's owned
+ *   by another user in the \c ChannelArbiter
+ * - the block is shorter than \c MinDmaSize - setting up the DMA costs more
+ * - the block has more than 65535 units of the widest transfer size that
+ *   the alignment of the addresses and the size allows
+ * The transfer size is 32-bit if the addresses and the size are 4-byte aligned,
+ * 16-bit if they are 2-byte aligned, otherwise 8-bit.
+ * No interrupt is used - completion is polled. While the DMA copies,
+ * it shares the bus matrix with the CPU, so the CPU runs slower if it
+ * accesses SRAM meanwhile.
+ * @param Dma The DMA controller - \c DMA1 or \c DMA2
+ * @param Chan The channel. Any channel can do memory-to-memory transfers
+ */
+template <uint32_t Dma=DMA1, uint8_t Chan=7, uint16_t MinDmaSize=64>
+class MemCopy
+{
+protected:
+    typedef PeriphInfo<Dma> DmaInfo;
+    uint32_t mFillWord; // source of fill() - the DMA reads it repeatedly
+    bool mActive = false;
+    static uint8_t wordSize(uintptr_t addrs, size_t size)
+    {
+        uintptr_t bits = addrs | size;
+        return (bits & 3) == 0 ? 4 : ((bits & 1) == 0 ? 2 : 1);
+    }
+    bool start(void* dst, const void* src, size_t size, bool incSrc)
+    {
+        wait();
+        if (size < MinDmaSize || dmaChannelIsBusy(Dma, Chan))
+        {
+            return false;
+        }
+        uint8_t width = wordSize((uintptr_t)dst | (incSrc ? (uintptr_t)src : 0), size);
+        if (size / width > 0xffff ||
+            !ChannelArbiter::tryAcquire(Dma, Chan, ChannelArbiter::kOwnerMemCopy))
+        {
+            return false;
+        }
+        dma_channel_reset(Dma, Chan);
+        dma_enable_mem2mem_mode(Dma, Chan);
+        // The source is the 'peripheral' side
+        dma_set_read_from_peripheral(Dma, Chan);
+        dma_set_peripheral_address(Dma, Chan, busAddr(src));
+        dma_set_memory_address(Dma, Chan, busAddr(dst));
+        dma_set_peripheral_size(Dma, Chan, periphSizeCode(width));
+        dma_set_memory_size(Dma, Chan, memSizeCode(width));
+        if (incSrc)
+        {
+            dma_enable_peripheral_increment_mode(Dma, Chan);
+        }
+        dma_enable_memory_increment_mode(Dma, Chan);
+        dma_set_priority(Dma, Chan, DMA_CCR_PL_LOW);
+        dma_set_number_of_data(Dma, Chan, size / width);
+        mActive = true;
+        dma_enable_channel(Dma, Chan);
+        return true;
+    }
+public:
+    void init()
+    {
+        rcc_periph_clock_enable(DmaInfo::kClockId);
+    }
+    /** @brief Starts copying \c size bytes from \c src to \c dst. The blocks
+     * must not overlap
+     * @return \c true if the copy is done by the DMA, \c false if it was
+     * done on the CPU and is already complete
+     */
+    bool copy(void* dst, const void* src, size_t size)
+    {
+        if (start(dst, src, size, true))
+        {
+            return true;
+        }
+        memcpy(dst, src, size);
+        return false;
+    }
+    /** @brief Starts filling \c size bytes at \c dst with \c val
+     * @return \c true if the fill is done by the DMA, \c false if it was
+     * done on the CPU and is already complete
+     */
+    bool fill(void* dst, uint8_t val, size_t size)
+    {
+        wait();
+        mFillWord = val * 0x01010101u;
+        if (start(dst, &mFillWord, size, false))
+        {
+            return true;
+        }
+        memset(dst, val, size);
+        return false;
+    }
+    bool busy() const
+    {
+        return mActive && (DMA_ISR(Dma) & (DMA_ISR_TCIF(Chan) | DMA_ISR_TEIF(Chan))) == 0;
+    }
+    /** @brief Waits for the current operation, if any, to complete
+     * @return \c false if the DMA reported a transfer error
+     */
+    bool wait()
+    {
+        if (!mActive)
+        {
+            return true;
+        }
+        while (busy());
+        bool ok = (DMA_ISR(Dma) & DMA_ISR_TEIF(Chan)) == 0;
+        DMA_IFCR(Dma) = DMA_IFCR_CGIF(Chan);
+        dma_disable_channel(Dma, Chan);
+        ChannelArbiter::release(Dma, Chan, ChannelArbiter::kOwnerMemCopy);
+        mActive = false;
+        return ok;
+    }
+};
+}
+
+#endif
@@ -2,14 +2,20 @@
 #define DMA_PRINT_HPP
 
 #include "printSink.hpp"
+#include "utils.hpp"
 namespace dma
 {
+/** @brief Async print sink that sends each message via DMA, from the buffer it
+ * was formatted in. The sink keeps that buffer till the next message. It's
+ * allocated by \c ftprintf() - from the heap, or with \c STM32PP_PRINT_BUF_POOL,
+ * it's a block of the print buffer pool
+ */
 template <class DmaDevice>
 class PrintSink: public DmaDevice, public AsyncPrintSink
 {
     virtual IPrintSink::BufferInfo* waitReady()
     {
-        while(DmaDevice::txBusy());
+        while(DmaDevice::txBusy()) { STM32PP_BUSY_WAIT(); }
         return &mPrintBuffer;
     }
     virtual void print(const char *str, size_t len, int bufSize)
@@ -20,6 +26,212 @@ class PrintSink: public DmaDevice, public AsyncPrintSink
         DmaDevice::dmaTxStart((const void*)str, len);
     }
 };
+
+/** @brief Print sink that sends its ring buffer via DMA. \c tprintf() formats
+ * directly into the ring, while the previous messages are being sent.
+ * The DMA Tx interrupt handler must call \c dmaTxIsr() of this class.
+ * When the ring is full, the caller waits for the DMA to free space
+ */
+template <class DmaDevice, size_t Size=512>
+class RingPrintSink: public DmaDevice, public ::RingPrintSink<Size>
+{
+protected:
+    typedef ::RingPrintSink<Size> Ring;
+    volatile size_t mTxLen = 0;
+    // Called with interrupts disabled, or from the DMA interrupt
+    void startTx()
+    {
+        const char* data;
+        size_t len = Ring::pending(data);
+        if (!len)
+        {
+            return;
+        }
+        if (len > 0xffff)
+        {
+            len = 0xffff;
+        }
+        mTxLen = len;
+        DmaDevice::dmaTxStart((const void*)data, len);
+    }
+    virtual void drain()
+    {
+        IntrDisable noIntr;
+        if (!DmaDevice::txBusy())
+        {
+            startTx();
+        }
+    }
+    virtual bool waitForSpace()
+    {
+        if (!DmaDevice::txBusy())
+        {
+            return false; // nothing to wait for, the message is larger than the ring
+        }
+        size_t readPos = Ring::mReadPos;
+        while (DmaDevice::txBusy() && Ring::mReadPos == readPos)
+        {
+            STM32PP_BUSY_WAIT();
+        }
+        return true;
+    }
+public:
+    void dmaTxIsr()
+    {
+        DmaDevice::dmaTxIsr();
+        if (!DmaDevice::txBusy())
+        {
+            Ring::consumed(mTxLen);
+            startTx();
+        }
+    }
+};
+
+/** @brief Multi-producer print sink, that sends its ring buffer via DMA. Any
+ * context, including interrupts of any priority, can log at any time, without
+ * disabling interrupts. See \c ::MpscPrintSink for the details.
+ * The DMA Tx interrupt handler must call \c dmaTxIsr() of this class.
+ * Messages that don't fit in the free space of the ring are dropped, see
+ * \c droppedCount()
+ */
+template <class DmaDevice, size_t Size=512>
+class MpscPrintSink: public DmaDevice, public ::MpscPrintSink<Size>
+{
+protected:
+    typedef ::MpscPrintSink<Size> Ring;
+    volatile uint32_t mTxOwner = 0; // set while a context is the consumer of the ring
+    size_t mTxLen = 0;
+    // Called only by the consumer
+    void startTx()
+    {
+        for (;;)
+        {
+            const char* data;
+            size_t len = Ring::pending(data);
+            if (len)
+            {
+                if (len > 0xffff)
+                {
+                    len = 0xffff;
+                }
+                mTxLen = len;
+                DmaDevice::dmaTxStart((const void*)data, len);
+                return;
+            }
+            atomicStore(&mTxOwner, 0);
+            // A message may have been committed after pending() returned, and its
+            // drain() didn't start the output, because we were still the consumer
+            uint32_t expected = 0;
+            if (!Ring::hasPending() || !atomicCas(&mTxOwner, expected, 1))
+            {
+                return;
+            }
+        }
+    }
+    virtual void drain()
+    {
+        uint32_t expected = 0;
+        if (atomicCas(&mTxOwner, expected, 1))
+        {
+            startTx();
+        }
+    }
+public:
+    void dmaTxIsr()
+    {
+        DmaDevice::dmaTxIsr();
+        if (!DmaDevice::txBusy())
+        {
+            Ring::consumed(mTxLen);
+            startTx();
+        }
+    }
+};
+
+/** @brief Print sink with two buffers, that are sent alternately via DMA.
+ * While one buffer is being sent, \c tprintf() formats directly into the
+ * other one, and short messages are appended to it, so that a burst of
+ * messages is sent with a single transfer, instead of one transfer per message.
+ * The caller waits only when the buffer being filled doesn't have space for
+ * the message, until the other one is sent. Messages longer than \c BufSize
+ * are dropped. Writes are by a single context at a time, as with
+ * \c RingPrintSink. The DMA Tx interrupt handler must call \c dmaTxIsr() of
+ * this class
+ */
+template <class DmaDevice, size_t BufSize=128>
+class PingPongPrintSink: public DmaDevice, public IRingPrintSink
+{
+    static_assert(BufSize <= 0xffff, "Buffer is larger than the maximum DMA transfer");
+protected:
+    char mBufs[2][BufSize];
+    volatile uint8_t mFillIdx = 0; // the buffer being filled, the other one is being sent
+    volatile size_t mFill = 0;
+    // Set between reserve() and commit(), so that the interrupt handler
+    // doesn't send the buffer while it's being written to
+    volatile bool mWriting = false;
+    // Called with interrupts disabled, or from the DMA interrupt, when the DMA is idle
+    void startTx()
+    {
+        size_t len = mFill;
+        if (!len)
+        {
+            return;
+        }
+        const char* data = mBufs[mFillIdx];
+        mFillIdx = !mFillIdx;
+        mFill = 0;
+        DmaDevice::dmaTxStart((const void*)data, len);
+    }
+public:
+    virtual bool reserve(Span& first, Span& second, size_t minSize)
+    {
+        if (minSize > BufSize)
+        {
+            mWriting = false;
+            return false;
+        }
+        mWriting = true;
+        while (BufSize - mFill < minSize)
+        {
+            {
+                IntrDisable noIntr;
+                if (!DmaDevice::txBusy())
+                {
+                    startTx();
+                    continue; // the buffer being filled is now empty
+                }
+            }
+            while (DmaDevice::txBusy())
+            {
+                STM32PP_BUSY_WAIT();
+            }
+        }
+        first.buf = mBufs[mFillIdx] + mFill;
+        first.size = BufSize - mFill;
+        second.buf = nullptr;
+        second.size = 0;
+        return true;
+    }
+    virtual void commit(size_t len)
+    {
+        assert(len <= BufSize - mFill);
+        mFill = mFill + len;
+        mWriting = false;
+        IntrDisable noIntr;
+        if (!DmaDevice::txBusy())
+        {
+            startTx();
+        }
+    }
+    void dmaTxIsr()
+    {
+        DmaDevice::dmaTxIsr();
+        if (!DmaDevice::txBusy() && !mWriting)
+        {
+            startTx();
+        }
+    }
+};
 }
 
 #endif
@@ -0,0 +1,214 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_DMA_RX_RING_HPP
+#define STM32PP_DMA_RX_RING_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+namespace dma
+{
+/** @brief Consumer side of a circular DMA receive buffer, used as a ring.
+ * The DMA writes continuously into the buffer, and the producer position is
+ * taken from the number of remaining transfers of the channel (CNDTR), passed
+ * to \c update(). It must be called at least twice per lap of the DMA, which is
+ * ensured by calling it from the half-transfer and transfer-complete interrupts.
+ * Positions are kept as free-running byte counts, so that the amount of data
+ * and the packet boundaries survive the wrap-around of the buffer. The counts
+ * wrap around at 2^32, which is not a multiple of an arbitrary buffer size, so
+ * the consumer's index in the buffer is kept separately.
+ * When the producer gets more than a buffer ahead of the consumer, the oldest
+ * data has been overwritten - the lost bytes are counted as overrun, and the
+ * consumer skips to the oldest byte that is still intact.
+ * Packet ends, e.g. detected by the USART idle line interrupt, are recorded by
+ * \c markPacketEnd(), up to \c MaxPackets pending ones. When they are more,
+ * the last packets are merged.
+ * This class only tracks the state, and doesn't do any locking. The DMA and
+ * USART interrupts and the consumer must access it with interrupts disabled,
+ * see \c nsusart::DmaRxRing
+ */
+template <uint8_t MaxPackets=8>
+class RxRing
+{
+protected:
+    uint8_t* mBuf = nullptr;
+    uint16_t mSize = 0;
+    uint16_t mLastPos = 0; // DMA write position at the last update
+    uint32_t mWritten = 0; // total bytes written by the DMA
+    uint32_t mRead = 0; // total bytes consumed
+    uint16_t mReadIdx = 0; // position of the consumer in the buffer
+    uint32_t mPacketEnds[MaxPackets];
+    uint8_t mPacketHead = 0;
+    uint8_t mPacketCount = 0;
+    volatile uint32_t mOverrunBytes = 0;
+    void consume(uint32_t count)
+    {
+        mRead += count;
+        mReadIdx = (mReadIdx + count % mSize) % mSize;
+        // drop the boundaries that are now behind the consumer
+        while (mPacketCount && (int32_t)(mPacketEnds[mPacketHead] - mRead) <= 0)
+        {
+            popPacket();
+        }
+    }
+    void popPacket()
+    {
+        mPacketHead = (mPacketHead + 1) % MaxPackets;
+        mPacketCount--;
+    }
+    /** Copies \c count bytes from the consumer position, without consuming them */
+    void copyOut(void* dest, uint32_t count) const
+    {
+        uint16_t start = mReadIdx;
+        uint16_t first = mSize - start;
+        if (count <= first)
+        {
+            memcpy(dest, mBuf + start, count);
+        }
+        else
+        {
+            memcpy(dest, mBuf + start, first);
+            memcpy((uint8_t*)dest + first, mBuf, count - first);
+        }
+    }
+    /** The byte at \c offset from the consumer position */
+    uint8_t at(uint32_t offset) const { return mBuf[(mReadIdx + offset) % mSize]; }
+public:
+    /** @param size The size of the DMA transfer, i.e. the initial CNDTR */
+    void start(void* buf, uint16_t size)
+    {
+        assert(size);
+        mBuf = (uint8_t*)buf;
+        mSize = size;
+        mLastPos = 0;
+        mWritten = mRead = 0;
+        mReadIdx = 0;
+        mPacketHead = mPacketCount = 0;
+        mOverrunBytes = 0;
+    }
+    /** Updates the producer position from the remaining transfers of the
+     * DMA channel. Must be called with interrupts disabled, or from an ISR */
+    void update(uint16_t dmaRemaining)
+    {
+        uint16_t pos = (mSize - dmaRemaining) % mSize;
+        mWritten += (uint32_t)(pos + mSize - mLastPos) % mSize;
+        mLastPos = pos;
+        if (mWritten - mRead > mSize)
+        {
+            uint32_t lost = mWritten - mRead - mSize;
+            mOverrunBytes = mOverrunBytes + lost;
+            consume(lost);
+        }
+    }
+    /** Records a packet boundary at the current producer position. Called
+     * after \c update(), typically on the idle line interrupt */
+    void markPacketEnd()
+    {
+        uint32_t last = mPacketCount
+            ? mPacketEnds[(mPacketHead + mPacketCount - 1) % MaxPackets]
+            : mRead;
+        if (mWritten == last)
+        {
+            return; // empty packet
+        }
+        if (mPacketCount < MaxPackets)
+        {
+            mPacketCount++;
+        }
+        mPacketEnds[(mPacketHead + mPacketCount - 1) % MaxPackets] = mWritten;
+    }
+    /** Number of bytes received and not consumed yet */
+    uint32_t available() const { return mWritten - mRead; }
+    /** Number of complete packets that can be read by \c readPacket() */
+    uint8_t packetCount() const { return mPacketCount; }
+    /** Number of bytes that were overwritten before they were consumed */
+    uint32_t overrunBytes() const { return mOverrunBytes; }
+    /** Reads up to \c size of the received bytes, regardless of packets.
+     * @return The number of bytes read */
+    size_t read(void* buf, size_t size)
+    {
+        uint32_t count = available();
+        if (count > size)
+        {
+            count = size;
+        }
+        copyOut(buf, count);
+        consume(count);
+        return count;
+    }
+    /** Reads the next complete packet.
+     * @return The size of the packet, 0 if there is no complete packet, or
+     * \c (size_t)-1 if it didn't fit in \c bufsize. In the latter case, the
+     * packet is discarded
+     */
+    size_t readPacket(void* buf, size_t bufsize)
+    {
+        if (!mPacketCount)
+        {
+            return 0;
+        }
+        uint32_t len = mPacketEnds[mPacketHead] - mRead;
+        if (len > bufsize)
+        {
+            consume(len);
+            return (size_t)-1;
+        }
+        copyOut(buf, len);
+        consume(len);
+        return len;
+    }
+    /** Reads the next line, terminated by \c \\r or \c \\n, without the
+     * terminator, and null-terminates it. Empty lines are skipped, so that
+     * \c \\r\\n is a single line end.
+     * @return The length of the line, 0 if there is no complete line yet, or
+     * \c (size_t)-1 if the line didn't fit in \c bufsize. In the latter case,
+     * \c bufsize-1 chars of it are returned, as in \c Usart::recvLine()
+     */
+    size_t readLine(char* buf, size_t bufsize)
+    {
+        assert(bufsize > 1);
+        while (available())
+        {
+            char ch = at(0);
+            if (ch != '\r' && ch != '\n')
+            {
+                break;
+            }
+            consume(1);
+        }
+        uint32_t avail = available();
+        uint32_t maxLen = bufsize - 1;
+        for (uint32_t len = 0; len < avail; len++)
+        {
+            char ch = at(len);
+            if (ch != '\r' && ch != '\n')
+            {
+                continue;
+            }
+            if (len > maxLen)
+            {
+                break;
+            }
+            copyOut(buf, len);
+            buf[len] = 0;
+            consume(len + 1);
+            return len;
+        }
+        if (avail < maxLen)
+        {
+            buf[0] = 0;
+            return 0;
+        }
+        copyOut(buf, maxLen);
+        buf[maxLen] = 0;
+        consume(maxLen);
+        return (size_t)-1;
+    }
+};
+}
+
+#endif
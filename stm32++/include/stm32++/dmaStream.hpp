@@ -0,0 +1,131 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_DMA_STREAM_HPP
+#define STM32PP_DMA_STREAM_HPP
+
+#include <stdint.h>
+#include <assert.h>
+#include "utils.hpp"
+
+namespace dma
+{
+/** @brief Double-buffer streaming over a circular DMA receive buffer.
+ * The buffer is split in two halves. When the DMA has filled one half (the
+ * half-transfer and transfer-complete interrupts), that half is stable while
+ * the DMA fills the other one, and it's handed over to the consumer via the
+ * half-complete or the full-complete callback, from the DMA interrupt.
+ * By default, the consumer is done with the half when the callback returns.
+ * With deferred release, the consumer keeps it (e.g. processes it in the main
+ * loop), and calls \c release() with the pointer it received, when done.
+ * An overrun is counted when the DMA starts overwriting a half that the
+ * consumer still holds, and when the interrupt handler was so late that both
+ * halves completed since it last ran.
+ * This class only tracks the state, the DMA interrupt handler feeds it the
+ * interrupt flags, see \c dma::Rx::dmaRxStreamStart()
+ */
+class RxStream
+{
+public:
+    /** Called with the stable half of the buffer. \c size is in bytes */
+    typedef void(*Callback)(const void* data, uint16_t size, void* userp);
+protected:
+    const uint8_t* mBuf = nullptr;
+    uint16_t mHalfSize = 0;
+    Callback mHalfCb = nullptr;
+    Callback mFullCb = nullptr;
+    void* mUserp = nullptr;
+    bool mDeferredRelease = false;
+    uint8_t mNextHalf = 0; // the half that the DMA is currently filling
+    volatile uint8_t mHeld = 0; // bit N set - half N is held by the consumer
+    volatile uint32_t mOverruns = 0;
+    /** @param hold Whether the consumer holds the half with deferred release.
+     * Not the case for a half that the DMA is already overwriting */
+    void deliver(uint8_t half, bool hold=true)
+    {
+        uint8_t other = half ^ 1;
+        if (mHeld & (1 << other)) // the DMA is now overwriting it
+        {
+            mOverruns = mOverruns + 1;
+            mHeld = mHeld & ~(1 << other);
+        }
+        if (hold)
+        {
+            mHeld = mHeld | (1 << half);
+        }
+        mNextHalf = other;
+        auto cb = half ? mFullCb : mHalfCb;
+        if (cb)
+        {
+            cb(mBuf + half * mHalfSize, mHalfSize, mUserp);
+        }
+        if (!mDeferredRelease)
+        {
+            mHeld = mHeld & ~(1 << half);
+        }
+    }
+public:
+    void start(const void* buf, uint16_t size, Callback halfCb, Callback fullCb,
+        void* userp, bool deferredRelease=false)
+    {
+        assert(size % 2 == 0);
+        mBuf = (const uint8_t*)buf;
+        mHalfSize = size / 2;
+        mHalfCb = halfCb;
+        mFullCb = fullCb;
+        mUserp = userp;
+        mDeferredRelease = deferredRelease;
+        mNextHalf = 0;
+        mHeld = 0;
+        mOverruns = 0;
+    }
+    /** Called from the DMA interrupt, with the state of the half-transfer
+     * and transfer-complete flags */
+    void onDmaEvents(bool halfDone, bool fullDone)
+    {
+        if (halfDone && fullDone)
+        {
+            // Both halves completed since the last interrupt, the older
+            // one is already being overwritten. This is a single overrun,
+            // whatever the consumer still holds is overwritten as well
+            mOverruns = mOverruns + 1;
+            mHeld = 0;
+            deliver(mNextHalf, false);
+            deliver(mNextHalf);
+            return;
+        }
+        uint8_t half;
+        if (halfDone)
+        {
+            half = 0;
+        }
+        else if (fullDone)
+        {
+            half = 1;
+        }
+        else
+        {
+            return;
+        }
+        if (half != mNextHalf) // an interrupt was lost
+        {
+            mOverruns = mOverruns + 1;
+        }
+        deliver(half);
+    }
+    /** With deferred release, the consumer is done with the half at \c data */
+    void release(const void* data)
+    {
+        assert(data == mBuf || data == mBuf + mHalfSize);
+        IntrDisable noIntr;
+        mHeld = mHeld & ~(1 << (data != mBuf));
+    }
+    uint16_t halfSize() const { return mHalfSize; }
+    /** Number of times the consumer fell behind, and data was overwritten */
+    uint32_t overrunCount() const { return mOverruns; }
+};
+}
+
+#endif
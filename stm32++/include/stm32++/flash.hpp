@@ -11,23 +11,25 @@
     #endif
     #include <libopencm3/stm32/flash.h>
     #include <libopencm3/stm32/desig.h>
-
-    #ifdef STM32PP_FLASH_DEBUG
-        #include <stm32++/tprintf.hpp>
-        #define STM32PP_FLASH_LOG(fmtString,...) tprintf("FLASH: " fmtString "\n", ##__VA_ARGS__)
-    #else
-        #define STM32PP_FLASH_LOG(fmtString,...)
-    #endif
 #else
     #include <assert.h>
     #include <memory.h>
     #include <stdio.h>
-    #define STM32PP_FLASH_LOG(fmtString,...) printf("FLASH: " fmtString "\n", ##__VA_ARGS__)
+#endif
+#include <stm32++/log.hpp>
+
+// On the target, flash logging is disabled unless STM32PP_FLASH_DEBUG is defined
+#ifndef STM32PP_LOG_LEVEL_FLASH
+    #if defined(STM32PP_FLASH_DEBUG) || !defined(__arm__)
+        #define STM32PP_LOG_LEVEL_FLASH kLogLevelDebug
+    #else
+        #define STM32PP_LOG_LEVEL_FLASH kLogLevelNone
+    #endif
 #endif
 
-#define STM32PP_FLASH_LOG_ERROR(fmtString,...) STM32PP_FLASH_LOG("ERROR: " fmtString, ##__VA_ARGS__)
-#define STM32PP_FLASH_LOG_WARNING(fmtString,...) STM32PP_FLASH_LOG("WARN: " fmtString, ##__VA_ARGS__)
-#define STM32PP_FLASH_LOG_DEBUG(fmtString,...) STM32PP_FLASH_LOG("DEBUG: " fmtString, ##__VA_ARGS__)
+#define STM32PP_FLASH_LOG_ERROR(fmtString,...) STM32PP_LOG(FLASH, Error, fmtString, ##__VA_ARGS__)
+#define STM32PP_FLASH_LOG_WARNING(fmtString,...) STM32PP_LOG(FLASH, Warning, fmtString, ##__VA_ARGS__)
+#define STM32PP_FLASH_LOG_DEBUG(fmtString,...) STM32PP_LOG(FLASH, Debug, fmtString, ##__VA_ARGS__)
 
 namespace flash
 {
@@ -443,7 +445,7 @@ public:
             {
                 return false;
             }
-            STM32PP_FLASH_LOG_DEBUG("Compacted to % bytes\n", Driver::pageSize()-pageBytesFree());
+            STM32PP_FLASH_LOG_DEBUG("Compacted to % bytes", Driver::pageSize()-pageBytesFree());
             bytesFree = pageBytesFree();
             if (bytesNeeded > bytesFree)
             {
@@ -617,8 +619,8 @@ protected:
     }
     static bool write16Block(uint8_t* dest, const uint8_t* src, uint16_t wordCnt)
     {
-        assert(((uint32_t)dest & 0x1) == 0);
-        assert(((uint32_t)src & 0x1) == 0);
+        assert(addressIsEven(dest));
+        assert(addressIsEven(src));
         uint16_t* wptr = (uint16_t*)dest;
         uint16_t* rptr = (uint16_t*)src;
         uint16_t* rend = rptr + wordCnt;
@@ -0,0 +1,182 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_FMTARG_HPP
+#define STM32PP_FMTARG_HPP
+
+/** @brief Type-erased tsnprintf() backend.
+ * Enabled by defining \c STM32PP_TSNPRINTF_TYPE_ERASED globally. The variadic
+ * \c tsnprintf() and \c tformattedLength() front ends then only pack their
+ * arguments in an array of \c FmtArg tagged unions, and a single non-template
+ * function in src/tsnprintf.cpp does all the formatting. This way, the code
+ * generated per distinct combination of argument types is only the packing of
+ * the arguments, instead of a whole recursive chain of formatting functions,
+ * which saves flash in firmwares that log a lot, at the cost of a few cycles
+ * per argument. The output is exactly the same as with the default backend.
+ */
+
+#include "tostring.hpp"
+
+struct FmtArg
+{
+    enum: uint8_t {
+        kU32 = 0, kI32, kU64, kI64, kChar, kStr, kFloat, kDouble,
+        kRptChar, kQ, kScaled,
+        kTypeMask = 0x7f,
+        kNegative = 0x80 //< For kQ and kScaled, the value is stored as absolute value
+    };
+    union
+    {
+        uint32_t u32;
+        uint64_t u64;
+        float f32;
+        double f64;
+        const char* str;
+    };
+    union
+    {
+        struct
+        {
+            Flags flags;
+            uint8_t minDigits;
+            uint8_t minLen;
+        } num;              //< integer and floating point types
+        uint32_t divisor;   //< kScaled
+        uint16_t count;     //< kRptChar
+        uint8_t fracBits;   //< kQ
+    };
+    uint8_t type;
+    uint8_t prec;           //< kQ and kScaled
+};
+
+/** Packing functions for each type that toString() supports */
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, char>::value, FmtArg>::type
+toFmtArg(T val, Flags flags=10, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    FmtArg arg;
+    if (sizeof(T) <= sizeof(uint32_t))
+    {
+        arg.type = std::is_signed<T>::value ? FmtArg::kI32 : FmtArg::kU32;
+        arg.u32 = (uint32_t)val;
+    }
+    else
+    {
+        arg.type = std::is_signed<T>::value ? FmtArg::kI64 : FmtArg::kU64;
+        arg.u64 = (uint64_t)val;
+    }
+    arg.num.flags = flags;
+    arg.num.minDigits = minDigits;
+    arg.num.minLen = minLen;
+    return arg;
+}
+
+static inline FmtArg toFmtArg(char val)
+{
+    FmtArg arg;
+    arg.type = FmtArg::kChar;
+    arg.u32 = val;
+    return arg;
+}
+
+static inline FmtArg toFmtArg(const char* val)
+{
+    FmtArg arg;
+    arg.type = FmtArg::kStr;
+    arg.str = val;
+    return arg;
+}
+
+template <typename T, Flags flags>
+FmtArg toFmtArg(IntFmt<T, flags> val)
+{
+    return toFmtArg(val.value, val.flags, val.minDigits, val.minLen);
+}
+
+template <class P>
+typename std::enable_if<std::is_pointer<P>::value && !is_char_ptr<P>::value, FmtArg>::type
+toFmtArg(P ptr)
+{
+    return toFmtArg(fmtPtr(ptr));
+}
+
+static inline FmtArg toFmtArg(float val, Flags flags=6, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    FmtArg arg;
+    arg.type = FmtArg::kFloat;
+    arg.f32 = val;
+    arg.num.flags = flags;
+    arg.num.minDigits = minDigits;
+    arg.num.minLen = minLen;
+    return arg;
+}
+
+static inline FmtArg toFmtArg(double val, Flags flags=6, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    FmtArg arg;
+    arg.type = FmtArg::kDouble;
+    arg.f64 = val;
+    arg.num.flags = flags;
+    arg.num.minDigits = minDigits;
+    arg.num.minLen = minLen;
+    return arg;
+}
+
+/** long double is formatted with double precision, same as toString() does */
+static inline FmtArg toFmtArg(long double val, Flags flags=6, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    return toFmtArg((double)val, flags, minDigits, minLen);
+}
+
+template <typename T, Flags flags>
+FmtArg toFmtArg(FpFmt<T, flags> val)
+{
+    return toFmtArg(val.value, val.flags, val.minDigits, val.minLen);
+}
+
+template <uint8_t flags>
+FmtArg toFmtArg(RptChar<flags> val)
+{
+    FmtArg arg;
+    arg.type = FmtArg::kRptChar;
+    arg.u32 = val.ch();
+    arg.count = val.count();
+    return arg;
+}
+
+template <typename T, uint8_t fracBits>
+FmtArg toFmtArg(QFmt<T, fracBits> val)
+{
+    FmtArg arg;
+    bool negative;
+    arg.u64 = absUnsigned(val.value, negative);
+    arg.type = FmtArg::kQ | (negative ? FmtArg::kNegative : 0);
+    arg.fracBits = fracBits;
+    arg.prec = val.prec;
+    return arg;
+}
+
+template <typename T, uint32_t divisor>
+FmtArg toFmtArg(ScaledFmt<T, divisor> val)
+{
+    FmtArg arg;
+    bool negative;
+    arg.u64 = absUnsigned(val.value, negative);
+    arg.type = FmtArg::kScaled | (negative ? FmtArg::kNegative : 0);
+    arg.divisor = divisor;
+    arg.prec = val.prec;
+    return arg;
+}
+
+/** The formatting core. Same semantics as \c toString<kDontNullTerminate>()
+ * and \c toStringLen() of the packed value */
+char* fmtArgToString(char* buf, size_t bufsize, const FmtArg& arg);
+size_t fmtArgLen(const FmtArg& arg);
+
+/** Same as \c tsnprintf() and \c tformattedLength(), with packed arguments */
+char* vtsnprintf(char* buf, size_t bufsize, const char* fmtStr, const FmtArg* args, uint8_t numArgs);
+size_t vtformattedLength(const char* fmtStr, const FmtArg* args, uint8_t numArgs);
+
+#endif
@@ -345,8 +345,8 @@ STM32PP_PERIPH_INFO(I2C1)
         kDmaRxChannel = DMA_CHANNEL7,
         kDmaWordSize = 1
     };
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&I2C1_DR); }
-    static const uint32_t dmaTxDataRegister() { return (uint32_t)(&I2C1_DR); }
+    static const uint32_t dmaRxDataRegister() { return busAddr(&I2C1_DR); }
+    static const uint32_t dmaTxDataRegister() { return busAddr(&I2C1_DR); }
 };
 
 STM32PP_PERIPH_INFO(I2C2)
@@ -359,8 +359,8 @@ STM32PP_PERIPH_INFO(I2C2)
         kDmaRxChannel = DMA_CHANNEL5,
         kDmaWordSize = 1
     };
-    static const uint32_t dmaTxDataRegister() { return (uint32_t)(&I2C2_DR); }
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&I2C2_DR); }
+    static const uint32_t dmaTxDataRegister() { return busAddr(&I2C2_DR); }
+    static const uint32_t dmaRxDataRegister() { return busAddr(&I2C2_DR); }
 };
 
 #endif
@@ -0,0 +1,127 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_ITM_HPP
+#define STM32PP_ITM_HPP
+
+/** @brief Print sink that outputs via the ITM stimulus ports, which the
+ * debug probe captures from the SWO pin. Writing to a stimulus port takes a
+ * few cycles and doesn't stop the core, and no peripheral is used.
+ * Each file descriptor is output to its own stimulus port (port = fd % 32),
+ * so \c ftprintf(fd, ...) separates log streams, which the host demultiplexes -
+ * see tools/swo. \c tprintf() prints to fd 1, i.e. port 1.
+ * The ITM, the SWO output and the used ports must be enabled, which is usually
+ * done by the debugger (e.g. OpenOCD's 'tpiu config' and 'itm ports on').
+ * Output to a disabled port is discarded.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "printSink.hpp"
+#include "utils.hpp"
+
+#ifndef STM32PP_NOT_EMBEDDED
+    #include <libopencm3/cm3/itm.h>
+#endif
+
+namespace itm
+{
+#ifndef STM32PP_NOT_EMBEDDED
+/** @brief Access to the ITM registers. A host build provides a mock class
+ * with the same interface */
+struct Regs
+{
+    static bool portEnabled(uint8_t port)
+    {
+        return (ITM_TCR & ITM_TCR_ITMENA) && (ITM_TER[0] & (1u << port));
+    }
+    static bool fifoReady(uint8_t port) { return ITM_STIM32(port) & ITM_STIM_FIFOREADY; }
+    static void write8(uint8_t port, uint8_t val) { ITM_STIM8(port) = val; }
+    static void write16(uint8_t port, uint16_t val) { ITM_STIM16(port) = val; }
+    static void write32(uint8_t port, uint32_t val) { ITM_STIM32(port) = val; }
+};
+#else
+struct Regs;
+#endif
+
+/** @brief The print sink. Messages are written with interrupts disabled, so
+ * that messages to the same port from different contexts are not interleaved.
+ * When the stimulus FIFO is full (the SWO output is slower than the logging),
+ * the sink polls it at most \c MaxWaitPolls times per word. If it's still full,
+ * the rest of the message is dropped, \c fifoFull() is set and
+ * \c fifoFullCount() is incremented
+ */
+template <class R=Regs, uint16_t MaxWaitPolls=1000>
+class PrintSink: public IPrintSink
+{
+protected:
+    volatile uint32_t mFifoFullCount = 0;
+    volatile bool mFifoFull = false;
+    bool waitFifo(uint8_t port)
+    {
+        for (uint16_t n = 0; n < MaxWaitPolls; n++)
+        {
+            if (R::fifoReady(port))
+            {
+                return true;
+            }
+        }
+        mFifoFull = true;
+        mFifoFullCount = mFifoFullCount + 1;
+        return false;
+    }
+public:
+    static uint8_t fdToPort(int fd) { return fd & 31; }
+    virtual BufferInfo* waitReady() { return nullptr; }
+    virtual void print(const char* str, size_t len, int fd)
+    {
+        uint8_t port = fdToPort(fd);
+        if (!R::portEnabled(port))
+        {
+            return;
+        }
+        IntrDisable noIntr;
+        // Whole words, and the remainder with 16- and 8-bit writes, so
+        // that the receiver gets the exact number of bytes
+        for (; len >= 4; str += 4, len -= 4)
+        {
+            if (!waitFifo(port))
+            {
+                return;
+            }
+            uint32_t word;
+            memcpy(&word, str, 4); // little endian - the bytes are sent in order
+            R::write32(port, word);
+        }
+        if (len >= 2)
+        {
+            if (!waitFifo(port))
+            {
+                return;
+            }
+            uint16_t half;
+            memcpy(&half, str, 2);
+            R::write16(port, half);
+            str += 2;
+            len -= 2;
+        }
+        if (len)
+        {
+            if (!waitFifo(port))
+            {
+                return;
+            }
+            R::write8(port, *str);
+        }
+    }
+    /** Set when a message was truncated because the FIFO was full */
+    bool fifoFull() const { return mFifoFull; }
+    void clearFifoFull() { mFifoFull = false; }
+    /** Number of messages truncated because the FIFO was full */
+    uint32_t fifoFullCount() const { return mFifoFullCount; }
+};
+}
+
+#endif
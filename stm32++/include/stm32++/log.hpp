@@ -0,0 +1,91 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_LOG_HPP
+#define STM32PP_LOG_HPP
+
+/** @brief Leveled logging, with a compile-time minimum level per module.
+ * \c STM32PP_LOG(module, level, fmt, args...) prints
+ * "[timestamp ]<module>/<level>: <message>\n" via \c tprintf(), where \c level
+ * is one of \c Debug, \c Info, \c Warning, \c Error.
+ * Each module has a minimum level \c STM32PP_LOG_LEVEL_<module>, which defaults
+ * to \c STM32PP_LOG_LEVEL. It's compared to the level of the call at compile
+ * time, so calls below it generate no code (the arguments are still compiled,
+ * so they don't go stale). A module declares its default in its header:
+ * \code
+ * #ifndef STM32PP_LOG_LEVEL_MYMOD
+ *     #define STM32PP_LOG_LEVEL_MYMOD STM32PP_LOG_LEVEL
+ * #endif
+ * \endcode
+ * and can be set for a single module with e.g. \c -DSTM32PP_LOG_LEVEL_DMA=kLogLevelDebug.
+ * The messages that pass the compile-time check are also filtered at runtime
+ * by \c logLevelMask() - a bit mask of the enabled levels, all enabled by default.
+ * If \c STM32PP_LOG_TIMESTAMPS is defined, messages are prefixed with the time
+ * in microseconds from the \c STM32PP_LOG_CLOCK clock, by default the DWT cycle
+ * counter (\c DwtCounter), which has to be enabled with \c dwt_enable_cycle_counter().
+ * The 32-bit cycle counter wraps around in about a minute at 72MHz
+ */
+
+#include <stdint.h>
+#include "tprintf.hpp"
+
+enum LogLevel: uint8_t
+{
+    kLogLevelDebug = 0,
+    kLogLevelInfo,
+    kLogLevelWarning,
+    kLogLevelError,
+    kLogLevelNone // as a minimum level - disables logging
+};
+
+/** Default minimum level of all modules */
+#ifndef STM32PP_LOG_LEVEL
+    #ifdef NDEBUG
+        #define STM32PP_LOG_LEVEL kLogLevelNone
+    #else
+        #define STM32PP_LOG_LEVEL kLogLevelWarning
+    #endif
+#endif
+
+/** Bit mask of the levels that are output, bit N is level N. Checked at runtime,
+ * after the compile-time minimum level. Not \c static, so that all translation
+ * units share the same mask */
+inline uint8_t& logLevelMask()
+{
+    static uint8_t mask = 0xff;
+    return mask;
+}
+
+inline bool logLevelEnabled(LogLevel level)
+{
+    return logLevelMask() & (1 << level);
+}
+
+/** Enables the levels from \c minLevel up, and disables the ones below it */
+inline void logSetMinLevel(LogLevel minLevel)
+{
+    logLevelMask() = 0xff << minLevel;
+}
+
+#ifdef STM32PP_LOG_TIMESTAMPS
+    #ifndef STM32PP_LOG_CLOCK
+        #include "timeutl.hpp"
+        #define STM32PP_LOG_CLOCK DwtCounter
+    #endif
+    #define STM32PP_LOG_PRINT(prefix, fmt, ...) \
+        tprintf("% " prefix fmt "\n", STM32PP_LOG_CLOCK::ticksToUs(STM32PP_LOG_CLOCK::get()), ##__VA_ARGS__)
+#else
+    #define STM32PP_LOG_PRINT(prefix, fmt, ...) tprintf(prefix fmt "\n", ##__VA_ARGS__)
+#endif
+
+#define STM32PP_LOG(module, level, fmt, ...) \
+    do { \
+        if (kLogLevel##level >= STM32PP_LOG_LEVEL_##module && logLevelEnabled(kLogLevel##level)) \
+        { \
+            STM32PP_LOG_PRINT(#module "/" #level ": ", fmt, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_PRINT_BUF_POOL_HPP
+#define STM32PP_PRINT_BUF_POOL_HPP
+
+/** @brief Pool of fixed-size print buffers.
+ * Enabled by defining \c STM32PP_PRINT_BUF_POOL globally. Then \c ftprintf(),
+ * \c setPrintSink() and \c BINLOG() take their buffers from the global pool
+ * \c gPrintBufPool instead of the heap, so logging doesn't fragment the heap and
+ * has bounded latency. The pool is defined in src/printSink.cpp and is configured
+ * with:
+ * - \c STM32PP_PRINT_BUF_POOL_BLOCK_SIZE - the size of a buffer, which is the
+ *   maximum length of a message (including the null terminator)
+ * - \c STM32PP_PRINT_BUF_POOL_BLOCK_COUNT - the number of buffers, up to 32.
+ *   Each async print sink (\c dma::PrintSink) holds one buffer, and each
+ *   context (main loop or interrupt) that is currently in \c ftprintf() with a
+ *   message that doesn't fit on the stack takes one more
+ * - \c STM32PP_PRINT_BUF_POOL_POLICY - what to do with a message when no buffer
+ *   is free, or the message is longer than a buffer:
+ *   - \c kPrintPoolBlock - wait till a buffer is freed by another context.
+ *     Longer messages are truncated. Use only if the contexts that hold buffers
+ *     can run while the caller waits - i.e. not when logging from an interrupt
+ *     that preempts a context which is logging
+ *   - \c kPrintPoolDrop - drop the message
+ *   - \c kPrintPoolTruncate - the message is truncated to the buffer that is
+ *     available (the stack buffer, if no pool buffer is free). This is the default
+ * Allocation and freeing are lock-free, so both can be done from interrupts.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include "atomic.hpp"
+
+enum PrintPoolPolicy: uint8_t
+{
+    kPrintPoolBlock = 0,
+    kPrintPoolDrop,
+    kPrintPoolTruncate
+};
+
+#ifndef STM32PP_PRINT_BUF_POOL_BLOCK_SIZE
+    #define STM32PP_PRINT_BUF_POOL_BLOCK_SIZE 128
+#endif
+
+#ifndef STM32PP_PRINT_BUF_POOL_BLOCK_COUNT
+    #define STM32PP_PRINT_BUF_POOL_BLOCK_COUNT 4
+#endif
+
+#ifndef STM32PP_PRINT_BUF_POOL_POLICY
+    #define STM32PP_PRINT_BUF_POOL_POLICY kPrintPoolTruncate
+#endif
+
+/** Called repeatedly while waiting for a free buffer, with the \c kPrintPoolBlock policy */
+#ifndef STM32PP_PRINT_BUF_POOL_WAIT
+    #define STM32PP_PRINT_BUF_POOL_WAIT()
+#endif
+
+template <size_t BlockSize, uint8_t NumBlocks>
+class PrintBufPool
+{
+    static_assert(NumBlocks > 0 && NumBlocks <= 32, "The number of blocks must be between 1 and 32");
+protected:
+    enum: uint32_t { kAllUsed = (NumBlocks == 32) ? 0xffffffff : ((1u << NumBlocks) - 1) };
+    alignas(4) char mBlocks[NumBlocks][BlockSize];
+    volatile uint32_t mUsed = 0; // bit N set - block N is allocated
+    volatile uint32_t mExhaustedCount = 0;
+public:
+    enum: size_t { kBlockSize = BlockSize };
+    enum: uint8_t { kNumBlocks = NumBlocks };
+    /** @brief Allocates a block.
+     * @return The block, or \c nullptr if all blocks are in use
+     */
+    char* tryAlloc()
+    {
+        uint32_t used = atomicLoad(&mUsed);
+        for (;;)
+        {
+            uint32_t freeBlocks = ~used & kAllUsed;
+            if (!freeBlocks)
+            {
+                uint32_t count = atomicLoad(&mExhaustedCount);
+                while (!atomicCas(&mExhaustedCount, count, count + 1));
+                return nullptr;
+            }
+            uint32_t bit = freeBlocks & (~freeBlocks + 1); // lowest free block
+            // on failure, reloads the current value in \c used
+            if (atomicCas(&mUsed, used, used | bit))
+            {
+                return mBlocks[__builtin_ctz(bit)];
+            }
+        }
+    }
+    /** @brief Allocates a block, applying the \c STM32PP_PRINT_BUF_POOL_POLICY
+     * policy if there is no free block
+     */
+    char* alloc()
+    {
+        for (;;)
+        {
+            char* block = tryAlloc();
+            if (block || STM32PP_PRINT_BUF_POOL_POLICY != kPrintPoolBlock)
+            {
+                return block;
+            }
+            STM32PP_PRINT_BUF_POOL_WAIT();
+        }
+    }
+    void free(const char* block)
+    {
+        assert(owns(block));
+        size_t idx = (block - mBlocks[0]) / BlockSize;
+        assert(block == mBlocks[idx]);
+        uint32_t used = atomicLoad(&mUsed);
+        assert(used & (1u << idx)); // double free
+        while (!atomicCas(&mUsed, used, used & ~(1u << idx)));
+    }
+    bool owns(const char* buf) const
+    {
+        return buf >= mBlocks[0] && buf < mBlocks[0] + sizeof(mBlocks);
+    }
+    uint8_t usedCount() const { return __builtin_popcount(atomicLoad(&mUsed)); }
+    /** Number of times an allocation failed because all blocks were in use */
+    uint32_t exhaustedCount() const { return atomicLoad(&mExhaustedCount); }
+};
+
+typedef PrintBufPool<STM32PP_PRINT_BUF_POOL_BLOCK_SIZE, STM32PP_PRINT_BUF_POOL_BLOCK_COUNT> DefaultPrintBufPool;
+extern DefaultPrintBufPool gPrintBufPool;
+
+#endif
@@ -8,6 +8,15 @@
 
 #include <stddef.h>
 #include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include "atomic.hpp"
+#ifdef STM32PP_PRINT_BUF_POOL
+    #include "printBufPool.hpp"
+#endif
+
+struct IRingPrintSink;
+struct IMpscPrintSink;
 
 struct IPrintSink
 {
@@ -36,6 +45,334 @@ struct IPrintSink
      * the buffer, that contains the string (\c len may be less than the buffer size)
      */
     virtual void print(const char* str, size_t len, int info) = 0;
+    /**
+     * @brief flush If the sink buffers the output, outputs it now. Called
+     * before the sink is replaced, and before an assertion failure halts the core
+     */
+    virtual void flush() {}
+    /**
+     * @brief ringSink If the sink has its own output ring buffer, returns its
+     * ring interface, so that \c tprintf() can format directly into the ring
+     */
+    virtual IRingPrintSink* ringSink() { return nullptr; }
+    /**
+     * @brief mpscSink If the sink can be written by multiple contexts at once,
+     * returns its interface for that, so that \c tprintf() formats directly into
+     * the sink's buffer
+     */
+    virtual IMpscPrintSink* mpscSink() { return nullptr; }
+};
+
+/** @brief Print sink that exposes the free space of its output ring buffer,
+ * so that the formatter writes directly into it, without an intermediate
+ * buffer. Messages are written by a single context at a time - logging from
+ * both the main loop and interrupts needs external locking.
+ * From the point of view of the plain \c IPrintSink interface, it is a
+ * synchronous sink - \c print() copies the string into the ring.
+ * The ring is a single output stream, so the file descriptor passed to
+ * \c print() and \c ftprintf() is ignored
+ */
+struct IRingPrintSink: public IPrintSink
+{
+    struct Span
+    {
+        char* buf;
+        size_t size;
+    };
+    /**
+     * @brief reserve Returns the free space of the ring, as two contiguous spans -
+     * from the write position to the end of the ring, and from the start of
+     * the ring to the read position. \c second.size is zero if the free space
+     * doesn't wrap around.
+     * @param minSize If there is less free space than that, waits for the sink
+     * to output some data. If the sink can't wait, returns \c false
+     */
+    virtual bool reserve(Span& first, Span& second, size_t minSize) = 0;
+    /**
+     * @brief commit Appends to the ring \c len bytes written to the spans
+     * returned by the last \c reserve() and starts outputting them
+     */
+    virtual void commit(size_t len) = 0;
+    virtual IRingPrintSink* ringSink() { return this; }
+    virtual BufferInfo* waitReady() { return nullptr; }
+    virtual void print(const char* str, size_t len, int /*fd*/)
+    {
+        Span first, second;
+        if (!reserve(first, second, len))
+        {
+            return;
+        }
+        copyToSpans(first, second, str, len);
+        commit(len);
+    }
+    static void copyToSpans(const Span& first, const Span& second, const char* str, size_t len)
+    {
+        if (len <= first.size)
+        {
+            memcpy(first.buf, str, len);
+        }
+        else
+        {
+            memcpy(first.buf, str, first.size);
+            memcpy(second.buf, str + first.size, len - first.size);
+        }
+    }
+};
+
+/** @brief Ring buffer of an \c IRingPrintSink. The derived class outputs the data:
+ * \c drain() is called after new data is committed, and the derived class
+ * outputs the chunks returned by \c pending(), calling \c consumed() after each.
+ * \c consumed() can be called from an interrupt.
+ * One byte of the ring is always left unused, to distinguish a full ring
+ * from an empty one
+ */
+template <size_t Size>
+class RingPrintSink: public IRingPrintSink
+{
+protected:
+    char mRing[Size];
+    volatile size_t mReadPos = 0; // modified only by consumed()
+    volatile size_t mWritePos = 0; // modified only by commit()
+    /** Starts outputting the pending data, if not already doing so */
+    virtual void drain() = 0;
+    /**
+     * @brief waitForSpace Called by \c reserve() when the free space is not enough.
+     * Should wait till some data is output and return \c true, or return \c false
+     * if no more space can be freed, in which case the message is dropped.
+     * By default, messages that don't fit are dropped
+     */
+    virtual bool waitForSpace() { return false; }
+    /** Returns the largest contiguous chunk of data, that is not yet output */
+    size_t pending(const char*& data) const
+    {
+        size_t readPos = mReadPos;
+        size_t writePos = mWritePos;
+        data = mRing + readPos;
+        return (writePos >= readPos) ? writePos - readPos : Size - readPos;
+    }
+    void consumed(size_t len)
+    {
+        mReadPos = (mReadPos + len) % Size;
+    }
+public:
+    size_t freeSpace() const { return (mReadPos + Size - mWritePos - 1) % Size; }
+    virtual bool reserve(Span& first, Span& second, size_t minSize)
+    {
+        size_t free;
+        while ((free = freeSpace()) < minSize)
+        {
+            if (!waitForSpace())
+            {
+                return false;
+            }
+        }
+        size_t writePos = mWritePos;
+        size_t toEnd = Size - writePos;
+        first.buf = mRing + writePos;
+        if (free <= toEnd)
+        {
+            first.size = free;
+            second.buf = nullptr;
+            second.size = 0;
+        }
+        else
+        {
+            first.size = toEnd;
+            second.buf = mRing;
+            second.size = free - toEnd;
+        }
+        return true;
+    }
+    virtual void commit(size_t len)
+    {
+        assert(len <= freeSpace());
+        mWritePos = (mWritePos + len) % Size;
+        drain();
+    }
+};
+
+/** @brief Print sink that can be written by any number of contexts at once -
+ * the main loop and interrupts of any priority, without disabling interrupts.
+ * A message is written in three steps - space for it is reserved, it's
+ * written to the reserved space, and it's committed. Messages are output in
+ * the order of reservation. Every reservation must be committed, as the output
+ * stops at the first message that is not committed.
+ * From the point of view of the plain \c IPrintSink interface, it is a
+ * synchronous sink - \c print() copies the string into the sink's buffer.
+ * All messages go to a single output stream, so the file descriptor passed to
+ * \c print() and \c ftprintf() is ignored
+ */
+struct IMpscPrintSink: public IPrintSink
+{
+    struct Reservation
+    {
+        IRingPrintSink::Span first;
+        IRingPrintSink::Span second; //< Non-empty if the space wraps around the end of the ring
+        uint32_t pos;
+        uint32_t len;
+    };
+    /**
+     * @brief reserve Reserves space for a message of \c len chars.
+     * Doesn't wait, so can be called from interrupts.
+     * @return \c false if there is not enough free space, in which case the
+     * message should be dropped
+     */
+    virtual bool reserve(size_t len, Reservation& res) = 0;
+    virtual void commit(const Reservation& res) = 0;
+    virtual IMpscPrintSink* mpscSink() { return this; }
+    virtual BufferInfo* waitReady() { return nullptr; }
+    virtual void print(const char* str, size_t len, int /*fd*/)
+    {
+        Reservation res;
+        if (!reserve(len, res))
+        {
+            return;
+        }
+        IRingPrintSink::copyToSpans(res.first, res.second, str, len);
+        commit(res);
+    }
+};
+
+/** @brief Ring buffer of an \c IMpscPrintSink. Each message is stored as a record -
+ * a header word, containing the message length and a 'committed' flag, followed
+ * by the message, padded to a multiple of 4 bytes. Space is reserved by a
+ * lock-free compare-exchange of the head position, and a message is committed
+ * by setting the flag in its header.
+ * The derived class outputs the data, as a single consumer: \c drain() is called
+ * after a message is committed, and the derived class outputs the chunks returned
+ * by \c pending(), calling \c consumed() after each. Only one context at a time
+ * can be the consumer - \c drain() is called concurrently from all contexts
+ * that log, so the derived class has to arbitrate.
+ * Consumed records are cleared, so that no word of an old message is
+ * taken for a committed header, when the ring wraps around
+ */
+template <size_t Size>
+class MpscPrintSink: public IMpscPrintSink
+{
+    static_assert(Size >= 16 && (Size & (Size - 1)) == 0, "Size must be a power of 2");
+protected:
+    enum: uint32_t { kCommitted = 0x80000000, kHdrSize = 4 };
+    uint32_t mRing[Size / 4];
+    // Free-running positions, the ring index is (pos & (Size-1))
+    volatile uint32_t mHead = 0; // end of the reserved space
+    volatile uint32_t mTail = 0; // start of the oldest record, modified only by the consumer
+    volatile uint32_t mDropped = 0;
+    // Consumer state - the part of the current record, that is not yet output
+    uint32_t mOutPos = 0;
+    uint32_t mOutRemaining = 0;
+
+    /** Starts outputting the pending data, if not already doing so */
+    virtual void drain() = 0;
+    char* ringData() { return (char*)mRing; }
+    volatile uint32_t* word(uint32_t pos) { return mRing + ((pos & (Size - 1)) >> 2); }
+    static uint32_t recordSize(uint32_t len) { return kHdrSize + ((len + 3) & ~3u); }
+    /** Clears the record at the tail and frees its space */
+    void release(uint32_t size)
+    {
+        uint32_t tail = mTail;
+        for (uint32_t pos = tail; pos != tail + size; pos += 4)
+        {
+            *word(pos) = 0;
+        }
+        atomicStore(&mTail, tail + size);
+    }
+    /** Returns the largest contiguous chunk of committed data, that is not yet output */
+    size_t pending(const char*& data)
+    {
+        while (!mOutRemaining)
+        {
+            uint32_t tail = mTail;
+            if (tail == atomicLoad(&mHead))
+            {
+                return 0;
+            }
+            uint32_t hdr = atomicLoad(word(tail));
+            if (!(hdr & kCommitted))
+            {
+                return 0;
+            }
+            uint32_t len = hdr & ~kCommitted;
+            if (!len)
+            {
+                release(recordSize(0));
+                continue;
+            }
+            mOutPos = tail + kHdrSize;
+            mOutRemaining = len;
+        }
+        uint32_t offs = mOutPos & (Size - 1);
+        data = ringData() + offs;
+        return (mOutRemaining <= Size - offs) ? mOutRemaining : Size - offs;
+    }
+    void consumed(size_t len)
+    {
+        assert(len <= mOutRemaining);
+        mOutPos += len;
+        mOutRemaining -= len;
+        if (!mOutRemaining)
+        {
+            release(recordSize(mOutPos - mTail - kHdrSize));
+        }
+    }
+    /** Whether the oldest record is committed. Can be called by any context */
+    bool hasPending()
+    {
+        uint32_t tail = atomicLoad(&mTail);
+        return tail != atomicLoad(&mHead) && (atomicLoad(word(tail)) & kCommitted);
+    }
+public:
+    MpscPrintSink() { memset(mRing, 0, sizeof(mRing)); }
+    /** Number of messages dropped because the ring was full */
+    uint32_t droppedCount() const { return mDropped; }
+    virtual bool reserve(size_t len, Reservation& res)
+    {
+        uint32_t size = recordSize(len);
+        uint32_t head;
+        for (;;)
+        {
+            // Load the tail first - it never passes the head
+            uint32_t tail = atomicLoad(&mTail);
+            head = atomicLoad(&mHead);
+            uint32_t used = head - tail;
+            if (used > Size)
+            {
+                continue; // preempted between the loads, and the tail is stale
+            }
+            if (len >= kCommitted || size > Size - used)
+            {
+                uint32_t dropped = mDropped;
+                while (!atomicCas(&mDropped, dropped, dropped + 1));
+                return false;
+            }
+            if (atomicCas(&mHead, head, head + size))
+            {
+                break;
+            }
+        }
+        res.pos = head;
+        res.len = len;
+        uint32_t offs = (head + kHdrSize) & (Size - 1);
+        uint32_t toEnd = Size - offs;
+        res.first.buf = ringData() + offs;
+        if (len <= toEnd)
+        {
+            res.first.size = len;
+            res.second.buf = nullptr;
+            res.second.size = 0;
+        }
+        else
+        {
+            res.first.size = toEnd;
+            res.second.buf = ringData();
+            res.second.size = len - toEnd;
+        }
+        return true;
+    }
+    virtual void commit(const Reservation& res)
+    {
+        atomicStore(word(res.pos), res.len | kCommitted);
+        drain();
+    }
 };
 
 struct AsyncPrintSink: public IPrintSink
@@ -44,9 +381,20 @@ protected:
     BufferInfo mPrintBuffer;
 };
 
+/** Frees a print buffer allocated by \c ftprintf() */
+static inline void freePrintBuf(const char* buf)
+{
+#ifdef STM32PP_PRINT_BUF_POOL
+    gPrintBufPool.free(buf);
+#else
+    free((void*)buf);
+#endif
+}
+
 static inline IPrintSink* setPrintSink(IPrintSink* newSink)
 {
     extern IPrintSink* gPrintSink;
+    gPrintSink->flush();
     IPrintSink::BufferInfo* currSinkBufInfo = gPrintSink->waitReady();
     bool isAsync = (currSinkBufInfo != nullptr);
     if (isAsync)
@@ -58,14 +406,14 @@ static inline IPrintSink* setPrintSink(IPrintSink* newSink)
             {
                 if (newSinkBufInfo->buf)
                 { // newSink also has a buffer allocated, free it
-                    free((void*)newSinkBufInfo->buf);
+                    freePrintBuf(newSinkBufInfo->buf);
                 }
                 *newSinkBufInfo = *currSinkBufInfo;
                 currSinkBufInfo->clear();
             }
             else // newSink is synchronous, and we have an async buffer, free it
             {
-                free(currSinkBufInfo);
+                freePrintBuf(currSinkBufInfo->buf);
                 currSinkBufInfo->clear();
             }
         }
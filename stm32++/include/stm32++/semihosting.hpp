@@ -14,6 +14,11 @@ enum: uint8_t {
     SYS_TIME = 0x11
 };
 
+/** @brief Executes a semihosting command. On the target, it's a \c bkpt 0xAB
+ * instruction, which halts the core while the debugger services the command.
+ * In a host build (\c STM32PP_NOT_EMBEDDED), it's not defined by the library -
+ * the program defines a stand-in, e.g. to test what is output via semihosting
+ */
 size_t bkpt(size_t cmd, size_t arg1);
 
 void fputs(const char* str, size_t len, int fd);
@@ -0,0 +1,81 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SEMIHOSTING_PRINT_HPP
+#define STM32PP_SEMIHOSTING_PRINT_HPP
+
+#include <stdint.h>
+#include "semihosting.hpp"
+#include "printSink.hpp"
+#include "utils.hpp"
+
+/** Size of the buffer of the default print sink, when logging via semihosting.
+ * Zero disables buffering - every message is output with a separate semihosting call
+ */
+#ifndef STM32PP_SEMIHOSTING_BUF_SIZE
+    #define STM32PP_SEMIHOSTING_BUF_SIZE 128
+#endif
+
+namespace shost
+{
+/** @brief Print sink that collects the output in RAM, and outputs it with a
+ * single \c SYS_WRITE semihosting call. Each semihosting call halts the core
+ * for milliseconds while the debugger services it, so batching the output
+ * distorts timing much less than a call per message.
+ * The buffer is output when a message that contains a newline is appended
+ * (if \c FlushOnNewline is set), when the buffer is full, when a message to a
+ * different file descriptor is printed, and on \c flush(). Messages longer than
+ * the buffer are output directly. Can be printed to from interrupts - the
+ * buffer is modified with interrupts disabled
+ */
+template <size_t Size, bool FlushOnNewline=true>
+class BufferedPrintSink: public IPrintSink
+{
+protected:
+    char mBuf[Size];
+    size_t mLen = 0;
+    int mFd = 1;
+    // Called with interrupts disabled
+    void flushLocked()
+    {
+        if (mLen)
+        {
+            write(mBuf, mLen, mFd);
+            mLen = 0;
+        }
+    }
+public:
+    virtual BufferInfo* waitReady() { return nullptr; }
+    virtual void print(const char* str, size_t len, int fd)
+    {
+        IntrDisable noIntr;
+        if (fd != mFd || len > Size - mLen)
+        {
+            flushLocked();
+            mFd = fd;
+        }
+        if (len > Size)
+        {
+            write(str, len, fd);
+            return;
+        }
+        memcpy(mBuf + mLen, str, len);
+        mLen += len;
+        if (mLen == Size || (FlushOnNewline && memchr(str, '\n', len)))
+        {
+            flushLocked();
+        }
+    }
+    virtual void flush()
+    {
+        IntrDisable noIntr;
+        flushLocked();
+    }
+    /** Number of bytes waiting to be output */
+    size_t bufferedLen() const { return mLen; }
+};
+}
+
+#endif
@@ -0,0 +1,553 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_CORE_HPP
+#define STM32PP_SIM_CORE_HPP
+
+/** @brief Core of the host-side peripheral simulator.
+ * The libopencm3 headers under sim/libopencm3 stand in for the real ones in
+ * \c STM32PP_SIM builds. Their register macros (\c MMIO32) return a \c sim::Reg
+ * proxy, whose reads and writes go to the model of the register block at that
+ * address (\c sim::Model), and the libopencm3 functions are implemented on
+ * top of them, as in libopencm3. Addresses without a model behave as plain memory.
+ * Time is simulated in CPU cycles at \c rcc_ahb_frequency. Every register access
+ * costs \c kRegAccessCycles, and polling loops on registers advance the clock
+ * that way. Loops that poll variables changed by interrupts have to call
+ * \c STM32PP_BUSY_WAIT(), which fast-forwards to the next hardware event.
+ * The models schedule their events (e.g. a byte shifted out) on the clock, and
+ * raise DMA requests and interrupt lines. DMA requests are served immediately.
+ * Interrupts are delivered between register accesses, by calling the handler
+ * (the libopencm3 \c xxx_isr() function, or one set by \c sim::setIsr()), with
+ * preemption by priority as in the NVIC, and are held off while PRIMASK is set
+ * by \c cm_disable_interrupts().
+ * The simulator is single-threaded, and its state is global - see \c sim::reset()
+ */
+
+#ifndef STM32PP_NOT_EMBEDDED
+    #error "The simulator is for host builds, define STM32PP_NOT_EMBEDDED"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bitset>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "libopencm3/stm32/memorymap.h"
+
+namespace sim
+{
+typedef uint64_t Cycles;
+enum: Cycles { kNever = ~(Cycles)0 };
+enum: uint8_t { kNumIrqs = 68 };
+enum: uint8_t { kRegAccessCycles = 2 };
+typedef std::bitset<kNumIrqs> IrqLines;
+
+[[noreturn]] static inline void fatal(const char* msg, uint32_t arg=0)
+{
+    fprintf(stderr, "sim: %s (0x%08x)\n", msg, arg);
+    abort();
+}
+
+/** @brief Model of a peripheral register block, \c kBlockSize bytes long */
+class Model
+{
+public:
+    enum: uint32_t { kBlockSize = 0x400 };
+    const uint32_t mBase;
+    Model(uint32_t base): mBase(base) {}
+    virtual ~Model() {}
+    /** Puts the registers in their reset state */
+    virtual void reset() = 0;
+    virtual uint32_t read(uint32_t offset) = 0;
+    virtual void write(uint32_t offset, uint32_t val) = 0;
+    /** Time of the next scheduled event, \c kNever if none */
+    virtual Cycles nextEvent() const { return kNever; }
+    /** Called when the time of \c nextEvent() is reached */
+    virtual void onEvent(Cycles now) {}
+    /** Whether the peripheral requests a transfer from the \c chan channel of
+     * the DMA controller \c dma */
+    virtual bool dmaRequest(uint32_t dma, uint8_t chan) const { return false; }
+    /** Sets the interrupt lines that the peripheral currently asserts */
+    virtual void irqLines(IrqLines& lines) const {}
+};
+
+/** @brief Model of a DMA controller. It performs the transfers that the
+ * other models request, see \c Model::dmaRequest() */
+class DmaController: public Model
+{
+public:
+    using Model::Model;
+    /** Performs a transfer for a pending request, if any
+     * @return Whether a transfer was performed */
+    virtual bool serveRequest() = 0;
+};
+
+/** @brief A register, as returned by \c MMIO32(). Accesses go through the
+ * simulator. Objects are unique per address, so that the register address can
+ * be taken, as in \c (uint32_t)&USART1_DR, see \c busAddr()
+ */
+class Reg
+{
+protected:
+    uint32_t mAddr;
+public:
+    explicit Reg(uint32_t addr): mAddr(addr) {}
+    Reg(const Reg&) = delete;
+    uint32_t addr() const { return mAddr; }
+    inline operator uint32_t() const volatile;
+    inline Reg& operator=(uint32_t val);
+    Reg& operator=(const Reg& other) { return *this = (uint32_t)other; }
+    Reg& operator|=(uint32_t val) { return *this = (uint32_t)*this | val; }
+    Reg& operator&=(uint32_t val) { return *this = (uint32_t)*this & val; }
+    Reg& operator^=(uint32_t val) { return *this = (uint32_t)*this ^ val; }
+};
+
+typedef std::function<void()> IsrFunc;
+
+/** Clock frequencies, as set up by the rcc_clock_setup_xxx() functions */
+struct Clocks
+{
+    uint32_t ahb = 72000000;
+    uint32_t apb1 = 36000000;
+    uint32_t apb2 = 72000000;
+    /** CPU cycles per cycle of an APB bus */
+    uint32_t apbRatio(bool apb2) const { return ahb / (apb2 ? this->apb2 : apb1); }
+};
+
+class Sim
+{
+protected:
+    enum: uint16_t { kThreadPrio = 0x100 }; // lower than any interrupt
+    enum: uint8_t { kRegionShift = 24, kMaxRegions = 0x3f };
+    Cycles mNow = 0;
+    Clocks mClocks;
+    std::map<uint32_t, std::unique_ptr<Model>> mModels;
+    std::vector<DmaController*> mDmas;
+    std::unordered_map<uint32_t, uint32_t> mMemory; // unmodeled registers
+    std::unordered_map<uint32_t, Reg> mRegs;
+    std::unordered_map<const volatile void*, uint32_t> mRegAddrs;
+    std::vector<uintptr_t> mRegions; // host address >> kRegionShift, index+1 is the bus region
+    // NVIC and PRIMASK
+    bool mPrimask = false;
+    IrqLines mIrqEnabled;
+    IrqLines mIrqPending; // software-pended
+    uint8_t mIrqPrio[kNumIrqs] = {};
+    uint16_t mRunningPrio = kThreadPrio;
+    uint8_t mRunningIrq = 0xff;
+    IsrFunc mIsrs[kNumIrqs];
+    Model* findModel(uint32_t addr) const
+    {
+        auto it = mModels.find(addr & ~(Model::kBlockSize - 1));
+        return (it == mModels.end()) ? nullptr : it->second.get();
+    }
+public:
+    static Sim& instance();
+    template <class M>
+    M& addModel(M* model)
+    {
+        mModels[model->mBase].reset(model);
+        model->reset();
+        addDma(model);
+        return *model;
+    }
+    template <class M>
+    M& model(uint32_t base) const
+    {
+        auto model = dynamic_cast<M*>(findModel(base));
+        if (!model)
+        {
+            fatal("No such peripheral model", base);
+        }
+        return *model;
+    }
+    void addDma(DmaController* dma) { mDmas.push_back(dma); }
+    void addDma(Model*) {}
+    Cycles now() const { return mNow; }
+    Clocks& clocks() { return mClocks; }
+    /** Puts all peripherals in their reset state and clears the NVIC.
+     * The clock keeps running */
+    void reset()
+    {
+        for (auto& item: mModels)
+        {
+            item.second->reset();
+        }
+        mMemory.clear();
+        mPrimask = false;
+        mIrqEnabled.reset();
+        mIrqPending.reset();
+        memset(mIrqPrio, 0, sizeof(mIrqPrio));
+        for (auto& isr: mIsrs)
+        {
+            isr = nullptr;
+        }
+    }
+    /** Puts a peripheral in its reset state, as done through the RCC */
+    void resetModel(uint32_t base)
+    {
+        Model* model = findModel(base);
+        if (model)
+        {
+            model->reset();
+        }
+    }
+    // Bus accesses, without time passing - from the DMA and the models
+    uint32_t busRead(uint32_t addr)
+    {
+        Model* model = findModel(addr);
+        if (model)
+        {
+            return model->read(addr - model->mBase);
+        }
+        auto it = mMemory.find(addr);
+        return (it == mMemory.end()) ? 0 : it->second;
+    }
+    void busWrite(uint32_t addr, uint32_t val)
+    {
+        Model* model = findModel(addr);
+        if (model)
+        {
+            model->write(addr - model->mBase, val);
+        }
+        else
+        {
+            mMemory[addr] = val;
+        }
+    }
+    // CPU register accesses
+    uint32_t read(uint32_t addr)
+    {
+        advance(kRegAccessCycles);
+        return busRead(addr);
+    }
+    void write(uint32_t addr, uint32_t val)
+    {
+        advance(kRegAccessCycles);
+        busWrite(addr, val);
+        update();
+    }
+    Reg& reg(uint32_t addr)
+    {
+        auto it = mRegs.find(addr);
+        if (it != mRegs.end())
+        {
+            return it->second;
+        }
+        Reg& reg = mRegs.emplace(std::piecewise_construct, std::forward_as_tuple(addr),
+            std::forward_as_tuple(addr)).first->second;
+        mRegAddrs[&reg] = addr;
+        return reg;
+    }
+    /** The 32-bit bus address of a host object, or of a register. Host memory
+     * is mapped in 16MB regions below the peripheral address space */
+    uint32_t busAddr(const volatile void* ptr)
+    {
+        if (!ptr)
+        {
+            return 0;
+        }
+        auto it = mRegAddrs.find(ptr);
+        if (it != mRegAddrs.end())
+        {
+            return it->second;
+        }
+        uintptr_t addr = (uintptr_t)ptr;
+        uintptr_t region = addr >> kRegionShift;
+        size_t idx = 0;
+        for (; idx < mRegions.size(); idx++)
+        {
+            if (mRegions[idx] == region)
+            {
+                break;
+            }
+        }
+        if (idx == mRegions.size())
+        {
+            if (idx >= kMaxRegions)
+            {
+                fatal("Out of bus address regions for host memory");
+            }
+            mRegions.push_back(region);
+        }
+        return ((idx + 1) << kRegionShift) | (addr & ((1 << kRegionShift) - 1));
+    }
+    /** Host pointer of a bus address returned by \c busAddr(), \c nullptr if
+     * it's not mapped */
+    void* hostPtr(uint32_t addr) const
+    {
+        uint32_t idx = addr >> kRegionShift;
+        if (idx == 0 || idx > mRegions.size())
+        {
+            return nullptr;
+        }
+        return (void*)((mRegions[idx - 1] << kRegionShift) | (addr & ((1 << kRegionShift) - 1)));
+    }
+    static bool isPeriphAddr(uint32_t addr) { return addr >= PERIPH_BASE; }
+    static uint32_t sizeMask(uint8_t size) { return (size < 4) ? (1u << (size * 8)) - 1 : ~0u; }
+    /** Reads \c size bytes at a bus address, from a register or host memory */
+    bool memRead(uint32_t addr, uint8_t size, uint32_t& val)
+    {
+        if (isPeriphAddr(addr))
+        {
+            val = busRead(addr) & sizeMask(size);
+            return true;
+        }
+        void* ptr = hostPtr(addr);
+        if (!ptr)
+        {
+            return false;
+        }
+        val = 0;
+        memcpy(&val, ptr, size); // little endian, as the target
+        return true;
+    }
+    bool memWrite(uint32_t addr, uint8_t size, uint32_t val)
+    {
+        if (isPeriphAddr(addr))
+        {
+            busWrite(addr, val & sizeMask(size));
+            return true;
+        }
+        void* ptr = hostPtr(addr);
+        if (!ptr)
+        {
+            return false;
+        }
+        memcpy(ptr, &val, size);
+        return true;
+    }
+    bool dmaRequested(uint32_t dma, uint8_t chan) const
+    {
+        for (auto& item: mModels)
+        {
+            if (item.second->dmaRequest(dma, chan))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    /** Advances the clock to \c time, processing the events on the way */
+    void advanceTo(Cycles time)
+    {
+        for (;;)
+        {
+            Model* next = nullptr;
+            Cycles nextTime = time;
+            for (auto& item: mModels)
+            {
+                Cycles t = item.second->nextEvent();
+                if (t <= nextTime)
+                {
+                    nextTime = t;
+                    next = item.second.get();
+                }
+            }
+            if (!next)
+            {
+                break;
+            }
+            if (nextTime > mNow)
+            {
+                mNow = nextTime;
+            }
+            next->onEvent(mNow);
+            update();
+        }
+        if (time > mNow)
+        {
+            mNow = time;
+        }
+        update();
+    }
+    void advance(Cycles cycles) { advanceTo(mNow + cycles); }
+    /** Time of the earliest scheduled event, \c kNever if none */
+    Cycles nextEvent() const
+    {
+        Cycles result = kNever;
+        for (auto& item: mModels)
+        {
+            Cycles t = item.second->nextEvent();
+            if (t < result)
+            {
+                result = t;
+            }
+        }
+        return result;
+    }
+    /** Called in busy-wait loops on variables. Fast-forwards to the next event */
+    void busyWait()
+    {
+        Cycles next = nextEvent();
+        if (next == kNever)
+        {
+            fatal("Busy-wait with no hardware activity pending - deadlock");
+        }
+        advanceTo(next > mNow ? next : mNow + 1);
+    }
+    /** Serves the DMA requests, and delivers the pending interrupts */
+    void update()
+    {
+        for (uint32_t n = 0; ; n++)
+        {
+            bool transferred = false;
+            for (auto dma: mDmas)
+            {
+                transferred |= dma->serveRequest();
+            }
+            if (!transferred)
+            {
+                break;
+            }
+            if (n > 1000000)
+            {
+                fatal("DMA request storm");
+            }
+        }
+        deliverIrqs();
+    }
+    // NVIC
+    void irqEnable(uint8_t irq, bool enable)
+    {
+        checkIrq(irq);
+        mIrqEnabled[irq] = enable;
+        if (enable)
+        {
+            deliverIrqs();
+        }
+    }
+    bool irqEnabled(uint8_t irq) const { checkIrq(irq); return mIrqEnabled[irq]; }
+    void irqSetPriority(uint8_t irq, uint8_t prio) { checkIrq(irq); mIrqPrio[irq] = prio; }
+    void irqSetPending(uint8_t irq, bool pending)
+    {
+        checkIrq(irq);
+        mIrqPending[irq] = pending;
+        if (pending)
+        {
+            deliverIrqs();
+        }
+    }
+    bool irqPending(uint8_t irq)
+    {
+        checkIrq(irq);
+        return mIrqPending[irq] || activeIrqLines()[irq];
+    }
+    static void checkIrq(uint8_t irq)
+    {
+        if (irq >= kNumIrqs)
+        {
+            fatal("Invalid IRQ number", irq);
+        }
+    }
+    void setPrimask(bool masked)
+    {
+        mPrimask = masked;
+        if (!masked)
+        {
+            deliverIrqs();
+        }
+    }
+    bool primask() const { return mPrimask; }
+    /** The IRQ being handled, 0xff in thread mode */
+    uint8_t runningIrq() const { return mRunningIrq; }
+    void setIsr(uint8_t irq, IsrFunc isr) { checkIrq(irq); mIsrs[irq] = isr; }
+    IsrFunc isr(uint8_t irq) const;
+    IrqLines activeIrqLines() const
+    {
+        IrqLines lines = mIrqPending;
+        for (auto& item: mModels)
+        {
+            item.second->irqLines(lines);
+        }
+        return lines;
+    }
+    void deliverIrqs()
+    {
+        while (!mPrimask)
+        {
+            IrqLines lines = activeIrqLines() & mIrqEnabled;
+            if (lines.none())
+            {
+                return;
+            }
+            // Only the upper 4 bits of the priority are implemented in the STM32F1
+            uint16_t bestPrio = mRunningPrio;
+            uint8_t best = 0xff;
+            for (uint8_t irq = 0; irq < kNumIrqs; irq++)
+            {
+                if (lines[irq] && (mIrqPrio[irq] & 0xf0) < bestPrio)
+                {
+                    bestPrio = mIrqPrio[irq] & 0xf0;
+                    best = irq;
+                }
+            }
+            if (best == 0xff)
+            {
+                return;
+            }
+            IsrFunc handler = isr(best);
+            if (!handler)
+            {
+                fatal("Interrupt without a handler", best);
+            }
+            mIrqPending[best] = false;
+            uint16_t savedPrio = mRunningPrio;
+            uint8_t savedIrq = mRunningIrq;
+            mRunningPrio = bestPrio;
+            mRunningIrq = best;
+            advance(12); // exception entry
+            handler();
+            mRunningPrio = savedPrio;
+            mRunningIrq = savedIrq;
+        }
+    }
+};
+
+inline Reg::operator uint32_t() const volatile { return Sim::instance().read(mAddr); }
+inline Reg& Reg::operator=(uint32_t val)
+{
+    Sim::instance().write(mAddr, val);
+    return *this;
+}
+
+static inline Cycles now() { return Sim::instance().now(); }
+static inline void advance(Cycles cycles) { Sim::instance().advance(cycles); }
+static inline void busyWait() { Sim::instance().busyWait(); }
+static inline uint32_t busAddr(const volatile void* ptr) { return Sim::instance().busAddr(ptr); }
+static inline void setIsr(uint8_t irq, IsrFunc isr) { Sim::instance().setIsr(irq, isr); }
+static inline void reset() { Sim::instance().reset(); }
+static inline void setClocks(uint32_t ahb, uint32_t apb1, uint32_t apb2)
+{
+    Clocks& clocks = Sim::instance().clocks();
+    clocks.ahb = ahb;
+    clocks.apb1 = apb1;
+    clocks.apb2 = apb2;
+}
+/** Runs the simulation until \c cond is true, or \c timeout cycles pass
+ * @return The final value of \c cond
+ */
+static inline bool runUntil(std::function<bool()> cond, Cycles timeout)
+{
+    Sim& sim = Sim::instance();
+    Cycles end = sim.now() + timeout;
+    while (!cond())
+    {
+        if (sim.now() >= end)
+        {
+            return false;
+        }
+        Cycles next = sim.nextEvent();
+        sim.advanceTo(next < end ? (next > sim.now() ? next : sim.now() + 1) : end);
+    }
+    return true;
+}
+}
+
+#endif
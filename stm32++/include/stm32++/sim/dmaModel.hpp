@@ -0,0 +1,260 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_DMA_MODEL_HPP
+#define STM32PP_SIM_DMA_MODEL_HPP
+
+#include "core.hpp"
+
+namespace sim
+{
+/** @brief Model of an STM32F1 DMA controller.
+ * A peripheral-to-memory or memory-to-peripheral channel transfers one unit
+ * whenever its peripheral requests it, without latency. A memory-to-memory
+ * transfer completes \c kMem2MemCycles per unit after the channel is enabled.
+ * An address that is neither a register nor mapped host memory
+ * (see \c Sim::busAddr()) causes a transfer error, which disables the channel
+ */
+class DmaModel: public DmaController
+{
+public:
+    enum: uint8_t { kMem2MemCycles = 5 };
+    enum: uint32_t
+    {
+        // registers
+        kIsr = 0x00, kIfcr = 0x04, kChanRegs = 0x08, kChanStride = 0x14,
+        kCcr = 0, kCndtr = 4, kCpar = 8, kCmar = 12,
+        // CCR bits
+        kEn = 1 << 0, kTcie = 1 << 1, kHtie = 1 << 2, kTeie = 1 << 3, kDir = 1 << 4,
+        kCirc = 1 << 5, kPinc = 1 << 6, kMinc = 1 << 7, kMem2Mem = 1 << 14,
+        // flags, per channel
+        kGif = 1, kTcif = 2, kHtif = 4, kTeif = 8
+    };
+protected:
+    struct Channel
+    {
+        uint32_t ccr;
+        uint16_t reload; // CNDTR as written
+        uint16_t count; // remaining units
+        uint32_t cpar;
+        uint32_t cmar;
+        uint32_t done; // units transferred since start or reload
+        Cycles mem2memDoneAt;
+    };
+    const uint8_t mNumChans;
+    const uint8_t* mIrqs;
+    uint32_t mIsr;
+    Channel mChans[7];
+    static uint8_t flagShift(uint8_t chan) { return (chan - 1) * 4; }
+    void setFlags(uint8_t chan, uint32_t flags)
+    {
+        mIsr |= (flags | kGif) << flagShift(chan);
+    }
+    void error(uint8_t chan)
+    {
+        setFlags(chan, kTeif);
+        mChans[chan - 1].ccr &= ~kEn;
+    }
+    /** Transfers one unit, returns false on error */
+    bool transfer(uint8_t chan)
+    {
+        Channel& ch = mChans[chan - 1];
+        Sim& sim = Sim::instance();
+        uint8_t psize = 1 << ((ch.ccr >> 8) & 3);
+        uint8_t msize = 1 << ((ch.ccr >> 10) & 3);
+        uint32_t paddr = ch.cpar + ((ch.ccr & kPinc) ? ch.done * psize : 0);
+        uint32_t maddr = ch.cmar + ((ch.ccr & kMinc) ? ch.done * msize : 0);
+        uint32_t val;
+        bool ok = (ch.ccr & kDir)
+            ? sim.memRead(maddr, msize, val) && sim.memWrite(paddr, psize, val)
+            : sim.memRead(paddr, psize, val) && sim.memWrite(maddr, msize, val);
+        if (!ok)
+        {
+            error(chan);
+            return false;
+        }
+        ch.done++;
+        ch.count--;
+        if (ch.count == ch.reload / 2)
+        {
+            setFlags(chan, kHtif);
+        }
+        if (ch.count == 0)
+        {
+            setFlags(chan, kTcif);
+            if (ch.ccr & kCirc)
+            {
+                ch.count = ch.reload;
+                ch.done = 0;
+            }
+        }
+        return true;
+    }
+    void start(uint8_t chan)
+    {
+        Channel& ch = mChans[chan - 1];
+        ch.count = ch.reload;
+        ch.done = 0;
+        ch.mem2memDoneAt = (ch.ccr & kMem2Mem)
+            ? Sim::instance().now() + (Cycles)ch.count * kMem2MemCycles
+            : kNever;
+    }
+public:
+    DmaModel(uint32_t base, uint8_t numChans, const uint8_t* irqs)
+    : DmaController(base), mNumChans(numChans), mIrqs(irqs)
+    {}
+    virtual void reset()
+    {
+        mIsr = 0;
+        memset(mChans, 0, sizeof(mChans));
+        for (auto& ch: mChans)
+        {
+            ch.mem2memDoneAt = kNever;
+        }
+    }
+    /** Returns the channel (1-based) and the register of a channel register offset */
+    bool chanReg(uint32_t offset, uint8_t& chan, uint32_t& reg) const
+    {
+        if (offset < kChanRegs)
+        {
+            return false;
+        }
+        offset -= kChanRegs;
+        chan = offset / kChanStride + 1;
+        reg = offset % kChanStride;
+        return chan <= mNumChans;
+    }
+    virtual uint32_t read(uint32_t offset)
+    {
+        if (offset == kIsr)
+        {
+            return mIsr;
+        }
+        uint8_t chan;
+        uint32_t reg;
+        if (!chanReg(offset, chan, reg))
+        {
+            return 0;
+        }
+        const Channel& ch = mChans[chan - 1];
+        switch (reg)
+        {
+            case kCcr: return ch.ccr;
+            case kCndtr: return (ch.ccr & kEn) ? ch.count : ch.reload;
+            case kCpar: return ch.cpar;
+            case kCmar: return ch.cmar;
+            default: return 0;
+        }
+    }
+    virtual void write(uint32_t offset, uint32_t val)
+    {
+        if (offset == kIfcr)
+        {
+            for (uint8_t chan = 1; chan <= mNumChans; chan++)
+            {
+                uint32_t clear = (val >> flagShift(chan)) & 0xf;
+                if (clear & kGif)
+                {
+                    clear = 0xf;
+                }
+                mIsr &= ~(clear << flagShift(chan));
+            }
+            return;
+        }
+        uint8_t chan;
+        uint32_t reg;
+        if (!chanReg(offset, chan, reg))
+        {
+            return;
+        }
+        Channel& ch = mChans[chan - 1];
+        bool enabled = ch.ccr & kEn;
+        switch (reg)
+        {
+            case kCcr:
+                ch.ccr = val & 0x7fff;
+                if (!enabled && (val & kEn))
+                {
+                    start(chan);
+                }
+                else if (enabled && !(val & kEn))
+                {
+                    ch.mem2memDoneAt = kNever;
+                }
+                break;
+            // the address and count registers are read-only while enabled
+            case kCndtr: if (!enabled) { ch.reload = val; } break;
+            case kCpar: if (!enabled) { ch.cpar = val; } break;
+            case kCmar: if (!enabled) { ch.cmar = val; } break;
+        }
+    }
+    virtual Cycles nextEvent() const
+    {
+        Cycles result = kNever;
+        for (uint8_t i = 0; i < mNumChans; i++)
+        {
+            if (mChans[i].mem2memDoneAt < result)
+            {
+                result = mChans[i].mem2memDoneAt;
+            }
+        }
+        return result;
+    }
+    virtual void onEvent(Cycles now)
+    {
+        for (uint8_t chan = 1; chan <= mNumChans; chan++)
+        {
+            Channel& ch = mChans[chan - 1];
+            if (ch.mem2memDoneAt > now)
+            {
+                continue;
+            }
+            ch.mem2memDoneAt = kNever;
+            while (ch.count && transfer(chan));
+        }
+    }
+    virtual bool serveRequest()
+    {
+        Sim& sim = Sim::instance();
+        // The highest software priority wins, then the lowest channel number
+        uint8_t best = 0;
+        int8_t bestPrio = -1;
+        for (uint8_t chan = 1; chan <= mNumChans; chan++)
+        {
+            const Channel& ch = mChans[chan - 1];
+            int8_t prio = (ch.ccr >> 12) & 3;
+            if (prio > bestPrio && (ch.ccr & kEn) && !(ch.ccr & kMem2Mem) && ch.count
+                && sim.dmaRequested(mBase, chan))
+            {
+                best = chan;
+                bestPrio = prio;
+            }
+        }
+        if (!best)
+        {
+            return false;
+        }
+        transfer(best);
+        return true;
+    }
+    virtual void irqLines(IrqLines& lines) const
+    {
+        for (uint8_t chan = 1; chan <= mNumChans; chan++)
+        {
+            uint32_t flags = (mIsr >> flagShift(chan)) & 0xf;
+            uint32_t ccr = mChans[chan - 1].ccr;
+            if (((flags & kTcif) && (ccr & kTcie)) || ((flags & kHtif) && (ccr & kHtie))
+                || ((flags & kTeif) && (ccr & kTeie)))
+            {
+                lines[mIrqs[chan - 1]] = true;
+            }
+        }
+    }
+    /** Remaining units of a channel */
+    uint16_t count(uint8_t chan) const { return mChans[chan - 1].count; }
+};
+}
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_GPIO_MODEL_HPP
+#define STM32PP_SIM_GPIO_MODEL_HPP
+
+#include "core.hpp"
+
+namespace sim
+{
+/** @brief Model of an STM32F1 GPIO port. IDR reads the levels driven from
+ * outside by \c drive(), and the ODR for the other pins. \c setOutputCallback()
+ * allows a test to observe pin changes, e.g. of a chip select
+ */
+class GpioModel: public Model
+{
+public:
+    enum: uint32_t
+    {
+        kCrl = 0x00, kCrh = 0x04, kIdr = 0x08, kOdr = 0x0c, kBsrr = 0x10, kBrr = 0x14, kLckr = 0x18
+    };
+    typedef std::function<void(uint16_t odr, uint16_t changed)> OutputCallback;
+protected:
+    uint32_t mCrl, mCrh, mLckr;
+    uint16_t mOdr;
+    uint16_t mDriven = 0; // pins driven from outside
+    uint16_t mInput = 0;
+    OutputCallback mOutputCallback;
+    void setOdr(uint16_t odr)
+    {
+        uint16_t changed = odr ^ mOdr;
+        mOdr = odr;
+        if (changed && mOutputCallback)
+        {
+            mOutputCallback(odr, changed);
+        }
+    }
+public:
+    using Model::Model;
+    /** Resets the registers. The levels driven from outside stay */
+    virtual void reset()
+    {
+        mCrl = mCrh = 0x44444444;
+        mLckr = 0;
+        mOdr = 0;
+    }
+    virtual uint32_t read(uint32_t offset)
+    {
+        switch (offset)
+        {
+        case kCrl: return mCrl;
+        case kCrh: return mCrh;
+        case kIdr: return (mOdr & ~mDriven) | (mInput & mDriven);
+        case kOdr: return mOdr;
+        case kLckr: return mLckr;
+        default: return 0;
+        }
+    }
+    virtual void write(uint32_t offset, uint32_t val)
+    {
+        switch (offset)
+        {
+        case kCrl: mCrl = val; break;
+        case kCrh: mCrh = val; break;
+        case kOdr: setOdr(val); break;
+        case kBsrr: setOdr((mOdr & ~(val >> 16)) | (val & 0xffff)); break; // set wins
+        case kBrr: setOdr(mOdr & ~val); break;
+        case kLckr: mLckr = val; break;
+        }
+    }
+    /** Drives \c pins from outside, to \c level */
+    void drive(uint16_t pins, bool level)
+    {
+        mDriven |= pins;
+        mInput = level ? (mInput | pins) : (mInput & ~pins);
+    }
+    /** Stops driving \c pins from outside */
+    void release(uint16_t pins) { mDriven &= ~pins; }
+    uint16_t odr() const { return mOdr; }
+    void setOutputCallback(OutputCallback cb) { mOutputCallback = cb; }
+};
+
+/** @brief Model of the DWT cycle counter, which counts the simulated time */
+class DwtModel: public Model
+{
+public:
+    enum: uint32_t { kCtrl = 0x00, kCyccnt = 0x04 };
+protected:
+    uint32_t mCtrl;
+    uint32_t mOffset;
+public:
+    using Model::Model;
+    virtual void reset() { mCtrl = 0; mOffset = 0; }
+    virtual uint32_t read(uint32_t offset)
+    {
+        switch (offset)
+        {
+        case kCtrl: return mCtrl;
+        case kCyccnt: return (uint32_t)Sim::instance().now() - mOffset;
+        default: return 0;
+        }
+    }
+    virtual void write(uint32_t offset, uint32_t val)
+    {
+        switch (offset)
+        {
+        case kCtrl: mCtrl = val; break;
+        case kCyccnt: mOffset = (uint32_t)Sim::instance().now() - val; break;
+        }
+    }
+};
+}
+
+#endif
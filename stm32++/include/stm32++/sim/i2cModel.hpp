@@ -0,0 +1,365 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_I2C_MODEL_HPP
+#define STM32PP_SIM_I2C_MODEL_HPP
+
+#include "core.hpp"
+
+namespace sim
+{
+/** @brief A slave device on a simulated I2C bus, see \c I2cModel::attach() */
+class I2cDevice
+{
+public:
+    virtual ~I2cDevice() {}
+    /** Called when the device is addressed, after a start or a repeated start
+     * @return Whether the device acknowledges its address
+     */
+    virtual bool onStart(bool read) { return true; }
+    /** A byte written by the master. @return Whether it's acknowledged */
+    virtual bool onWrite(uint8_t byte) = 0;
+    /** Returns the next byte to be read by the master */
+    virtual uint8_t onRead() = 0;
+    virtual void onStop() {}
+};
+
+/** @brief Model of an STM32F1 I2C, in 7-bit master mode.
+ * A byte takes 9 SCL periods, as configured by CCR. As in the hardware, SB is
+ * cleared by writing the address to DR, ADDR by a read of SR1 followed by a
+ * read of SR2, and STOP is generated after the byte being transferred.
+ * In receive mode, bytes are received while ACK is set, and the clock is
+ * stretched while RxNE is set. Addressing a device that is not attached, or
+ * that doesn't acknowledge, sets AF
+ */
+class I2cModel: public Model
+{
+public:
+    enum: uint32_t
+    {
+        kCr1 = 0x00, kCr2 = 0x04, kOar1 = 0x08, kOar2 = 0x0c, kDr = 0x10,
+        kSr1 = 0x14, kSr2 = 0x18, kCcr = 0x1c, kTrise = 0x20,
+        // CR1
+        kPe = 1 << 0, kStart = 1 << 8, kStop = 1 << 9, kAck = 1 << 10, kSwrst = 1 << 15,
+        // CR2
+        kIterren = 1 << 8, kItevten = 1 << 9, kItbufen = 1 << 10, kDmaen = 1 << 11,
+        // SR1
+        kSb = 1 << 0, kAddr = 1 << 1, kBtf = 1 << 2, kStopf = 1 << 4, kRxne = 1 << 6,
+        kTxe = 1 << 7, kBerr = 1 << 8, kArlo = 1 << 9, kAf = 1 << 10, kOvr = 1 << 11,
+        kSr1Errors = kBerr | kArlo | kAf | kOvr,
+        // SR2
+        kMsl = 1 << 0, kBusy = 1 << 1, kTra = 1 << 2,
+        // CCR
+        kFastMode = 1 << 15, kDuty = 1 << 14
+    };
+protected:
+    enum Phase: uint8_t { kIdle, kStarting, kAddressing, kTransmitting, kReceiving };
+    const uint8_t mEvIrq;
+    const uint8_t mErIrq;
+    const uint32_t mDma;
+    const uint8_t mTxChan;
+    const uint8_t mRxChan;
+    uint32_t mCr1, mCr2, mOar1, mOar2, mSr1, mSr2, mCcr, mTrise;
+    uint8_t mRxDr;
+    uint8_t mTxBuf;
+    bool mTxBufFull;
+    uint8_t mShiftReg;
+    bool mAddrSr1Read; // SR1 was read while ADDR was set
+    bool mRead;
+    Phase mPhase;
+    Cycles mEventAt;
+    I2cDevice* mDevice;
+    I2cDevice* mDevices[128];
+    Cycles byteCycles() const { return 9 * sclCycles(); }
+    void schedule(Phase phase, Cycles after)
+    {
+        mPhase = phase;
+        mEventAt = Sim::instance().now() + after;
+    }
+    void generateStop()
+    {
+        if (mDevice)
+        {
+            mDevice->onStop();
+            mDevice = nullptr;
+        }
+        mCr1 &= ~kStop;
+        mSr1 &= ~(kTxe | kBtf);
+        mSr2 = 0;
+        mPhase = kIdle;
+        mEventAt = kNever;
+    }
+    void beginStart()
+    {
+        mSr1 &= ~(kTxe | kBtf);
+        mTxBufFull = false;
+        schedule(kStarting, sclCycles());
+    }
+    /** Generates a start or stop condition requested during a byte transfer */
+    bool busCondition()
+    {
+        if (mCr1 & kStart)
+        {
+            beginStart();
+            return true;
+        }
+        if (mCr1 & kStop)
+        {
+            generateStop();
+            return true;
+        }
+        return false;
+    }
+    void addressDone()
+    {
+        mEventAt = kNever;
+        uint8_t addr = mShiftReg >> 1;
+        mRead = mShiftReg & 1;
+        mDevice = mDevices[addr];
+        if (!mDevice || !mDevice->onStart(mRead))
+        {
+            mDevice = nullptr;
+            mSr1 |= kAf;
+            return;
+        }
+        mSr1 |= kAddr;
+        if (!mRead)
+        {
+            mSr2 |= kTra;
+        }
+    }
+    void startReceive()
+    {
+        schedule(kReceiving, byteCycles());
+    }
+    void byteSent()
+    {
+        mEventAt = kNever;
+        if (!mDevice->onWrite(mShiftReg))
+        {
+            mSr1 |= kAf;
+            return;
+        }
+        if (mTxBufFull)
+        {
+            mTxBufFull = false;
+            mShiftReg = mTxBuf;
+            mSr1 |= kTxe;
+            schedule(kTransmitting, byteCycles());
+        }
+        else if (!busCondition())
+        {
+            mSr1 |= kBtf;
+        }
+    }
+    void byteReceived()
+    {
+        mEventAt = kNever;
+        uint8_t byte = mDevice->onRead();
+        if (mSr1 & kRxne)
+        {
+            mShiftReg = byte; // clock is stretched until DR is read
+            mSr1 |= kBtf;
+            return;
+        }
+        mRxDr = byte;
+        mSr1 |= kRxne;
+        continueReceive();
+    }
+    void continueReceive()
+    {
+        if (!busCondition() && (mCr1 & kAck))
+        {
+            startReceive();
+        }
+    }
+public:
+    I2cModel(uint32_t base, uint8_t evIrq, uint8_t erIrq, uint32_t dma, uint8_t txChan, uint8_t rxChan)
+    : Model(base), mEvIrq(evIrq), mErIrq(erIrq), mDma(dma), mTxChan(txChan), mRxChan(rxChan)
+    {
+        memset(mDevices, 0, sizeof(mDevices));
+    }
+    /** Resets the registers. The attached devices are wiring, and stay */
+    virtual void reset()
+    {
+        mCr1 = mCr2 = mOar1 = mOar2 = mSr1 = mSr2 = mCcr = 0;
+        mTrise = 2;
+        mRxDr = mTxBuf = mShiftReg = 0;
+        mTxBufFull = mAddrSr1Read = mRead = false;
+        mPhase = kIdle;
+        mEventAt = kNever;
+        mDevice = nullptr;
+    }
+    /** Attaches a device at a 7-bit address. The device is not owned */
+    void attach(uint8_t addr, I2cDevice* device) { mDevices[addr & 0x7f] = device; }
+    /** Duration of an SCL period, in CPU cycles */
+    Cycles sclCycles() const
+    {
+        uint32_t ccr = mCcr & 0xfff;
+        if (!ccr)
+        {
+            fatal("I2C clock not set", mBase);
+        }
+        uint32_t mult = !(mCcr & kFastMode) ? 2 : ((mCcr & kDuty) ? 25 : 3);
+        return (Cycles)ccr * mult * Sim::instance().clocks().apbRatio(false);
+    }
+    virtual uint32_t read(uint32_t offset)
+    {
+        switch (offset)
+        {
+        case kCr1: return mCr1;
+        case kCr2: return mCr2;
+        case kOar1: return mOar1;
+        case kOar2: return mOar2;
+        case kDr:
+        {
+            uint8_t data = mRxDr;
+            mSr1 &= ~kRxne;
+            if (mSr1 & kBtf && mPhase == kReceiving) // the stretched byte goes to DR
+            {
+                mSr1 &= ~kBtf;
+                mRxDr = mShiftReg;
+                mSr1 |= kRxne;
+                continueReceive();
+            }
+            return data;
+        }
+        case kSr1:
+            mAddrSr1Read = (mSr1 & kAddr) != 0;
+            return mSr1;
+        case kSr2:
+        {
+            uint32_t sr2 = mSr2;
+            if (mAddrSr1Read)
+            {
+                mAddrSr1Read = false;
+                mSr1 &= ~kAddr;
+                if (mRead)
+                {
+                    startReceive();
+                }
+                else
+                {
+                    mPhase = kTransmitting;
+                    mSr1 |= kTxe;
+                }
+            }
+            return sr2;
+        }
+        case kCcr: return mCcr;
+        case kTrise: return mTrise;
+        default: return 0;
+        }
+    }
+    virtual void write(uint32_t offset, uint32_t val)
+    {
+        switch (offset)
+        {
+        case kCr1:
+            if (val & kSwrst)
+            {
+                reset();
+                mCr1 = kSwrst;
+                return;
+            }
+            mCr1 = val & 0xffff;
+            if (!(mCr1 & kPe))
+            {
+                mSr1 = mSr2 = 0;
+                mPhase = kIdle;
+                mEventAt = kNever;
+                return;
+            }
+            // During a byte transfer, the condition is generated after it
+            if (mEventAt == kNever && (mPhase != kIdle || (mCr1 & kStart)))
+            {
+                busCondition();
+            }
+            break;
+        case kCr2: mCr2 = val & 0x1fff; break;
+        case kOar1: mOar1 = val; break;
+        case kOar2: mOar2 = val; break;
+        case kDr:
+            if (mSr1 & kSb)
+            {
+                mSr1 &= ~kSb;
+                mShiftReg = val;
+                schedule(kAddressing, byteCycles());
+            }
+            else if (mPhase == kTransmitting && mDevice)
+            {
+                mSr1 &= ~kBtf;
+                if (mEventAt == kNever)
+                {
+                    mShiftReg = val;
+                    schedule(kTransmitting, byteCycles());
+                }
+                else
+                {
+                    mTxBuf = val;
+                    mTxBufFull = true;
+                    mSr1 &= ~kTxe;
+                }
+            }
+            break;
+        case kSr1: // the error flags are cleared by writing 0
+            mSr1 &= val | ~kSr1Errors;
+            break;
+        case kCcr: mCcr = val & 0xcfff; break;
+        case kTrise: mTrise = val & 0x3f; break;
+        }
+    }
+    virtual Cycles nextEvent() const { return mEventAt; }
+    virtual void onEvent(Cycles now)
+    {
+        if (mEventAt > now)
+        {
+            return;
+        }
+        switch (mPhase)
+        {
+        case kStarting:
+            mEventAt = kNever;
+            mCr1 &= ~kStart;
+            mSr1 |= kSb;
+            mSr2 |= kMsl | kBusy;
+            mSr2 &= ~kTra;
+            if (mDevice)
+            {
+                mDevice->onStop(); // repeated start ends the previous transfer
+                mDevice = nullptr;
+            }
+            break;
+        case kAddressing: addressDone(); break;
+        case kTransmitting: byteSent(); break;
+        case kReceiving: byteReceived(); break;
+        default: mEventAt = kNever; break;
+        }
+    }
+    virtual bool dmaRequest(uint32_t dma, uint8_t chan) const
+    {
+        if (dma != mDma || !(mCr2 & kDmaen))
+        {
+            return false;
+        }
+        return (chan == mTxChan && mPhase == kTransmitting && (mSr1 & kTxe))
+            || (chan == mRxChan && (mSr1 & kRxne));
+    }
+    virtual void irqLines(IrqLines& lines) const
+    {
+        if (((mCr2 & kItevten) && (mSr1 & (kSb | kAddr | kBtf | kStopf)))
+            || ((mCr2 & kItevten) && (mCr2 & kItbufen) && (mSr1 & (kTxe | kRxne))))
+        {
+            lines[mEvIrq] = true;
+        }
+        if ((mCr2 & kIterren) && (mSr1 & kSr1Errors))
+        {
+            lines[mErIrq] = true;
+        }
+    }
+};
+}
+
+#endif
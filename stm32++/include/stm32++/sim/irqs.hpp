@@ -0,0 +1,47 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_IRQS_HPP
+#define STM32PP_SIM_IRQS_HPP
+
+/** The STM32F1 interrupts and their handlers, as in libopencm3 */
+
+#include <stdint.h>
+
+#define STM32PP_SIM_IRQS(X) \
+    X(0, WWDG, wwdg) X(1, PVD, pvd) X(2, TAMPER, tamper) X(3, RTC, rtc) \
+    X(4, FLASH, flash) X(5, RCC, rcc) X(6, EXTI0, exti0) X(7, EXTI1, exti1) \
+    X(8, EXTI2, exti2) X(9, EXTI3, exti3) X(10, EXTI4, exti4) \
+    X(11, DMA1_CHANNEL1, dma1_channel1) X(12, DMA1_CHANNEL2, dma1_channel2) \
+    X(13, DMA1_CHANNEL3, dma1_channel3) X(14, DMA1_CHANNEL4, dma1_channel4) \
+    X(15, DMA1_CHANNEL5, dma1_channel5) X(16, DMA1_CHANNEL6, dma1_channel6) \
+    X(17, DMA1_CHANNEL7, dma1_channel7) X(18, ADC1_2, adc1_2) \
+    X(19, USB_HP_CAN_TX, usb_hp_can_tx) X(20, USB_LP_CAN_RX0, usb_lp_can_rx0) \
+    X(21, CAN_RX1, can_rx1) X(22, CAN_SCE, can_sce) X(23, EXTI9_5, exti9_5) \
+    X(24, TIM1_BRK, tim1_brk) X(25, TIM1_UP, tim1_up) X(26, TIM1_TRG_COM, tim1_trg_com) \
+    X(27, TIM1_CC, tim1_cc) X(28, TIM2, tim2) X(29, TIM3, tim3) X(30, TIM4, tim4) \
+    X(31, I2C1_EV, i2c1_ev) X(32, I2C1_ER, i2c1_er) X(33, I2C2_EV, i2c2_ev) \
+    X(34, I2C2_ER, i2c2_er) X(35, SPI1, spi1) X(36, SPI2, spi2) X(37, USART1, usart1) \
+    X(38, USART2, usart2) X(39, USART3, usart3) X(40, EXTI15_10, exti15_10) \
+    X(41, RTC_ALARM, rtc_alarm) X(42, USB_WAKEUP, usb_wakeup) X(43, TIM8_BRK, tim8_brk) \
+    X(44, TIM8_UP, tim8_up) X(45, TIM8_TRG_COM, tim8_trg_com) X(46, TIM8_CC, tim8_cc) \
+    X(47, ADC3, adc3) X(48, FSMC, fsmc) X(49, SDIO, sdio) X(50, TIM5, tim5) \
+    X(51, SPI3, spi3) X(52, UART4, uart4) X(53, UART5, uart5) X(54, TIM6, tim6) \
+    X(55, TIM7, tim7) X(56, DMA2_CHANNEL1, dma2_channel1) X(57, DMA2_CHANNEL2, dma2_channel2) \
+    X(58, DMA2_CHANNEL3, dma2_channel3) X(59, DMA2_CHANNEL4_5, dma2_channel4_5) \
+    X(60, DMA2_CHANNEL5, dma2_channel5) X(61, ETH, eth) X(62, ETH_WKUP, eth_wkup) \
+    X(63, CAN2_TX, can2_tx) X(64, CAN2_RX0, can2_rx0) X(65, CAN2_RX1, can2_rx1) \
+    X(66, CAN2_SCE, can2_sce) X(67, OTG_FS, otg_fs)
+
+#define STM32PP_SIM_IRQ_ENUM(num, name, func) NVIC_##name##_IRQ = num,
+enum: uint8_t { STM32PP_SIM_IRQS(STM32PP_SIM_IRQ_ENUM) NVIC_IRQ_COUNT };
+#undef STM32PP_SIM_IRQ_ENUM
+
+// The handlers are weak, as in libopencm3 - the ones that are not defined are null
+#define STM32PP_SIM_IRQ_ISR(num, name, func) void func##_isr(void) __attribute__((weak));
+extern "C" { STM32PP_SIM_IRQS(STM32PP_SIM_IRQ_ISR) }
+#undef STM32PP_SIM_IRQ_ISR
+
+#endif
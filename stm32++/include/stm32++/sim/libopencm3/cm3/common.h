@@ -0,0 +1,16 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_CM3_COMMON_H
+#define STM32PP_SIM_CM3_COMMON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../sim.hpp"
+
+/** Registers are \c sim::Reg proxies, whose accesses go to the peripheral models */
+#define MMIO32(addr)            (sim::Sim::instance().reg(addr))
+
+#endif
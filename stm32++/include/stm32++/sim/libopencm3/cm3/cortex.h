@@ -0,0 +1,24 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_CORTEX_H
+#define STM32PP_SIM_CORTEX_H
+
+/** PRIMASK, on top of the simulator. Interrupts are held off while it's set */
+
+#include "../../sim.hpp"
+
+static inline void cm_enable_interrupts(void) { sim::Sim::instance().setPrimask(false); }
+static inline void cm_disable_interrupts(void) { sim::Sim::instance().setPrimask(true); }
+static inline bool cm_is_masked_interrupts(void) { return sim::Sim::instance().primask(); }
+static inline uint32_t cm_mask_interrupts(uint32_t mask)
+{
+    uint32_t old = sim::Sim::instance().primask();
+    sim::Sim::instance().setPrimask(mask != 0);
+    return old;
+}
+static inline void __dmb(void) {}
+
+#endif
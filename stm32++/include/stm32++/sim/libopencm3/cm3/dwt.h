@@ -0,0 +1,24 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_DWT_H
+#define STM32PP_SIM_DWT_H
+
+/** The DWT cycle counter, which counts the simulated CPU cycles */
+
+#include "../../sim.hpp"
+
+#define DWT_CTRL                MMIO32(DWT_BASE + 0x00)
+#define DWT_CYCCNT              MMIO32(DWT_BASE + 0x04)
+#define DWT_CTRL_CYCCNTENA      (1 << 0)
+
+static inline bool dwt_enable_cycle_counter(void)
+{
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+    return true;
+}
+static inline uint32_t dwt_read_cycle_counter(void) { return DWT_CYCCNT; }
+
+#endif
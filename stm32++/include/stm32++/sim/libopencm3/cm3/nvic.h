@@ -0,0 +1,26 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_NVIC_H
+#define STM32PP_SIM_NVIC_H
+
+/** The NVIC functions of libopencm3, on top of the simulated NVIC.
+ * The interrupt numbers are defined in sim/irqs.hpp */
+
+#include "../../sim.hpp"
+
+static inline void nvic_enable_irq(uint8_t irqn) { sim::Sim::instance().irqEnable(irqn, true); }
+static inline void nvic_disable_irq(uint8_t irqn) { sim::Sim::instance().irqEnable(irqn, false); }
+static inline uint8_t nvic_get_irq_enabled(uint8_t irqn) { return sim::Sim::instance().irqEnabled(irqn); }
+static inline uint8_t nvic_get_pending_irq(uint8_t irqn) { return sim::Sim::instance().irqPending(irqn); }
+static inline void nvic_set_pending_irq(uint8_t irqn) { sim::Sim::instance().irqSetPending(irqn, true); }
+static inline void nvic_clear_pending_irq(uint8_t irqn) { sim::Sim::instance().irqSetPending(irqn, false); }
+static inline uint8_t nvic_get_active_irq(uint8_t irqn) { return sim::Sim::instance().runningIrq() == irqn; }
+static inline void nvic_set_priority(uint8_t irqn, uint8_t priority)
+{
+    sim::Sim::instance().irqSetPriority(irqn, priority);
+}
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_DMA_H
+#define STM32PP_SIM_DMA_H
+
+/** The STM32F1 DMA registers and functions, as in libopencm3 */
+
+#include "../cm3/common.h"
+#include "memorymap.h"
+
+#define DMA1                    DMA1_BASE
+#define DMA2                    DMA2_BASE
+
+#define DMA_ISR(port)           MMIO32((port) + 0x00)
+#define DMA_IFCR(port)          MMIO32((port) + 0x04)
+#define DMA_CCR(port, channel)      MMIO32((port) + 0x08 + (0x14 * ((channel) - 1)))
+#define DMA_CNDTR(port, channel)    MMIO32((port) + 0x0c + (0x14 * ((channel) - 1)))
+#define DMA_CPAR(port, channel)     MMIO32((port) + 0x10 + (0x14 * ((channel) - 1)))
+#define DMA_CMAR(port, channel)     MMIO32((port) + 0x14 + (0x14 * ((channel) - 1)))
+
+#define DMA_CHANNEL1            1
+#define DMA_CHANNEL2            2
+#define DMA_CHANNEL3            3
+#define DMA_CHANNEL4            4
+#define DMA_CHANNEL5            5
+#define DMA_CHANNEL6            6
+#define DMA_CHANNEL7            7
+
+#define DMA_GIF                 (1 << 0)
+#define DMA_TCIF                (1 << 1)
+#define DMA_HTIF                (1 << 2)
+#define DMA_TEIF                (1 << 3)
+#define DMA_FLAGS               (DMA_TEIF | DMA_TCIF | DMA_HTIF | DMA_GIF)
+#define DMA_FLAG_OFFSET(channel)    (4 * ((channel) - 1))
+#define DMA_ISR_GIF(channel)    (DMA_GIF << DMA_FLAG_OFFSET(channel))
+#define DMA_ISR_TCIF(channel)   (DMA_TCIF << DMA_FLAG_OFFSET(channel))
+#define DMA_ISR_HTIF(channel)   (DMA_HTIF << DMA_FLAG_OFFSET(channel))
+#define DMA_ISR_TEIF(channel)   (DMA_TEIF << DMA_FLAG_OFFSET(channel))
+#define DMA_IFCR_CGIF(channel)  (DMA_GIF << DMA_FLAG_OFFSET(channel))
+#define DMA_IFCR_CTCIF(channel) (DMA_TCIF << DMA_FLAG_OFFSET(channel))
+#define DMA_IFCR_CHTIF(channel) (DMA_HTIF << DMA_FLAG_OFFSET(channel))
+#define DMA_IFCR_CTEIF(channel) (DMA_TEIF << DMA_FLAG_OFFSET(channel))
+#define DMA_IFCR_CIF(channel)   (DMA_FLAGS << DMA_FLAG_OFFSET(channel))
+
+#define DMA_CCR_EN              (1 << 0)
+#define DMA_CCR_TCIE            (1 << 1)
+#define DMA_CCR_HTIE            (1 << 2)
+#define DMA_CCR_TEIE            (1 << 3)
+#define DMA_CCR_DIR             (1 << 4)
+#define DMA_CCR_CIRC            (1 << 5)
+#define DMA_CCR_PINC            (1 << 6)
+#define DMA_CCR_MINC            (1 << 7)
+#define DMA_CCR_PSIZE_8BIT      (0x0 << 8)
+#define DMA_CCR_PSIZE_16BIT     (0x1 << 8)
+#define DMA_CCR_PSIZE_32BIT     (0x2 << 8)
+#define DMA_CCR_PSIZE_MASK      (0x3 << 8)
+#define DMA_CCR_MSIZE_8BIT      (0x0 << 10)
+#define DMA_CCR_MSIZE_16BIT     (0x1 << 10)
+#define DMA_CCR_MSIZE_32BIT     (0x2 << 10)
+#define DMA_CCR_MSIZE_MASK      (0x3 << 10)
+#define DMA_CCR_PL_SHIFT        12
+#define DMA_CCR_PL_LOW          (0x0 << DMA_CCR_PL_SHIFT)
+#define DMA_CCR_PL_MEDIUM       (0x1 << DMA_CCR_PL_SHIFT)
+#define DMA_CCR_PL_HIGH         (0x2 << DMA_CCR_PL_SHIFT)
+#define DMA_CCR_PL_VERY_HIGH    (0x3 << DMA_CCR_PL_SHIFT)
+#define DMA_CCR_PL_MASK         (0x3 << DMA_CCR_PL_SHIFT)
+#define DMA_CCR_MEM2MEM         (1 << 14)
+
+static inline void dma_channel_reset(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) = 0;
+    DMA_CNDTR(dma, channel) = 0;
+    DMA_CPAR(dma, channel) = 0;
+    DMA_CMAR(dma, channel) = 0;
+    DMA_IFCR(dma) |= DMA_IFCR_CIF(channel);
+}
+static inline void dma_clear_interrupt_flags(uint32_t dma, uint8_t channel, uint32_t interrupts)
+{
+    DMA_IFCR(dma) = ((interrupts & DMA_FLAGS) << DMA_FLAG_OFFSET(channel));
+}
+static inline bool dma_get_interrupt_flag(uint32_t dma, uint8_t channel, uint32_t interrupts)
+{
+    return (DMA_ISR(dma) & ((interrupts & DMA_FLAGS) << DMA_FLAG_OFFSET(channel))) != 0;
+}
+static inline void dma_enable_mem2mem_mode(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) |= DMA_CCR_MEM2MEM;
+    DMA_CCR(dma, channel) &= ~DMA_CCR_CIRC;
+}
+static inline void dma_set_priority(uint32_t dma, uint8_t channel, uint32_t prio)
+{
+    DMA_CCR(dma, channel) &= ~(DMA_CCR_PL_MASK);
+    DMA_CCR(dma, channel) |= prio;
+}
+static inline void dma_set_memory_size(uint32_t dma, uint8_t channel, uint32_t mem_size)
+{
+    DMA_CCR(dma, channel) &= ~(DMA_CCR_MSIZE_MASK);
+    DMA_CCR(dma, channel) |= mem_size;
+}
+static inline void dma_set_peripheral_size(uint32_t dma, uint8_t channel, uint32_t peripheral_size)
+{
+    DMA_CCR(dma, channel) &= ~(DMA_CCR_PSIZE_MASK);
+    DMA_CCR(dma, channel) |= peripheral_size;
+}
+static inline void dma_enable_memory_increment_mode(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) |= DMA_CCR_MINC;
+}
+static inline void dma_disable_memory_increment_mode(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) &= ~DMA_CCR_MINC;
+}
+static inline void dma_enable_peripheral_increment_mode(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) |= DMA_CCR_PINC;
+}
+static inline void dma_disable_peripheral_increment_mode(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) &= ~DMA_CCR_PINC;
+}
+static inline void dma_enable_circular_mode(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) |= DMA_CCR_CIRC;
+    DMA_CCR(dma, channel) &= ~DMA_CCR_MEM2MEM;
+}
+static inline void dma_set_read_from_peripheral(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) &= ~DMA_CCR_DIR;
+}
+static inline void dma_set_read_from_memory(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) |= DMA_CCR_DIR;
+}
+static inline void dma_enable_transfer_error_interrupt(uint32_t dma, uint8_t channel)
+{
+    DMA_IFCR(dma) |= DMA_IFCR_CTEIF(channel);
+    DMA_CCR(dma, channel) |= DMA_CCR_TEIE;
+}
+static inline void dma_disable_transfer_error_interrupt(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) &= ~DMA_CCR_TEIE;
+}
+static inline void dma_enable_half_transfer_interrupt(uint32_t dma, uint8_t channel)
+{
+    DMA_IFCR(dma) |= DMA_IFCR_CHTIF(channel);
+    DMA_CCR(dma, channel) |= DMA_CCR_HTIE;
+}
+static inline void dma_disable_half_transfer_interrupt(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) &= ~DMA_CCR_HTIE;
+}
+static inline void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t channel)
+{
+    DMA_IFCR(dma) |= DMA_IFCR_CTCIF(channel);
+    DMA_CCR(dma, channel) |= DMA_CCR_TCIE;
+}
+static inline void dma_disable_transfer_complete_interrupt(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) &= ~DMA_CCR_TCIE;
+}
+static inline void dma_enable_channel(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) |= DMA_CCR_EN;
+}
+static inline void dma_disable_channel(uint32_t dma, uint8_t channel)
+{
+    DMA_CCR(dma, channel) &= ~DMA_CCR_EN;
+}
+static inline void dma_set_peripheral_address(uint32_t dma, uint8_t channel, uint32_t address)
+{
+    if (!(DMA_CCR(dma, channel) & DMA_CCR_EN))
+    {
+        DMA_CPAR(dma, channel) = address;
+    }
+}
+static inline void dma_set_memory_address(uint32_t dma, uint8_t channel, uint32_t address)
+{
+    if (!(DMA_CCR(dma, channel) & DMA_CCR_EN))
+    {
+        DMA_CMAR(dma, channel) = address;
+    }
+}
+static inline uint16_t dma_get_number_of_data(uint32_t dma, uint8_t channel)
+{
+    return DMA_CNDTR(dma, channel);
+}
+static inline void dma_set_number_of_data(uint32_t dma, uint8_t channel, uint16_t number)
+{
+    DMA_CNDTR(dma, channel) = number;
+}
+
+#endif
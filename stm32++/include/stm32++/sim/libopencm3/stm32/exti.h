@@ -0,0 +1,44 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_EXTI_H
+#define STM32PP_SIM_EXTI_H
+
+/** The EXTI definitions of libopencm3. The EXTI is not modeled, the functions do nothing */
+
+#include "gpio.h"
+
+#define EXTI0                   GPIO0
+#define EXTI1                   GPIO1
+#define EXTI2                   GPIO2
+#define EXTI3                   GPIO3
+#define EXTI4                   GPIO4
+#define EXTI5                   GPIO5
+#define EXTI6                   GPIO6
+#define EXTI7                   GPIO7
+#define EXTI8                   GPIO8
+#define EXTI9                   GPIO9
+#define EXTI10                  GPIO10
+#define EXTI11                  GPIO11
+#define EXTI12                  GPIO12
+#define EXTI13                  GPIO13
+#define EXTI14                  GPIO14
+#define EXTI15                  GPIO15
+
+enum exti_trigger_type
+{
+    EXTI_TRIGGER_RISING,
+    EXTI_TRIGGER_FALLING,
+    EXTI_TRIGGER_BOTH
+};
+
+static inline void exti_set_trigger(uint32_t extis, enum exti_trigger_type trig) {}
+static inline void exti_enable_request(uint32_t extis) {}
+static inline void exti_disable_request(uint32_t extis) {}
+static inline void exti_reset_request(uint32_t extis) {}
+static inline void exti_select_source(uint32_t exti, uint32_t gpioport) {}
+static inline uint32_t exti_get_flag_status(uint32_t exti) { return 0; }
+
+#endif
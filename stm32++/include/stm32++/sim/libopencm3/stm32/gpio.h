@@ -0,0 +1,112 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_GPIO_H
+#define STM32PP_SIM_GPIO_H
+
+/** The STM32F1 GPIO registers and functions, as in libopencm3 */
+
+#include "../cm3/common.h"
+#include "memorymap.h"
+
+#define GPIOA                   GPIO_PORT_A_BASE
+#define GPIOB                   GPIO_PORT_B_BASE
+#define GPIOC                   GPIO_PORT_C_BASE
+#define GPIOD                   GPIO_PORT_D_BASE
+#define GPIOE                   GPIO_PORT_E_BASE
+#define GPIOF                   GPIO_PORT_F_BASE
+#define GPIOG                   GPIO_PORT_G_BASE
+
+#define GPIO0                   (1 << 0)
+#define GPIO1                   (1 << 1)
+#define GPIO2                   (1 << 2)
+#define GPIO3                   (1 << 3)
+#define GPIO4                   (1 << 4)
+#define GPIO5                   (1 << 5)
+#define GPIO6                   (1 << 6)
+#define GPIO7                   (1 << 7)
+#define GPIO8                   (1 << 8)
+#define GPIO9                   (1 << 9)
+#define GPIO10                  (1 << 10)
+#define GPIO11                  (1 << 11)
+#define GPIO12                  (1 << 12)
+#define GPIO13                  (1 << 13)
+#define GPIO14                  (1 << 14)
+#define GPIO15                  (1 << 15)
+#define GPIO_ALL                0xffff
+
+#define GPIO_CRL(port)          MMIO32((port) + 0x00)
+#define GPIO_CRH(port)          MMIO32((port) + 0x04)
+#define GPIO_IDR(port)          MMIO32((port) + 0x08)
+#define GPIO_ODR(port)          MMIO32((port) + 0x0c)
+#define GPIO_BSRR(port)         MMIO32((port) + 0x10)
+#define GPIO_BRR(port)          MMIO32((port) + 0x14)
+#define GPIO_LCKR(port)         MMIO32((port) + 0x18)
+#define GPIOA_ODR               GPIO_ODR(GPIOA)
+#define GPIOB_ODR               GPIO_ODR(GPIOB)
+#define GPIOC_ODR               GPIO_ODR(GPIOC)
+
+#define GPIO_MODE_INPUT                 0x00
+#define GPIO_MODE_OUTPUT_10_MHZ         0x01
+#define GPIO_MODE_OUTPUT_2_MHZ          0x02
+#define GPIO_MODE_OUTPUT_50_MHZ         0x03
+#define GPIO_CNF_INPUT_ANALOG           0x00
+#define GPIO_CNF_INPUT_FLOAT            0x01
+#define GPIO_CNF_INPUT_PULL_UPDOWN      0x02
+#define GPIO_CNF_OUTPUT_PUSHPULL        0x00
+#define GPIO_CNF_OUTPUT_OPENDRAIN       0x01
+#define GPIO_CNF_OUTPUT_ALTFN_PUSHPULL  0x02
+#define GPIO_CNF_OUTPUT_ALTFN_OPENDRAIN 0x03
+
+// Alternate function pins, without remapping
+#define GPIO_USART1_TX          GPIO9   // PA9
+#define GPIO_USART1_RX          GPIO10  // PA10
+#define GPIO_USART2_TX          GPIO2   // PA2
+#define GPIO_USART2_RX          GPIO3   // PA3
+#define GPIO_USART3_TX          GPIO10  // PB10
+#define GPIO_USART3_RX          GPIO11  // PB11
+#define GPIO_SPI1_NSS           GPIO4   // PA4
+#define GPIO_SPI1_SCK           GPIO5   // PA5
+#define GPIO_SPI1_MISO          GPIO6   // PA6
+#define GPIO_SPI1_MOSI          GPIO7   // PA7
+#define GPIO_SPI2_NSS           GPIO12  // PB12
+#define GPIO_SPI2_SCK           GPIO13  // PB13
+#define GPIO_SPI2_MISO          GPIO14  // PB14
+#define GPIO_SPI2_MOSI          GPIO15  // PB15
+#define GPIO_I2C1_SCL           GPIO6   // PB6
+#define GPIO_I2C1_SDA           GPIO7   // PB7
+#define GPIO_I2C2_SCL           GPIO10  // PB10
+#define GPIO_I2C2_SDA           GPIO11  // PB11
+
+static inline void gpio_set_mode(uint32_t gpioport, uint8_t mode, uint8_t cnf, uint16_t gpios)
+{
+    uint32_t crl = GPIO_CRL(gpioport);
+    uint32_t crh = GPIO_CRH(gpioport);
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        if (!((1 << i) & gpios))
+        {
+            continue;
+        }
+        uint8_t offset = (i < 8) ? (i * 4) : ((i - 8) * 4);
+        uint32_t& reg = (i < 8) ? crl : crh;
+        reg &= ~(0xf << offset);
+        reg |= (mode << offset) | (cnf << (offset + 2));
+    }
+    GPIO_CRL(gpioport) = crl;
+    GPIO_CRH(gpioport) = crh;
+}
+static inline void gpio_set(uint32_t gpioport, uint16_t gpios) { GPIO_BSRR(gpioport) = gpios; }
+static inline void gpio_clear(uint32_t gpioport, uint16_t gpios) { GPIO_BSRR(gpioport) = (gpios << 16); }
+static inline uint16_t gpio_get(uint32_t gpioport, uint16_t gpios) { return GPIO_IDR(gpioport) & gpios; }
+static inline void gpio_toggle(uint32_t gpioport, uint16_t gpios)
+{
+    uint32_t port = GPIO_ODR(gpioport);
+    GPIO_BSRR(gpioport) = ((port & gpios) << 16) | (~port & gpios);
+}
+static inline uint16_t gpio_port_read(uint32_t gpioport) { return GPIO_IDR(gpioport); }
+static inline void gpio_port_write(uint32_t gpioport, uint16_t data) { GPIO_ODR(gpioport) = data; }
+
+#endif
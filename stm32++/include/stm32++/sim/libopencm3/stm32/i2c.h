@@ -0,0 +1,121 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_I2C_H
+#define STM32PP_SIM_I2C_H
+
+/** The STM32F1 I2C registers and functions, as in libopencm3 */
+
+#include "../cm3/common.h"
+#include "memorymap.h"
+#include "rcc.h"
+
+#define I2C1                    I2C1_BASE
+#define I2C2                    I2C2_BASE
+
+#define I2C_CR1(i2c_base)       MMIO32((i2c_base) + 0x00)
+#define I2C_CR2(i2c_base)       MMIO32((i2c_base) + 0x04)
+#define I2C_OAR1(i2c_base)      MMIO32((i2c_base) + 0x08)
+#define I2C_OAR2(i2c_base)      MMIO32((i2c_base) + 0x0c)
+#define I2C_DR(i2c_base)        MMIO32((i2c_base) + 0x10)
+#define I2C_SR1(i2c_base)       MMIO32((i2c_base) + 0x14)
+#define I2C_SR2(i2c_base)       MMIO32((i2c_base) + 0x18)
+#define I2C_CCR(i2c_base)       MMIO32((i2c_base) + 0x1c)
+#define I2C_TRISE(i2c_base)     MMIO32((i2c_base) + 0x20)
+#define I2C1_DR                 I2C_DR(I2C1)
+#define I2C2_DR                 I2C_DR(I2C2)
+
+#define I2C_CR1_PE              (1 << 0)
+#define I2C_CR1_START           (1 << 8)
+#define I2C_CR1_STOP            (1 << 9)
+#define I2C_CR1_ACK             (1 << 10)
+#define I2C_CR1_POS             (1 << 11)
+#define I2C_CR1_SWRST           (1 << 15)
+
+#define I2C_CR2_FREQ_MASK       0x3f
+#define I2C_CR2_ITERREN         (1 << 8)
+#define I2C_CR2_ITEVTEN         (1 << 9)
+#define I2C_CR2_ITBUFEN         (1 << 10)
+#define I2C_CR2_DMAEN           (1 << 11)
+#define I2C_CR2_LAST            (1 << 12)
+
+#define I2C_SR1_SB              (1 << 0)
+#define I2C_SR1_ADDR            (1 << 1)
+#define I2C_SR1_BTF             (1 << 2)
+#define I2C_SR1_ADD10           (1 << 3)
+#define I2C_SR1_STOPF           (1 << 4)
+#define I2C_SR1_RxNE            (1 << 6)
+#define I2C_SR1_TxE             (1 << 7)
+#define I2C_SR1_BERR            (1 << 8)
+#define I2C_SR1_ARLO            (1 << 9)
+#define I2C_SR1_AF              (1 << 10)
+#define I2C_SR1_OVR             (1 << 11)
+
+#define I2C_SR2_MSL             (1 << 0)
+#define I2C_SR2_BUSY            (1 << 1)
+#define I2C_SR2_TRA             (1 << 2)
+
+#define I2C_CCR_FS              (1 << 15)
+#define I2C_CCR_DUTY            (1 << 14)
+#define I2C_CCR_DUTY_DIV2       0
+#define I2C_CCR_DUTY_16_DIV_9   1
+#define I2C_CCR_CCR_MASK        0xfff
+
+#define I2C_WRITE               0
+#define I2C_READ                1
+
+static inline void i2c_reset(uint32_t i2c)
+{
+    rcc_periph_reset_pulse((enum rcc_periph_rst)i2c);
+}
+static inline void i2c_peripheral_enable(uint32_t i2c) { I2C_CR1(i2c) |= I2C_CR1_PE; }
+static inline void i2c_peripheral_disable(uint32_t i2c) { I2C_CR1(i2c) &= ~I2C_CR1_PE; }
+static inline void i2c_send_start(uint32_t i2c) { I2C_CR1(i2c) |= I2C_CR1_START; }
+static inline void i2c_send_stop(uint32_t i2c) { I2C_CR1(i2c) |= I2C_CR1_STOP; }
+static inline void i2c_clear_stop(uint32_t i2c) { I2C_CR1(i2c) &= ~I2C_CR1_STOP; }
+static inline void i2c_set_own_7bit_slave_address(uint32_t i2c, uint8_t slave)
+{
+    uint16_t val = (uint16_t)(slave << 1);
+    val |= (1 << 14); // bit 14 should always be set to 1
+    I2C_OAR1(i2c) = val;
+}
+static inline void i2c_set_clock_frequency(uint32_t i2c, uint8_t freq)
+{
+    I2C_CR2(i2c) = (I2C_CR2(i2c) & ~I2C_CR2_FREQ_MASK) | freq;
+}
+static inline void i2c_send_data(uint32_t i2c, uint8_t data) { I2C_DR(i2c) = data; }
+static inline uint8_t i2c_get_data(uint32_t i2c) { return I2C_DR(i2c) & 0xff; }
+static inline void i2c_set_fast_mode(uint32_t i2c) { I2C_CCR(i2c) |= I2C_CCR_FS; }
+static inline void i2c_set_standard_mode(uint32_t i2c) { I2C_CCR(i2c) &= ~I2C_CCR_FS; }
+static inline void i2c_set_ccr(uint32_t i2c, uint16_t freq)
+{
+    I2C_CCR(i2c) = (I2C_CCR(i2c) & ~I2C_CCR_CCR_MASK) | freq;
+}
+static inline void i2c_set_trise(uint32_t i2c, uint16_t trise) { I2C_TRISE(i2c) = trise; }
+static inline void i2c_send_7bit_address(uint32_t i2c, uint8_t slave, uint8_t readwrite)
+{
+    I2C_DR(i2c) = (uint8_t)((slave << 1) | readwrite);
+}
+static inline void i2c_enable_interrupt(uint32_t i2c, uint32_t interrupt) { I2C_CR2(i2c) |= interrupt; }
+static inline void i2c_disable_interrupt(uint32_t i2c, uint32_t interrupt) { I2C_CR2(i2c) &= ~interrupt; }
+static inline void i2c_enable_ack(uint32_t i2c) { I2C_CR1(i2c) |= I2C_CR1_ACK; }
+static inline void i2c_disable_ack(uint32_t i2c) { I2C_CR1(i2c) &= ~I2C_CR1_ACK; }
+static inline void i2c_set_dutycycle(uint32_t i2c, uint32_t dutycycle)
+{
+    if (dutycycle == I2C_CCR_DUTY_DIV2)
+    {
+        I2C_CCR(i2c) &= ~I2C_CCR_DUTY;
+    }
+    else
+    {
+        I2C_CCR(i2c) |= I2C_CCR_DUTY;
+    }
+}
+static inline void i2c_enable_dma(uint32_t i2c) { I2C_CR2(i2c) |= I2C_CR2_DMAEN; }
+static inline void i2c_disable_dma(uint32_t i2c) { I2C_CR2(i2c) &= ~I2C_CR2_DMAEN; }
+static inline void i2c_set_dma_last_transfer(uint32_t i2c) { I2C_CR2(i2c) |= I2C_CR2_LAST; }
+static inline void i2c_clear_dma_last_transfer(uint32_t i2c) { I2C_CR2(i2c) &= ~I2C_CR2_LAST; }
+
+#endif
@@ -0,0 +1,41 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_MEMORYMAP_H
+#define STM32PP_SIM_MEMORYMAP_H
+
+/** STM32F1 register block addresses, as in libopencm3. The simulator maps
+ * them to its peripheral models, see sim/core.hpp */
+
+#define PERIPH_BASE             (0x40000000U)
+#define PERIPH_BASE_APB1        (PERIPH_BASE + 0x00000)
+#define PERIPH_BASE_APB2        (PERIPH_BASE + 0x10000)
+#define PERIPH_BASE_AHB         (PERIPH_BASE + 0x18000)
+
+#define SPI2_BASE               (PERIPH_BASE_APB1 + 0x3800)
+#define USART2_BASE             (PERIPH_BASE_APB1 + 0x4400)
+#define USART3_BASE             (PERIPH_BASE_APB1 + 0x4800)
+#define I2C1_BASE               (PERIPH_BASE_APB1 + 0x5400)
+#define I2C2_BASE               (PERIPH_BASE_APB1 + 0x5800)
+
+#define AFIO_BASE               (PERIPH_BASE_APB2 + 0x0000)
+#define EXTI_BASE               (PERIPH_BASE_APB2 + 0x0400)
+#define GPIO_PORT_A_BASE        (PERIPH_BASE_APB2 + 0x0800)
+#define GPIO_PORT_B_BASE        (PERIPH_BASE_APB2 + 0x0c00)
+#define GPIO_PORT_C_BASE        (PERIPH_BASE_APB2 + 0x1000)
+#define GPIO_PORT_D_BASE        (PERIPH_BASE_APB2 + 0x1400)
+#define GPIO_PORT_E_BASE        (PERIPH_BASE_APB2 + 0x1800)
+#define GPIO_PORT_F_BASE        (PERIPH_BASE_APB2 + 0x1c00)
+#define GPIO_PORT_G_BASE        (PERIPH_BASE_APB2 + 0x2000)
+#define SPI1_BASE               (PERIPH_BASE_APB2 + 0x3000)
+#define USART1_BASE             (PERIPH_BASE_APB2 + 0x3800)
+
+#define DMA1_BASE               (PERIPH_BASE_AHB + 0x08000)
+#define DMA2_BASE               (PERIPH_BASE_AHB + 0x08400)
+#define RCC_BASE                (PERIPH_BASE_AHB + 0x09000)
+
+#define DWT_BASE                (0xE0001000U)
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_RCC_H
+#define STM32PP_SIM_RCC_H
+
+/** The RCC functions of libopencm3. Peripheral clocks are always on, a reset
+ * pulse resets the peripheral model. The bus frequencies are those of the simulator */
+
+#include "../cm3/common.h"
+#include "memorymap.h"
+
+#define rcc_ahb_frequency       (sim::Sim::instance().clocks().ahb)
+#define rcc_apb1_frequency      (sim::Sim::instance().clocks().apb1)
+#define rcc_apb2_frequency      (sim::Sim::instance().clocks().apb2)
+
+enum rcc_periph_clken
+{
+    RCC_DMA1, RCC_DMA2, RCC_SRAM, RCC_FLTF, RCC_CRC, RCC_FSMC, RCC_SDIO,
+    RCC_AFIO, RCC_GPIOA, RCC_GPIOB, RCC_GPIOC, RCC_GPIOD, RCC_GPIOE, RCC_GPIOF, RCC_GPIOG,
+    RCC_ADC1, RCC_ADC2, RCC_ADC3, RCC_TIM1, RCC_TIM2, RCC_TIM3, RCC_TIM4, RCC_TIM8,
+    RCC_SPI1, RCC_SPI2, RCC_SPI3, RCC_USART1, RCC_USART2, RCC_USART3, RCC_UART4, RCC_UART5,
+    RCC_I2C1, RCC_I2C2, RCC_USB, RCC_CAN, RCC_BKP, RCC_PWR, RCC_DAC, RCC_WWDG
+};
+
+/** The reset ids are the base addresses of the modeled peripherals */
+enum rcc_periph_rst: uint32_t
+{
+    RST_USART1 = USART1_BASE, RST_USART2 = USART2_BASE, RST_USART3 = USART3_BASE,
+    RST_SPI1 = SPI1_BASE, RST_SPI2 = SPI2_BASE, RST_I2C1 = I2C1_BASE, RST_I2C2 = I2C2_BASE,
+    RST_GPIOA = GPIO_PORT_A_BASE, RST_GPIOB = GPIO_PORT_B_BASE, RST_GPIOC = GPIO_PORT_C_BASE,
+    RST_GPIOD = GPIO_PORT_D_BASE, RST_GPIOE = GPIO_PORT_E_BASE, RST_GPIOF = GPIO_PORT_F_BASE,
+    RST_GPIOG = GPIO_PORT_G_BASE, RST_AFIO = AFIO_BASE
+};
+
+static inline void rcc_periph_clock_enable(enum rcc_periph_clken clken) {}
+static inline void rcc_periph_clock_disable(enum rcc_periph_clken clken) {}
+static inline void rcc_periph_reset_pulse(enum rcc_periph_rst rst)
+{
+    sim::Sim::instance().resetModel(rst);
+}
+static inline void rcc_periph_reset_hold(enum rcc_periph_rst rst)
+{
+    sim::Sim::instance().resetModel(rst);
+}
+static inline void rcc_periph_reset_release(enum rcc_periph_rst rst) {}
+
+static inline void rcc_clock_setup_in_hse_8mhz_out_72mhz(void)
+{
+    sim::setClocks(72000000, 36000000, 72000000);
+}
+static inline void rcc_clock_setup_in_hsi_out_48mhz(void)
+{
+    sim::setClocks(48000000, 24000000, 48000000);
+}
+static inline void rcc_clock_setup_in_hsi_out_24mhz(void)
+{
+    sim::setClocks(24000000, 24000000, 24000000);
+}
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_SPI_H
+#define STM32PP_SIM_SPI_H
+
+/** The STM32F1 SPI registers and functions, as in libopencm3 */
+
+#include "../cm3/common.h"
+#include "memorymap.h"
+#include "rcc.h"
+
+#define SPI1                    SPI1_BASE
+#define SPI2                    SPI2_BASE
+
+#define SPI_CR1(spi_base)       MMIO32((spi_base) + 0x00)
+#define SPI_CR2(spi_base)       MMIO32((spi_base) + 0x04)
+#define SPI_SR(spi_base)        MMIO32((spi_base) + 0x08)
+#define SPI_DR(spi_base)        MMIO32((spi_base) + 0x0c)
+#define SPI_CRCPR(spi_base)     MMIO32((spi_base) + 0x10)
+#define SPI1_DR                 SPI_DR(SPI1)
+#define SPI2_DR                 SPI_DR(SPI2)
+
+#define SPI_CR1_CPHA_CLK_TRANSITION_1   (0 << 0)
+#define SPI_CR1_CPHA_CLK_TRANSITION_2   (1 << 0)
+#define SPI_CR1_CPHA                    (1 << 0)
+#define SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE (0 << 1)
+#define SPI_CR1_CPOL_CLK_TO_1_WHEN_IDLE (1 << 1)
+#define SPI_CR1_CPOL                    (1 << 1)
+#define SPI_CR1_MSTR                    (1 << 2)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_2    (0x00 << 3)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_4    (0x01 << 3)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_8    (0x02 << 3)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_16   (0x03 << 3)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_32   (0x04 << 3)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_64   (0x05 << 3)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_128  (0x06 << 3)
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_256  (0x07 << 3)
+#define SPI_CR1_BR_MASK                 (0x07 << 3)
+#define SPI_CR1_SPE                     (1 << 6)
+#define SPI_CR1_MSBFIRST                (0 << 7)
+#define SPI_CR1_LSBFIRST                (1 << 7)
+#define SPI_CR1_SSI                     (1 << 8)
+#define SPI_CR1_SSM                     (1 << 9)
+#define SPI_CR1_RXONLY                  (1 << 10)
+#define SPI_CR1_DFF_8BIT                (0 << 11)
+#define SPI_CR1_DFF_16BIT               (1 << 11)
+#define SPI_CR1_DFF                     (1 << 11)
+#define SPI_CR1_CRCNEXT                 (1 << 12)
+#define SPI_CR1_CRCEN                   (1 << 13)
+
+#define SPI_CR2_RXDMAEN         (1 << 0)
+#define SPI_CR2_TXDMAEN         (1 << 1)
+#define SPI_CR2_SSOE            (1 << 2)
+#define SPI_CR2_ERRIE           (1 << 5)
+#define SPI_CR2_RXNEIE          (1 << 6)
+#define SPI_CR2_TXEIE           (1 << 7)
+
+#define SPI_SR_RXNE             (1 << 0)
+#define SPI_SR_TXE              (1 << 1)
+#define SPI_SR_OVR              (1 << 6)
+#define SPI_SR_BSY              (1 << 7)
+
+static inline void spi_reset(uint32_t spi_peripheral)
+{
+    rcc_periph_reset_pulse((enum rcc_periph_rst)spi_peripheral);
+}
+static inline int spi_init_master(uint32_t spi, uint32_t br, uint32_t cpol, uint32_t cpha,
+    uint32_t dff, uint32_t lsbfirst)
+{
+    uint32_t reg32 = SPI_CR1(spi);
+    // Reset all bits omitting SPE, CRCEN and CRCNEXT bits
+    reg32 &= SPI_CR1_SPE | SPI_CR1_CRCEN | SPI_CR1_CRCNEXT;
+    reg32 |= SPI_CR1_MSTR | br | cpol | cpha | dff | lsbfirst;
+    SPI_CR2(spi) |= SPI_CR2_SSOE;
+    SPI_CR1(spi) = reg32;
+    return 0;
+}
+static inline void spi_enable(uint32_t spi) { SPI_CR1(spi) |= SPI_CR1_SPE; }
+static inline void spi_disable(uint32_t spi) { SPI_CR1(spi) &= ~SPI_CR1_SPE; }
+static inline void spi_write(uint32_t spi, uint16_t data) { SPI_DR(spi) = data; }
+static inline void spi_send(uint32_t spi, uint16_t data)
+{
+    while (!(SPI_SR(spi) & SPI_SR_TXE));
+    SPI_DR(spi) = data;
+}
+static inline uint16_t spi_read(uint32_t spi)
+{
+    while (!(SPI_SR(spi) & SPI_SR_RXNE));
+    return SPI_DR(spi);
+}
+static inline uint16_t spi_xfer(uint32_t spi, uint16_t data)
+{
+    spi_write(spi, data);
+    while (!(SPI_SR(spi) & SPI_SR_RXNE));
+    return SPI_DR(spi);
+}
+static inline void spi_set_baudrate_prescaler(uint32_t spi, uint8_t baudrate)
+{
+    SPI_CR1(spi) = (SPI_CR1(spi) & ~SPI_CR1_BR_MASK) | ((baudrate & 7) << 3);
+}
+static inline void spi_set_dff_8bit(uint32_t spi) { SPI_CR1(spi) &= ~SPI_CR1_DFF; }
+static inline void spi_set_dff_16bit(uint32_t spi) { SPI_CR1(spi) |= SPI_CR1_DFF; }
+static inline void spi_set_clock_polarity_0(uint32_t spi) { SPI_CR1(spi) &= ~SPI_CR1_CPOL; }
+static inline void spi_set_clock_polarity_1(uint32_t spi) { SPI_CR1(spi) |= SPI_CR1_CPOL; }
+static inline void spi_set_clock_phase_0(uint32_t spi) { SPI_CR1(spi) &= ~SPI_CR1_CPHA; }
+static inline void spi_set_clock_phase_1(uint32_t spi) { SPI_CR1(spi) |= SPI_CR1_CPHA; }
+static inline void spi_send_msb_first(uint32_t spi) { SPI_CR1(spi) &= ~SPI_CR1_LSBFIRST; }
+static inline void spi_send_lsb_first(uint32_t spi) { SPI_CR1(spi) |= SPI_CR1_LSBFIRST; }
+static inline void spi_enable_software_slave_management(uint32_t spi) { SPI_CR1(spi) |= SPI_CR1_SSM; }
+static inline void spi_disable_software_slave_management(uint32_t spi) { SPI_CR1(spi) &= ~SPI_CR1_SSM; }
+static inline void spi_set_nss_high(uint32_t spi) { SPI_CR1(spi) |= SPI_CR1_SSI; }
+static inline void spi_set_nss_low(uint32_t spi) { SPI_CR1(spi) &= ~SPI_CR1_SSI; }
+static inline void spi_enable_ss_output(uint32_t spi) { SPI_CR2(spi) |= SPI_CR2_SSOE; }
+static inline void spi_disable_ss_output(uint32_t spi) { SPI_CR2(spi) &= ~SPI_CR2_SSOE; }
+static inline void spi_enable_tx_dma(uint32_t spi) { SPI_CR2(spi) |= SPI_CR2_TXDMAEN; }
+static inline void spi_disable_tx_dma(uint32_t spi) { SPI_CR2(spi) &= ~SPI_CR2_TXDMAEN; }
+static inline void spi_enable_rx_dma(uint32_t spi) { SPI_CR2(spi) |= SPI_CR2_RXDMAEN; }
+static inline void spi_disable_rx_dma(uint32_t spi) { SPI_CR2(spi) &= ~SPI_CR2_RXDMAEN; }
+static inline void spi_enable_tx_buffer_empty_interrupt(uint32_t spi) { SPI_CR2(spi) |= SPI_CR2_TXEIE; }
+static inline void spi_disable_tx_buffer_empty_interrupt(uint32_t spi) { SPI_CR2(spi) &= ~SPI_CR2_TXEIE; }
+static inline void spi_enable_rx_buffer_not_empty_interrupt(uint32_t spi) { SPI_CR2(spi) |= SPI_CR2_RXNEIE; }
+static inline void spi_disable_rx_buffer_not_empty_interrupt(uint32_t spi) { SPI_CR2(spi) &= ~SPI_CR2_RXNEIE; }
+static inline void spi_enable_error_interrupt(uint32_t spi) { SPI_CR2(spi) |= SPI_CR2_ERRIE; }
+static inline void spi_disable_error_interrupt(uint32_t spi) { SPI_CR2(spi) &= ~SPI_CR2_ERRIE; }
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_USART_H
+#define STM32PP_SIM_USART_H
+
+/** The STM32F1 USART registers and functions, as in libopencm3 */
+
+#include "../cm3/common.h"
+#include "memorymap.h"
+#include "rcc.h"
+
+#define USART1                  USART1_BASE
+#define USART2                  USART2_BASE
+#define USART3                  USART3_BASE
+
+#define USART_SR(usart_base)    MMIO32((usart_base) + 0x00)
+#define USART_DR(usart_base)    MMIO32((usart_base) + 0x04)
+#define USART_BRR(usart_base)   MMIO32((usart_base) + 0x08)
+#define USART_CR1(usart_base)   MMIO32((usart_base) + 0x0c)
+#define USART_CR2(usart_base)   MMIO32((usart_base) + 0x10)
+#define USART_CR3(usart_base)   MMIO32((usart_base) + 0x14)
+#define USART_GTPR(usart_base)  MMIO32((usart_base) + 0x18)
+#define USART1_SR               USART_SR(USART1)
+#define USART1_DR               USART_DR(USART1)
+#define USART2_SR               USART_SR(USART2)
+#define USART2_DR               USART_DR(USART2)
+#define USART3_SR               USART_SR(USART3)
+#define USART3_DR               USART_DR(USART3)
+
+#define USART_SR_PE             (1 << 0)
+#define USART_SR_FE             (1 << 1)
+#define USART_SR_NE             (1 << 2)
+#define USART_SR_ORE            (1 << 3)
+#define USART_SR_IDLE           (1 << 4)
+#define USART_SR_RXNE           (1 << 5)
+#define USART_SR_TC             (1 << 6)
+#define USART_SR_TXE            (1 << 7)
+#define USART_SR_LBD            (1 << 8)
+#define USART_SR_CTS            (1 << 9)
+#define USART_DR_MASK           0x1ff
+
+#define USART_CR1_SBK           (1 << 0)
+#define USART_CR1_RWU           (1 << 1)
+#define USART_CR1_RE            (1 << 2)
+#define USART_CR1_TE            (1 << 3)
+#define USART_CR1_IDLEIE        (1 << 4)
+#define USART_CR1_RXNEIE        (1 << 5)
+#define USART_CR1_TCIE          (1 << 6)
+#define USART_CR1_TXEIE         (1 << 7)
+#define USART_CR1_PEIE          (1 << 8)
+#define USART_CR1_PS            (1 << 9)
+#define USART_CR1_PCE           (1 << 10)
+#define USART_CR1_WAKE          (1 << 11)
+#define USART_CR1_M             (1 << 12)
+#define USART_CR1_UE            (1 << 13)
+
+#define USART_CR2_STOPBITS_1    (0x00 << 12)
+#define USART_CR2_STOPBITS_0_5  (0x01 << 12)
+#define USART_CR2_STOPBITS_2    (0x02 << 12)
+#define USART_CR2_STOPBITS_1_5  (0x03 << 12)
+#define USART_CR2_STOPBITS_MASK (0x03 << 12)
+
+#define USART_CR3_EIE           (1 << 0)
+#define USART_CR3_DMAR          (1 << 6)
+#define USART_CR3_DMAT          (1 << 7)
+#define USART_CR3_RTSE          (1 << 8)
+#define USART_CR3_CTSE          (1 << 9)
+
+#define USART_PARITY_NONE       0x00
+#define USART_PARITY_EVEN       USART_CR1_PCE
+#define USART_PARITY_ODD        (USART_CR1_PS | USART_CR1_PCE)
+#define USART_PARITY_MASK       (USART_CR1_PS | USART_CR1_PCE)
+#define USART_MODE_RX           USART_CR1_RE
+#define USART_MODE_TX           USART_CR1_TE
+#define USART_MODE_TX_RX        (USART_CR1_RE | USART_CR1_TE)
+#define USART_MODE_MASK         (USART_CR1_RE | USART_CR1_TE)
+#define USART_STOPBITS_0_5      USART_CR2_STOPBITS_0_5
+#define USART_STOPBITS_1        USART_CR2_STOPBITS_1
+#define USART_STOPBITS_1_5      USART_CR2_STOPBITS_1_5
+#define USART_STOPBITS_2        USART_CR2_STOPBITS_2
+#define USART_FLOWCONTROL_NONE      0x00
+#define USART_FLOWCONTROL_RTS       USART_CR3_RTSE
+#define USART_FLOWCONTROL_CTS       USART_CR3_CTSE
+#define USART_FLOWCONTROL_RTS_CTS   (USART_CR3_RTSE | USART_CR3_CTSE)
+#define USART_FLOWCONTROL_MASK      (USART_CR3_RTSE | USART_CR3_CTSE)
+
+static inline void usart_set_baudrate(uint32_t usart, uint32_t baud)
+{
+    uint32_t clock = (usart == USART1) ? rcc_apb2_frequency : rcc_apb1_frequency;
+    USART_BRR(usart) = (clock + baud / 2) / baud;
+}
+static inline void usart_set_databits(uint32_t usart, uint32_t bits)
+{
+    if (bits == 8)
+    {
+        USART_CR1(usart) &= ~USART_CR1_M;
+    }
+    else
+    {
+        USART_CR1(usart) |= USART_CR1_M;
+    }
+}
+static inline void usart_set_stopbits(uint32_t usart, uint32_t stopbits)
+{
+    USART_CR2(usart) = (USART_CR2(usart) & ~USART_CR2_STOPBITS_MASK) | stopbits;
+}
+static inline void usart_set_parity(uint32_t usart, uint32_t parity)
+{
+    USART_CR1(usart) = (USART_CR1(usart) & ~USART_PARITY_MASK) | parity;
+}
+static inline void usart_set_mode(uint32_t usart, uint32_t mode)
+{
+    USART_CR1(usart) = (USART_CR1(usart) & ~USART_MODE_MASK) | mode;
+}
+static inline void usart_set_flow_control(uint32_t usart, uint32_t flowcontrol)
+{
+    USART_CR3(usart) = (USART_CR3(usart) & ~USART_FLOWCONTROL_MASK) | flowcontrol;
+}
+static inline void usart_enable(uint32_t usart) { USART_CR1(usart) |= USART_CR1_UE; }
+static inline void usart_disable(uint32_t usart) { USART_CR1(usart) &= ~USART_CR1_UE; }
+static inline void usart_send(uint32_t usart, uint16_t data) { USART_DR(usart) = (data & USART_DR_MASK); }
+static inline uint16_t usart_recv(uint32_t usart) { return USART_DR(usart) & USART_DR_MASK; }
+static inline void usart_wait_send_ready(uint32_t usart)
+{
+    while ((USART_SR(usart) & USART_SR_TXE) == 0);
+}
+static inline void usart_wait_recv_ready(uint32_t usart)
+{
+    while ((USART_SR(usart) & USART_SR_RXNE) == 0);
+}
+static inline void usart_send_blocking(uint32_t usart, uint16_t data)
+{
+    usart_wait_send_ready(usart);
+    usart_send(usart, data);
+}
+static inline uint16_t usart_recv_blocking(uint32_t usart)
+{
+    usart_wait_recv_ready(usart);
+    return usart_recv(usart);
+}
+static inline void usart_enable_rx_dma(uint32_t usart) { USART_CR3(usart) |= USART_CR3_DMAR; }
+static inline void usart_disable_rx_dma(uint32_t usart) { USART_CR3(usart) &= ~USART_CR3_DMAR; }
+static inline void usart_enable_tx_dma(uint32_t usart) { USART_CR3(usart) |= USART_CR3_DMAT; }
+static inline void usart_disable_tx_dma(uint32_t usart) { USART_CR3(usart) &= ~USART_CR3_DMAT; }
+static inline void usart_enable_rx_interrupt(uint32_t usart) { USART_CR1(usart) |= USART_CR1_RXNEIE; }
+static inline void usart_disable_rx_interrupt(uint32_t usart) { USART_CR1(usart) &= ~USART_CR1_RXNEIE; }
+static inline void usart_enable_tx_interrupt(uint32_t usart) { USART_CR1(usart) |= USART_CR1_TXEIE; }
+static inline void usart_disable_tx_interrupt(uint32_t usart) { USART_CR1(usart) &= ~USART_CR1_TXEIE; }
+static inline void usart_enable_tx_complete_interrupt(uint32_t usart) { USART_CR1(usart) |= USART_CR1_TCIE; }
+static inline void usart_disable_tx_complete_interrupt(uint32_t usart) { USART_CR1(usart) &= ~USART_CR1_TCIE; }
+static inline void usart_enable_idle_interrupt(uint32_t usart) { USART_CR1(usart) |= USART_CR1_IDLEIE; }
+static inline void usart_disable_idle_interrupt(uint32_t usart) { USART_CR1(usart) &= ~USART_CR1_IDLEIE; }
+static inline void usart_enable_error_interrupt(uint32_t usart) { USART_CR3(usart) |= USART_CR3_EIE; }
+static inline void usart_disable_error_interrupt(uint32_t usart) { USART_CR3(usart) &= ~USART_CR3_EIE; }
+static inline bool usart_get_flag(uint32_t usart, uint32_t flag) { return (USART_SR(usart) & flag) != 0; }
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_HPP
+#define STM32PP_SIM_HPP
+
+/** @brief Host-side simulator of the STM32F1 peripherals, see core.hpp.
+ * A test is built with \c STM32PP_NOT_EMBEDDED and \c STM32PP_SIM, and with
+ * \c include/stm32++/sim ahead of libopencm3 in the include path, so that the
+ * library drivers run unmodified against the peripheral models:
+ * \code
+ * dma::Tx<nsusart::Usart<USART1>> usart;
+ * extern "C" void dma1_channel4_isr() { usart.dmaTxIsr(); }
+ * ...
+ * usart.init(nsusart::kOptEnableTx, 115200);
+ * usart.dmaTxStart(msg, sizeof(msg));
+ * sim::runUntil([]() { return !usart.txBusy(); }, 1000000);
+ * check(sim::usart(USART1).txData() == msg);
+ * \endcode
+ * The models are created on first use. Interrupt handlers are looked up as in
+ * the vector table, i.e. the \c xxx_isr() functions, unless set by \c sim::setIsr()
+ */
+
+#include "core.hpp"
+#include "irqs.hpp"
+#include "dmaModel.hpp"
+#include "usartModel.hpp"
+#include "spiModel.hpp"
+#include "i2cModel.hpp"
+#include "gpioModel.hpp"
+
+namespace sim
+{
+inline Sim& Sim::instance()
+{
+    static Sim* inst = nullptr;
+    if (inst)
+    {
+        return *inst;
+    }
+    inst = new Sim;
+    static const uint8_t dma1Irqs[] = {
+        NVIC_DMA1_CHANNEL1_IRQ, NVIC_DMA1_CHANNEL2_IRQ, NVIC_DMA1_CHANNEL3_IRQ,
+        NVIC_DMA1_CHANNEL4_IRQ, NVIC_DMA1_CHANNEL5_IRQ, NVIC_DMA1_CHANNEL6_IRQ,
+        NVIC_DMA1_CHANNEL7_IRQ
+    };
+    static const uint8_t dma2Irqs[] = {
+        NVIC_DMA2_CHANNEL1_IRQ, NVIC_DMA2_CHANNEL2_IRQ, NVIC_DMA2_CHANNEL3_IRQ,
+        NVIC_DMA2_CHANNEL4_5_IRQ, NVIC_DMA2_CHANNEL5_IRQ
+    };
+    inst->addModel(new DmaModel(DMA1_BASE, 7, dma1Irqs));
+    inst->addModel(new DmaModel(DMA2_BASE, 5, dma2Irqs));
+    inst->addModel(new UsartModel(USART1_BASE, true, NVIC_USART1_IRQ, DMA1_BASE, 4, 5));
+    inst->addModel(new UsartModel(USART2_BASE, false, NVIC_USART2_IRQ, DMA1_BASE, 7, 6));
+    inst->addModel(new UsartModel(USART3_BASE, false, NVIC_USART3_IRQ, DMA1_BASE, 2, 3));
+    inst->addModel(new SpiModel(SPI1_BASE, true, NVIC_SPI1_IRQ, DMA1_BASE, 3, 2));
+    inst->addModel(new SpiModel(SPI2_BASE, false, NVIC_SPI2_IRQ, DMA1_BASE, 5, 4));
+    inst->addModel(new I2cModel(I2C1_BASE, NVIC_I2C1_EV_IRQ, NVIC_I2C1_ER_IRQ, DMA1_BASE, 6, 7));
+    inst->addModel(new I2cModel(I2C2_BASE, NVIC_I2C2_EV_IRQ, NVIC_I2C2_ER_IRQ, DMA1_BASE, 4, 5));
+    for (uint32_t port = GPIO_PORT_A_BASE; port <= GPIO_PORT_G_BASE; port += Model::kBlockSize)
+    {
+        inst->addModel(new GpioModel(port));
+    }
+    inst->addModel(new DwtModel(DWT_BASE));
+    return *inst;
+}
+
+inline IsrFunc Sim::isr(uint8_t irq) const
+{
+    checkIrq(irq);
+    if (mIsrs[irq])
+    {
+        return mIsrs[irq];
+    }
+#define STM32PP_SIM_IRQ_VECTOR(num, name, func) func##_isr,
+    static void (* const vectors[kNumIrqs])(void) = { STM32PP_SIM_IRQS(STM32PP_SIM_IRQ_VECTOR) };
+#undef STM32PP_SIM_IRQ_VECTOR
+    return vectors[irq] ? IsrFunc(vectors[irq]) : IsrFunc();
+}
+
+static inline DmaModel& dma(uint32_t base) { return Sim::instance().model<DmaModel>(base); }
+static inline UsartModel& usart(uint32_t base) { return Sim::instance().model<UsartModel>(base); }
+static inline SpiModel& spi(uint32_t base) { return Sim::instance().model<SpiModel>(base); }
+static inline I2cModel& i2c(uint32_t base) { return Sim::instance().model<I2cModel>(base); }
+static inline GpioModel& gpio(uint32_t base) { return Sim::instance().model<GpioModel>(base); }
+}
+
+#endif
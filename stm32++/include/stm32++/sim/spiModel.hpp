@@ -0,0 +1,189 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_SPI_MODEL_HPP
+#define STM32PP_SIM_SPI_MODEL_HPP
+
+#include "core.hpp"
+#include <vector>
+
+namespace sim
+{
+/** @brief Model of an STM32F1 SPI, in master mode.
+ * A frame takes (8 or 16) * baudrate prescaler APB cycles. As in the hardware,
+ * a word written to DR goes to the shift register if it's idle, so that two
+ * words can be queued. The slave is a callback that is given each word sent
+ * on MOSI, and returns the word to shift in on MISO - by default all ones.
+ * The words sent on MOSI are also collected in \c mosi().
+ * OVR is cleared by a read of DR followed by a read of SR
+ */
+class SpiModel: public Model
+{
+public:
+    enum: uint32_t
+    {
+        kCr1 = 0x00, kCr2 = 0x04, kSr = 0x08, kDr = 0x0c, kCrcpr = 0x10,
+        // CR1
+        kMstr = 1 << 2, kSpe = 1 << 6, kDff = 1 << 11,
+        // CR2
+        kRxdmaen = 1 << 0, kTxdmaen = 1 << 1, kErrie = 1 << 5, kRxneie = 1 << 6, kTxeie = 1 << 7,
+        // SR
+        kRxne = 1 << 0, kTxe = 1 << 1, kOvr = 1 << 6, kBsy = 1 << 7
+    };
+    typedef std::function<uint16_t(uint16_t)> Slave;
+protected:
+    const bool mApb2;
+    const uint8_t mIrq;
+    const uint32_t mDma;
+    const uint8_t mTxChan;
+    const uint8_t mRxChan;
+    uint32_t mCr1, mCr2, mSr, mCrcpr;
+    uint16_t mRxDr;
+    uint16_t mTxBuf;
+    bool mTxBufFull;
+    uint16_t mShiftReg;
+    Cycles mFrameDoneAt;
+    bool mOvrDrRead; // DR was read while OVR was set
+    Slave mSlave;
+    std::vector<uint16_t> mMosi;
+    uint16_t wordMask() const { return (mCr1 & kDff) ? 0xffff : 0xff; }
+    void startFrame(uint16_t word)
+    {
+        mShiftReg = word;
+        mSr |= kBsy;
+        mFrameDoneAt = Sim::instance().now() + frameCycles();
+    }
+    void frameDone(Cycles now)
+    {
+        uint16_t out = mShiftReg & wordMask();
+        mMosi.push_back(out);
+        uint16_t in = (mSlave ? mSlave(out) : 0xffff) & wordMask();
+        if (mSr & kRxne)
+        {
+            mSr |= kOvr; // the received word is lost
+        }
+        else
+        {
+            mRxDr = in;
+            mSr |= kRxne;
+        }
+        if (mTxBufFull)
+        {
+            mTxBufFull = false;
+            mSr |= kTxe;
+            mShiftReg = mTxBuf;
+            mFrameDoneAt = now + frameCycles();
+        }
+        else
+        {
+            mSr &= ~kBsy;
+            mFrameDoneAt = kNever;
+        }
+    }
+public:
+    SpiModel(uint32_t base, bool apb2, uint8_t irq, uint32_t dma, uint8_t txChan, uint8_t rxChan)
+    : Model(base), mApb2(apb2), mIrq(irq), mDma(dma), mTxChan(txChan), mRxChan(rxChan)
+    {}
+    virtual void reset()
+    {
+        mCr1 = mCr2 = 0;
+        mSr = kTxe;
+        mCrcpr = 7;
+        mRxDr = mTxBuf = mShiftReg = 0;
+        mTxBufFull = mOvrDrRead = false;
+        mFrameDoneAt = kNever;
+        mMosi.clear();
+    }
+    /** Duration of a frame, in CPU cycles */
+    Cycles frameCycles() const
+    {
+        uint32_t prescaler = 2 << ((mCr1 >> 3) & 7);
+        return (Cycles)((mCr1 & kDff) ? 16 : 8) * prescaler
+            * Sim::instance().clocks().apbRatio(mApb2);
+    }
+    virtual uint32_t read(uint32_t offset)
+    {
+        switch (offset)
+        {
+        case kCr1: return mCr1;
+        case kCr2: return mCr2;
+        case kSr:
+        {
+            uint32_t sr = mSr;
+            if (mOvrDrRead)
+            {
+                mSr &= ~kOvr;
+                mOvrDrRead = false;
+            }
+            return sr;
+        }
+        case kDr:
+            mSr &= ~kRxne;
+            mOvrDrRead = (mSr & kOvr) != 0;
+            return mRxDr;
+        case kCrcpr: return mCrcpr;
+        default: return 0;
+        }
+    }
+    virtual void write(uint32_t offset, uint32_t val)
+    {
+        switch (offset)
+        {
+        case kCr1: mCr1 = val & 0xffff; break;
+        case kCr2: mCr2 = val & 0xff; break;
+        case kSr: break; // the flags are cleared by the hardware
+        case kDr:
+            if ((mCr1 & (kSpe | kMstr)) != (kSpe | kMstr))
+            {
+                break;
+            }
+            if (!(mSr & kBsy))
+            {
+                startFrame(val);
+            }
+            else
+            {
+                mTxBuf = val;
+                mTxBufFull = true;
+                mSr &= ~kTxe;
+            }
+            break;
+        case kCrcpr: mCrcpr = val & 0xffff; break;
+        }
+    }
+    virtual Cycles nextEvent() const { return mFrameDoneAt; }
+    virtual void onEvent(Cycles now)
+    {
+        if (mFrameDoneAt <= now)
+        {
+            frameDone(now);
+        }
+    }
+    virtual bool dmaRequest(uint32_t dma, uint8_t chan) const
+    {
+        if (dma != mDma || !(mCr1 & kSpe))
+        {
+            return false;
+        }
+        return (chan == mTxChan && (mCr2 & kTxdmaen) && (mSr & kTxe))
+            || (chan == mRxChan && (mCr2 & kRxdmaen) && (mSr & kRxne));
+    }
+    virtual void irqLines(IrqLines& lines) const
+    {
+        if (((mCr2 & kTxeie) && (mSr & kTxe)) || ((mCr2 & kRxneie) && (mSr & kRxne))
+            || ((mCr2 & kErrie) && (mSr & kOvr)))
+        {
+            lines[mIrq] = true;
+        }
+    }
+    /** Sets the slave, which returns the MISO word for each MOSI word */
+    void setSlave(Slave slave) { mSlave = slave; }
+    /** The words sent on MOSI so far */
+    const std::vector<uint16_t>& mosi() const { return mMosi; }
+    void clearMosi() { mMosi.clear(); }
+};
+}
+
+#endif
@@ -0,0 +1,268 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SIM_USART_MODEL_HPP
+#define STM32PP_SIM_USART_MODEL_HPP
+
+#include "core.hpp"
+#include <deque>
+#include <string>
+
+namespace sim
+{
+/** @brief Model of an STM32F1 USART, in asynchronous mode.
+ * A frame takes (start + data + stop bits) * BRR APB cycles. The transmitter
+ * has a data register and a shift register, so two frames can be queued.
+ * Transmitted frames are collected in \c txData(), and passed to the callback
+ * set by \c setTxCallback(). Frames to receive are queued by \c rxInject(), and
+ * arrive back to back. With \c setLoopback(), the transmitter is connected to
+ * the receiver. The IDLE flag is set when the line stays idle for a frame after
+ * a reception. As in the hardware, IDLE, ORE, NE, FE and PE are cleared by a
+ * read of SR followed by a read of DR
+ */
+class UsartModel: public Model
+{
+public:
+    enum: uint32_t
+    {
+        kSr = 0x00, kDr = 0x04, kBrr = 0x08, kCr1 = 0x0c, kCr2 = 0x10, kCr3 = 0x14, kGtpr = 0x18,
+        // SR
+        kPe = 1 << 0, kFe = 1 << 1, kNe = 1 << 2, kOre = 1 << 3, kIdle = 1 << 4,
+        kRxne = 1 << 5, kTc = 1 << 6, kTxe = 1 << 7, kLbd = 1 << 8, kCts = 1 << 9,
+        kSrErrors = kPe | kFe | kNe | kOre | kIdle,
+        // CR1
+        kRe = 1 << 2, kTe = 1 << 3, kIdleie = 1 << 4, kRxneie = 1 << 5, kTcie = 1 << 6,
+        kTxeie = 1 << 7, kPeie = 1 << 8, kM = 1 << 12, kUe = 1 << 13,
+        // CR3
+        kDmar = 1 << 6, kDmat = 1 << 7
+    };
+    typedef std::function<void(uint16_t)> TxCallback;
+protected:
+    const bool mApb2;
+    const uint8_t mIrq;
+    const uint32_t mDma;
+    const uint8_t mTxChan;
+    const uint8_t mRxChan;
+    uint32_t mSr, mDr, mBrr, mCr1, mCr2, mCr3, mGtpr;
+    uint32_t mSrSeen; // error flags seen by the last SR read
+    // transmitter
+    uint16_t mTdr;
+    bool mTdrFull;
+    uint16_t mShiftReg;
+    bool mShifting;
+    Cycles mTxDoneAt;
+    // receiver
+    std::deque<uint16_t> mRxQueue;
+    Cycles mRxDoneAt;
+    Cycles mIdleAt;
+    std::string mTxData;
+    TxCallback mTxCallback;
+    bool mLoopback = false;
+    bool enabled(uint32_t dir) const { return (mCr1 & kUe) && (mCr1 & dir); }
+    void receive(uint16_t frame, Cycles now)
+    {
+        if (!enabled(kRe))
+        {
+            return;
+        }
+        if (mSr & kRxne)
+        {
+            mSr |= kOre; // the new frame is lost
+        }
+        else
+        {
+            mDr = frame & ((mCr1 & kM) ? 0x1ff : 0xff);
+            mSr |= kRxne;
+        }
+        mIdleAt = now + frameCycles();
+    }
+    void txDone(Cycles now)
+    {
+        uint16_t frame = mShiftReg & ((mCr1 & kM) ? 0x1ff : 0xff);
+        mTxData += (char)frame;
+        if (mTxCallback)
+        {
+            mTxCallback(frame);
+        }
+        if (mLoopback)
+        {
+            receive(frame, now);
+        }
+        if (mTdrFull)
+        {
+            mShiftReg = mTdr;
+            mTdrFull = false;
+            mSr |= kTxe;
+            mTxDoneAt = now + frameCycles();
+        }
+        else
+        {
+            mShifting = false;
+            mSr |= kTc;
+            mTxDoneAt = kNever;
+        }
+    }
+    void rxDone(Cycles now)
+    {
+        uint16_t frame = mRxQueue.front();
+        mRxQueue.pop_front();
+        receive(frame, now);
+        mRxDoneAt = mRxQueue.empty() ? kNever : now + frameCycles();
+    }
+public:
+    UsartModel(uint32_t base, bool apb2, uint8_t irq, uint32_t dma, uint8_t txChan, uint8_t rxChan)
+    : Model(base), mApb2(apb2), mIrq(irq), mDma(dma), mTxChan(txChan), mRxChan(rxChan)
+    {}
+    virtual void reset()
+    {
+        mSr = kTxe | kTc;
+        mDr = mBrr = mCr1 = mCr2 = mCr3 = mGtpr = 0;
+        mSrSeen = 0;
+        mTdrFull = mShifting = false;
+        mTxDoneAt = mRxDoneAt = mIdleAt = kNever;
+        mRxQueue.clear();
+        mTxData.clear();
+    }
+    /** Duration of a frame, in CPU cycles */
+    Cycles frameCycles() const
+    {
+        if (!mBrr)
+        {
+            fatal("USART baud rate not set", mBase);
+        }
+        uint8_t stopBits = ((mCr2 >> 12) & 3) >= 2 ? 2 : 1; // 1.5 is rounded up, 0.5 down
+        uint8_t bits = 1 + ((mCr1 & kM) ? 9 : 8) + stopBits;
+        return (Cycles)bits * mBrr * Sim::instance().clocks().apbRatio(mApb2);
+    }
+    virtual uint32_t read(uint32_t offset)
+    {
+        switch (offset)
+        {
+        case kSr:
+            mSrSeen = mSr & kSrErrors;
+            return mSr;
+        case kDr:
+        {
+            mSr &= ~(kRxne | mSrSeen);
+            mSrSeen = 0;
+            return mDr;
+        }
+        case kBrr: return mBrr;
+        case kCr1: return mCr1;
+        case kCr2: return mCr2;
+        case kCr3: return mCr3;
+        case kGtpr: return mGtpr;
+        default: return 0;
+        }
+    }
+    virtual void write(uint32_t offset, uint32_t val)
+    {
+        switch (offset)
+        {
+        case kSr: // RXNE, TC, LBD and CTS are cleared by writing 0
+            mSr &= val | ~(kRxne | kTc | kLbd | kCts);
+            break;
+        case kDr:
+            if (!enabled(kTe))
+            {
+                break;
+            }
+            mSr &= ~kTc;
+            if (!mShifting)
+            {
+                mShiftReg = val;
+                mShifting = true;
+                mTxDoneAt = Sim::instance().now() + frameCycles();
+            }
+            else
+            {
+                mTdr = val;
+                mTdrFull = true;
+                mSr &= ~kTxe;
+            }
+            break;
+        case kBrr: mBrr = val & 0xffff; break;
+        case kCr1: mCr1 = val; break;
+        case kCr2: mCr2 = val; break;
+        case kCr3: mCr3 = val; break;
+        case kGtpr: mGtpr = val; break;
+        }
+    }
+    virtual Cycles nextEvent() const
+    {
+        return std::min(mTxDoneAt, std::min(mRxDoneAt, mIdleAt));
+    }
+    virtual void onEvent(Cycles now)
+    {
+        if (mTxDoneAt <= now)
+        {
+            txDone(now);
+        }
+        if (mRxDoneAt <= now)
+        {
+            rxDone(now);
+        }
+        if (mIdleAt <= now)
+        {
+            mIdleAt = kNever;
+            if (enabled(kRe))
+            {
+                mSr |= kIdle;
+            }
+        }
+    }
+    virtual bool dmaRequest(uint32_t dma, uint8_t chan) const
+    {
+        if (dma != mDma)
+        {
+            return false;
+        }
+        return (chan == mTxChan && (mCr3 & kDmat) && (mSr & kTxe))
+            || (chan == mRxChan && (mCr3 & kDmar) && (mSr & kRxne));
+    }
+    virtual void irqLines(IrqLines& lines) const
+    {
+        if (!(mCr1 & kUe))
+        {
+            return;
+        }
+        if (((mCr1 & kTxeie) && (mSr & kTxe)) || ((mCr1 & kTcie) && (mSr & kTc))
+            || ((mCr1 & kRxneie) && (mSr & (kRxne | kOre)))
+            || ((mCr1 & kIdleie) && (mSr & kIdle)) || ((mCr1 & kPeie) && (mSr & kPe)))
+        {
+            lines[mIrq] = true;
+        }
+    }
+    /** Queues frames to be received, after the ones already queued */
+    void rxInject(const void* data, size_t len)
+    {
+        if (mRxQueue.empty() && mRxDoneAt == kNever)
+        {
+            mRxDoneAt = Sim::instance().now() + frameCycles();
+        }
+        for (const uint8_t* ptr = (const uint8_t*)data; len--; ptr++)
+        {
+            mRxQueue.push_back(*ptr);
+        }
+    }
+    void rxInject(const char* str) { rxInject(str, strlen(str)); }
+    /** Number of frames that are yet to be received */
+    size_t rxPending() const { return mRxQueue.size(); }
+    /** Whether the transmitter is idle, i.e. TC is set */
+    bool txIdle() const { return !mShifting; }
+    /** The frames transmitted so far */
+    const std::string& txData() const { return mTxData; }
+    std::string takeTxData()
+    {
+        std::string result;
+        result.swap(mTxData);
+        return result;
+    }
+    void setTxCallback(TxCallback cb) { mTxCallback = cb; }
+    void setLoopback(bool loopback) { mLoopback = loopback; }
+};
+}
+
+#endif
@@ -14,6 +14,8 @@
 #include <libopencm3/stm32/spi.h>
 #include<stm32++/common.hpp>
 #include<stm32++/tprintf.hpp>
+#include<stm32++/gpio.hpp>
+#include<stm32++/dma.hpp>
 namespace nsspi
 {
 struct Baudrate
@@ -50,15 +52,152 @@ enum: uint32_t
     kMsbFirst = 0
 };
 
+/** @brief SPI in master mode.
+ * Besides the single-word accesses, it runs full-duplex DMA transactions -
+ * \c transfer(), \c write() and \c read() - that use the Tx and Rx DMA
+ * channels of the peripheral together. The Rx channel is started before the Tx
+ * one, so that no received word is missed, and has the higher priority. The
+ * transaction completes when the last word is received, in the Rx channel
+ * interrupt, which must call \c dmaXferIsr(), and then the completion callback
+ * is called from the interrupt. A transfer error of the Tx channel stops the
+ * transaction as well, so the Tx channel interrupt must also call
+ * \c dmaXferIsr() - if the channel is shared, when no \c dma::Tx mixin owns it.
+ * Frames can be 8 or 16 bit, as set by \c init(),
+ * and lengths are in bytes. The DMA channels are acquired from the
+ * \c dma::ChannelArbiter for the duration of the transaction, so they can be
+ * shared with other peripherals, and with \c dma::Tx and \c dma::Rx mixins
+ * of this SPI, if these use \c dma::kDmaShared
+ */
 template <uint32_t SPI, bool Remap=false>
 class SpiMaster: public PeriphInfo<SPI, Remap>
 {
+public:
+    typedef void(*XferCallback)(bool ok, void* userp);
+protected:
+    typedef PeriphInfo<SPI, Remap> Info;
+    /** Owner id of the DMA channels in the \c ChannelArbiter, during a transaction */
+    enum: uint32_t { kXferOwnerId = SPI | 2 };
+    volatile bool mXferBusy = false;
+    XferCallback mXferCb = nullptr;
+    void* mXferUserp = nullptr;
+    uint16_t mFillWord = 0xffff; // sent by read()
+    uint16_t mDiscard; // receives the words of write()
+    static void xferConfigChannel(uint32_t dma, uint8_t chan, uint32_t mem, bool memInc,
+        uint8_t wordSize, uint32_t count, bool fromMem, uint8_t prio)
+    {
+        dma_channel_reset(dma, chan);
+        dma_set_peripheral_address(dma, chan, busAddr(&SPI_DR(SPI)));
+        dma_set_memory_address(dma, chan, mem);
+        dma_set_peripheral_size(dma, chan, dma::periphSizeCode(wordSize));
+        dma_set_memory_size(dma, chan, dma::memSizeCode(wordSize));
+        if (memInc)
+        {
+            dma_enable_memory_increment_mode(dma, chan);
+        }
+        if (fromMem)
+        {
+            dma_set_read_from_memory(dma, chan);
+        }
+        else
+        {
+            dma_set_read_from_peripheral(dma, chan);
+        }
+        dma_set_priority(dma, chan, prio << DMA_CCR_PL_SHIFT);
+        dma_set_number_of_data(dma, chan, count);
+    }
+    static bool xferTryAcquireChannel(uint32_t dma, uint8_t chan)
+    {
+        if (dma::ChannelArbiter::tryAcquire(dma, chan, kXferOwnerId))
+        {
+            return true;
+        }
+        // Waiting for a permanent owner would never end
+        xassert(!dma::ChannelArbiter::isClaimed(dma, chan),
+            "SPI DMA channel is claimed by a peripheral that doesn't share it");
+        return false;
+    }
+    /** Acquires both DMA channels for a transaction, without waiting.
+     * @return \c false if either of them is used by another peripheral, in
+     * which case none is acquired
+     */
+    bool xferTryAcquire()
+    {
+        if (!xferTryAcquireChannel(Info::kDmaTxId, Info::kDmaTxChannel))
+        {
+            return false;
+        }
+        if (!xferTryAcquireChannel(Info::kDmaRxId, Info::kDmaRxChannel))
+        {
+            dma::ChannelArbiter::release(Info::kDmaTxId, Info::kDmaTxChannel, kXferOwnerId);
+            return false;
+        }
+        return true;
+    }
+    /** Waits for the transaction in progress, and for the DMA channels to be
+     * released by the peripherals that share them. Must not be called with
+     * interrupts disabled, as the channels are released from interrupts */
+    void xferAcquire()
+    {
+        waitTransfer();
+        while (!xferTryAcquire())
+        {
+            STM32PP_BUSY_WAIT();
+        }
+    }
+    /** A DMA transfer of zero words would never complete, so an empty
+     * transaction completes right away, after the one in progress, if any.
+     * @return \c true if \c len is zero, and the callback was called */
+    bool xferEmpty(uint16_t len, XferCallback cb, void* userp)
+    {
+        if (len)
+        {
+            return false;
+        }
+        waitTransfer();
+        if (cb)
+        {
+            cb(true, userp);
+        }
+        return true;
+    }
+    /** Starts a transaction. The DMA channels must be acquired */
+    void xferStart(const void* tx, bool txInc, void* rx, bool rxInc, uint16_t len,
+        XferCallback cb, void* userp)
+    {
+        enum: uint32_t { txDma = Info::kDmaTxId, rxDma = Info::kDmaRxId };
+        enum: uint8_t { txChan = Info::kDmaTxChannel, rxChan = Info::kDmaRxChannel };
+        uint8_t wordSize = dmaWordSize();
+        xassert(len % wordSize == 0);
+        mXferBusy = true;
+        mXferCb = cb;
+        mXferUserp = userp;
+        uint32_t count = len / wordSize;
+        xferConfigChannel(rxDma, rxChan, busAddr(rx), rxInc, wordSize, count, false, dma::kPrioVeryHigh);
+        xferConfigChannel(txDma, txChan, busAddr(tx), txInc, wordSize, count, true, dma::kPrioHigh);
+        dma_enable_transfer_complete_interrupt(rxDma, rxChan);
+        dma_enable_transfer_error_interrupt(rxDma, rxChan);
+        // Without the Rx words, the Rx channel would never complete
+        dma_enable_transfer_error_interrupt(txDma, txChan);
+        nvic_enable_irq(PeriphInfo<rxDma>::dmaIrqForChannel(rxChan));
+        nvic_enable_irq(PeriphInfo<txDma>::dmaIrqForChannel(txChan));
+        if (SPI_SR(SPI) & SPI_SR_RXNE)
+        {
+            spi_read(SPI); // a stale word would be the first one received
+        }
+        dma_enable_channel(rxDma, rxChan);
+        dma_enable_channel(txDma, txChan);
+        spi_enable_rx_dma(SPI);
+        spi_enable_tx_dma(SPI); // starts the transfer
+    }
 public:
     template <class S>
     void init(S speed, uint32_t config)
     {
         rcc_periph_clock_enable(this->kClockId);
         rcc_periph_clock_enable(PeriphInfo<this->kPortId>::kClockId);
+        // for the DMA transactions
+        rcc_periph_clock_enable(PeriphInfo<Info::kDmaTxId>::kClockId);
+        rcc_periph_clock_enable(PeriphInfo<Info::kDmaRxId>::kClockId);
 
         uint32_t outputPins = this->kPinSck;
         if ((config & kDisableOutput) == 0) {
@@ -100,8 +239,83 @@ public:
     {
         return spi_read(SPI);
     }
+    /** Sends a word and returns the word received meanwhile */
+    uint16_t xfer(uint16_t data)
+    {
+        return spi_xfer(SPI, data);
+    }
     bool isBusy() const { return (SPI_SR(SPI) & SPI_SR_BSY) != 0; }
     void waitComplete() const { while (SPI_SR(SPI) & SPI_SR_BSY); }
+    /** Sends \c len bytes from \c tx and at the same time receives \c len bytes
+     * into \c rx. If a transaction is in progress, waits for it to complete.
+     * \c cb is called from the DMA interrupt when done. If \c len is zero, it's
+     * called before returning */
+    void transfer(const void* tx, void* rx, uint16_t len, XferCallback cb=nullptr, void* userp=nullptr)
+    {
+        if (xferEmpty(len, cb, userp))
+        {
+            return;
+        }
+        xferAcquire();
+        xferStart(tx, true, rx, true, len, cb, userp);
+    }
+    /** Sends \c len bytes from \c tx, the received data is discarded */
+    void write(const void* tx, uint16_t len, XferCallback cb=nullptr, void* userp=nullptr)
+    {
+        if (xferEmpty(len, cb, userp))
+        {
+            return;
+        }
+        xferAcquire();
+        xferStart(tx, true, &mDiscard, false, len, cb, userp);
+    }
+    /** Receives \c len bytes into \c rx, sending \c fill as each word */
+    void read(void* rx, uint16_t len, uint16_t fill=0xffff, XferCallback cb=nullptr, void* userp=nullptr)
+    {
+        if (xferEmpty(len, cb, userp))
+        {
+            return;
+        }
+        xferAcquire();
+        mFillWord = fill;
+        xferStart(&mFillWord, false, rx, true, len, cb, userp);
+    }
+    /** Whether a \c transfer(), \c write() or \c read() is in progress */
+    bool transferBusy() const { return mXferBusy; }
+    void waitTransfer() const
+    {
+        while (mXferBusy) { STM32PP_BUSY_WAIT(); }
+    }
+    /** Must be called by the interrupt handlers of the Rx and Tx DMA channels */
+    void dmaXferIsr()
+    {
+        enum: uint32_t { txDma = Info::kDmaTxId, rxDma = Info::kDmaRxId };
+        enum: uint8_t { txChan = Info::kDmaTxChannel, rxChan = Info::kDmaRxChannel };
+        if (!mXferBusy) // the channels may be used by another peripheral
+        {
+            return;
+        }
+        uint32_t rxFlags = DMA_ISR(rxDma);
+        bool txError = (DMA_ISR(txDma) & DMA_ISR_TEIF(txChan)) != 0;
+        if ((rxFlags & (DMA_ISR_TCIF(rxChan) | DMA_ISR_TEIF(rxChan))) == 0 && !txError)
+        {
+            return;
+        }
+        bool ok = (rxFlags & DMA_ISR_TEIF(rxChan)) == 0 && !txError;
+        DMA_IFCR(rxDma) = DMA_IFCR_CGIF(rxChan);
+        DMA_IFCR(txDma) = DMA_IFCR_CGIF(txChan);
+        spi_disable_tx_dma(SPI);
+        spi_disable_rx_dma(SPI);
+        dma_disable_channel(txDma, txChan);
+        dma_disable_channel(rxDma, rxChan);
+        dma::ChannelArbiter::release(txDma, txChan, kXferOwnerId);
+        dma::ChannelArbiter::release(rxDma, rxChan, kXferOwnerId);
+        mXferBusy = false;
+        if (mXferCb)
+        {
+            mXferCb(ok, mXferUserp);
+        }
+    }
     uint8_t dmaWordSize() const
     {
         return ((SPI_CR1(SPI) & SPI_CR1_DFF) == SPI_CR1_DFF_16BIT) ? 2 : 1;
@@ -113,7 +327,6 @@ public:
     {
         waitComplete();
         spi_disable_tx_dma(SPI);
-        this->stop();
     }
     void dmaStopPeripheralRx()
     {
@@ -170,10 +383,11 @@ STM32PP_PERIPH_INFO(SPI1)
     enum: uint32_t { kDmaTxId = DMA1, kDmaRxId = DMA1 };
     enum: uint8_t {
         kDmaTxChannel = DMA_CHANNEL3,
-        kDmaRxChannel = DMA_CHANNEL2
+        kDmaRxChannel = DMA_CHANNEL2,
+        kDmaWordSize = 1
     };
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&SPI1_DR); }
-    static const uint32_t dmaTxDataRegister() { return (uint32_t)(&SPI1_DR); }
+    static const uint32_t dmaRxDataRegister() { return busAddr(&SPI1_DR); }
+    static const uint32_t dmaTxDataRegister() { return busAddr(&SPI1_DR); }
 };
 
 STM32PP_PERIPH_INFO(SPI2)
@@ -186,10 +400,11 @@ STM32PP_PERIPH_INFO(SPI2)
     enum: uint32_t { kDmaTxId = DMA1, kDmaRxId = DMA1 };
     enum: uint8_t {
         kDmaTxChannel = DMA_CHANNEL5,
-        kDmaRxChannel = DMA_CHANNEL4
+        kDmaRxChannel = DMA_CHANNEL4,
+        kDmaWordSize = 1
     };
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&SPI2_DR); }
-    static const uint32_t dmaTxDataRegister() { return (uint32_t)(&SPI2_DR); }
+    static const uint32_t dmaRxDataRegister() { return busAddr(&SPI2_DR); }
+    static const uint32_t dmaTxDataRegister() { return busAddr(&SPI2_DR); }
 };
 
 #endif
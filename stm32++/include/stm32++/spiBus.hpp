@@ -0,0 +1,298 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SPI_BUS_HPP
+#define STM32PP_SPI_BUS_HPP
+
+#include "spi.hpp"
+#include "utils.hpp"
+
+namespace nsspi
+{
+/** Converts the \c kIdleClock*, \c k*ClockTransition, \c k*BitFrame and
+ * \c k*First flags of \c SpiMaster::init() to CR1 bits */
+static inline uint16_t configToCr1(uint32_t config)
+{
+    return ((config & kIdleClockIsLow) ? SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE : SPI_CR1_CPOL_CLK_TO_1_WHEN_IDLE)
+         | ((config & kFirstClockTransition) ? SPI_CR1_CPHA_CLK_TRANSITION_1 : SPI_CR1_CPHA_CLK_TRANSITION_2)
+         | ((config & k16BitFrame) ? SPI_CR1_DFF_16BIT : SPI_CR1_DFF_8BIT)
+         | ((config & kLsbFirst) ? SPI_CR1_LSBFIRST : SPI_CR1_MSBFIRST);
+}
+
+/** @brief A device on a shared SPI bus - its chip select pin, and the clock
+ * mode, speed, frame size and bit order it needs. Set up by
+ * \c SpiBus::initDevice()
+ */
+struct SpiDevice
+{
+    uint32_t mCsPort = 0;
+    uint16_t mCsPin = 0;
+    uint16_t mCr1 = 0; // BR, CPOL, CPHA, DFF and LSBFIRST bits
+};
+
+/** @brief A DMA transaction with a device on an \c SpiBus.
+ * Sends \c mLen bytes from \c mTx and receives as many into \c mRx. If
+ * \c mTx is null, \c mFill is sent as each word, and if \c mRx is null, the
+ * received data is discarded, but at least one of them must be set.
+ * Transactions can be chained via \c mNext, e.g. a command followed by the
+ * data read in response - the chain is queued as a whole and runs with the
+ * chip select asserted from the first transaction to the last one, without
+ * transactions of other devices in between. The device of the first
+ * transaction of the chain is used.
+ * The object is owned by the caller, and must stay alive until it completes.
+ * \c mCb is called from the DMA interrupt when the transaction completes.
+ */
+struct SpiTransaction
+{
+    typedef void(*Callback)(bool ok, void* userp);
+    enum: uint8_t { kIdle, kQueued, kRunning, kDone, kFailed };
+    SpiDevice* mDevice;
+    const void* mTx;
+    void* mRx;
+    uint16_t mLen;
+    uint16_t mFill = 0xffff;
+    Callback mCb;
+    void* mUserp;
+    SpiTransaction* mNext = nullptr;
+    volatile uint8_t mState = kIdle;
+    SpiTransaction* mQueueNext = nullptr; // used by SpiBus
+    SpiTransaction(SpiDevice& dev, const void* tx, void* rx, uint16_t len,
+        Callback cb=nullptr, void* userp=nullptr)
+    : mDevice(&dev), mTx(tx), mRx(rx), mLen(len), mCb(cb), mUserp(userp)
+    {}
+    bool isComplete() const { return mState >= kDone; }
+    bool ok() const { return mState == kDone; }
+};
+
+/** @brief An SPI master shared by several devices, each with its own chip
+ * select pin and settings. Transactions of several clients are queued and run
+ * one after the other by DMA - each one is started from the completion
+ * interrupt of the previous one. The chip select of the device is asserted
+ * for the duration of the transaction, and CR1 is reprogrammed only when the
+ * next device needs different settings than the current one, while the SPI is
+ * idle. The chip select pins are driven by software, so any GPIO can be used.
+ * As with \c SpiMaster, the Rx and Tx DMA channel interrupts must call
+ * \c dmaXferIsr().
+ * If the DMA channels are shared with other peripherals, a transaction that
+ * finds them in use is started when they are released, see
+ * \c dma::ChannelArbiter::notifyOnRelease() - the bus never waits for them.
+ * The single-word and direct DMA methods of \c SpiMaster must not be used
+ * while transactions are queued.
+ * \code
+ * nsspi::SpiBus<SPI1> bus;
+ * nsspi::SpiDevice flash, display;
+ * extern "C" void dma1_channel2_isr() { bus.dmaXferIsr(); }
+ * extern "C" void dma1_channel3_isr() { bus.dmaXferIsr(); }
+ * ...
+ * bus.init();
+ * bus.initDevice<nsgpio::Pin<GPIOB, GPIO0>>(flash, nsspi::Baudrate(18000000), nsspi::kIdleClockIsLow | nsspi::kFirstClockTransition);
+ * bus.initDevice<nsgpio::Pin<GPIOB, GPIO1>>(display, (uint8_t)4, nsspi::k16BitFrame);
+ * nsspi::SpiTransaction cmd(flash, readCmd, nullptr, sizeof(readCmd));
+ * nsspi::SpiTransaction data(flash, nullptr, buf, sizeof(buf), onRead, nullptr);
+ * cmd.mNext = &data;
+ * bus.enqueue(cmd);
+ * \endcode
+ */
+template <uint32_t SPI, bool Remap=false>
+class SpiBus: public SpiMaster<SPI, Remap>
+{
+protected:
+    typedef SpiMaster<SPI, Remap> Base;
+    enum: uint16_t
+    {
+        kCr1ConfigMask = SPI_CR1_BR_MASK | SPI_CR1_CPOL | SPI_CR1_CPHA | SPI_CR1_DFF | SPI_CR1_LSBFIRST
+    };
+    SpiTransaction* mQueueHead = nullptr; // the current chain, followed by the queued ones
+    SpiTransaction* mQueueTail = nullptr;
+    SpiTransaction* mCurrent = nullptr; // the running or next transaction of the chain at mQueueHead
+    uint16_t mCr1Config = 0;
+    uint32_t mConfigSwitches = 0;
+    static void onXferDone(bool ok, void* userp)
+    {
+        static_cast<SpiBus*>(userp)->xferDone(ok);
+    }
+    static void onChannelReleased(void* userp)
+    {
+        static_cast<SpiBus*>(userp)->tryStart();
+    }
+    void applyConfig(const SpiDevice& dev)
+    {
+        if (dev.mCr1 == mCr1Config)
+        {
+            return;
+        }
+        // BR and DFF must not be changed while the SPI is enabled. The bus is
+        // idle, as the previous chain has completed
+        uint32_t cr1 = (SPI_CR1(SPI) & ~(kCr1ConfigMask | SPI_CR1_SPE)) | dev.mCr1;
+        SPI_CR1(SPI) = cr1;
+        SPI_CR1(SPI) = cr1 | SPI_CR1_SPE;
+        mCr1Config = dev.mCr1;
+        mConfigSwitches++;
+    }
+    /** Starts \c xfer, with the DMA channels acquired */
+    void startXfer(SpiTransaction& xfer)
+    {
+        xfer.mState = SpiTransaction::kRunning;
+        if (!xfer.mRx)
+        {
+            this->xferStart(xfer.mTx, true, &this->mDiscard, false, xfer.mLen, onXferDone, this);
+        }
+        else if (!xfer.mTx)
+        {
+            this->mFillWord = xfer.mFill;
+            this->xferStart(&this->mFillWord, false, xfer.mRx, true, xfer.mLen, onXferDone, this);
+        }
+        else
+        {
+            this->xferStart(xfer.mTx, true, xfer.mRx, true, xfer.mLen, onXferDone, this);
+        }
+    }
+    /** Starts \c mCurrent, if it's waiting to run. The DMA channels may be in
+     * use by peripherals that share them - then it's retried when they are
+     * released, instead of waiting, as this is called with interrupts disabled
+     * or from the DMA interrupt */
+    void tryStart()
+    {
+        enum: uint32_t { txDma = Base::Info::kDmaTxId, rxDma = Base::Info::kDmaRxId };
+        enum: uint8_t { txChan = Base::Info::kDmaTxChannel, rxChan = Base::Info::kDmaRxChannel };
+        IntrDisable noIntr;
+        SpiTransaction* xfer = mCurrent;
+        if (!xfer || xfer->mState != SpiTransaction::kQueued)
+        {
+            return; // already started, e.g. by a stale release notification
+        }
+        while (!this->xferTryAcquire())
+        {
+            // a notification is not registered if the channel got free meanwhile
+            bool txWait = dma::ChannelArbiter::notifyOnRelease(txDma, txChan, onChannelReleased, this);
+            bool rxWait = dma::ChannelArbiter::notifyOnRelease(rxDma, rxChan, onChannelReleased, this);
+            if (txWait || rxWait)
+            {
+                return;
+            }
+        }
+        if (xfer == mQueueHead)
+        {
+            // the first transaction of the chain
+            SpiDevice& dev = *xfer->mDevice;
+            applyConfig(dev);
+            gpio_clear(dev.mCsPort, dev.mCsPin);
+        }
+        startXfer(*xfer);
+    }
+    static void complete(SpiTransaction& xfer, bool ok)
+    {
+        xfer.mState = ok ? SpiTransaction::kDone : SpiTransaction::kFailed;
+        if (xfer.mCb)
+        {
+            xfer.mCb(ok, xfer.mUserp);
+        }
+    }
+    void xferDone(bool ok)
+    {
+        SpiTransaction* xfer = mCurrent;
+        if (ok && xfer->mNext)
+        {
+            // the next one of the chain is started first, to keep the bus busy
+            mCurrent = xfer->mNext;
+            tryStart();
+            complete(*xfer, true);
+            return;
+        }
+        SpiTransaction* chain = mQueueHead;
+        Base::waitComplete(); // the last word has left the shift register
+        gpio_set(chain->mDevice->mCsPort, chain->mDevice->mCsPin);
+        mQueueHead = chain->mQueueNext;
+        if (!mQueueHead)
+        {
+            mQueueTail = nullptr;
+        }
+        mCurrent = mQueueHead;
+        tryStart();
+        complete(*xfer, ok);
+        // after an error, the rest of the chain is not run
+        for (xfer = xfer->mNext; xfer; xfer = xfer->mNext)
+        {
+            complete(*xfer, false);
+        }
+    }
+public:
+    /** Configures the pins and enables the SPI. The settings are programmed
+     * per device, so only \c kDisableOutput and \c kDisableInput of \c config
+     * are used */
+    void init(uint32_t config=0)
+    {
+        Base::init((uint8_t)255, config & (kDisableOutput | kDisableInput));
+        mCr1Config = SPI_CR1(SPI) & kCr1ConfigMask;
+        mQueueHead = mQueueTail = mCurrent = nullptr;
+        mConfigSwitches = 0;
+    }
+    /** Sets up a device, with its chip select on \c CsPin, which is
+     * configured as an output and deasserted (high). \c speed and \c config
+     * are as for \c SpiMaster::init() */
+    template <class CsPin, class S>
+    void initDevice(SpiDevice& dev, S speed, uint32_t config)
+    {
+        CsPin::set();
+        CsPin::setMode(GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL);
+        dev.mCsPort = CsPin::kPort;
+        dev.mCsPin = CsPin::kPin;
+        dev.mCr1 = clockPrescaler(speed, this->apbFreq()) | configToCr1(config);
+    }
+    /** Queues a transaction, or a chain of transactions linked by \c mNext.
+     * If the bus is idle, it's started immediately. Can be called from an
+     * interrupt, including from the completion callback of a transaction */
+    void enqueue(SpiTransaction& xfer)
+    {
+        for (SpiTransaction* item = &xfer; item; item = item->mNext)
+        {
+            xassert(item->mLen && item->mState != SpiTransaction::kQueued
+                && item->mState != SpiTransaction::kRunning);
+            xassert(item->mTx || item->mRx, "SPI transaction has neither a Tx nor an Rx buffer");
+            item->mState = SpiTransaction::kQueued;
+        }
+        xfer.mQueueNext = nullptr;
+        IntrDisable noIntr;
+        if (mQueueTail)
+        {
+            mQueueTail->mQueueNext = &xfer;
+            mQueueTail = &xfer;
+            return;
+        }
+        mQueueHead = mQueueTail = mCurrent = &xfer;
+        tryStart();
+    }
+    /** Queues the transaction or chain and waits for it to complete.
+     * @return Whether all transactions of the chain completed without error */
+    bool transact(SpiTransaction& xfer)
+    {
+        enqueue(xfer);
+        SpiTransaction* last = &xfer;
+        while (last->mNext)
+        {
+            last = last->mNext;
+        }
+        while (!last->isComplete()) { STM32PP_BUSY_WAIT(); }
+        for (SpiTransaction* item = &xfer; item; item = item->mNext)
+        {
+            if (!item->ok())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    /** Whether no transaction is running or queued */
+    bool idle() const { return mQueueHead == nullptr; }
+    void waitIdle() const
+    {
+        while (mQueueHead) { STM32PP_BUSY_WAIT(); }
+    }
+    /** Number of times CR1 was reprogrammed for a different device */
+    uint32_t configSwitchCount() const { return mConfigSwitches; }
+};
+}
+
+#endif
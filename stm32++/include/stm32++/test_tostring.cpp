@@ -2,6 +2,9 @@
 #include <tostring.hpp>
 #include <unistd.h>
 #include <string.h>
+#include <alloca.h>
+#include <algorithm>
+#include <math.h>
 
 enum { kConsoleWidth = 80, kStatusWidth = 12 };
 
@@ -46,6 +49,9 @@ void verify(const char* testName, const char* expected, Args... args)
         printf("%sMISMATCH%s\n", COLOR_RED, COLOR_NORMAL);
         printf("%.*sinstead got: \"%s\"\n", (int)strlen(testName) + numSpaces + lenExpected - (int)strlen(buf)- 12, spaces, buf);
         gFails++;
+    } else if (toStringLen<flags>(args...) != (size_t)lenExpected) {
+        printf("%sLENGTH-MISMATCH%s (toStringLen returned %zu)\n", COLOR_RED, COLOR_NORMAL, toStringLen<flags>(args...));
+        gFails++;
     } else {
         printf("%sOK%s\n", COLOR_GREEN, COLOR_NORMAL);
     }
@@ -62,6 +68,16 @@ int main()
     verify("decimal-", "-567890", -567890);
     verify("bigDecimal+", "1234567890123456789", 1234567890123456789LL);
     verify("bigDecimal-", "-1234567890123456789", -1234567890123456789LL);
+    verify("decimal zero", "0", 0);
+    verify("decimal 9", "9", 9u);
+    verify("decimal 10", "10", 10u);
+    verify("decimal max32", "4294967295", 0xffffffffu);
+    verify("decimal max32+1", "4294967296", 0x100000000ULL);
+    verify("decimal inner zeroes", "100000000000000001", 100000000000000001ULL);
+    verify("decimal max64", "18446744073709551615", 0xffffffffffffffffULL);
+    verify("decimal min64", "-9223372036854775808", (long long)0x8000000000000000ULL);
+    verify("decimal minDigits", "000042", fmtInt(42, 6));
+    verify("decimal minLen", "    42", fmtInt(42, 0, 6));
 
     verify("hex(+)", "12abcde", fmtHex(0x12abcde));
     verify("hex(+) w/prefix", "0x12abcde", fmtHex<kNumPrefix>(0x12abcde));
@@ -71,6 +87,10 @@ int main()
 
     verify("bigHex(+)", "0xdeadbeefcafebabe", fmtHex<kNumPrefix>(0xdeadbeefcafebabeLL));
     verify("bigHex(-)", "-0x7eadbeefcafebabe", fmtHex<kNumPrefix>(-0x7eadbeefcafebabeLL));
+    verify("hex64 upper", "FFFFFFFFFFFFFFFF", fmtHex<kUpperCase>(0xffffffffffffffffULL));
+    verify("hex zero", "0", fmtHex(0u));
+    verify("octal", "OCT4553207", fmtInt<kNumPrefix|8>(1234567));
+    verify("octal64", "1777777777777777777777", fmtInt<8>(0xffffffffffffffffULL));
 
     verify("bin(-1)", "-1", fmtBin(-1));
     verify("bin(-1) w/prefix", "-0b1", fmtBin<kNumPrefix>(-1));
@@ -79,6 +99,7 @@ int main()
     verify("bin32(-1)", "11111111111111111111111111111111", fmtBin32(-1));
     verify("bin32(-1) w/prefix", "0b11111111111111111111111111111111", fmtBin<kNumPrefix>((uint32_t)-1));
     verify("bin32(+)", "10101110111101111010000001011001", fmtBin(0b10101110111101111010000001011001));
+    verify("pointer", sizeof(void*) == 8 ? "00000000deadbeef" : "deadbeef", (void*)0xdeadbeef);
     verify("bin32(+) w/prefix", "0b10101110111101111010000001011001", fmtBin<kNumPrefix>(0b10101110111101111010000001011001));
 
     verify("float single dec", "44.9", fmtFp<1>(44.9f));
@@ -99,5 +120,46 @@ int main()
     verify("float round-down", "44.9", fmtFp<1>(44.94f));
     verify("float round-up", "-45.0", fmtFp<1>(-44.95f));
     verify("float round-down", "-44.9", fmtFp<1>(-44.94f));
+    verify("float above 4e9", "12345678901.50", fmtFp<2>(12345678901.5));
+    verify("float 2^64-1", "18446744073709549568.0", fmtFp<1>(18446744073709549568.0));
+    verify("float too big for fixed", "1.0e+20", fmtFp<1>(1e20));
+    verify("float tiny", "0.000001", fmtFp<6>(0.0000006));
+    verify("float subnormal", "0.000", fmtFp<3>(5e-324));
+    verify("float NaN", "nan", fmtFp<2>(NAN));
+    verify("float -NaN", "nan", fmtFp<2>(-NAN));
+    verify("float inf", "inf", fmtFp<2>(INFINITY));
+    verify("float -inf", "-inf", fmtFp<2>(-INFINITY));
+    verify("float -inf upper", "-INF", fmtFp<2|kUpperCase>(-INFINITY));
+    verify("float minLen", "  3.14", fmtFp<2>(3.14159, 0, 6));
+    verify("sci", "1.234560e+05", fmtSci(123456.0));
+    verify("sci negative", "-1.23e-07", fmtSci<2>(-1.234e-7f));
+    verify("sci round-up", "1.00e+01", fmtSci<2>(9.999));
+    verify("sci zero", "0.000e+00", fmtSci<3>(0.0));
+    verify("sci big exponent", "1.797693e+308", fmtSci(1.7976931348623157e308));
+    verify("sci subnormal", "4.941e-324", fmtSci<3>(5e-324));
+    verify("sci upper", "1.5E+10", fmtSci<1|kUpperCase>(1.5e10));
+    verify("sci minLen", "   1.5e+10", fmtSci<1>(1.5e10, 10));
+    verify("auto fixed", "1234.500", fmtFpAuto<3>(1234.5));
+    verify("auto small", "1.000e-05", fmtFpAuto<3>(0.00001));
+    verify("auto large", "-2.500e+12", fmtFpAuto<3>(-2.5e12));
+    verify("auto zero", "0.000", fmtFpAuto<3>(0.0));
+
+    verify("q8", "1.5000", fmtQ<8>(0x180));
+    verify("q8 negative", "-1.50", fmtQ<8>(-0x180, 2));
+    verify("q8 round-up", "0.004", fmtQ<8>(1, 3)); // 0.00390625
+    verify("q8 round-up carry", "1.0", fmtQ<8>(255, 1)); // 0.99609375
+    verify("q15 max", "0.99997", fmtQ<15>((int16_t)0x7fff, 5));
+    verify("q15 min", "-1.00000", fmtQ<15>((int16_t)-0x8000, 5));
+    verify("q31 half", "0.500000000", fmtQ<31>((int32_t)0x40000000, 9));
+    verify("q31 min", "-1.000", fmtQ<31>((int32_t)0x80000000, 3));
+    verify("q16.16 no fraction", "-3", fmtQ<16>(-3 * 65536 - 100, 0));
+    verify("q40", "2.2500", fmtQ<40>(9LL << 38));
+    verify("scaled centi", "23.45", fmtScaled<100>(2345));
+    verify("scaled centi negative", "-0.05", fmtScaled<100>(-5));
+    verify("scaled round", "1.3", fmtScaled<100>(125, 1));
+    verify("scaled non-power of 10", "0.333", fmtScaled<3>(1, 3));
+    verify("scaled no prec", "101325", fmtScaled<1>(101325));
+    verify("scaled int64", "-9223372036854775.808", fmtScaled<1000>((int64_t)0x8000000000000000LL));
+    verify("scaled unsigned", "42949672.95", fmtScaled<100>(0xffffffffu));
     return summary();
 }
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h> // for memcpy
 #include <math.h> //for padding calculation we need log10
 
 static_assert(sizeof(size_t) == sizeof(void*), "size_t is not same size as void*");
@@ -25,6 +26,9 @@ enum: uint16_t {
     kFlagsPrecMask = 0xff,
     kLowerCase = 0x0, kUpperCase = 0x1000,
     kDontNullTerminate = 0x0200, kNumPrefix = 0x0400,
+    // Floating point notation. Fixed notation is the default
+    kFpSci = 0x0100, //< Always use scientific notation
+    kFpAuto = 0x0800, //< Scientific notation only for very large and very small values
     kFlagsMaskGlobal = kDontNullTerminate
 };
 
@@ -85,6 +89,178 @@ struct DigitConverter<8, flags>
     static char toDigit(uint8_t digit) { return '0'+digit; }
 };
 
+/** Lookup table with the two-digit decimal representations of 0-99.
+ * Wrapped in a template so that the header-only library can define it
+ * without a separate translation unit
+ */
+template <class T=void>
+struct DigitPairs
+{
+    static const char table[201];
+};
+
+template <class T>
+const char DigitPairs<T>::table[201] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+/** Writes the decimal digits of \c val backwards, so that the last digit
+ * is at <tt>end-1</tt>. Two digits are produced per division.
+ * @return Pointer to the most significant digit
+ */
+static inline char* putDecDigitsReverse(char* end, uint32_t val)
+{
+    while (val >= 100)
+    {
+        const char* pair = DigitPairs<>::table + (val % 100) * 2;
+        val /= 100;
+        *(--end) = pair[1];
+        *(--end) = pair[0];
+    }
+    if (val >= 10)
+    {
+        const char* pair = DigitPairs<>::table + val * 2;
+        *(--end) = pair[1];
+        *(--end) = pair[0];
+    }
+    else
+    {
+        *(--end) = '0' + val;
+    }
+    return end;
+}
+
+/** 64-bit version. Splits off 8-digit chunks with a 64-bit division
+ * (a libgcc call on 32-bit targets), and formats each chunk with 32-bit
+ * arithmetic. Values that fit in 32 bits don't do any 64-bit division.
+ */
+static inline char* putDecDigitsReverse(char* end, uint64_t val)
+{
+    while (val > 0xffffffff)
+    {
+        uint64_t high = val / 100000000;
+        uint32_t chunk = val - high * 100000000;
+        val = high;
+        char* chunkStart = end - 8;
+        end = putDecDigitsReverse(end, chunk);
+        while (end > chunkStart)
+        {
+            *(--end) = '0';
+        }
+    }
+    return putDecDigitsReverse(end, (uint32_t)val);
+}
+
+static inline uint8_t countDecDigits(uint32_t val)
+{
+    uint8_t count = 1;
+    for (uint32_t pow = 10; (val >= pow) && (count < 10); pow *= 10)
+    {
+        count++;
+    }
+    return count;
+}
+
+static inline uint8_t countDecDigits(uint64_t val)
+{
+    if (val <= 0xffffffff)
+    {
+        return countDecDigits((uint32_t)val);
+    }
+    uint8_t count = 10;
+    for (uint64_t pow = 10000000000ULL; (val >= pow) && (count < 20); pow *= 10)
+    {
+        count++;
+    }
+    return count;
+}
+
+/** Number of bits per digit, if \c base is a power of two, or zero otherwise */
+constexpr uint8_t bitsPerDigit(size_t base, uint8_t bits=0)
+{
+    return (base == 1) ? bits
+         : (base & 1) ? 0
+         : bitsPerDigit(base >> 1, bits + 1);
+}
+
+/** Produces the digits of a number in the specified base, backwards, ending
+ * at a given address. Selects the fastest method for the base -
+ * digit pair table for decimal, shift and mask for power of two bases, and
+ * a generic division loop for anything else. \c count() returns the number
+ * of digits that \c put() would produce, without producing them
+ */
+template <size_t base, Flags flags, uint8_t bits=bitsPerDigit(base), class Enabled=void>
+struct DigitWriter
+{
+    template <typename Val>
+    static char* put(char* end, Val val)
+    {
+        do
+        {
+            *(--end) = DigitConverter<base, flags>::toDigit(val % base);
+            val /= base;
+        } while(val);
+        return end;
+    }
+    template <typename Val>
+    static uint8_t count(Val val)
+    {
+        uint8_t count = 0;
+        do
+        {
+            count++;
+            val /= base;
+        } while(val);
+        return count;
+    }
+};
+
+template <Flags flags>
+struct DigitWriter<10, flags, 0, void>
+{
+    template <typename Val>
+    static typename std::enable_if<(sizeof(Val) <= sizeof(uint32_t)), char*>::type
+    put(char* end, Val val) { return putDecDigitsReverse(end, (uint32_t)val); }
+
+    template <typename Val>
+    static typename std::enable_if<(sizeof(Val) > sizeof(uint32_t)), char*>::type
+    put(char* end, Val val) { return putDecDigitsReverse(end, (uint64_t)val); }
+
+    template <typename Val>
+    static typename std::enable_if<(sizeof(Val) <= sizeof(uint32_t)), uint8_t>::type
+    count(Val val) { return countDecDigits((uint32_t)val); }
+
+    template <typename Val>
+    static typename std::enable_if<(sizeof(Val) > sizeof(uint32_t)), uint8_t>::type
+    count(Val val) { return countDecDigits((uint64_t)val); }
+};
+
+template <size_t base, Flags flags, uint8_t bits>
+struct DigitWriter<base, flags, bits, typename std::enable_if<(bits != 0)>::type>
+{
+    template <typename Val>
+    static char* put(char* end, Val val)
+    {
+        do
+        {
+            *(--end) = DigitConverter<base, flags>::toDigit(val & (base - 1));
+            val >>= bits;
+        } while(val);
+        return end;
+    }
+    template <typename Val>
+    static uint8_t count(Val val)
+    {
+        if (!val)
+            return 1;
+        uint8_t numBits = 64 - __builtin_clzll(val);
+        return (numBits + bits - 1) / bits;
+    }
+};
+
 template<Flags flags=10, typename Val>
 typename std::enable_if<std::is_unsigned<Val>::value
                      && std::is_integral<Val>::value
@@ -104,15 +280,10 @@ toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint16_t minLe
     enum: uint8_t { base = baseFromFlags(flags) };
     DigitConverter<base, flags> digitConv;
     char stagingBuf[digitConv.digitsPerByte * sizeof(Val)];
-    char* writePtr = stagingBuf;
-    do
-    {
-        Val digit = val % base;
-        *(writePtr++) = digitConv.toDigit(digit);
-        val /= base;
-    } while(val);
-
-    size_t numDigits = writePtr - stagingBuf;
+    char* stagingEnd = stagingBuf + sizeof(stagingBuf);
+    // digits are written backwards, ending at the end of the staging buffer
+    char* digits = DigitWriter<base, flags>::put(stagingEnd, val);
+    size_t numDigits = stagingEnd - digits;
     size_t padLen;
     if (minDigits && (numDigits < minDigits))
     {
@@ -154,12 +325,8 @@ toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint16_t minLe
         *(buf++) = '0';
     }
     // numDigits is at least one
-    do
-    {
-        *(buf++) = *(--writePtr);
-        numDigits--;
-
-    } while(numDigits);
+    memcpy(buf, digits, numDigits);
+    buf += numDigits;
 
 
     if ((flags & kDontNullTerminate) == 0) {
@@ -168,6 +335,30 @@ toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint16_t minLe
     return buf;
 }
 
+/** @brief Length-only counterparts of the toString() functions.
+ * \c toStringLen() returns the number of chars that the toString() overload with
+ * the same arguments would write, not counting the null terminator.
+ * Used to determine the exact buffer size before formatting.
+ */
+template<Flags flags=10, typename Val>
+typename std::enable_if<std::is_unsigned<Val>::value
+                     && std::is_integral<Val>::value
+                     && !std::is_same<Val, char>::value, size_t>::type
+toStringLen(Val val, uint8_t minDigits=0, uint16_t minLen=0)
+{
+    enum: uint8_t { base = baseFromFlags(flags) };
+    size_t len = DigitWriter<base, flags>::count(val);
+    if (len < minDigits)
+    {
+        len = minDigits;
+    }
+    if (flags & kNumPrefix)
+    {
+        len += DigitConverter<base, flags>::prefixLen;
+    }
+    return (len < minLen) ? minLen : len;
+}
+
 template<Flags flags=10, typename Val>
 typename std::enable_if<std::is_integral<Val>::value
     && std::is_signed<Val>::value
@@ -193,6 +384,18 @@ toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint8_t minLen
     }
 }
 
+template<Flags flags=10, typename Val>
+typename std::enable_if<std::is_integral<Val>::value
+    && std::is_signed<Val>::value
+    && !std::is_same<Val, char>::value, size_t>::type
+toStringLen(Val val, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    typedef typename std::make_unsigned<Val>::type UVal;
+    return (val < 0)
+        ? 1 + toStringLen<flags, UVal>(-val, minDigits, minLen)
+        : toStringLen<flags, UVal>(val, minDigits, minLen);
+}
+
 template <class T, class Enabled=void>
 struct is_char_ptr
 {
@@ -258,7 +461,7 @@ auto fmtHex32(T aVal, uint8_t minDigits=8)
 { return IntFmt<uint32_t, (flags & ~kFlagsBaseMask)|16>(aVal, minDigits); }
 
 template <Flags flags=0, typename Ptr>
-auto fmtPtr(Ptr ptr) { return fmtHex(ptr, sizeof(void*) * 2); }
+auto fmtPtr(Ptr ptr) { return fmtHex<flags>((size_t)ptr, sizeof(void*) * 2); }
 
 template <Flags flags=0, typename T>
 auto fmtBin(T aVal, uint8_t minDigits=0, uint8_t minLen=0)
@@ -280,7 +483,14 @@ template <Flags flags=0, class P>
 typename std::enable_if<std::is_pointer<P>::value && !is_char_ptr<P>::value, char*>::type
 toString(char *buf, size_t bufsize, P ptr)
 {
-    return toString(buf, bufsize, fmtPtr(ptr));
+    return toString<flags>(buf, bufsize, fmtPtr(ptr));
+}
+
+template <Flags flags=0, class P>
+typename std::enable_if<std::is_pointer<P>::value && !is_char_ptr<P>::value, size_t>::type
+toStringLen(P ptr)
+{
+    return toStringLen<flags>(fmtPtr(ptr));
 }
 
 template<Flags flags=0, Flags _, typename Val>
@@ -289,6 +499,12 @@ char* toString(char *buf, size_t bufsize, IntFmt<Val, _> num)
     return toString<num.flags | globalFlags(flags)>(buf, bufsize, num.value, num.minDigits, num.minLen);
 }
 
+template<Flags flags=0, Flags _, typename Val>
+size_t toStringLen(IntFmt<Val, _> num)
+{
+    return toStringLen<num.flags>(num.value, num.minDigits, num.minLen);
+}
+
 template<Flags flags=0>
 typename std::enable_if<(flags & kDontNullTerminate) == 0, char*>::type
 toString(char* buf, size_t bufsize, const char* val)
@@ -324,6 +540,19 @@ toString(char* buf, size_t bufsize, const char* val)
     return buf;
 }
 
+template<Flags flags=0>
+size_t toStringLen(const char* val)
+{
+    return strlen(val);
+}
+
+template<Flags flags=0, typename Val>
+typename std::enable_if<std::is_same<Val, char>::value, size_t>::type
+toStringLen(Val)
+{
+    return 1;
+}
+
 template<Flags flags=0, typename Val>
 typename std::enable_if<std::is_same<Val, char>::value
     && (flags & kDontNullTerminate), char*>::type
@@ -364,11 +593,324 @@ template <size_t base>
 struct Pow<base, 1>
 { enum: size_t { value = base }; };
 
-template<Flags flags=6, typename Val>
-typename std::enable_if<std::is_floating_point<Val>::value, char*>::type
-toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint8_t minLen=0)
+/** @brief Integer-only floating point formatting engine.
+ * The value is decomposed from its IEEE-754 bits into a mantissa and binary
+ * exponent, and all further processing is done with integer arithmetic, so
+ * no soft-float library calls are made.
+ */
+enum: uint8_t { kFpKindFixed, kFpKindSci, kFpKindInf, kFpKindNan };
+
+/** Decimal representation of a floating point number, as produced by \c fpToDecimal() */
+struct FpDecimal
+{
+    /** Fixed notation: the whole part.
+     * Scientific notation: all significant digits, i.e. prec+1 of them */
+    uint64_t digits;
+    /** Fixed notation: the fractional digits, scaled by 10^prec */
+    uint32_t fraction;
+    /** Scientific notation: the decimal exponent */
+    int16_t exp10;
+    uint8_t kind;
+    bool negative;
+};
+
+/** Floating point number as mantissa * 2^exp */
+struct DiyFp
+{
+    uint64_t f;
+    int16_t e;
+};
+
+/** High 64 bits of the 128-bit product, rounded */
+static inline uint64_t mulHigh64(uint64_t a, uint64_t b)
+{
+    uint64_t aLo = (uint32_t)a, aHi = a >> 32;
+    uint64_t bLo = (uint32_t)b, bHi = b >> 32;
+    uint64_t hilo = aHi * bLo;
+    uint64_t lohi = aLo * bHi;
+    uint64_t mid = ((aLo * bLo) >> 32) + (uint32_t)hilo + (uint32_t)lohi + (1u << 31);
+    return aHi * bHi + (hilo >> 32) + (lohi >> 32) + (mid >> 32);
+}
+
+/** Multiplies two normalized DiyFp values and normalizes the result */
+static inline DiyFp diyFpMul(DiyFp a, DiyFp b)
+{
+    DiyFp result = { mulHigh64(a.f, b.f), (int16_t)(a.e + b.e + 64) };
+    if ((result.f & (1ULL << 63)) == 0)
+    {
+        result.f <<= 1;
+        result.e--;
+    }
+    return result;
+}
+
+/** 10^n as a normalized DiyFp, with about 60 bits of precision */
+static inline DiyFp diyFpPow10(int16_t n)
+{
+    DiyFp base = (n >= 0)
+        ? DiyFp{ 0xA000000000000000ULL, -60 }  // 10
+        : DiyFp{ 0xCCCCCCCCCCCCCCCDULL, -67 }; // 0.1
+    DiyFp result = { 1ULL << 63, -63 };
+    for (uint16_t absN = (n >= 0) ? n : -n; absN; absN >>= 1)
+    {
+        if (absN & 1)
+        {
+            result = diyFpMul(result, base);
+        }
+        base = diyFpMul(base, base);
+    }
+    return result;
+}
+
+/** Number of significant bits */
+static inline uint8_t bitLength(uint64_t val)
+{
+    return val ? 64 - __builtin_clzll(val) : 0;
+}
+
+/** Fixed notation conversion of mant * 2^exp. The conversion is exact,
+ * except that bits below 2^-59 are discarded.
+ * @return false if the whole part doesn't fit in 64 bits
+ */
+static inline bool fpToFixed(uint64_t mant, int16_t exp, uint8_t prec, FpDecimal& dec)
+{
+    dec.kind = kFpKindFixed;
+    dec.fraction = 0;
+    if (exp >= 0)
+    {
+        if (bitLength(mant) + exp > 64)
+        {
+            return false;
+        }
+        dec.digits = mant << exp;
+        return true;
+    }
+    uint16_t shift = -exp;
+    uint64_t rem;
+    if (shift < 64)
+    {
+        dec.digits = mant >> shift;
+        rem = mant & ((1ULL << shift) - 1);
+    }
+    else
+    {
+        dec.digits = 0;
+        rem = mant;
+    }
+    // Leave 4 bits of headroom for multiplication by 10
+    if (shift > 59)
+    {
+        rem = (shift - 59 < 64) ? (rem >> (shift - 59)) : 0;
+        shift = 59;
+    }
+    uint64_t mask = (1ULL << shift) - 1;
+    uint32_t mult = 1;
+    for (uint8_t i = 0; i < prec; i++)
+    {
+        rem *= 10;
+        dec.fraction = dec.fraction * 10 + (uint32_t)(rem >> shift);
+        rem &= mask;
+        mult *= 10;
+    }
+    if (rem >> (shift - 1)) // round half up
+    {
+        if (++dec.fraction >= mult) // the part after the dot overflows to >= 1
+        {
+            dec.digits++;
+            dec.fraction = 0;
+        }
+    }
+    return true;
+}
+
+/** Scientific notation conversion of mant * 2^exp to prec+1 significant digits */
+static inline void fpToSci(uint64_t mant, int16_t exp, uint8_t prec, FpDecimal& dec)
+{
+    dec.kind = kFpKindSci;
+    if (!mant)
+    {
+        dec.digits = 0;
+        dec.exp10 = 0;
+        return;
+    }
+    uint64_t low = 1;
+    for (uint8_t i = 0; i < prec; i++)
+    {
+        low *= 10;
+    }
+    uint64_t high = low * 10; // prec+1 digits must be in [low, high)
+
+    uint8_t norm = 64 - bitLength(mant);
+    DiyFp val = { mant << norm, (int16_t)(exp - norm) };
+    // Estimate of floor(log10(val)), may be one less than the actual value.
+    // 78913 / 2^18 is log10(2)
+    int32_t log2 = val.e + 63;
+    int16_t exp10 = (log2 >= 0) ? ((log2 * 78913) >> 18) : -((-log2 * 78913 + 262143) >> 18);
+    for (;;)
+    {
+        DiyFp scaled = diyFpMul(val, diyFpPow10(prec - exp10));
+        // scaled < 10^(prec+2) < 2^64, so the exponent is always negative
+        uint8_t shift = -scaled.e;
+        uint64_t digits = (shift < 64) ? (scaled.f >> shift) : 0;
+        if (shift && shift <= 64 && ((scaled.f >> (shift - 1)) & 1))
+        {
+            digits++;
+        }
+        if (digits >= high)
+        {
+            exp10++;
+        }
+        else if (digits < low)
+        {
+            exp10--;
+        }
+        else
+        {
+            dec.digits = digits;
+            dec.exp10 = exp10;
+            return;
+        }
+    }
+}
+
+/** Values in this range are printed in fixed notation in \c kFpAuto mode */
+enum: int8_t { kFpAutoMinExp10 = -4, kFpAutoMaxExp10 = 9 };
+
+template <typename Val>
+struct FpTraits;
+
+template <>
+struct FpTraits<float>
+{
+    typedef uint32_t Bits;
+    enum: uint8_t { kMantBits = 23 };
+    enum: int16_t { kExpMax = 0xff, kExpBias = 127 };
+};
+
+template <>
+struct FpTraits<double>
+{
+    typedef uint64_t Bits;
+    enum: uint8_t { kMantBits = 52 };
+    enum: int16_t { kExpMax = 0x7ff, kExpBias = 1023 };
+};
+
+/** Converts a float or double to decimal.
+ * @param mode Only the \c kFpSci and \c kFpAuto flags are used. Normally it's
+ * a compile-time constant, passed via the \c fpToDecimal<flags>() wrapper
+ */
+template <typename Val>
+void fpToDecimal(Val val, uint8_t prec, Flags mode, FpDecimal& dec)
+{
+    typedef FpTraits<Val> Traits;
+    typename Traits::Bits bits;
+    memcpy(&bits, &val, sizeof(bits));
+    dec.negative = (bits >> (sizeof(bits) * 8 - 1)) != 0;
+    int16_t biasedExp = (bits >> Traits::kMantBits) & Traits::kExpMax;
+    uint64_t mant = bits & (((typename Traits::Bits)1 << Traits::kMantBits) - 1);
+    if (biasedExp == Traits::kExpMax)
+    {
+        dec.kind = mant ? kFpKindNan : kFpKindInf;
+        return;
+    }
+    int16_t exp;
+    if (biasedExp)
+    {
+        mant |= (uint64_t)1 << Traits::kMantBits;
+        exp = biasedExp - Traits::kExpBias - Traits::kMantBits;
+    }
+    else // subnormal
+    {
+        exp = 1 - Traits::kExpBias - Traits::kMantBits;
+    }
+    if (mode & kFpSci)
+    {
+        fpToSci(mant, exp, prec, dec);
+        return;
+    }
+    if (mode & kFpAuto)
+    {
+        // decide by the value rounded to the number of significant digits we print
+        fpToSci(mant, exp, prec, dec);
+        if (dec.digits && (dec.exp10 < kFpAutoMinExp10 || dec.exp10 >= kFpAutoMaxExp10))
+        {
+            return;
+        }
+    }
+    if (!fpToFixed(mant, exp, prec, dec))
+    {
+        fpToSci(mant, exp, prec, dec); // too large for fixed notation
+    }
+}
+
+template <Flags flags, typename Val>
+void fpToDecimal(Val val, uint8_t prec, FpDecimal& dec)
+{
+    fpToDecimal<Val>(val, prec, flags & (kFpSci|kFpAuto), dec);
+}
+
+/** long double is formatted with double precision */
+template <Flags flags>
+void fpToDecimal(long double val, uint8_t prec, FpDecimal& dec)
+{
+    fpToDecimal<double>(val, prec, flags & (kFpSci|kFpAuto), dec);
+}
+
+/** Writes the scientific notation, i.e. 1.234560e+05 */
+template <Flags flags>
+char* fpSciToString(char* buf, char* bufend, const FpDecimal& dec, uint8_t prec)
+{
+    if (dec.negative)
+    {
+        *(buf++) = '-';
+    }
+    char digits[24];
+    char* digitsEnd = digits + sizeof(digits);
+    char* digitPtr = putDecDigitsReverse(digitsEnd, dec.digits);
+    while (digitPtr > digitsEnd - prec - 1) // zero mantissa
+    {
+        *(--digitPtr) = '0';
+    }
+    *(buf++) = *(digitPtr++);
+    *(buf++) = '.';
+    memcpy(buf, digitPtr, prec);
+    buf += prec;
+    *(buf++) = (flags & kUpperCase) ? 'E' : 'e';
+    uint16_t absExp;
+    if (dec.exp10 < 0)
+    {
+        *(buf++) = '-';
+        absExp = -dec.exp10;
+    }
+    else
+    {
+        *(buf++) = '+';
+        absExp = dec.exp10;
+    }
+    if (absExp < 10)
+    {
+        *(buf++) = '0';
+    }
+    buf = toString<kDontNullTerminate|10>(buf, bufend - buf, absExp);
+    assert(buf && (buf <= bufend));
+    return buf;
+}
+
+static inline size_t fpSciLen(const FpDecimal& dec, uint8_t prec)
+{
+    uint16_t absExp = (dec.exp10 < 0) ? -dec.exp10 : dec.exp10;
+    return dec.negative + prec + ((absExp >= 100) ? 7 : 6);
+}
+
+/** Writes a fixed notation decimal, i.e. -123.45. If \c prec is zero, only the
+ * whole part is written. Used for both floating and fixed point values
+ * @param minLen The minimum length of the whole string. It is only
+ * applied to the whole part, which is padded with spaces after the sign
+ */
+template <Flags flags>
+char* fixedDecToString(char* buf, size_t bufsize, const FpDecimal& dec,
+    uint8_t prec, uint8_t minDigits=0, uint8_t minLen=0)
 {
-    enum: uint8_t { prec = precFromFlags(flags) };
     if (!bufsize) {
         return nullptr;
     }
@@ -377,7 +919,7 @@ toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint8_t minLen
         bufsize--;
 
     char* bufend = buf+bufsize;
-    if (val < 0)
+    if (dec.negative)
     {
         if (bufsize < 4) //at least '-0.0'
         {
@@ -385,7 +927,6 @@ toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint8_t minLen
             return nullptr;
         }
         *(buf++) = '-';
-        val = -val;
     }
     else
     {
@@ -395,50 +936,157 @@ toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint8_t minLen
             return nullptr;
         }
     }
-    if (std::numeric_limits<Val>::has_infinity && (val == std::numeric_limits<Val>::infinity()))
-    {
-        *(buf++) = 'i';
-        *(buf++) = 'n';
-        *(buf++) = 'f';
-        if (!(flags & kDontNullTerminate))
-        {
-            *buf = 0;
-        }
-        return buf;
-    }
-
-
-    size_t whole = (size_t)(val);
-
-    // value to multiply the fractional part so that it becomes an int
-    enum: uint32_t { mult = Pow<10, prec>::value };
-    size_t fractional = (val - whole) * mult + 0.5;
-    if (fractional >= mult) //the part after the dot overflows to >= 1 due to rounding
-    {
-        //move the overflowed unit to the whole part and subtract it from
-        //the decimal
-        whole++;
-        fractional -= mult;
-    }
-    if (minLen > prec) {
+    if (prec && (minLen > prec)) {
         minLen -= (prec + 1);
     }
     //we have some minimum space for null termination even if buffer is not enough
     auto originalBuf = buf;
-    buf = toString<kDontNullTerminate|10>(buf, bufRealEnd-buf, whole, minDigits, minLen);
+    if (!prec)
+    {
+        return toString<globalFlags(flags)|10>(buf, bufRealEnd-buf, dec.digits, minDigits, minLen);
+    }
+    buf = toString<kDontNullTerminate|10>(buf, bufRealEnd-buf, dec.digits, minDigits, minLen);
     if (!buf)
     {
         assert(*originalBuf == 0); //assert null termination
         return nullptr;
     }
-    assert(buf < bufRealEnd);
+    assert(buf <= bufRealEnd); // without null terminator, the whole part may fill the buffer
     if (bufend-buf < 2) //must have space at least for '.0' and optional null terminator
     {
         *originalBuf = 0;
         return nullptr;
     }
     *(buf++) = '.';
-    return toString<globalFlags(flags)|10>(buf, bufRealEnd-buf, fractional, prec);
+    return toString<globalFlags(flags)|10>(buf, bufRealEnd-buf, dec.fraction, prec);
+}
+
+static inline size_t fixedDecLen(const FpDecimal& dec, uint8_t prec,
+    uint8_t minDigits=0, uint8_t minLen=0)
+{
+    if (!prec)
+    {
+        return dec.negative + toStringLen<10>(dec.digits, minDigits, minLen);
+    }
+    if (minLen > prec) {
+        minLen -= (prec + 1);
+    }
+    return dec.negative + toStringLen<10>(dec.digits, minDigits, minLen) + 1 + prec;
+}
+
+/** Writes a decimal produced by \c fpToDecimal(), in the notation selected by it.
+ * Only the \c kUpperCase and \c kDontNullTerminate flags are used, the precision
+ * is a runtime parameter
+ */
+template <Flags flags>
+char* fpDecToString(char* buf, size_t bufsize, const FpDecimal& dec, uint8_t prec,
+    uint8_t minDigits=0, uint8_t minLen=0)
+{
+    if (dec.kind == kFpKindFixed)
+    {
+        return fixedDecToString<flags>(buf, bufsize, dec, prec, minDigits, minLen);
+    }
+    if (!bufsize) {
+        return nullptr;
+    }
+    if ((flags & kDontNullTerminate) == 0)
+        bufsize--;
+
+    char* bufend = buf+bufsize;
+    if (dec.kind == kFpKindNan)
+    {
+        if (bufsize < 3)
+        {
+            *buf = 0;
+            return nullptr;
+        }
+        *(buf++) = (flags & kUpperCase) ? 'N' : 'n';
+        *(buf++) = (flags & kUpperCase) ? 'A' : 'a';
+        *(buf++) = (flags & kUpperCase) ? 'N' : 'n';
+        if (!(flags & kDontNullTerminate))
+        {
+            *buf = 0;
+        }
+        return buf;
+    }
+    if (dec.kind == kFpKindSci)
+    {
+        size_t len = fpSciLen(dec, prec);
+        size_t padLen = (len < minLen) ? minLen - len : 0;
+        if (len + padLen > bufsize)
+        {
+            *buf = 0;
+            return nullptr;
+        }
+        for (; padLen; padLen--)
+        {
+            *(buf++) = ' ';
+        }
+        buf = fpSciToString<flags>(buf, bufend, dec, prec);
+        if (!(flags & kDontNullTerminate))
+        {
+            *buf = 0;
+        }
+        return buf;
+    }
+    // infinity
+    if (bufsize < 3u + dec.negative)
+    {
+        *buf = 0;
+        return nullptr;
+    }
+    if (dec.negative)
+    {
+        *(buf++) = '-';
+    }
+    *(buf++) = (flags & kUpperCase) ? 'I' : 'i';
+    *(buf++) = (flags & kUpperCase) ? 'N' : 'n';
+    *(buf++) = (flags & kUpperCase) ? 'F' : 'f';
+    if (!(flags & kDontNullTerminate))
+    {
+        *buf = 0;
+    }
+    return buf;
+}
+
+template<Flags flags=6, typename Val>
+typename std::enable_if<std::is_floating_point<Val>::value, char*>::type
+toString(char* buf, size_t bufsize, Val val, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    enum: uint8_t { prec = precFromFlags(flags) };
+    static_assert(prec <= 9, "Floating point precision can't be more than 9 digits");
+    FpDecimal dec;
+    fpToDecimal<flags>(val, prec, dec);
+    return fpDecToString<flags>(buf, bufsize, dec, prec, minDigits, minLen);
+}
+
+static inline size_t fpDecLen(const FpDecimal& dec, uint8_t prec,
+    uint8_t minDigits=0, uint8_t minLen=0)
+{
+    switch (dec.kind)
+    {
+        case kFpKindNan:
+            return 3;
+        case kFpKindInf:
+            return dec.negative + 3;
+        case kFpKindSci:
+        {
+            size_t len = fpSciLen(dec, prec);
+            return (len < minLen) ? minLen : len;
+        }
+        default:
+            return fixedDecLen(dec, prec, minDigits, minLen);
+    }
+}
+
+template<Flags flags=6, typename Val>
+typename std::enable_if<std::is_floating_point<Val>::value, size_t>::type
+toStringLen(Val val, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    enum: uint8_t { prec = precFromFlags(flags) };
+    FpDecimal dec;
+    fpToDecimal<flags>(val, prec, dec);
+    return fpDecLen(dec, prec, minDigits, minLen);
 }
 
 template <class T, Flags aFlags>
@@ -469,6 +1117,30 @@ auto fmtFp(T val, uint8_t minDigits=0, uint8_t minLen=0)
     return FpFmt<T, aFlags>(val, minDigits, minLen);
 }
 
+/**
+ * Specifies that a number must be formatted in scientific notation, i.e. 1.234560e+05
+ * @param aFlags - the formatting flags, where the low 8 bits specify the number
+ * of digits after the decimal point
+ * @param minLen - the minimum length of the string. If the actual output is
+ * shorter, then spaces are prepended
+ */
+template <Flags aFlags=6, class T>
+auto fmtSci(T val, uint8_t minLen=0)
+{
+    return FpFmt<T, aFlags|kFpSci>(val, 0, minLen);
+}
+
+/**
+ * Specifies that a number must be formatted in fixed notation if its decimal
+ * exponent is in the range [kFpAutoMinExp10, kFpAutoMaxExp10), and in scientific
+ * notation otherwise. Parameters are the same as for \c fmtFp()
+ */
+template <Flags aFlags=6, class T>
+auto fmtFpAuto(T val, uint8_t minDigits=0, uint8_t minLen=0)
+{
+    return FpFmt<T, aFlags|kFpAuto>(val, minDigits, minLen);
+}
+
 template <Flags glFlags, Flags _, typename Val>
 char* toString(char *buf, size_t bufsize, FpFmt<Val, _> fp)
 {
@@ -476,6 +1148,245 @@ char* toString(char *buf, size_t bufsize, FpFmt<Val, _> fp)
     return toString<fp.flags|globalFlags(glFlags), Val>(buf, bufsize, fp.value, fp.minDigits, fp.minLen);
 }
 
+template <Flags glFlags=0, Flags _, typename Val>
+size_t toStringLen(FpFmt<Val, _> fp)
+{
+    return toStringLen<fp.flags, Val>(fp.value, fp.minDigits, fp.minLen);
+}
+
+/** Absolute value of an integer, as the corresponding unsigned type,
+ * so that the most negative value is handled correctly */
+template <typename T>
+typename std::make_unsigned<T>::type absUnsigned(T val, bool& negative)
+{
+    typedef typename std::make_unsigned<T>::type UVal;
+    negative = std::is_signed<T>::value && (val < 0);
+    return negative ? (UVal)(0 - (UVal)val) : (UVal)val;
+}
+
+template <typename T, uint8_t aFracBits>
+struct QFmt
+{
+    enum: uint8_t { kFracBits = aFracBits };
+    T value;
+    uint8_t prec;
+    QFmt(T aVal, uint8_t aPrec): value(aVal), prec(aPrec) {}
+};
+
+/**
+ * Specifies that an integer is a fixed point value with \c fracBits fractional
+ * bits, i.e. a Qm.n number, such as q15_t (fmtQ<15>) or q31_t (fmtQ<31>), and
+ * must be printed in decimal notation, i.e. fmtQ<8>(0x180) prints 1.5000.
+ * Only integer operations are used for the conversion.
+ * @param prec The number of digits after the decimal point (up to 9).
+ * The value is rounded half up.
+ */
+template <uint8_t fracBits, class T>
+QFmt<T, fracBits> fmtQ(T val, uint8_t prec=4)
+{
+    static_assert(std::is_integral<T>::value, "Fixed point value must be of an integer type");
+    static_assert(fracBits > 0 && fracBits < sizeof(uint64_t) * 8 - 4, "Invalid number of fractional bits");
+    return QFmt<T, fracBits>(val, prec);
+}
+
+template <uint8_t fracBits, typename T>
+void qToDecimal(T val, uint8_t prec, FpDecimal& dec)
+{
+    typedef typename std::conditional<(fracBits <= 28) && (sizeof(T) <= sizeof(uint32_t)),
+        uint32_t, uint64_t>::type W; // must fit the fractional part multiplied by 10
+    W absVal = absUnsigned(val, dec.negative);
+    dec.kind = kFpKindFixed;
+    dec.digits = absVal >> fracBits;
+    dec.fraction = 0;
+    W rem = absVal & (((W)1 << fracBits) - 1);
+    uint32_t mult = 1;
+    for (uint8_t i = 0; i < prec; i++)
+    {
+        rem *= 10;
+        dec.fraction = dec.fraction * 10 + (uint32_t)(rem >> fracBits);
+        rem &= ((W)1 << fracBits) - 1;
+        mult *= 10;
+    }
+    if (rem >> (fracBits - 1)) // round half up
+    {
+        if (++dec.fraction >= mult)
+        {
+            dec.digits++;
+            dec.fraction = 0;
+        }
+    }
+}
+
+/** Runtime counterpart of \c qToDecimal(), for when \c fracBits is not known at
+ * compile time. Takes the absolute value, the caller sets \c dec.negative
+ */
+static inline void qAbsToDecimal(uint64_t absVal, uint8_t fracBits, uint8_t prec, FpDecimal& dec)
+{
+    dec.kind = kFpKindFixed;
+    dec.digits = absVal >> fracBits;
+    dec.fraction = 0;
+    uint64_t mask = ((uint64_t)1 << fracBits) - 1;
+    uint64_t rem = absVal & mask;
+    uint32_t mult = 1;
+    for (uint8_t i = 0; i < prec; i++)
+    {
+        rem *= 10;
+        dec.fraction = dec.fraction * 10 + (uint32_t)(rem >> fracBits);
+        rem &= mask;
+        mult *= 10;
+    }
+    if (rem >> (fracBits - 1)) // round half up
+    {
+        if (++dec.fraction >= mult)
+        {
+            dec.digits++;
+            dec.fraction = 0;
+        }
+    }
+}
+
+template <Flags flags=0, typename Val, uint8_t fracBits>
+char* toString(char* buf, size_t bufsize, QFmt<Val, fracBits> q)
+{
+    assert(q.prec <= 9);
+    FpDecimal dec;
+    qToDecimal<fracBits>(q.value, q.prec, dec);
+    return fixedDecToString<flags>(buf, bufsize, dec, q.prec);
+}
+
+template <Flags flags=0, typename Val, uint8_t fracBits>
+size_t toStringLen(QFmt<Val, fracBits> q)
+{
+    FpDecimal dec;
+    qToDecimal<fracBits>(q.value, q.prec, dec);
+    return fixedDecLen(dec, q.prec);
+}
+
+template <typename T, uint32_t aDivisor>
+struct ScaledFmt
+{
+    enum: uint32_t { kDivisor = aDivisor };
+    T value;
+    uint8_t prec;
+    ScaledFmt(T aVal, uint8_t aPrec): value(aVal), prec(aPrec) {}
+};
+
+/** Number of decimal digits needed to represent the fractional part of x/divisor
+ * exactly, if divisor is a power of 10 */
+constexpr uint8_t scaledDefaultPrec(uint32_t divisor)
+{
+    return (divisor <= 1) ? 0 : 1 + scaledDefaultPrec((divisor + 9) / 10);
+}
+
+/**
+ * Specifies that an integer is a value scaled by \c divisor, and must be printed
+ * as value/divisor in decimal notation. For example, a temperature in centi-degrees
+ * is printed with fmtScaled<100>(temp), i.e. 2345 is printed as 23.45.
+ * Only integer operations are used for the conversion, and the division by the
+ * constant \c divisor is normally optimized to a multiplication by the compiler.
+ * @param prec The number of digits after the decimal point (up to 9). By default,
+ * it is the number of digits needed to print the value exactly, if \c divisor
+ * is a power of 10. The value is rounded half up.
+ */
+template <uint32_t divisor, class T>
+ScaledFmt<T, divisor> fmtScaled(T val, uint8_t prec=scaledDefaultPrec(divisor))
+{
+    static_assert(std::is_integral<T>::value, "Scaled value must be of an integer type");
+    static_assert(divisor > 0, "Divisor can't be zero");
+    return ScaledFmt<T, divisor>(val, prec);
+}
+
+template <uint32_t divisor, typename T>
+void scaledToDecimal(T val, uint8_t prec, FpDecimal& dec)
+{
+    typedef typename std::conditional<(divisor <= 0xffffffff / 10) && (sizeof(T) <= sizeof(uint32_t)),
+        uint32_t, uint64_t>::type W; // must fit the remainder multiplied by 10
+    W absVal = absUnsigned(val, dec.negative);
+    dec.kind = kFpKindFixed;
+    dec.digits = absVal / divisor;
+    dec.fraction = 0;
+    W rem = absVal % divisor;
+    uint32_t mult = 1;
+    for (uint8_t i = 0; i < prec; i++)
+    {
+        rem *= 10;
+        dec.fraction = dec.fraction * 10 + (uint32_t)(rem / divisor);
+        rem %= divisor;
+        mult *= 10;
+    }
+    if (rem * 2 >= divisor) // round half up
+    {
+        if (++dec.fraction >= mult)
+        {
+            dec.digits++;
+            dec.fraction = 0;
+        }
+    }
+}
+
+/** Runtime counterpart of \c scaledToDecimal(), for when \c divisor is not known
+ * at compile time. Uses 32-bit divisions whenever the value allows it. Takes the
+ * absolute value, the caller sets \c dec.negative
+ */
+static inline void scaledAbsToDecimal(uint64_t absVal, uint32_t divisor, uint8_t prec, FpDecimal& dec)
+{
+    dec.kind = kFpKindFixed;
+    dec.fraction = 0;
+    uint32_t mult = 1;
+    if ((absVal >> 32) == 0 && divisor <= 0xffffffff / 10)
+    {
+        uint32_t val32 = absVal;
+        dec.digits = val32 / divisor;
+        uint32_t rem = val32 % divisor;
+        for (uint8_t i = 0; i < prec; i++)
+        {
+            rem *= 10;
+            dec.fraction = dec.fraction * 10 + rem / divisor;
+            rem %= divisor;
+            mult *= 10;
+        }
+        absVal = rem; // for the rounding below
+    }
+    else
+    {
+        dec.digits = absVal / divisor;
+        uint64_t rem = absVal % divisor;
+        for (uint8_t i = 0; i < prec; i++)
+        {
+            rem *= 10;
+            dec.fraction = dec.fraction * 10 + (uint32_t)(rem / divisor);
+            rem %= divisor;
+            mult *= 10;
+        }
+        absVal = rem;
+    }
+    if (absVal * 2 >= divisor) // round half up
+    {
+        if (++dec.fraction >= mult)
+        {
+            dec.digits++;
+            dec.fraction = 0;
+        }
+    }
+}
+
+template <Flags flags=0, typename Val, uint32_t divisor>
+char* toString(char* buf, size_t bufsize, ScaledFmt<Val, divisor> val)
+{
+    assert(val.prec <= 9);
+    FpDecimal dec;
+    scaledToDecimal<divisor>(val.value, val.prec, dec);
+    return fixedDecToString<flags>(buf, bufsize, dec, val.prec);
+}
+
+template <Flags flags=0, typename Val, uint32_t divisor>
+size_t toStringLen(ScaledFmt<Val, divisor> val)
+{
+    FpDecimal dec;
+    scaledToDecimal<divisor>(val.value, val.prec, dec);
+    return fixedDecLen(dec, val.prec);
+}
+
 template <uint8_t aFlags=0>
 struct RptChar
 {
@@ -513,4 +1424,10 @@ char* toString(char* buf, size_t bufsize, RptChar<rptFlags> val)
     return buf;
 }
 
+template <Flags aFlags=0, uint8_t rptFlags>
+size_t toStringLen(RptChar<rptFlags> val)
+{
+    return val.count();
+}
+
 #endif
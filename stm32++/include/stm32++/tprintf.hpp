@@ -16,19 +16,100 @@
     #define STM32PP_TPRINTF_MAX_DYNAMIC_BUFSIZE 10240
 #endif
 
+/** Allocations of async print buffers are rounded up to a multiple of this,
+ * so that the buffer doesn't have to be reallocated for every slightly longer message
+ */
 #ifndef STM32PP_TPRINTF_ASYNC_EXPAND_STEP
     #define STM32PP_TPRINTF_ASYNC_EXPAND_STEP 64
 #endif
 
-#ifndef STM32PP_TPRINTF_SYNC_EXPAND_STEP
-    #define STM32PP_TPRINTF_SYNC_EXPAND_STEP 128
-#endif
+/** @brief Formats the message directly into the ring buffer of \c sink.
+ * First, the message is formatted in the currently free space. If it doesn't
+ * fit, its exact length is calculated and the sink is asked to free that much
+ * space, and the message is formatted once more. No intermediate buffer and
+ * no heap allocation is used
+ * @return The length of the message, or 0 if it was dropped
+ */
+template <typename F, typename... Args>
+size_t ringPrintf(IRingPrintSink* sink, F fmtStr, Args... args)
+{
+    IRingPrintSink::Span first, second;
+    if (!sink->reserve(first, second, 0))
+    {
+        return 0;
+    }
+    SpanWriter writer(first.buf, first.size, second.buf, second.size);
+    if (!tsnprintfSpans(writer, fmtStr, args...))
+    {
+        size_t needed = tformattedLength(fmtStr, args...);
+        if (!sink->reserve(first, second, needed))
+        {
+            return 0;
+        }
+        writer = SpanWriter(first.buf, first.size, second.buf, second.size);
+        if (!tsnprintfSpans(writer, fmtStr, args...))
+        {
+            assert(false); // length calculation didn't match the actual output
+            sink->commit(0); // release the reservation
+            return 0;
+        }
+    }
+    sink->commit(writer.written());
+    return writer.written();
+}
 
-template <int InitialBufSize=64, typename... Args>
-size_t ftprintf(uint8_t fd, const char* fmtStr, Args... args)
+/** @brief Formats the message directly into the buffer of a multi-producer
+ * sink. As the space has to be reserved in a single step, the length of the
+ * message is calculated first. Can be called from any context, including
+ * interrupts
+ * @return The length of the message, or 0 if it was dropped
+ */
+template <typename F, typename... Args>
+size_t mpscPrintf(IMpscPrintSink* sink, F fmtStr, Args... args)
+{
+    size_t len = tformattedLength(fmtStr, args...);
+    IMpscPrintSink::Reservation res;
+    if (!sink->reserve(len, res))
+    {
+        return 0;
+    }
+    SpanWriter writer(res.first.buf, res.first.size, res.second.buf, res.second.size);
+    bool ok = tsnprintfSpans(writer, fmtStr, args...);
+    assert(ok && writer.written() == len); // length calculation didn't match the actual output
+    (void)ok;
+    // commit even on error, as an uncommitted reservation blocks the output
+    sink->commit(res);
+    return len;
+}
+
+/** @brief Formats and prints the message to the current print sink.
+ * The message is first formatted directly into the stack buffer (for
+ * synchronous sinks) or the sink's current buffer (for async sinks). If it
+ * doesn't fit, its exact length is calculated with \c tformattedLength(),
+ * and it is formatted once more, in a heap buffer of exactly that size. This
+ * way short messages are formatted in a single pass, and long ones are formatted
+ * at most twice, with a single allocation. If \c STM32PP_PRINT_BUF_POOL is
+ * defined, buffers are allocated from the print buffer pool instead of the
+ * heap, see printBufPool.hpp. Sinks that have their own ring
+ * buffer are written to directly, via \c ringPrintf() or \c mpscPrintf().
+ * These have a single output stream and ignore \c fd.
+ * @param InitialBufSize Size of the stack buffer for synchronous sinks
+ * @param fmtStr Either a format string, or a compile-time format string
+ * created with \c FMT()
+ */
+template <int InitialBufSize=64, typename F, typename... Args>
+size_t ftprintf(uint8_t fd, F fmtStr, Args... args)
 {
     extern IPrintSink* gPrintSink;
-    char* staticBuf; // static buf
+    if (auto ring = gPrintSink->ringSink())
+    {
+        return ringPrintf(ring, fmtStr, args...);
+    }
+    if (auto mpsc = gPrintSink->mpscSink())
+    {
+        return mpscPrintf(mpsc, fmtStr, args...);
+    }
+    char* staticBuf;
     char* buf;
     size_t bufsize;
 
@@ -36,50 +117,94 @@ size_t ftprintf(uint8_t fd, const char* fmtStr, Args... args)
     if (async)
     {
         staticBuf = nullptr;
-        if (async->buf)
+#ifdef STM32PP_PRINT_BUF_POOL
+        if (!async->buf)
         {
-            buf = (char*)async->buf;
-            bufsize = async->bufSize;
-        }
-        else
-        {
-            buf = (char*)malloc(InitialBufSize);
-            bufsize = InitialBufSize;
+            async->buf = gPrintBufPool.alloc();
+            if (!async->buf)
+            {
+                return 0;
+            }
+            async->bufSize = DefaultPrintBufPool::kBlockSize;
         }
+#endif
+        buf = (char*)async->buf;
+        bufsize = async->bufSize;
     }
     else
     {
         buf = staticBuf = (char*)alloca(InitialBufSize);
         bufsize = InitialBufSize;
     }
-    char* ret;
-    for(;;)
+    char* ret = buf ? tsnprintf(buf, bufsize, fmtStr, args...) : nullptr;
+    if (!ret)
     {
-        ret = tsnprintf(buf, bufsize, fmtStr, args...);
-        if (ret)
+#ifdef STM32PP_PRINT_BUF_POOL
+        // Doesn't fit. Async sinks already format in a pool block, for
+        // synchronous ones retry in a pool block, if it's larger than the stack buffer
+        if (!async && InitialBufSize < DefaultPrintBufPool::kBlockSize)
         {
-            break;
+            if (char* block = gPrintBufPool.alloc())
+            {
+                buf = block;
+                bufsize = DefaultPrintBufPool::kBlockSize;
+                ret = tsnprintf(buf, bufsize, fmtStr, args...);
+            }
         }
-        // tsnprintf() returned nullptr, have to increase buf size
-        bufsize += async ? STM32PP_TPRINTF_ASYNC_EXPAND_STEP : STM32PP_TPRINTF_SYNC_EXPAND_STEP;
-        if (bufsize > STM32PP_TPRINTF_MAX_DYNAMIC_BUFSIZE)
+        if (!ret)
         {
-            //too much, bail out
-            if ((buf != staticBuf) && !async) // buffer is dynamic and synchronous, free it
+            if (STM32PP_PRINT_BUF_POOL_POLICY == kPrintPoolDrop)
             {
-                free(buf);
+                if (buf != staticBuf && !async)
+                {
+                    freePrintBuf(buf);
+                }
+                return 0;
             }
+            // tsnprintf() leaves the output truncated after the last value that fits
+            ret = buf + strlen(buf);
+        }
+#else
+        // Doesn't fit, allocate a buffer of the exact size
+        size_t needed = tformattedLength(fmtStr, args...) + 1;
+        if (needed > STM32PP_TPRINTF_MAX_DYNAMIC_BUFSIZE)
+        {
             return 0;
         }
-        buf = (buf == staticBuf)
-            ? (char*)malloc(bufsize)
-            : (char*)realloc(buf, bufsize);
-        if (!buf)
+        if (async)
+        {
+            bufsize = (needed + STM32PP_TPRINTF_ASYNC_EXPAND_STEP - 1)
+                / STM32PP_TPRINTF_ASYNC_EXPAND_STEP * STM32PP_TPRINTF_ASYNC_EXPAND_STEP;
+            buf = (char*)realloc(buf, bufsize);
+            if (!buf)
+            {
+                // realloc doesn't free the old buffer on failure,
+                // so the sink's pointer remains valid
+                return 0;
+            }
+            async->buf = buf;
+            async->bufSize = bufsize;
+        }
+        else
         {
-            // If we are async, we did a realloc. When realloc fails,
-            // it doesn't free the old buffer, so the sink's pointer remains valid
+            bufsize = needed;
+            buf = (char*)malloc(bufsize);
+            if (!buf)
+            {
+                return 0;
+            }
+        }
+        ret = tsnprintf(buf, bufsize, fmtStr, args...);
+        if (!ret) // length calculation didn't match the actual output
+        {
+            assert(false);
+            if (buf != staticBuf && !async)
+            {
+                free(buf);
+            }
             return 0;
         }
+#endif
     }
     assert(ret >= buf);
     size_t size = ret-buf;
@@ -92,14 +217,14 @@ size_t ftprintf(uint8_t fd, const char* fmtStr, Args... args)
         gPrintSink->print(buf, size, fd);
         if (buf != staticBuf)
         {
-            free(buf);
+            freePrintBuf(buf);
         }
     }
     return size;
 }
 
-template <int InitialBufSize=64, typename ...Args>
-uint16_t tprintf(const char* fmtStr, Args... args)
+template <int InitialBufSize=64, typename F, typename ...Args>
+uint16_t tprintf(F fmtStr, Args... args)
 {
     return ftprintf<InitialBufSize>(1, fmtStr, args...);
 }
@@ -9,10 +9,33 @@
 #include "tostring.hpp"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h> // for memcpy
 #include <alloca.h>
+#include <type_traits>
 char* tsnprintf(char* buf, size_t bufsize, const char* fmtStr);
+size_t tformattedLength(const char* fmtStr);
 
-// Returns the address of the terminating null of the written string
+#ifdef STM32PP_TSNPRINTF_TYPE_ERASED
+#include "fmtArg.hpp"
+
+// Type-erased backend, see fmtArg.hpp
+template <typename Val, typename ...Args>
+char* tsnprintf(char* buf, size_t bufsize, const char* fmtStr, Val val, Args... args)
+{
+    const FmtArg packed[] = { toFmtArg(val), toFmtArg(args)... };
+    return vtsnprintf(buf, bufsize, fmtStr, packed, 1 + sizeof...(Args));
+}
+
+template <typename Val, typename ...Args>
+size_t tformattedLength(const char* fmtStr, Val val, Args... args)
+{
+    const FmtArg packed[] = { toFmtArg(val), toFmtArg(args)... };
+    return vtformattedLength(fmtStr, packed, 1 + sizeof...(Args));
+}
+#else
+// Returns the address of the terminating null of the written string, or null
+// if it doesn't fit. Then the buffer contains the output truncated after the last
+// literal char or value that fits
 template <typename Val, typename ...Args>
 char* tsnprintf(char* buf, size_t bufsize, const char* fmtStr, Val val, Args... args)
 {
@@ -30,26 +53,30 @@ char* tsnprintf(char* buf, size_t bufsize, const char* fmtStr, Val val, Args...
             // - the address of the char after the last written,
             // if it managed to write everything. However, that returned
             // address may be past the end of the buffer, so we need to check
-            buf = toString<kDontNullTerminate>(buf, bufend-buf+1, val);
-            if (!buf)
+            char* valEnd = toString<kDontNullTerminate>(buf, bufend-buf+1, val);
+            if (!valEnd)
             {
-                *bufend = 0;
+                // terminate the output after the last value that fit
+                *buf = 0;
                 return nullptr;
             }
-            if (buf >= bufend)
+            if (valEnd >= bufend)
             {
-                *bufend = 0;
-                if (buf == bufend)
+                if (valEnd == bufend)
                 {
-                    return bufend;
+                    *bufend = 0;
+                    // fits exactly, but only if nothing follows
+                    return *fmtStr ? nullptr : bufend;
                 }
                 // toString() just managed to fit everything, without the terminating zero
                 // but now we don't have space for the terminator
-                assert(buf - bufend == 1); // make sure we haven't gone past the end of the buffer
-                // replace last char with terminator, and return null, to signal
-                // that we didn't have enough space
+                assert(valEnd - bufend == 1); // make sure we haven't gone past the end of the buffer
+                // terminate the output after the last value that fit, and return
+                // null, to signal that we didn't have enough space
+                *buf = 0;
                 return nullptr;
             }
+            buf = valEnd;
             return tsnprintf(buf, bufend-buf+1, fmtStr, args...);
         }
         else if (ch == 0)
@@ -71,4 +98,291 @@ char* tsnprintf(char* buf, size_t bufsize, const char* fmtStr, Val val, Args...
     return nullptr;
 }
 
+/** @brief Returns the length of the string that tsnprintf() would produce with
+ * the same arguments (not counting the null terminator), without formatting it
+ */
+template <typename Val, typename ...Args>
+size_t tformattedLength(const char* fmtStr, Val val, Args... args)
+{
+    size_t len = 0;
+    for (;;)
+    {
+        char ch = *fmtStr++;
+        if (ch == '%')
+        {
+            return len + toStringLen(val) + tformattedLength(fmtStr, args...);
+        }
+        else if (ch == 0)
+        {
+            return len;
+        }
+        len++;
+    }
+}
+#endif
+
+/** @brief Compile-time format strings
+ * \c FMT("...") wraps a string literal in a type, so that the positions of
+ * the \c % placeholders are known at compile time. The literal parts between
+ * placeholders are copied with \c memcpy() without scanning, and a mismatch
+ * between placeholder and argument count is a compile error:
+ * \code
+ * tsnprintf(buf, sizeof(buf), FMT("temp: %, press: %"), temp, press);
+ * tprintf(FMT("temp: %\n"), temp);
+ * \endcode
+ */
+struct CompiledFmtTag {};
+
+#define FMT(literal)                                                \
+    ([]() {                                                         \
+        struct Fmt: public CompiledFmtTag                           \
+        { static constexpr const char* str() { return literal; } }; \
+        return Fmt();                                               \
+    }())
+
+template <class F>
+struct IsCompiledFmt: std::integral_constant<bool, std::is_base_of<CompiledFmtTag, F>::value> {};
+
+constexpr size_t fmtSlotCount(const char* str)
+{
+    size_t count = 0;
+    for (; *str; str++)
+    {
+        if (*str == '%')
+            count++;
+    }
+    return count;
+}
+
+/** Offset of the literal segment that follows placeholder \c idx-1.
+ * Segment 0 starts at the beginning of the string */
+constexpr size_t fmtSegmentStart(const char* str, size_t idx)
+{
+    size_t pos = 0;
+    for (; idx; pos++)
+    {
+        if (str[pos] == '%')
+            idx--;
+    }
+    return pos;
+}
+
+constexpr size_t fmtSegmentLen(const char* str, size_t idx)
+{
+    size_t start = fmtSegmentStart(str, idx);
+    size_t end = start;
+    while (str[end] && str[end] != '%')
+    {
+        end++;
+    }
+    return end - start;
+}
+
+/** Copies literal segment \c idx of the compiled format string \c F.
+ * \c bufend points to the last char of the buffer, reserved for the null terminator
+ */
+template <class F, size_t idx>
+char* tsnprintfPutSegment(char* buf, char* bufend)
+{
+    enum: size_t {
+        kStart = fmtSegmentStart(F::str(), idx),
+        kLen = fmtSegmentLen(F::str(), idx)
+    };
+    if (kLen > (size_t)(bufend - buf))
+    {
+        memcpy(buf, F::str() + kStart, bufend - buf);
+        *bufend = 0;
+        return nullptr;
+    }
+    memcpy(buf, F::str() + kStart, kLen);
+    return buf + kLen;
+}
+
+template <class F, size_t idx>
+char* tsnprintfCompiled(char* buf, char* bufend)
+{
+    buf = tsnprintfPutSegment<F, idx>(buf, bufend);
+    if (buf)
+    {
+        *buf = 0;
+    }
+    return buf;
+}
+
+template <class F, size_t idx, typename Val, typename... Args>
+char* tsnprintfCompiled(char* buf, char* bufend, Val val, Args... args)
+{
+    buf = tsnprintfPutSegment<F, idx>(buf, bufend);
+    if (!buf)
+    {
+        return nullptr;
+    }
+    char* valEnd = toString<kDontNullTerminate>(buf, bufend-buf+1, val);
+    if (!valEnd)
+    {
+        *buf = 0;
+        return nullptr;
+    }
+    if (valEnd > bufend)
+    {
+        // the value fit, but the terminator didn't
+        *buf = 0;
+        return nullptr;
+    }
+    return tsnprintfCompiled<F, idx+1>(valEnd, bufend, args...);
+}
+
+template <class F, size_t idx>
+size_t tformattedLengthCompiled()
+{
+    enum: size_t { kLen = fmtSegmentLen(F::str(), idx) };
+    return kLen;
+}
+
+template <class F, size_t idx, typename Val, typename... Args>
+size_t tformattedLengthCompiled(Val val, Args... args)
+{
+    enum: size_t { kLen = fmtSegmentLen(F::str(), idx) };
+    return kLen + toStringLen(val) + tformattedLengthCompiled<F, idx+1>(args...);
+}
+
+template <class F, typename... Args>
+typename std::enable_if<IsCompiledFmt<F>::value, size_t>::type
+tformattedLength(F, Args... args)
+{
+    static_assert(fmtSlotCount(F::str()) == sizeof...(Args),
+        "Number of % placeholders in format string does not match the number of arguments");
+#ifdef STM32PP_TSNPRINTF_TYPE_ERASED
+    return tformattedLength(F::str(), args...);
+#else
+    return tformattedLengthCompiled<F, 0>(args...);
+#endif
+}
+
+/** @brief Compiled format string version of tsnprintf().
+ * Same return value semantics as the runtime version
+ */
+template <class F, typename... Args>
+typename std::enable_if<IsCompiledFmt<F>::value, char*>::type
+tsnprintf(char* buf, size_t bufsize, F, Args... args)
+{
+    static_assert(fmtSlotCount(F::str()) == sizeof...(Args),
+        "Number of % placeholders in format string does not match the number of arguments");
+#ifdef STM32PP_TSNPRINTF_TYPE_ERASED
+    // Only the placeholder count check is done at compile time
+    return tsnprintf(buf, bufsize, F::str(), args...);
+#else
+    assert(buf);
+    assert(bufsize);
+    return tsnprintfCompiled<F, 0>(buf, buf+bufsize-1, args...);
+#endif
+}
+
+/** @brief Output of \c tsnprintfSpans() - a buffer that consists of two
+ * contiguous spans, such as the free space of a ring buffer, which wraps around
+ * its end
+ */
+class SpanWriter
+{
+protected:
+    char* mPtr;
+    char* mEnd;
+    char* mNext;
+    size_t mNextSize;
+    size_t mWritten = 0;
+public:
+    SpanWriter(char* buf1, size_t size1, char* buf2=nullptr, size_t size2=0)
+    : mPtr(buf1), mEnd(buf1 + size1), mNext(buf2), mNextSize(size2) {}
+    size_t written() const { return mWritten; }
+    size_t available() const { return (mEnd - mPtr) + mNextSize; }
+    bool put(const char* str, size_t len)
+    {
+        if (len > available())
+        {
+            return false;
+        }
+        mWritten += len;
+        size_t len1 = mEnd - mPtr;
+        if (len <= len1)
+        {
+            memcpy(mPtr, str, len);
+            mPtr += len;
+            return true;
+        }
+        memcpy(mPtr, str, len1);
+        switchSpan();
+        len -= len1;
+        memcpy(mPtr, str + len1, len);
+        mPtr += len;
+        return true;
+    }
+    void switchSpan()
+    {
+        mPtr = mNext;
+        mEnd = mNext + mNextSize;
+        mNext = nullptr;
+        mNextSize = 0;
+    }
+    /** Formats the value directly in the current span. Only if it straddles the
+     * boundary between the spans, it's formatted in a temporary buffer on the
+     * stack and copied */
+    template <typename Val>
+    bool putValue(Val val)
+    {
+        char* end = (mPtr < mEnd) ? toString<kDontNullTerminate>(mPtr, mEnd - mPtr, val) : nullptr;
+        if (end)
+        {
+            mWritten += end - mPtr;
+            mPtr = end;
+            return true;
+        }
+        size_t len = toStringLen(val);
+        if (len > available())
+        {
+            return false;
+        }
+        if (!len)
+        {
+            return true; // an empty value at the end of the span
+        }
+        char* tmp = (char*)alloca(len);
+        toString<kDontNullTerminate>(tmp, len, val);
+        return put(tmp, len);
+    }
+};
+
+static inline bool tsnprintfSpans(SpanWriter& writer, const char* fmtStr)
+{
+    return writer.put(fmtStr, strlen(fmtStr));
+}
+
+/** @brief Same as \c tsnprintf(), but writes to a \c SpanWriter, without a null
+ * terminator.
+ * @return \c false if the output doesn't fit, in which case the contents of the
+ * spans is undefined
+ */
+template <typename Val, typename ...Args>
+bool tsnprintfSpans(SpanWriter& writer, const char* fmtStr, Val val, Args... args)
+{
+    const char* placeholder = strchr(fmtStr, '%');
+    if (!placeholder)
+    {
+        return writer.put(fmtStr, strlen(fmtStr));
+    }
+    if (!writer.put(fmtStr, placeholder - fmtStr) || !writer.putValue(val))
+    {
+        return false;
+    }
+    return tsnprintfSpans(writer, placeholder + 1, args...);
+}
+
+template <class F, typename... Args>
+typename std::enable_if<IsCompiledFmt<F>::value, bool>::type
+tsnprintfSpans(SpanWriter& writer, F, Args... args)
+{
+    static_assert(fmtSlotCount(F::str()) == sizeof...(Args),
+        "Number of % placeholders in format string does not match the number of arguments");
+    return tsnprintfSpans(writer, F::str(), args...);
+}
+
 #endif
@@ -13,55 +13,65 @@
 #include "gpio.hpp"
 #include "tprintf.hpp"
 #include "dma.hpp"
+#include "dmaRxRing.hpp"
+#include "log.hpp"
 #include <assert.h>
-#ifdef STM32PP_USART_DEBUG
-#define STM32PP_USART_LOG(fmtString,...) tprintf("%: " fmtString "\n", Self::periphName(), ##__VA_ARGS__)
-#else
-#define STM32PP_USART_LOG(fmtString,...)
+
+#ifndef STM32PP_LOG_LEVEL_USART
+    #ifdef STM32PP_USART_DEBUG
+        #define STM32PP_LOG_LEVEL_USART kLogLevelDebug
+    #else
+        #define STM32PP_LOG_LEVEL_USART STM32PP_LOG_LEVEL
+    #endif
 #endif
 
+#define STM32PP_USART_LOG(fmtString,...) STM32PP_LOG(USART, Debug, "%: " fmtString, Self::periphName(), ##__VA_ARGS__)
+
 #define STM32PP_LOG_DEBUG(fmtString,...) STM32PP_USART_LOG(fmtString, ##__VA_ARGS__)
 
 STM32PP_PERIPH_INFO(USART1)
     enum: uint32_t { kPort = GPIOA };
     enum: uint16_t { kPinTx = GPIO_USART1_TX, kPinRx = GPIO_USART1_RX };
     static constexpr rcc_periph_clken kClockId = RCC_USART1;
+    enum: uint8_t { kIrqn = NVIC_USART1_IRQ };
     enum: uint32_t { kDmaTxId = DMA1, kDmaRxId = DMA1 };
     enum: uint8_t {
         kDmaTxChannel = DMA_CHANNEL4,
         kDmaRxChannel = DMA_CHANNEL5
     };
-    static const uint8_t dmaWordSize() { return 1; }
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&USART1_DR); }
-    static const uint32_t dmaTxDataRegister() { return (uint32_t)(&USART1_DR); }
+    enum: uint8_t { kDmaWordSize = 1 };
+    static const uint32_t dmaRxDataRegister() { return busAddr(&USART1_DR); }
+    static const uint32_t dmaTxDataRegister() { return busAddr(&USART1_DR); }
 };
 
 STM32PP_PERIPH_INFO(USART2)
     enum: uint32_t { kPort = GPIOA };
     enum: uint16_t { kPinTx = GPIO_USART2_TX, kPinRx = GPIO_USART2_RX };
     static constexpr rcc_periph_clken kClockId = RCC_USART2;
+    enum: uint8_t { kIrqn = NVIC_USART2_IRQ };
     enum: uint32_t { kDmaTxId = DMA1, kDmaRxId = DMA1 };
     enum: uint8_t {
         kDmaTxChannel = DMA_CHANNEL7,
         kDmaRxChannel = DMA_CHANNEL6
     };
-    static const uint8_t dmaWordSize() { return 1; }
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&USART2_DR); }
-    static const uint32_t dmaTxDataRegister() { return (uint32_t)(&USART2_DR); }
+    enum: uint8_t { kDmaWordSize = 1 };
+    static const uint32_t dmaRxDataRegister() { return busAddr(&USART2_DR); }
+    static const uint32_t dmaTxDataRegister() { return busAddr(&USART2_DR); }
 };
 
 STM32PP_PERIPH_INFO(USART3)
     enum: uint32_t { kPort = GPIOB };
     enum: uint16_t { kPinTx = GPIO_USART3_TX, kPinRx = GPIO_USART3_RX };
     static constexpr rcc_periph_clken kClockId = RCC_USART3;
+    enum: uint8_t { kIrqn = NVIC_USART3_IRQ };
     enum: uint32_t { kDmaTxId = DMA1, kDmaRxId = DMA1 };
     enum: uint8_t {
         kDmaTxChannel = DMA_CHANNEL2,
         kDmaRxChannel = DMA_CHANNEL3
     };
-    static const uint8_t dmaWordSize() { return 1; }
-    static const uint32_t dmaRxDataRegister() { return (uint32_t)(&USART3_DR); }
-    static const uint32_t dmaTxDataRegister() { return (uint32_t)(&USART3_DR); }
+    enum: uint8_t { kDmaWordSize = 1 };
+    static const uint32_t dmaRxDataRegister() { return busAddr(&USART3_DR); }
+    static const uint32_t dmaTxDataRegister() { return busAddr(&USART3_DR); }
 };
 
 namespace nsusart
@@ -187,7 +197,8 @@ public:
         }
         usart_set_mode(Self::kPeriphId, mode);
         usart_set_baudrate(Self::kPeriphId, baudRate);
-        usart_set_databits(Self::kPeriphId, 9);
+        // With parity, the parity bit is the 9th bit of the frame
+        usart_set_databits(Self::kPeriphId, (parity == USART_PARITY_NONE) ? 8 : 9);
         usart_set_stopbits(Self::kPeriphId, stopBits);
         usart_set_parity(Self::kPeriphId, parity);
         usart_set_flow_control(Self::kPeriphId, USART_FLOWCONTROL_NONE);
@@ -211,6 +222,117 @@ public:
     }
 };
 
+/** @brief Non-blocking reception into a circular DMA buffer, with packet
+ * boundaries detected by the idle line interrupt. The DMA runs continuously,
+ * and \c available(), \c read(), \c readLine() and \c readPacket() return
+ * immediately with whatever has been received, see \c dma::RxRing for the
+ * semantics. A packet ends when the line stays idle for a frame.
+ * The DMA interrupt (half and full transfer) and the USART interrupt must be
+ * forwarded to \c dmaRxIsr() and \c usartRxIsr():
+ * \code
+ * nsusart::DmaRxRing<nsusart::Usart<USART1>> cmd;
+ * extern "C" void dma1_channel5_isr() { cmd.dmaRxIsr(); }
+ * extern "C" void usart1_isr() { cmd.usartRxIsr(); }
+ * ...
+ * cmd.init(nsusart::kOptEnableRx | nsusart::kOptEnableTx, 115200);
+ * cmd.rxRingStart(buf, sizeof(buf));
+ * ...
+ * size_t len = cmd.readPacket(packet, sizeof(packet));
+ * \endcode
+ * The buffer must hold the data received during the longest time the
+ * consumer doesn't read it, otherwise the lost bytes are counted in
+ * \c rxOverrunBytes().
+ * The consumer copies data out with interrupts disabled
+ */
+template <class UsartDevice, uint32_t Opts=dma::kDefaultOpts, uint8_t MaxPackets=8>
+class DmaRxRing: public dma::Rx<UsartDevice, Opts | dma::kDmaCircularMode>
+{
+protected:
+    typedef dma::Rx<UsartDevice, Opts | dma::kDmaCircularMode> Base;
+    static_assert((Opts & dma::kDmaNoDoneIntr) == 0, "The ring requires the DMA interrupt");
+    dma::RxRing<MaxPackets> mRing;
+    volatile uint32_t mHwOverruns = 0;
+    void ringUpdate()
+    {
+        mRing.update(dma_get_number_of_data(Base::kDmaRxId, Base::kDmaRxChannel));
+    }
+public:
+    /** Starts continuous reception into \c buf, until \c rxRingStop() */
+    void rxRingStart(void* buf, uint16_t size)
+    {
+        {
+            IntrDisable noIntr;
+            mRing.start(buf, size);
+            mHwOverruns = 0;
+        }
+        Base::dmaRxStart(buf, size);
+        dma_enable_half_transfer_interrupt(Base::kDmaRxId, Base::kDmaRxChannel);
+        usart_enable_idle_interrupt(Base::kPeriphId);
+        nvic_enable_irq(Base::kIrqn);
+    }
+    void rxRingStop()
+    {
+        usart_disable_idle_interrupt(Base::kPeriphId);
+        dma_disable_half_transfer_interrupt(Base::kDmaRxId, Base::kDmaRxChannel);
+        Base::dmaRxStop();
+    }
+    /** Replaces the one-shot handling of \c dma::Rx, the transfer never ends */
+    void dmaRxIsr()
+    {
+        enum: uint32_t { dma = Base::kDmaRxId };
+        enum: uint8_t { chan = Base::kDmaRxChannel };
+        DMA_IFCR(dma) = DMA_IFCR_CHTIF(chan) | DMA_IFCR_CTCIF(chan);
+        ringUpdate();
+    }
+    void usartRxIsr()
+    {
+        uint32_t sr = USART_SR(Base::kPeriphId);
+        if ((sr & (USART_SR_IDLE | USART_SR_ORE)) == 0)
+        {
+            return;
+        }
+        usart_recv(Base::kPeriphId); // clears IDLE and ORE, after the SR read
+        if (sr & USART_SR_ORE)
+        {
+            mHwOverruns = mHwOverruns + 1;
+        }
+        if (sr & USART_SR_IDLE)
+        {
+            ringUpdate();
+            mRing.markPacketEnd();
+        }
+    }
+    /** Number of received bytes that have not been read yet */
+    uint32_t available()
+    {
+        IntrDisable noIntr;
+        ringUpdate();
+        return mRing.available();
+    }
+    size_t read(void* buf, size_t size)
+    {
+        IntrDisable noIntr;
+        ringUpdate();
+        return mRing.read(buf, size);
+    }
+    size_t readLine(char* buf, size_t bufsize)
+    {
+        IntrDisable noIntr;
+        ringUpdate();
+        return mRing.readLine(buf, bufsize);
+    }
+    size_t readPacket(void* buf, size_t bufsize)
+    {
+        IntrDisable noIntr;
+        return mRing.readPacket(buf, bufsize);
+    }
+    uint8_t packetCount() const { return mRing.packetCount(); }
+    /** Number of received bytes that were overwritten in the buffer before they were read */
+    uint32_t rxOverrunBytes() const { return mRing.overrunBytes(); }
+    /** Number of USART overruns, i.e. the DMA didn't read a byte in time */
+    uint32_t rxHwOverrunCount() const { return mHwOverruns; }
+};
+
 template <class UsartDevice>
 class PrintSink: public UsartDevice, public IPrintSink
 {
@@ -220,6 +342,131 @@ class PrintSink: public UsartDevice, public IPrintSink
         UsartDevice::sendBlocking(str, len);
     }
 };
+
+/** @brief Interrupt-driven transmission from a ring buffer, for USARTs whose
+ * DMA channel is not available. \c write() copies as much as fits in the ring
+ * and returns immediately, and the TXE interrupt feeds the data register, a
+ * byte per interrupt. After the last byte, the TC interrupt marks the end of
+ * the transmission, see \c txBusy().
+ * The USART interrupt handler must call \c usartTxIsr() (as well as
+ * \c DmaRxRing::usartRxIsr(), if reception also uses the interrupt).
+ * As an \c IRingPrintSink, \c tprintf() formats directly into the ring.
+ * Messages that don't fit in the free space are dropped, see \c RingPrintSink
+ * for a sink that waits for space instead
+ */
+template <class UsartDevice, size_t Size=256>
+class IntrTx: public UsartDevice, public ::RingPrintSink<Size>
+{
+protected:
+    typedef ::RingPrintSink<Size> Ring;
+    volatile bool mTxActive = false;
+    virtual void drain()
+    {
+        IntrDisable noIntr;
+        if (!mTxActive)
+        {
+            mTxActive = true;
+            usart_enable_tx_interrupt(UsartDevice::kPeriphId);
+            nvic_enable_irq(UsartDevice::kIrqn);
+        }
+    }
+public:
+    /** Queues up to \c len bytes for transmission, without waiting.
+     * @return The number of bytes accepted */
+    size_t write(const void* data, size_t len)
+    {
+        size_t free = Ring::freeSpace();
+        if (len > free)
+        {
+            len = free;
+        }
+        if (!len)
+        {
+            return 0;
+        }
+        IRingPrintSink::Span first, second;
+        Ring::reserve(first, second, len);
+        IRingPrintSink::copyToSpans(first, second, (const char*)data, len);
+        Ring::commit(len);
+        return len;
+    }
+    size_t write(const char* str) { return write(str, strlen(str)); }
+    /** Whether data is being transmitted, i.e. until the last byte in the
+     * ring has left the shift register */
+    bool txBusy() const { return mTxActive; }
+    void usartTxIsr()
+    {
+        enum: uint32_t { usart = UsartDevice::kPeriphId };
+        uint32_t cr1 = USART_CR1(usart);
+        uint32_t sr = USART_SR(usart);
+        if ((cr1 & USART_CR1_TXEIE) && (sr & USART_SR_TXE))
+        {
+            const char* data;
+            if (Ring::pending(data))
+            {
+                USART_DR(usart) = *data;
+                Ring::consumed(1);
+            }
+            else
+            {
+                usart_disable_tx_interrupt(usart);
+                usart_enable_tx_complete_interrupt(usart);
+            }
+        }
+        else if ((cr1 & USART_CR1_TCIE) && (sr & USART_SR_TC))
+        {
+            usart_disable_tx_complete_interrupt(usart);
+            const char* data;
+            if (Ring::pending(data)) // written after the ring was emptied
+            {
+                usart_enable_tx_interrupt(usart);
+            }
+            else
+            {
+                mTxActive = false;
+            }
+        }
+    }
+    /** Waits till all data is sent. Works with interrupts disabled as well,
+     * e.g. before an assertion failure halts the core */
+    virtual void flush()
+    {
+        while (mTxActive)
+        {
+            IntrDisable noIntr;
+            usartTxIsr();
+        }
+    }
+};
+
+/** @brief Print sink that sends its ring buffer by the USART TXE interrupt.
+ * Logging returns as soon as the message is copied into the ring. When the
+ * ring is full, the caller waits for the interrupt to free space.
+ * The USART interrupt handler must call \c usartTxIsr()
+ */
+template <class UsartDevice, size_t Size=256>
+class RingPrintSink: public IntrTx<UsartDevice, Size>
+{
+protected:
+    typedef IntrTx<UsartDevice, Size> Base;
+    virtual bool waitForSpace()
+    {
+        if (!Base::mTxActive)
+        {
+            return false; // nothing to wait for, the message is larger than the ring
+        }
+        size_t readPos = Base::mReadPos;
+        while (Base::mTxActive && Base::mReadPos == readPos)
+        {
+            if (cm_is_masked_interrupts())
+            {
+                Base::usartTxIsr(); // e.g. logging from an interrupt
+            }
+            STM32PP_BUSY_WAIT();
+        }
+        return true;
+    }
+};
 }
 
 #endif
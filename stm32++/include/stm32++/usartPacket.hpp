@@ -0,0 +1,124 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_USART_PACKET_HPP
+#define STM32PP_USART_PACKET_HPP
+
+#include "usart.hpp"
+#include "cobs.hpp"
+
+namespace nsusart
+{
+/** @brief Transport of COBS-framed packets over a USART, with DMA in both
+ * directions. See \c cobs.hpp for the framing.
+ * Sending is zero-copy: the packet is written directly into one of two transmit
+ * buffers, returned by \c txPayload(), and \c send() appends the CRC, encodes
+ * it in place and starts the DMA. The next packet is written into the other
+ * buffer, while the previous one is being sent, so that packets go out back to
+ * back. \c send() waits only if the previous packet has not been sent yet.
+ * Receiving runs continuously into the circular buffer of \c DmaRxRing, and
+ * \c poll() decodes the data received so far, calling the receive callback for
+ * each complete packet. \c poll() must be called often enough, so that the
+ * buffer doesn't overrun, see \c rxOverrunBytes().
+ * The DMA Tx and Rx interrupts, and the USART interrupt must be forwarded to
+ * \c dmaTxIsr(), \c dmaRxIsr() and \c usartRxIsr():
+ * \code
+ * typedef nsusart::PacketTransport<nsusart::Usart<USART1>, 64> Link;
+ * Link link;
+ * extern "C" void dma1_channel4_isr() { link.dmaTxIsr(); }
+ * extern "C" void dma1_channel5_isr() { link.dmaRxIsr(); }
+ * extern "C" void usart1_isr() { link.usartRxIsr(); }
+ * ...
+ * link.init(nsusart::kOptEnableTx | nsusart::kOptEnableRx, 2000000);
+ * link.start(onPacket, nullptr);
+ * for (;;)
+ * {
+ *     auto frame = (SensorFrame*)link.txPayload();
+ *     ...fill in frame...
+ *     link.send(sizeof(SensorFrame));
+ *     link.poll();
+ * }
+ * \endcode
+ */
+template <class UsartDevice, size_t MaxPacket=256, uint16_t RxBufSize=512, bool Crc=true>
+class PacketTransport: public DmaRxRing<dma::Tx<UsartDevice>>
+{
+public:
+    typedef cobs::Decoder<MaxPacket, Crc> Decoder;
+    typedef typename Decoder::Callback RecvCallback;
+    enum: size_t
+    {
+        kCrcSize = Decoder::kCrcSize,
+        kTxBufSize = cobs::maxEncodedSize(MaxPacket + kCrcSize)
+    };
+protected:
+    typedef DmaRxRing<dma::Tx<UsartDevice>> Base;
+    uint8_t mTxBufs[2][kTxBufSize];
+    uint8_t mTxBufIdx = 0;
+    uint8_t mRxBuf[RxBufSize];
+    Decoder mDecoder;
+    uint32_t mRxOverrunBytes = 0;
+public:
+    /** Starts the reception. \c cb is called from \c poll() */
+    void start(RecvCallback cb, void* userp)
+    {
+        mDecoder.setCallback(cb, userp);
+        mDecoder.reset();
+        mRxOverrunBytes = 0;
+        Base::rxRingStart(mRxBuf, sizeof(mRxBuf));
+    }
+    void stop()
+    {
+        Base::rxRingStop();
+    }
+    /** The buffer where the next packet to send is written, of \c MaxPacket bytes.
+     * It's not being sent, so can be written at any time */
+    uint8_t* txPayload() { return mTxBufs[mTxBufIdx] + 1; }
+    /** Sends the \c len bytes written to \c txPayload(). Waits if the previous
+     * packet is still being sent */
+    void send(size_t len)
+    {
+        xassert(len <= MaxPacket);
+        uint8_t* buf = mTxBufs[mTxBufIdx];
+        if (Crc)
+        {
+            uint16_t crc = cobs::crc16(buf + 1, len);
+            buf[1 + len] = crc >> 8;
+            buf[2 + len] = crc & 0xff;
+            len += kCrcSize;
+        }
+        size_t encodedLen = cobs::encodeInPlace(buf, len);
+        Base::dmaTxStart(buf, encodedLen);
+        mTxBufIdx ^= 1;
+    }
+    /** Copies the packet to the transmit buffer and sends it */
+    void send(const void* data, size_t len)
+    {
+        xassert(len <= MaxPacket);
+        memcpy(txPayload(), data, len);
+        send(len);
+    }
+    /** Decodes the received data, and calls the receive callback for each
+     * complete packet. Returns immediately if nothing was received */
+    void poll()
+    {
+        uint8_t chunk[64];
+        size_t len;
+        while ((len = Base::read(chunk, sizeof(chunk))) != 0)
+        {
+            uint32_t overrun = Base::rxOverrunBytes();
+            if (overrun != mRxOverrunBytes) // the data continues in the middle of a packet
+            {
+                mRxOverrunBytes = overrun;
+                mDecoder.resync();
+            }
+            mDecoder.feed(chunk, len);
+        }
+    }
+    const Decoder& decoder() const { return mDecoder; }
+};
+}
+
+#endif
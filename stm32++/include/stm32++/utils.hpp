@@ -20,7 +20,7 @@ struct HighestBitIdx { enum: uint8_t { value = 1 + HighestBitIdx<(val >> 1)>::va
 template<>
 struct HighestBitIdx<0> { enum: uint8_t { value = 0 }; };
 
-#ifndef STM32PP_NOT_EMBEDDED
+#if !defined(STM32PP_NOT_EMBEDDED) || defined(STM32PP_SIM)
 #include <libopencm3/cm3/cortex.h>
 
 /** @brief Scoped global disable of interrupts */
@@ -41,6 +41,21 @@ public:
             cm_enable_interrupts();
     }
 };
+#else
+/** No interrupts in the desktop emulation. The constructor and destructor are
+ * user-provided, so that the scoped guards don't warn as unused variables */
+struct IntrDisable
+{
+    IntrDisable() {}
+    ~IntrDisable() {}
+};
+#endif
 
+/** Body of the loops that wait for a variable to be changed by an interrupt.
+ * In the simulator, it lets the simulated hardware run until its next event */
+#ifdef STM32PP_SIM
+    #define STM32PP_BUSY_WAIT() sim::busyWait()
+#else
+    #define STM32PP_BUSY_WAIT()
 #endif
 #endif // UTILS_HPP
@@ -14,6 +14,9 @@
             tprintf("assert(%)\n", expr);
         }
         tprintf("at %:%\n========\n", file, line);
+        // output what a buffering sink holds, before halting
+        extern IPrintSink* gPrintSink;
+        gPrintSink->flush();
 
 #ifdef STM32PP_NOT_EMBEDDED
         abort();
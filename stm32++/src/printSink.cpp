@@ -1,10 +1,13 @@
 #include <stm32++/printSink.hpp>
 #ifdef STM32PP_LOG_VIA_SEMIHOSTING
-    #include <stm32++/semihosting.hpp>
+    #include <stm32++/semihostingPrint.hpp>
 #else
     #include <unistd.h>
 #endif
 
+#if defined(STM32PP_LOG_VIA_SEMIHOSTING) && STM32PP_SEMIHOSTING_BUF_SIZE
+typedef shost::BufferedPrintSink<STM32PP_SEMIHOSTING_BUF_SIZE> DefaultPrintSink;
+#else
 struct DefaultPrintSink: public IPrintSink
 {
     IPrintSink::BufferInfo* waitReady() { return nullptr; }
@@ -17,6 +20,11 @@ struct DefaultPrintSink: public IPrintSink
 #endif
     }
 };
+#endif
 
 DefaultPrintSink gDefaultPrintSink;
 IPrintSink* gPrintSink = &gDefaultPrintSink;
+
+#ifdef STM32PP_PRINT_BUF_POOL
+DefaultPrintBufPool gPrintBufPool;
+#endif
@@ -11,6 +11,8 @@ static_assert(sizeof(size_t) == sizeof(void*), "");
 namespace shost
 {
 
+// In a host build, the program provides a stand-in for bkpt()
+#ifndef STM32PP_NOT_EMBEDDED
 /** Single-argument wrapper for the BKPT instruction. Note that some commands
  * use a second argument in r2
  */
@@ -28,6 +30,7 @@ size_t bkpt(size_t cmd, size_t arg1)
     );
     return ret;
 }
+#endif
 
 void write(const void* buf, size_t bufsize, int fd)
 {
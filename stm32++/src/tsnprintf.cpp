@@ -1,4 +1,5 @@
 #include <stddef.h> // for size_t
+#include <string.h>
 #include <assert.h>
 
 // Trivial case for the tsnprintf recursion.
@@ -21,3 +22,340 @@ char* tsnprintf(char* buf, size_t bufsize, const char* fmtStr)
     *buf = 0;
     return buf;
 }
+
+// Trivial case for the tformattedLength recursion
+size_t tformattedLength(const char* fmtStr)
+{
+    return strlen(fmtStr);
+}
+
+#ifdef STM32PP_TSNPRINTF_TYPE_ERASED
+#include <stm32++/fmtArg.hpp>
+
+// The type-erased formatting core. Everything here takes the formatting
+// options at runtime, so there is a single copy of it in the firmware
+
+template <typename Val>
+static char* putPow2DigitsReverse(char* end, Val val, uint8_t bits, char hexA)
+{
+    Val mask = ((Val)1 << bits) - 1;
+    do
+    {
+        uint8_t digit = val & mask;
+        *(--end) = (digit < 10) ? '0' + digit : hexA + (digit - 10);
+        val >>= bits;
+    } while(val);
+    return end;
+}
+
+static uint8_t bitsForBase(uint8_t base)
+{
+    return (base == 16) ? 4 : ((base == 8) ? 3 : 1);
+}
+
+static uint8_t prefixLenForBase(uint8_t base)
+{
+    return (base == 10) ? 0 : ((base == 8) ? 3 : 2);
+}
+
+static char* putDigitsReverse(char* end, uint64_t val, uint8_t base, Flags flags)
+{
+    bool is32 = (val >> 32) == 0;
+    if (base == 10)
+    {
+        return is32 ? putDecDigitsReverse(end, (uint32_t)val) : putDecDigitsReverse(end, val);
+    }
+    uint8_t bits = bitsForBase(base);
+    char hexA = (flags & kUpperCase) ? 'A' : 'a';
+    return is32 ? putPow2DigitsReverse(end, (uint32_t)val, bits, hexA)
+                : putPow2DigitsReverse(end, val, bits, hexA);
+}
+
+static uint8_t countDigits(uint64_t val, uint8_t base)
+{
+    if (base == 10)
+    {
+        return ((val >> 32) == 0) ? countDecDigits((uint32_t)val) : countDecDigits(val);
+    }
+    if (!val)
+        return 1;
+    uint8_t bits = bitsForBase(base);
+    return (64 - __builtin_clzll(val) + bits - 1) / bits;
+}
+
+// Same as toString<kDontNullTerminate>() for integers
+static char* intToString(char* buf, size_t bufsize, uint64_t val, bool negative,
+    Flags flags, uint8_t minDigits, uint8_t minLen)
+{
+    if (negative)
+    {
+        if (bufsize < 2)
+        {
+            if (bufsize) {
+                *buf = 0;
+            }
+            return nullptr;
+        }
+        *(buf++) = '-';
+        bufsize--;
+    }
+    if (bufsize < minLen) {
+        *buf = 0;
+        return nullptr;
+    }
+    uint8_t base = baseFromFlags(flags);
+    char stagingBuf[64];
+    char* stagingEnd = stagingBuf + sizeof(stagingBuf);
+    char* digits = putDigitsReverse(stagingEnd, val, base, flags);
+    size_t numDigits = stagingEnd - digits;
+    size_t padLen = (numDigits < minDigits) ? minDigits - numDigits : 0;
+    size_t prefixLen = (flags & kNumPrefix) ? prefixLenForBase(base) : 0;
+    size_t totalLen = prefixLen + padLen + numDigits;
+    if (bufsize < totalLen)
+    {
+        *buf = 0;
+        return nullptr;
+    }
+    if (prefixLen)
+    {
+        if (base == 8)
+        {
+            memcpy(buf, "OCT", 3);
+        }
+        else
+        {
+            buf[0] = '0';
+            buf[1] = (base == 16) ? 'x' : 'b';
+        }
+        buf += prefixLen;
+    }
+    for (; totalLen < minLen; totalLen++)
+    {
+        *(buf++) = ' ';
+    }
+    for (; padLen; padLen--)
+    {
+        *(buf++) = '0';
+    }
+    memcpy(buf, digits, numDigits);
+    return buf + numDigits;
+}
+
+static size_t intLen(uint64_t val, bool negative, Flags flags, uint8_t minDigits, uint8_t minLen)
+{
+    uint8_t base = baseFromFlags(flags);
+    size_t len = countDigits(val, base);
+    if (len < minDigits)
+    {
+        len = minDigits;
+    }
+    if (flags & kNumPrefix)
+    {
+        len += prefixLenForBase(base);
+    }
+    return negative + ((len < minLen) ? minLen : len);
+}
+
+// Extracts the absolute value of an integer argument
+static uint64_t intArgAbs(const FmtArg& arg, bool& negative)
+{
+    switch (arg.type)
+    {
+        case FmtArg::kI32:
+            return absUnsigned((int32_t)arg.u32, negative);
+        case FmtArg::kI64:
+            return absUnsigned((int64_t)arg.u64, negative);
+        case FmtArg::kU32:
+            negative = false;
+            return arg.u32;
+        default:
+            negative = false;
+            return arg.u64;
+    }
+}
+
+static void fpArgToDecimal(const FmtArg& arg, FpDecimal& dec)
+{
+    uint8_t prec = precFromFlags(arg.num.flags);
+    if (arg.type == FmtArg::kFloat)
+    {
+        fpToDecimal(arg.f32, prec, arg.num.flags, dec);
+    }
+    else
+    {
+        fpToDecimal(arg.f64, prec, arg.num.flags, dec);
+    }
+}
+
+// Converts kQ and kScaled arguments
+static void fixedArgToDecimal(const FmtArg& arg, FpDecimal& dec)
+{
+    if ((arg.type & FmtArg::kTypeMask) == FmtArg::kQ)
+    {
+        qAbsToDecimal(arg.u64, arg.fracBits, arg.prec, dec);
+    }
+    else
+    {
+        scaledAbsToDecimal(arg.u64, arg.divisor, arg.prec, dec);
+    }
+    dec.negative = (arg.type & FmtArg::kNegative) != 0;
+}
+
+char* fmtArgToString(char* buf, size_t bufsize, const FmtArg& arg)
+{
+    switch (arg.type & FmtArg::kTypeMask)
+    {
+        case FmtArg::kU32:
+        case FmtArg::kI32:
+        case FmtArg::kU64:
+        case FmtArg::kI64:
+        {
+            bool negative;
+            uint64_t val = intArgAbs(arg, negative);
+            return intToString(buf, bufsize, val, negative,
+                arg.num.flags, arg.num.minDigits, arg.num.minLen);
+        }
+        case FmtArg::kChar:
+            if (!bufsize)
+                return nullptr;
+            *(buf++) = arg.u32;
+            return buf;
+        case FmtArg::kStr:
+            return toString<kDontNullTerminate>(buf, bufsize, arg.str);
+        case FmtArg::kFloat:
+        case FmtArg::kDouble:
+        {
+            FpDecimal dec;
+            fpArgToDecimal(arg, dec);
+            uint8_t prec = precFromFlags(arg.num.flags);
+            return (arg.num.flags & kUpperCase)
+                ? fpDecToString<kDontNullTerminate|kUpperCase>(buf, bufsize, dec, prec,
+                    arg.num.minDigits, arg.num.minLen)
+                : fpDecToString<kDontNullTerminate>(buf, bufsize, dec, prec,
+                    arg.num.minDigits, arg.num.minLen);
+        }
+        case FmtArg::kRptChar:
+            return toString<kDontNullTerminate>(buf, bufsize, RptChar<>(arg.u32, arg.count));
+        default:
+        {
+            FpDecimal dec;
+            fixedArgToDecimal(arg, dec);
+            return fixedDecToString<kDontNullTerminate>(buf, bufsize, dec, arg.prec);
+        }
+    }
+}
+
+size_t fmtArgLen(const FmtArg& arg)
+{
+    switch (arg.type & FmtArg::kTypeMask)
+    {
+        case FmtArg::kU32:
+        case FmtArg::kI32:
+        case FmtArg::kU64:
+        case FmtArg::kI64:
+        {
+            bool negative;
+            uint64_t val = intArgAbs(arg, negative);
+            return intLen(val, negative, arg.num.flags, arg.num.minDigits, arg.num.minLen);
+        }
+        case FmtArg::kChar:
+            return 1;
+        case FmtArg::kStr:
+            return strlen(arg.str);
+        case FmtArg::kFloat:
+        case FmtArg::kDouble:
+        {
+            FpDecimal dec;
+            fpArgToDecimal(arg, dec);
+            return fpDecLen(dec, precFromFlags(arg.num.flags), arg.num.minDigits, arg.num.minLen);
+        }
+        case FmtArg::kRptChar:
+            return arg.count;
+        default:
+        {
+            FpDecimal dec;
+            fixedArgToDecimal(arg, dec);
+            return fixedDecLen(dec, arg.prec);
+        }
+    }
+}
+
+char* vtsnprintf(char* buf, size_t bufsize, const char* fmtStr, const FmtArg* args, uint8_t numArgs)
+{
+    assert(buf);
+    assert(bufsize);
+
+    char* bufend = buf+bufsize-1; //point to last char
+    const FmtArg* argsEnd = args + numArgs;
+    for (; args < argsEnd; args++)
+    {
+        for (;;)
+        {
+            char ch = *fmtStr++;
+            if (ch == '%')
+            {
+                break;
+            }
+            else if (ch == 0)
+            {
+                *buf = 0;
+                return buf;
+            }
+            *(buf++) = ch;
+            if (buf >= bufend)
+            {
+                // reached the end of the buffer before the end of the format string
+                assert(buf == bufend);
+                *bufend = 0;
+                return nullptr;
+            }
+        }
+        // See the recursive tsnprintf() for the return value semantics of toString()
+        char* valEnd = fmtArgToString(buf, bufend-buf+1, *args);
+        if (!valEnd)
+        {
+            *buf = 0;
+            return nullptr;
+        }
+        if (valEnd >= bufend)
+        {
+            if (valEnd == bufend)
+            {
+                *bufend = 0;
+                // fits exactly, but only if nothing follows
+                return *fmtStr ? nullptr : bufend;
+            }
+            // the value fit, but the terminator didn't
+            assert(valEnd - bufend == 1);
+            *buf = 0;
+            return nullptr;
+        }
+        buf = valEnd;
+    }
+    return tsnprintf(buf, bufend-buf+1, fmtStr);
+}
+
+size_t vtformattedLength(const char* fmtStr, const FmtArg* args, uint8_t numArgs)
+{
+    size_t len = 0;
+    const FmtArg* argsEnd = args + numArgs;
+    for (; args < argsEnd; args++)
+    {
+        for (;;)
+        {
+            char ch = *fmtStr++;
+            if (ch == '%')
+            {
+                break;
+            }
+            else if (ch == 0)
+            {
+                return len;
+            }
+            len++;
+        }
+        len += fmtArgLen(*args);
+    }
+    return len + strlen(fmtStr);
+}
+#endif
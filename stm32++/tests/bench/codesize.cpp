@@ -0,0 +1,27 @@
+/**
+ * A set of tprintf() call sites with different argument type combinations,
+ * typical for firmware logging. Compiled once with each tsnprintf() backend,
+ * to compare the code size - see the codesize target
+ */
+#include <stm32++/tprintf.hpp>
+
+void logCalls(uint32_t u32, int32_t i32, uint64_t u64, int16_t i16, uint8_t u8,
+    float f, double d, const char* str, void* ptr)
+{
+    tprintf("init: %\n", str);
+    tprintf("reg % = %\n", u8, fmtHex8(u8));
+    tprintf("adc: % % %\n", u32, i32, i16);
+    tprintf("temp: %, press: %\n", fmtScaled<100>(i32), fmtScaled<100>(u32));
+    tprintf("timestamp: %us\n", u64);
+    tprintf("ptr: % size: %\n", ptr, u32);
+    tprintf("float: % double: %\n", f, d);
+    tprintf("sci: % auto: %\n", fmtSci<4>(d), fmtFpAuto(f));
+    tprintf("q15: %, q31: %\n", fmtQ<15>(i16), fmtQ<31>(i32));
+    tprintf("status: % %\n", fmtBin8(u8), fmtHex32(u32));
+    tprintf("%: % bytes, % errors, last %\n", str, u32, u8, i32);
+    tprintf("%%\n", rptChar('-', u8), str);
+    tprintf("dma ch % cnt % addr %\n", u8, (uint16_t)u32, ptr);
+    tprintf("fp padded: [%]\n", fmtFp<2>(d, 4, 10));
+    tprintf("i2c: addr %, reg %, val %\n", fmtHex<kNumPrefix>(u8), u8, fmtHex16((uint16_t)i16));
+    tprintf("mixed: % % % % %\n", str, u64, f, fmtHex(u32), (char)u8);
+}
@@ -0,0 +1,75 @@
+#include "corpus.hpp"
+#ifdef STM32PP_NOT_EMBEDDED
+    #include <stdio.h>
+    #include <inttypes.h>
+#endif
+
+BenchValues gBenchValues;
+NullPrintSink gNullPrintSink;
+
+void benchInitValues()
+{
+    uint32_t state = 12345;
+    auto next = [&state]()
+    {
+        state = state * 1664525 + 1013904223;
+        return state;
+    };
+    for (uint16_t i = 0; i < kCorpusSize; i++)
+    {
+        // spread the values over all magnitudes
+        gBenchValues.i32[i] = (int32_t)next() >> (next() % 31);
+        gBenchValues.u32[i] = next() >> (next() % 32);
+        gBenchValues.u64[i] = (((uint64_t)next() << 32) | next()) >> (next() % 64);
+        gBenchValues.f32[i] = (float)((int32_t)next() >> 8) / (1 << (next() % 20));
+        gBenchValues.f64[i] = (double)(int32_t)next() * (1 << (next() % 16)) / (1 << (next() % 24));
+    }
+}
+
+#define V(type) gBenchValues.type[idx]
+
+#define EXPAND(...) __VA_ARGS__
+
+/** \c args and \c refArgs are the parenthesized arguments after the buffer,
+ * of tsnprintf() and snprintf() respectively */
+#define BENCH_CASE(name, args)                                          \
+    { name, [](char* buf, size_t bufsize, uint16_t idx) -> size_t       \
+        { return tsnprintf(buf, bufsize, EXPAND args) - buf; },         \
+      nullptr }
+
+#ifdef STM32PP_NOT_EMBEDDED
+    #define REF_CASE(name, args, refArgs)                               \
+        { name, [](char* buf, size_t bufsize, uint16_t idx) -> size_t   \
+            { return tsnprintf(buf, bufsize, EXPAND args) - buf; },     \
+          [](char* buf, size_t bufsize, uint16_t idx) -> size_t         \
+            { return snprintf(buf, bufsize, EXPAND refArgs); } }
+#else
+    #define REF_CASE(name, args, refArgs) BENCH_CASE(name, args)
+#endif
+
+const BenchCase gBenchCases[] = {
+    REF_CASE("int32", ("%", V(i32)), ("%" PRId32, V(i32))),
+    REF_CASE("uint64", ("%", V(u64)), ("%" PRIu64, V(u64))),
+    REF_CASE("hex uint32", ("%", fmtHex(V(u32))), ("%" PRIx32, V(u32))),
+    REF_CASE("hex32 padded", ("%", fmtHex32(V(u32))), ("%08" PRIx32, V(u32))),
+    BENCH_CASE("bin16", ("%", fmtBin16((uint16_t)V(u32)))),
+    REF_CASE("float prec 3", ("%", fmtFp<3>(V(f32))), ("%.3f", V(f32))),
+    REF_CASE("double prec 6", ("%", V(f64)), ("%f", V(f64))),
+    REF_CASE("double sci", ("%", fmtSci(V(f64))), ("%e", V(f64))),
+    REF_CASE("scaled /100", ("%", fmtScaled<100>(V(i32))), ("%.2f", V(i32) / 100.0)),
+    REF_CASE("mixed 5 args",
+        ("id %: temp %C, press % mbar, status %, name %", V(u32) % 1000,
+         fmtScaled<100>(V(i32) % 10000), fmtFp<2>(V(f32)), fmtHex8(V(u32) & 0xff), "sensor"),
+        ("id %" PRIu32 ": temp %.2fC, press %.2f mbar, status %02" PRIx32 ", name %s", V(u32) % 1000,
+         (V(i32) % 10000) / 100.0, V(f32), V(u32) & 0xff, "sensor")),
+    { "tprintf mixed, null sink", [](char*, size_t, uint16_t idx) -> size_t
+        {
+            auto prev = setPrintSink(&gNullPrintSink);
+            size_t ret = tprintf("id %: temp %C, press % mbar, status %, name %\n", V(u32) % 1000,
+                fmtScaled<100>(V(i32) % 10000), fmtFp<2>(V(f32)), fmtHex8(V(u32) & 0xff), "sensor");
+            setPrintSink(prev);
+            return ret;
+        }, nullptr }
+};
+
+const uint8_t gNumBenchCases = sizeof(gBenchCases) / sizeof(gBenchCases[0]);
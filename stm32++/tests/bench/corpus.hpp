@@ -0,0 +1,70 @@
+/**
+ * Fixed corpus of formatting calls, shared by the host benchmark (format-bench)
+ * and the target benchmark (target/). The values are generated by a deterministic
+ * integer generator, so that both run exactly the same calls
+ */
+#ifndef BENCH_CORPUS_HPP
+#define BENCH_CORPUS_HPP
+
+#include <stm32++/tprintf.hpp>
+
+enum: uint16_t { kCorpusSize = 64 };
+
+struct BenchValues
+{
+    int32_t i32[kCorpusSize];
+    uint32_t u32[kCorpusSize];
+    uint64_t u64[kCorpusSize];
+    float f32[kCorpusSize];
+    double f64[kCorpusSize];
+};
+extern BenchValues gBenchValues;
+void benchInitValues();
+
+typedef size_t(*BenchFunc)(char* buf, size_t bufsize, uint16_t idx);
+struct BenchCase
+{
+    const char* name;
+    BenchFunc func;
+    /** The snprintf() counterpart of \c func, if there is one. Used only on the host */
+    BenchFunc reference;
+};
+extern const BenchCase gBenchCases[];
+extern const uint8_t gNumBenchCases;
+
+/** Spaces that align the results after the case name */
+static inline RptChar<> benchPad(const char* name)
+{
+    size_t len = strlen(name);
+    return rptChar(' ', len < 26 ? 26 - len : 0);
+}
+
+/** Print sink that discards the output, to measure the tprintf() overhead
+ * without the actual output */
+struct NullPrintSink: public IPrintSink
+{
+    BufferInfo* waitReady() { return nullptr; }
+    void print(const char*, size_t, int) {}
+};
+extern NullPrintSink gNullPrintSink;
+
+/** Calls \c func with each value of the corpus \c rounds times, and returns the
+ * elapsed time. \c Clock::now() returns a timestamp in arbitrary units
+ */
+template <class Clock>
+typename Clock::Time benchRun(BenchFunc func, uint16_t rounds)
+{
+    char buf[96];
+    volatile size_t sink = 0;
+    auto start = Clock::now();
+    for (uint16_t round = 0; round < rounds; round++)
+    {
+        for (uint16_t i = 0; i < kCorpusSize; i++)
+        {
+            sink += func(buf, sizeof(buf), i);
+        }
+    }
+    return Clock::now() - start;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * Host half of the formatting benchmark: runs the corpus in corpus.cpp and
+ * reports ns/call, compared to the snprintf() equivalent of each call.
+ * The target half is in target/
+ */
+#include "corpus.hpp"
+#include <chrono>
+#include <stdio.h>
+
+struct SteadyClock
+{
+    typedef int64_t Time;
+    static Time now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+enum: uint16_t { kRounds = 2000 };
+enum: uint32_t { kCalls = (uint32_t)kRounds * kCorpusSize };
+
+int main()
+{
+    benchInitValues();
+    char sample[96];
+    for (uint8_t i = 0; i < gNumBenchCases; i++)
+    {
+        auto& bc = gBenchCases[i];
+        benchRun<SteadyClock>(bc.func, kRounds / 10); // warm up
+        // best of 3, to filter out scheduling noise
+        int64_t best = INT64_MAX, bestRef = INT64_MAX;
+        for (int n = 0; n < 3; n++)
+        {
+            auto time = benchRun<SteadyClock>(bc.func, kRounds);
+            if (time < best)
+                best = time;
+            if (bc.reference)
+            {
+                time = benchRun<SteadyClock>(bc.reference, kRounds);
+                if (time < bestRef)
+                    bestRef = time;
+            }
+        }
+        double ns = (double)best / kCalls;
+        if (bc.reference)
+        {
+            double refNs = (double)bestRef / kCalls;
+            tprintf("%:% % ns/call, snprintf: % ns/call (x%)\n", bc.name, benchPad(bc.name),
+                fmtFp<1>(ns, 0, 7), fmtFp<1>(refNs, 0, 7), fmtFp<2>(refNs / ns));
+        }
+        else
+        {
+            tprintf("%:% % ns/call\n", bc.name, benchPad(bc.name), fmtFp<1>(ns, 0, 7));
+        }
+        // show what is being formatted
+        sample[0] = 0;
+        bc.func(sample, sizeof(sample), 0);
+        if (!sample[0])
+        {
+            continue; // doesn't output to the buffer
+        }
+        if (bc.reference)
+        {
+            char ref[96];
+            bc.reference(ref, sizeof(ref), 0);
+            tprintf("    \"%\" / \"%\"\n", sample, ref);
+        }
+        else
+        {
+            tprintf("    \"%\"\n", sample);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,302 @@
+/**
+ * Host benchmarks for the formatting functions:
+ * - Integer toString() conversion. Compares the digit pair table / shift-and-mask
+ *   implementation with the previous one-digit-per-division loop, and verifies
+ *   that both produce identical output
+ * - ftprintf() of long lines, with the exact length pre-calculation, compared
+ *   to the previous guess-and-grow buffer allocation
+ * - Floating point toString(), integer-only engine compared to the previous
+ *   floating point arithmetic implementation. Note that on the host, floating
+ *   point is done in hardware, so the gain is much smaller than on a soft-float MCU
+ * - The recursive tsnprintf() compared to the type-erased formatting core,
+ *   including verification that both produce identical output
+ */
+#include <stm32++/tprintf.hpp>
+#include <stm32++/fmtArg.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    static inline uint64_t cycles() { return __rdtsc(); }
+#else
+    static inline uint64_t cycles() { return 0; }
+#endif
+
+/** The previous implementation of the digit generation loop, kept as a reference */
+template<Flags flags=10, typename Val>
+char* legacyToString(char* buf, size_t bufsize, Val val)
+{
+    enum: uint8_t { base = baseFromFlags(flags) };
+    DigitConverter<base, flags> digitConv;
+    char stagingBuf[digitConv.digitsPerByte * sizeof(Val)];
+    char* writePtr = stagingBuf;
+    do
+    {
+        Val digit = val % base;
+        *(writePtr++) = digitConv.toDigit(digit);
+        val /= base;
+    } while(val);
+
+    size_t numDigits = writePtr - stagingBuf;
+    if (bufsize <= numDigits)
+    {
+        *buf = 0;
+        return nullptr;
+    }
+    do
+    {
+        *(buf++) = *(--writePtr);
+    } while(writePtr > stagingBuf);
+    *buf = 0;
+    return buf;
+}
+
+/** The previous floating point conversion, kept as a reference. Doesn't handle
+ * values that don't fit in size_t */
+template <uint8_t prec, typename Val>
+char* legacyFpToString(char* buf, size_t bufsize, Val val)
+{
+    if (val < 0)
+    {
+        *(buf++) = '-';
+        val = -val;
+    }
+    size_t whole = (size_t)(val);
+    enum: uint32_t { mult = Pow<10, prec>::value };
+    size_t fractional = (val - whole) * mult + 0.5;
+    if (fractional >= mult)
+    {
+        whole++;
+        fractional -= mult;
+    }
+    buf = toString<kDontNullTerminate|10>(buf, bufsize - 1, whole);
+    *(buf++) = '.';
+    return toString<10>(buf, bufsize, fractional, prec);
+}
+
+/** The previous buffer allocation strategy of ftprintf() for synchronous sinks -
+ * start with a 64-byte stack buffer and grow it by 128 bytes until the message fits
+ */
+template <int InitialBufSize=64, typename... Args>
+size_t legacyFtprintf(uint8_t fd, const char* fmtStr, Args... args)
+{
+    extern IPrintSink* gPrintSink;
+    char* staticBuf = (char*)alloca(InitialBufSize);
+    char* buf = staticBuf;
+    size_t bufsize = InitialBufSize;
+    char* ret;
+    for(;;)
+    {
+        ret = tsnprintf(buf, bufsize, fmtStr, args...);
+        if (ret)
+        {
+            break;
+        }
+        bufsize += 128;
+        buf = (buf == staticBuf)
+            ? (char*)malloc(bufsize)
+            : (char*)realloc(buf, bufsize);
+    }
+    size_t size = ret-buf;
+    gPrintSink->print(buf, size, fd);
+    if (buf != staticBuf)
+    {
+        free(buf);
+    }
+    return size;
+}
+
+struct NullPrintSink: public IPrintSink
+{
+    BufferInfo* waitReady() { return nullptr; }
+    void print(const char* str, size_t len, int fd) {}
+};
+NullPrintSink gNullPrintSink;
+extern IPrintSink* gPrintSink;
+
+enum { kNumValues = 4096, kRounds = 200 };
+uint64_t gValues[kNumValues];
+double gFpValues[kNumValues];
+volatile size_t gSink;
+int gFails = 0;
+
+uint64_t rand64()
+{
+    uint64_t val = ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ rand();
+    // spread the values over all magnitudes
+    return val >> (rand() % 64);
+}
+
+template <Flags flags, typename Val>
+void verify(const char* name)
+{
+    char buf1[80], buf2[80];
+    for (auto val: gValues)
+    {
+        toString<flags>(buf1, sizeof(buf1), (Val)val);
+        legacyToString<flags>(buf2, sizeof(buf2), (Val)val);
+        if (strcmp(buf1, buf2))
+        {
+            printf("MISMATCH %s: '%s' != '%s'\n", name, buf1, buf2);
+            gFails++;
+            return;
+        }
+    }
+}
+
+template <class F, class V=uint64_t>
+void measure(const char* name, F func, V* values=gValues)
+{
+    char buf[80];
+    auto start = std::chrono::steady_clock::now();
+    uint64_t startCycles = cycles();
+    for (int round = 0; round < kRounds; round++)
+    {
+        for (int i = 0; i < kNumValues; i++)
+        {
+            auto val = values[i];
+            gSink += (size_t)func(buf, val);
+        }
+    }
+    uint64_t elapsedCycles = cycles() - startCycles;
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double calls = (double)kNumValues * kRounds;
+    printf("%-32s %8.2f ns/call %8.1f cycles/call\n", name,
+        std::chrono::duration<double, std::nano>(elapsed).count() / calls,
+        elapsedCycles / calls);
+}
+
+/** Calls the type-erased core directly, regardless of the backend that
+ * tsnprintf() is configured to use */
+template <typename... Args>
+char* erasedTsnprintf(char* buf, size_t bufsize, const char* fmtStr, Args... args)
+{
+    const FmtArg packed[] = { toFmtArg(args)... };
+    return vtsnprintf(buf, bufsize, fmtStr, packed, sizeof...(Args));
+}
+
+template <typename... Args>
+size_t erasedFormattedLength(const char* fmtStr, Args... args)
+{
+    const FmtArg packed[] = { toFmtArg(args)... };
+    return vtformattedLength(fmtStr, packed, sizeof...(Args));
+}
+
+/** Compares the output of both backends for all buffer sizes, including too small ones */
+template <typename... Args>
+void verifyErased(const char* fmtStr, Args... args)
+{
+    char buf1[300], buf2[300];
+    size_t len = tformattedLength(fmtStr, args...);
+    if (erasedFormattedLength(fmtStr, args...) != len)
+    {
+        printf("MISMATCH erased length: %zu != %zu, format '%s'\n",
+            erasedFormattedLength(fmtStr, args...), len, fmtStr);
+        gFails++;
+        return;
+    }
+    for (size_t bufsize = 2; bufsize < len + 3 && bufsize <= sizeof(buf1); bufsize++)
+    {
+        memset(buf1, 0x55, sizeof(buf1));
+        memset(buf2, 0x55, sizeof(buf2));
+        char* ret1 = tsnprintf(buf1, bufsize, fmtStr, args...);
+        char* ret2 = erasedTsnprintf(buf2, bufsize, fmtStr, args...);
+        if ((ret1 ? ret1 - buf1 : -1) != (ret2 ? ret2 - buf2 : -1)
+            || strcmp(buf1, buf2))
+        {
+            printf("MISMATCH erased tsnprintf, bufsize %zu: '%s' != '%s'\n", bufsize, buf2, buf1);
+            gFails++;
+            return;
+        }
+    }
+}
+
+void verifyErasedAll()
+{
+    for (int i = 0; i < 2000; i++)
+    {
+        uint64_t val = gValues[i];
+        double fp = gFpValues[i] * ((i & 1) ? -1 : 1);
+        verifyErased("u32 %, i32 %, u64 %, i64 %", (uint32_t)val, (int32_t)val, val, (int64_t)val);
+        verifyErased("u8 % i8 % u16 % i16 %", (uint8_t)val, (int8_t)val, (uint16_t)val, (int16_t)val);
+        verifyErased("hex % HEX % oct % bin %", fmtHex(val), fmtHex<kUpperCase|kNumPrefix>((uint32_t)val),
+            fmtInt<8|kNumPrefix>((uint16_t)val), fmtBin<kNumPrefix>((uint8_t)val));
+        verifyErased("pad [%] [%] [%]", fmtInt((int32_t)val, i % 12, i % 20),
+            fmtHex((uint16_t)val, i % 6, i % 9), fmtInt((int64_t)val, 3, 25));
+        verifyErased("char % str % ptr % %%", (char)('a' + i % 26), "text", (void*)val, rptChar('=', i % 30));
+        verifyErased("fp % % % %", fp, (float)fp, fmtFp<3>(fp, i % 5, i % 15), fmtFp<1>((float)fp));
+        verifyErased("sci % % auto % %", fmtSci<4>(fp), fmtSci<2|kUpperCase>((float)fp, 12),
+            fmtFpAuto(fp / (1 << (i % 40))), fmtFpAuto<3>((float)fp * 1e6f));
+        verifyErased("q % % % scaled % % %", fmtQ<15>((int16_t)val), fmtQ<31>((int32_t)val, 9),
+            fmtQ<40>((int64_t)val), fmtScaled<100>((int32_t)val), fmtScaled<1000>((uint64_t)val, 2),
+            fmtScaled<3>((int16_t)val, 5));
+    }
+    verifyErased("nan % inf % % extra %%", NAN, INFINITY, -INFINITY, 1);
+    verifyErased("fewer % args", 1, 2, 3);
+}
+
+#define BENCH(name, flags, type)                                              \
+    verify<flags, type>(name);                                                \
+    measure("new    " name, [](char* buf, uint64_t val)                       \
+        { return toString<flags>(buf, 80, (type)val); });                    \
+    measure("legacy " name, [](char* buf, uint64_t val)                       \
+        { return legacyToString<flags>(buf, 80, (type)val); })
+
+int main()
+{
+    srand(1);
+    for (int i = 0; i < kNumValues; i++)
+    {
+        gValues[i] = rand64();
+        // values that the legacy implementation can format - up to 32 bits whole part
+        gFpValues[i] = (double)(gValues[i] >> 20) / (1 << (rand() % 32));
+    }
+    BENCH("dec uint32", 10, uint32_t);
+    BENCH("dec uint64", 10, uint64_t);
+    BENCH("hex uint32", 16, uint32_t);
+    BENCH("hex uint64", 16, uint64_t);
+    BENCH("oct uint32", 8, uint32_t);
+    BENCH("bin uint32", 2, uint32_t);
+    BENCH("bin uint64", 2, uint64_t);
+
+    measure("new    fp double prec 3", [](char* buf, double val)
+        { return toString<3>(buf, 80, val); }, gFpValues);
+    measure("legacy fp double prec 3", [](char* buf, double val)
+        { return legacyFpToString<3>(buf, 80, val); }, gFpValues);
+    measure("new    fp float prec 3", [](char* buf, double val)
+        { return toString<3>(buf, 80, (float)val); }, gFpValues);
+    measure("legacy fp float prec 3", [](char* buf, double val)
+        { return legacyFpToString<3>(buf, 80, (float)val); }, gFpValues);
+    measure("new    fp double sci prec 6", [](char* buf, double val)
+        { return toString<kFpSci|6>(buf, 80, val); }, gFpValues);
+
+    verifyErasedAll();
+    measure("recursive tsnprintf 3 args", [](char* buf, uint64_t val)
+        { return tsnprintf(buf, 80, "value: %, hex: %, text: %", val, fmtHex(val), "abc"); });
+    measure("erased    tsnprintf 3 args", [](char* buf, uint64_t val)
+        { return erasedTsnprintf(buf, 80, "value: %, hex: %, text: %", val, fmtHex(val), "abc"); });
+    measure("recursive tsnprintf 2 fp args", [](char* buf, double val)
+        { return tsnprintf(buf, 80, "temp: %, press: %", fmtFp<2>(val), (float)val); }, gFpValues);
+    measure("erased    tsnprintf 2 fp args", [](char* buf, double val)
+        { return erasedTsnprintf(buf, 80, "temp: %, press: %", fmtFp<2>(val), (float)val); }, gFpValues);
+
+    gPrintSink = &gNullPrintSink;
+    static char line[301];
+    memset(line, 'x', 300);
+    measure("new    ftprintf 40 chars", [](char*, uint64_t val)
+        { return ftprintf(1, "value: %, hex: %, text: %", val, fmtHex(val), "abc"); });
+    measure("legacy ftprintf 40 chars", [](char*, uint64_t val)
+        { return legacyFtprintf(1, "value: %, hex: %, text: %", val, fmtHex(val), "abc"); });
+    measure("new    ftprintf 330 chars", [](char*, uint64_t val)
+        { return ftprintf(1, "value: %, text: %", val, (const char*)line); });
+    measure("legacy ftprintf 330 chars", [](char*, uint64_t val)
+        { return legacyFtprintf(1, "value: %, text: %", val, (const char*)line); });
+    if (gFails)
+    {
+        printf("%d output mismatches\n", gFails);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+/**
+ * Main loop throughput with logging enabled, for each DMA print sink.
+ * The DMA is simulated - a transfer completes after the time it would take
+ * to send it over a UART, and the sink's Tx interrupt handler is called when
+ * the main loop polls the simulated DMA, which it does continuously while it
+ * works. Each main loop iteration does a fixed amount of work and then logs a
+ * burst of messages. The time the main loop is blocked in tprintf() is the
+ * difference from the run without logging
+ */
+#include <stm32++/tprintf.hpp>
+#include <stm32++/dmaPrint.hpp>
+#include <chrono>
+#include <stdio.h>
+
+typedef std::chrono::steady_clock Clock;
+
+enum: uint32_t
+{
+    kBaudRate = 921600,
+    kByteTimeNs = 10000000000ull / kBaudRate, // 8N1 - 10 bits per byte
+    kIterations = 250
+};
+
+/** DMA device, that sends the data over a simulated UART */
+struct UartDma
+{
+    Clock::time_point mDoneTime;
+    bool mBusy = false;
+    uint32_t txCount = 0;
+    void dmaTxStart(const void* /*data*/, size_t len)
+    {
+        assert(!mBusy);
+        mDoneTime = Clock::now() + std::chrono::nanoseconds(len * kByteTimeNs);
+        mBusy = true;
+        txCount++;
+    }
+    /** Also acts as the interrupt controller - fires the interrupt if the
+     * transfer is complete */
+    bool txBusy()
+    {
+        if (mBusy && Clock::now() >= mDoneTime)
+        {
+            mBusy = false;
+            txComplete();
+        }
+        return mBusy;
+    }
+    void dmaTxIsr() {}
+    virtual void txComplete() = 0;
+};
+
+template <class Sink>
+struct BenchSink: public Sink
+{
+    void txComplete() { this->dmaTxIsr(); }
+};
+
+/** Busy main loop work, during which the DMA is serviced */
+void work(UartDma& dma, uint32_t us)
+{
+    auto end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end)
+    {
+        dma.txBusy();
+    }
+}
+
+struct Result
+{
+    double usPerIter;
+    uint32_t txCount;
+};
+
+/** Runs the main loop. If \c sink is null, nothing is logged */
+Result runLoop(UartDma& dma, IPrintSink* sink, uint32_t workUs, uint8_t burst)
+{
+    extern IPrintSink* gPrintSink;
+    auto savedSink = gPrintSink;
+    if (sink)
+    {
+        gPrintSink = sink;
+    }
+    dma.txCount = 0;
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < kIterations; i++)
+    {
+        work(dma, workUs);
+        if (!sink)
+        {
+            continue;
+        }
+        for (uint8_t n = 0; n < burst; n++)
+        {
+            tprintf("iter % ch % adc % t %\n", i, n, fmtHex16(i * 37 + n), fmtFp<1>(i * 0.1));
+        }
+    }
+    auto elapsed = Clock::now() - start;
+    // let the last transfers complete
+    while (dma.txBusy());
+    gPrintSink = savedSink;
+    return Result{(double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()
+        / 1000 / kIterations, dma.txCount};
+}
+
+void printResult(const char* name, const Result& res, const Result& base)
+{
+    // a negative difference is timing noise
+    double blocked = res.usPerIter - base.usPerIter;
+    tprintf("  %: % us/iter, blocked % us/iter, % transfers\n", name,
+        fmtFp<1>(res.usPerIter, 0, 7), fmtFp<1>(blocked > 0 ? blocked : 0, 0, 6),
+        res.txCount);
+}
+
+void benchConfig(uint32_t workUs, uint8_t burst)
+{
+    BenchSink<dma::PrintSink<UartDma>> single;
+    BenchSink<dma::RingPrintSink<UartDma, 256>> ring;
+    BenchSink<dma::PingPongPrintSink<UartDma, 128>> pingPong;
+    tprintf("work % us, burst of % messages:\n", workUs, burst);
+    auto base = runLoop(single, nullptr, workUs, burst);
+    printResult("no logging      ", base, base);
+    printResult("dma::PrintSink  ", runLoop(single, &single, workUs, burst), base);
+    printResult("dma::PingPong   ", runLoop(pingPong, &pingPong, workUs, burst), base);
+    printResult("dma::RingPrint  ", runLoop(ring, &ring, workUs, burst), base);
+}
+
+int main()
+{
+    tprintf("UART at % baud, % iterations\n", (uint32_t)kBaudRate, (uint32_t)kIterations);
+    benchConfig(2000, 1);
+    benchConfig(2000, 4);
+    benchConfig(500, 4);
+    return 0;
+}
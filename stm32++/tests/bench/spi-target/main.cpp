@@ -0,0 +1,88 @@
+/**
+ * Compares a full-duplex DMA transaction of SpiMaster with a blocking loop of
+ * single-word exchanges, for all clock prescalers of SPI1, in cycles measured
+ * with the DWT cycle counter. The results are shown as a percentage of the
+ * bus rate - the blocking loop leaves a gap between words, while the status
+ * flags are polled, which is significant at the high clock rates.
+ * MOSI must be connected to MISO, so that the received data can be verified.
+ * The results are printed via the default print sink (semihosting)
+ */
+#include <libopencm3/stm32/rcc.h>
+#include <stm32++/timeutl.hpp>
+#include <stm32++/spi.hpp>
+#include <stm32++/tprintf.hpp>
+
+enum: uint16_t { kSize = 1024 };
+uint8_t gTx[kSize];
+uint8_t gRx[kSize];
+nsspi::SpiMaster<SPI1> gSpi;
+
+extern "C" void dma1_channel2_isr()
+{
+    gSpi.dmaXferIsr();
+}
+
+extern "C" void dma1_channel3_isr()
+{
+    gSpi.dmaXferIsr();
+}
+
+/** Percentage of the bus rate, in tenths of a percent */
+uint32_t busPercent(uint32_t cycles, uint32_t ratio)
+{
+    // a word takes 8 SPI clocks, of ratio APB2 clocks each, and APB2 runs at
+    // the CPU clock, as set up by main()
+    uint64_t busCycles = (uint64_t)kSize * 8 * ratio;
+    return (uint32_t)(busCycles * 1000 / cycles);
+}
+
+bool verify()
+{
+    bool ok = memcmp(gTx, gRx, kSize) == 0;
+    memset(gRx, 0, kSize);
+    return ok;
+}
+
+void benchRatio(uint8_t ratio)
+{
+    gSpi.init(ratio, nsspi::kSoftwareNSS);
+    uint32_t start = DwtCounter::get();
+    gSpi.transfer(gTx, gRx, kSize);
+    gSpi.waitTransfer();
+    uint32_t dmaCycles = DwtCounter::get() - start;
+    bool dmaOk = verify();
+
+    start = DwtCounter::get();
+    for (uint16_t i = 0; i < kSize; i++)
+    {
+        gRx[i] = gSpi.xfer(gTx[i]);
+    }
+    uint32_t loopCycles = DwtCounter::get() - start;
+    bool loopOk = verify();
+
+    uint32_t dmaPct = busPercent(dmaCycles, ratio);
+    uint32_t loopPct = busPercent(loopCycles, ratio);
+    uint32_t freqKhz = rcc_ahb_frequency / 1000;
+    tprintf("clk/%: DMA % kB/s (%%)%, loop % kB/s (%%)%\n",
+        fmtInt(ratio, 0, 3),
+        fmtInt(kSize * freqKhz / dmaCycles, 0, 5), fmtScaled<10>(dmaPct), '%', dmaOk ? "" : " MISMATCH",
+        fmtInt(kSize * freqKhz / loopCycles, 0, 5), fmtScaled<10>(loopPct), '%', loopOk ? "" : " MISMATCH");
+}
+
+int main()
+{
+    rcc_clock_setup_in_hse_8mhz_out_72mhz();
+    dwt_enable_cycle_counter();
+    for (uint16_t i = 0; i < kSize; i++)
+    {
+        gTx[i] = i * 7;
+    }
+    tprintf("SPI1 benchmark at % MHz, % bytes per run\n",
+        rcc_ahb_frequency / 1000000, (uint32_t)kSize);
+    for (uint8_t ratio = 2; ratio && ratio <= 128; ratio *= 2)
+    {
+        benchRatio(ratio);
+    }
+    tprintf("done\n");
+    for (;;);
+}
@@ -0,0 +1,42 @@
+/**
+ * Target half of the formatting benchmark: runs the corpus in ../corpus.cpp and
+ * reports cycles/call, measured with the DWT cycle counter. The results are
+ * printed via the default print sink (semihosting)
+ */
+#include <libopencm3/stm32/rcc.h>
+#include <stm32++/timeutl.hpp>
+#include "../corpus.hpp"
+
+struct DwtClock
+{
+    typedef uint32_t Time;
+    static Time now() { return DwtCounter::get(); }
+};
+
+// Keep the run of a case well below the wrap period of the cycle counter (~59s at 72MHz)
+enum: uint16_t { kRounds = 8 };
+enum: uint32_t { kCalls = (uint32_t)kRounds * kCorpusSize };
+
+int main()
+{
+    rcc_clock_setup_in_hse_8mhz_out_72mhz();
+    dwt_enable_cycle_counter();
+    benchInitValues();
+    tprintf("Formatting benchmark, % calls per case at % MHz\n",
+        (uint32_t)kCalls, rcc_ahb_frequency / 1000000);
+
+    // cost of the loop and the indirect call, subtracted from the results
+    uint32_t overhead = benchRun<DwtClock>(
+        [](char*, size_t, uint16_t) -> size_t { return 0; }, kRounds);
+    for (uint8_t i = 0; i < gNumBenchCases; i++)
+    {
+        auto& bc = gBenchCases[i];
+        uint32_t cycles = benchRun<DwtClock>(bc.func, kRounds);
+        cycles = (cycles > overhead) ? cycles - overhead : 0;
+        tprintf("%:% % cycles/call, % ns/call\n", bc.name, benchPad(bc.name),
+            fmtInt(cycles / kCalls, 0, 7),
+            fmtInt(DwtCounter::ticksToNs<uint64_t>(cycles) / kCalls, 0, 7));
+    }
+    tprintf("done\n");
+    for (;;);
+}
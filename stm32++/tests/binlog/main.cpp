@@ -0,0 +1,196 @@
+#include <stm32++/binlog.hpp>
+#include <stm32++/tsnprintf.hpp>
+#include <binlogDecoder.hpp>
+#include <stdio.h>
+
+// Collects the binary records, as a UART would send them to the host
+struct CaptureSink: public IPrintSink
+{
+    BufferInfo mBufInfo;
+    bool mIsAsync = false;
+    std::vector<uint8_t> data;
+    BufferInfo* waitReady() { return mIsAsync ? &mBufInfo : nullptr; }
+    void print(const char *str, size_t len, int info)
+    {
+        if (mIsAsync)
+        {
+            assert(str == mBufInfo.buf);
+            assert((size_t)info == mBufInfo.bufSize);
+        }
+        data.insert(data.end(), (const uint8_t*)str, (const uint8_t*)str + len);
+    }
+};
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+binlog::Decoder decoder;
+int errors = 0;
+
+template <typename F, typename... Args>
+void check(int line, F&& binlogFunc, const char* fmt, Args... args)
+{
+    sink.data.clear();
+    binlogFunc();
+    char expected[512];
+    if (!tsnprintf(expected, sizeof(expected), fmt, args...))
+    {
+        printf("ERROR (line %d): tsnprintf failed\n", line);
+        errors++;
+        return;
+    }
+    std::string text;
+    size_t recSize;
+    auto status = decoder.decodeRecord(sink.data.data(), sink.data.size(), recSize, text);
+    if (status != binlog::Decoder::kOk || recSize != sink.data.size())
+    {
+        printf("ERROR (line %d): Decode error %d, record size %zu\n", line, status, recSize);
+        errors++;
+        return;
+    }
+    if (text != expected)
+    {
+        printf("ERROR (line %d): Expected '%s', decoded '%s'\n", line, expected, text.c_str());
+        errors++;
+        return;
+    }
+    printf("PASS: '%s' (%zu bytes, formatted %zu)\n", expected, recSize, strlen(expected));
+}
+
+#define CHECK(fmt, ...) check(__LINE__, [&]() { BINLOG(fmt, ##__VA_ARGS__); }, fmt, ##__VA_ARGS__)
+
+void runChecks()
+{
+    CHECK("no arguments\n");
+    CHECK("literal % without argument\n");
+    CHECK("int8=% uint8=% int16=% uint16=%", (int8_t)-128, (uint8_t)255, (int16_t)-32768, (uint16_t)65535);
+    CHECK("int32=% uint32=% int64=% uint64=%", (int32_t)-2147483647-1, 4294967295u,
+          (int64_t)-1234567890123456789LL, (uint64_t)18446744073709551615ULL);
+    CHECK("char='%' str='%' empty='%'", 'x', "hello", "");
+    const char* longStr = "a string that is longer than 127 chars, so that its length "
+        "doesn't fit in a single byte of the varint and needs two bytes to be encoded";
+    CHECK("long: %", longStr);
+    CHECK("hex=% HEX=% oct=% bin=%", fmtHex(0xbeefu), fmtHex<kUpperCase|kNumPrefix>(0xbeef),
+          fmtInt<8>(511), fmtBin8(0x5a));
+    CHECK("padded=% neg=%", fmtInt(42, 5, 8), fmtInt((int64_t)-42, 4));
+    CHECK("ptr=%", (void*)0x12345678);
+    CHECK("float=% double=% neg=%", 3.25f, 1234567.125, -0.5);
+    CHECK("long double=% neg=%", 1.5L, -1234.0625L);
+    CHECK("fp=% sci=% SCI=% auto=% auto=%", fmtFp<3>(3.14159), fmtSci<4>(123456.789),
+          fmtSci<2|kUpperCase>(-0.000123f), fmtFpAuto(1e-7), fmtFpAuto<2>(42.0f));
+    CHECK("padfp=%", fmtFp<2>(1.5, 3, 10));
+    CHECK("nan=% inf=% -inf=%", NAN, INFINITY, -INFINITY);
+    CHECK("rpt=[%]", rptChar('-', 20));
+    CHECK("q15=% q31=% q16.16=%", fmtQ<15>((int16_t)-16384), fmtQ<31>((int32_t)0x40000000, 6),
+          fmtQ<16>((int32_t)0x18000, 2));
+    CHECK("temp=% press=% big=%", fmtScaled<100>(-2345), fmtScaled<100>(101325u),
+          fmtScaled<1000, int64_t>(123456789012LL));
+    CHECK("extra arg dropped", 5);
+}
+
+int main()
+{
+    if (!decoder.loadElf("/proc/self/exe"))
+    {
+        printf("ERROR: Can't load binlog_fmt section from own ELF file\n");
+        return 1;
+    }
+    printf("Loaded %zu bytes of format strings\n", decoder.formatTable().size());
+    printf("==== Synchronous sink\n");
+    runChecks();
+    printf("==== Async sink\n");
+    sink.mIsAsync = true;
+    runChecks();
+    free((void*)sink.mBufInfo.buf);
+
+    // Records split at arbitrary positions must be reported as incomplete
+    sink.mIsAsync = false;
+    sink.data.clear();
+    BINLOG("split % %", 123456789u, "record");
+    BINLOG("second %", 2);
+    std::string text;
+    size_t recSize;
+    for (size_t len = 0; len < sink.data.size(); len++)
+    {
+        auto status = decoder.decodeRecord(sink.data.data(), len, recSize, text);
+        size_t firstSize = recSize;
+        if (status == binlog::Decoder::kOk)
+        {
+            // first record complete, the second must not be
+            if (decoder.decodeRecord(sink.data.data() + firstSize, len - firstSize,
+                recSize, text) != binlog::Decoder::kIncomplete)
+            {
+                printf("ERROR: Incomplete second record not detected, len = %zu\n", len);
+                errors++;
+            }
+        }
+        else if (status != binlog::Decoder::kIncomplete)
+        {
+            printf("ERROR: Incomplete record not detected, len = %zu\n", len);
+            errors++;
+        }
+        text.clear();
+    }
+    // Corrupt argument tag
+    sink.data.clear();
+    BINLOG("corrupt %", 1);
+    sink.data.back() = 0xff;
+    sink.data[sink.data.size() - 5] = 0xff;
+    if (decoder.decodeRecord(sink.data.data(), sink.data.size(), recSize, text) != binlog::Decoder::kInvalid
+        || recSize != sink.data.size())
+    {
+        printf("ERROR: Corrupt record not detected\n");
+        errors++;
+    }
+    // Corrupt and truncated ELF files must be rejected, without reading outside of them
+    binlog::Decoder elfDecoder;
+    uint8_t hdr[64] = { 0x7f, 'E', 'L', 'F', 2, 1 };
+    uint32_t shOffs = 0x10000;
+    memcpy(hdr + 0x28, &shOffs, sizeof(shOffs));
+    hdr[0x3a] = 64; // e_shentsize
+    hdr[0x3c] = 2;  // e_shnum
+    hdr[0x3e] = 1;  // e_shstrndx
+    if (elfDecoder.loadElf(hdr, sizeof(hdr)))
+    {
+        printf("ERROR: Section headers beyond the end of the ELF file not detected\n");
+        errors++;
+    }
+    memset(hdr + 0x28, 0xff, 8);
+    if (elfDecoder.loadElf(hdr, sizeof(hdr)))
+    {
+        printf("ERROR: Overflowing section header offset not detected\n");
+        errors++;
+    }
+    FILE* file = fopen("/proc/self/exe", "rb");
+    std::vector<uint8_t> elf;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        elf.insert(elf.end(), chunk, chunk + n);
+    }
+    fclose(file);
+    uint64_t elfShOffs;
+    memcpy(&elfShOffs, elf.data() + 0x28, sizeof(elfShOffs));
+    // The last cut is inside the section header table
+    for (size_t len: { (size_t)64, (size_t)65, elf.size() / 2, (size_t)elfShOffs + 1 })
+    {
+        std::vector<uint8_t> truncated(elf.begin(), elf.begin() + len);
+        if (elfDecoder.loadElf(truncated.data(), truncated.size()))
+        {
+            printf("ERROR: ELF file truncated to %zu bytes not detected\n", len);
+            errors++;
+        }
+    }
+    if (!elfDecoder.loadElf(elf.data(), elf.size()))
+    {
+        printf("ERROR: Can't load binlog_fmt section from the in-memory ELF file\n");
+        errors++;
+    }
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
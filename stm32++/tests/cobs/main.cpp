@@ -0,0 +1,190 @@
+#include <stm32++/usartPacket.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+typedef std::vector<uint8_t> Bytes;
+
+Bytes encode(const Bytes& payload)
+{
+    Bytes buf(cobs::maxEncodedSize(payload.size()) + 16, 0xcc);
+    std::copy(payload.begin(), payload.end(), buf.begin() + 1);
+    size_t len = cobs::encodeInPlace(buf.data(), payload.size());
+    CHECK(len <= cobs::maxEncodedSize(payload.size()), "Encoded size within the maximum");
+    CHECK(buf[len] == 0xcc, "No write past the encoded packet");
+    buf.resize(len);
+    return buf;
+}
+
+std::vector<Bytes> received;
+void onPacket(const uint8_t* data, size_t size, void*)
+{
+    received.emplace_back(data, data + size);
+}
+
+void testEncoder()
+{
+    CHECK(encode({}) == Bytes({0x01, 0x00}), "Empty payload");
+    CHECK(encode({0x00}) == Bytes({0x01, 0x01, 0x00}), "Single zero");
+    CHECK(encode({0x11, 0x22, 0x00, 0x33}) == Bytes({0x03, 0x11, 0x22, 0x02, 0x33, 0x00}),
+        "Zero in the middle");
+    CHECK(encode({0x11, 0x00, 0x00}) == Bytes({0x02, 0x11, 0x01, 0x01, 0x00}), "Trailing zeros");
+    Bytes run(300);
+    for (size_t i = 0; i < run.size(); i++)
+    {
+        run[i] = i % 255 + 1;
+    }
+    Bytes enc = encode(run);
+    CHECK(enc.size() == 300 + 2 + 1 && enc[0] == 0xff && enc[255] == 47,
+        "Run of more than 254 non-zero bytes");
+    CHECK(std::find(enc.begin(), enc.end() - 1, 0) == enc.end() - 1, "No zeros but the delimiter");
+}
+
+void testDecoder()
+{
+    cobs::Decoder<400, false> dec(onPacket);
+    received.clear();
+    std::vector<Bytes> payloads = { {}, {0}, {1, 2, 0, 3}, {0, 0, 0}, Bytes(254, 7), Bytes(255, 7) };
+    Bytes run(400);
+    for (size_t i = 0; i < run.size(); i++)
+    {
+        run[i] = (i % 100 == 0) ? 0 : i;
+    }
+    payloads.push_back(run);
+    Bytes stream;
+    for (auto& payload: payloads)
+    {
+        Bytes enc = encode(payload);
+        stream.insert(stream.end(), enc.begin(), enc.end());
+    }
+    // Fed one byte at a time, as from an interrupt
+    for (uint8_t byte: stream)
+    {
+        dec.feed(&byte, 1);
+    }
+    CHECK(received == payloads, "Round trip, byte by byte");
+    received.clear();
+    for (size_t pos = 0; pos < stream.size(); pos += 37)
+    {
+        dec.feed(stream.data() + pos, std::min<size_t>(37, stream.size() - pos));
+    }
+    CHECK(received == payloads, "Round trip, in chunks");
+    CHECK(dec.errorCount() == 0, "No errors");
+
+    received.clear();
+    const uint8_t noise[] = { 0x00, 0x00, 0x05, 0x11, 0x00, 0x02, 0x11, 0x00 };
+    dec.feed(noise, sizeof(noise));
+    CHECK(received.size() == 1 && received[0] == Bytes({0x11}), "Truncated packet dropped, next one received");
+    CHECK(dec.errorCount() == 1, "Truncated packet counted");
+
+    cobs::Decoder<4, false> small(onPacket);
+    received.clear();
+    Bytes enc = encode({1, 2, 3, 4, 5});
+    small.feed(enc.data(), enc.size());
+    enc = encode({1, 2, 3, 4});
+    small.feed(enc.data(), enc.size());
+    CHECK(small.errorCount() == 1 && received.size() == 1 && received[0].size() == 4,
+        "Too long packet dropped");
+}
+
+void testCrc()
+{
+    CHECK(cobs::crc16("123456789", 9) == 0x29b1, "CRC-16/CCITT-FALSE check value");
+    cobs::Decoder<16> dec(onPacket);
+    Bytes payload = {1, 0, 2, 3};
+    uint16_t crc = cobs::crc16(payload.data(), payload.size());
+    payload.push_back(crc >> 8);
+    payload.push_back(crc & 0xff);
+    Bytes enc = encode(payload);
+    received.clear();
+    dec.feed(enc.data(), enc.size());
+    CHECK(received.size() == 1 && received[0] == Bytes({1, 0, 2, 3}), "CRC checked and stripped");
+    enc[3] ^= 0x40; // a data byte
+    dec.feed(enc.data(), enc.size());
+    CHECK(received.size() == 1 && dec.crcErrorCount() == 1, "Corrupted packet dropped");
+}
+
+enum: sim::Cycles { kTimeout = 100000000 };
+enum: uint32_t { kBaudRate = 2000000 };
+typedef nsusart::PacketTransport<nsusart::Usart<USART1>, 64> Link;
+Link link;
+extern "C" void dma1_channel4_isr() { link.dmaTxIsr(); }
+extern "C" void dma1_channel5_isr() { link.dmaRxIsr(); }
+extern "C" void usart1_isr() { link.usartRxIsr(); }
+
+void testTransport()
+{
+    sim::reset();
+    auto& model = sim::usart(USART1);
+    model.setLoopback(true);
+    link.init(nsusart::kOptEnableTx | nsusart::kOptEnableRx, kBaudRate);
+    received.clear();
+    link.start(onPacket, nullptr);
+
+    enum { kPackets = 100, kPayload = 48 };
+    std::vector<Bytes> sent;
+    srand(1);
+    sim::Cycles start = sim::now();
+    for (int i = 0; i < kPackets; i++)
+    {
+        uint8_t* payload = link.txPayload();
+        for (int j = 0; j < kPayload; j++)
+        {
+            payload[j] = (rand() % 4) ? rand() : 0;
+        }
+        sent.emplace_back(payload, payload + kPayload);
+        link.send(kPayload);
+        link.poll();
+    }
+    sim::runUntil([]() { return !link.txBusy(); }, kTimeout);
+    sim::Cycles elapsed = sim::now() - start;
+    sim::runUntil([]() { link.poll(); return received.size() == kPackets; }, kTimeout);
+    CHECK(received == sent, "Packets received in order through the loopback");
+    CHECK(link.decoder().errorCount() == 0 && link.decoder().crcErrorCount() == 0, "No errors");
+    CHECK(link.rxOverrunBytes() == 0, "No overruns");
+
+    size_t wireBytes = model.takeTxData().size();
+    double lineTime = wireBytes * model.frameCycles();
+    printf("%d packets of %d bytes, %zu bytes on the wire: %.1f%% of the line rate\n",
+        kPackets, kPayload, wireBytes, 100 * lineTime / elapsed);
+    CHECK(lineTime / elapsed > 0.99, "Packets sent back to back");
+
+    // A corrupted packet is dropped, and the link recovers at the next delimiter
+    received.clear();
+    model.setLoopback(false);
+    const uint8_t garbage[] = { 0x05, 0x11, 0x22, 0x00 };
+    model.rxInject(garbage, sizeof(garbage));
+    Bytes good = { 1, 2, 3 };
+    uint16_t crc = cobs::crc16(good.data(), good.size());
+    Bytes withCrc = good;
+    withCrc.push_back(crc >> 8);
+    withCrc.push_back(crc & 0xff);
+    Bytes enc = encode(withCrc);
+    model.rxInject(enc.data(), enc.size());
+    sim::runUntil([]() { link.poll(); return !received.empty(); }, kTimeout);
+    CHECK(received.size() == 1 && received[0] == good, "Link recovers after a corrupted packet");
+    CHECK(link.decoder().errorCount() == 1, "Corrupted packet counted");
+    link.stop();
+}
+
+int main()
+{
+    testEncoder();
+    testDecoder();
+    testCrc();
+    testTransport();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <stm32++/dmaStream.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+/** Simulation of a DMA channel in circular mode, receiving into a buffer.
+ * The interrupt flags are set as the DMA controller sets them, and the
+ * interrupt handler runs when the test calls \c isr(), i.e. it can be late */
+struct SimDma
+{
+    uint8_t buf[16];
+    uint16_t pos = 0;
+    bool htif = false;
+    bool tcif = false;
+    dma::RxStream stream;
+    void receive(uint8_t byte)
+    {
+        buf[pos++] = byte;
+        if (pos == sizeof(buf) / 2)
+        {
+            htif = true;
+        }
+        else if (pos == sizeof(buf))
+        {
+            tcif = true;
+            pos = 0;
+        }
+    }
+    void isr()
+    {
+        bool half = htif, full = tcif;
+        htif = tcif = false;
+        stream.onDmaEvents(half, full);
+    }
+};
+
+struct Consumer
+{
+    std::string data;
+    std::vector<char> halves; // 'h' or 'f', in order of the callbacks
+    const void* held = nullptr;
+    static void onHalf(const void* data, uint16_t size, void* userp)
+    {
+        auto self = (Consumer*)userp;
+        self->data.append((const char*)data, size);
+        self->halves.push_back('h');
+        self->held = data;
+    }
+    static void onFull(const void* data, uint16_t size, void* userp)
+    {
+        auto self = (Consumer*)userp;
+        self->data.append((const char*)data, size);
+        self->halves.push_back('f');
+        self->held = data;
+    }
+};
+
+int errors = 0;
+
+std::string sequence(int from, int count)
+{
+    std::string str;
+    for (int i = from; i < from + count; i++)
+    {
+        str += (char)('A' + i % 26);
+    }
+    return str;
+}
+
+void testStreaming()
+{
+    SimDma dma;
+    Consumer consumer;
+    dma.stream.start(dma.buf, sizeof(dma.buf), Consumer::onHalf, Consumer::onFull, &consumer);
+    for (int i = 0; i < 100; i++)
+    {
+        dma.receive('A' + i % 26);
+        dma.isr();
+    }
+    CHECK(consumer.data == sequence(0, 96), "Halves handed over in order");
+    CHECK(consumer.halves.size() == 12 && consumer.halves[0] == 'h' && consumer.halves[1] == 'f',
+        "Half-complete and full-complete callbacks alternate");
+    CHECK(dma.stream.overrunCount() == 0, "No overruns");
+}
+
+void testLateIsr()
+{
+    SimDma dma;
+    Consumer consumer;
+    dma.stream.start(dma.buf, sizeof(dma.buf), Consumer::onHalf, Consumer::onFull, &consumer);
+    for (int i = 0; i < 8; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    // both halves complete before the interrupt handler runs
+    for (int i = 8; i < 24; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    CHECK(dma.stream.overrunCount() == 1, "Late interrupt counted as an overrun");
+    CHECK(consumer.halves == std::vector<char>({'h', 'f', 'h'}), "Both completed halves handed over, in order");
+    for (int i = 24; i < 32; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    CHECK(consumer.halves.back() == 'f' && dma.stream.overrunCount() == 1, "Streaming continues after an overrun");
+}
+
+void testDeferredRelease()
+{
+    SimDma dma;
+    Consumer consumer;
+    dma.stream.start(dma.buf, sizeof(dma.buf), Consumer::onHalf, Consumer::onFull, &consumer, true);
+    for (int i = 0; i < 8; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    CHECK(consumer.held == dma.buf, "First half handed over");
+    dma.stream.release(consumer.held); // consumer keeps up
+    for (int i = 8; i < 16; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    CHECK(consumer.held == dma.buf + 8 && dma.stream.overrunCount() == 0, "Released in time");
+    // the consumer doesn't release the second half before the DMA has filled the first
+    for (int i = 16; i < 24; i++)
+    {
+        dma.receive('A' + i);
+        dma.isr();
+    }
+    CHECK(dma.stream.overrunCount() == 1, "Consumer falling behind counted as an overrun");
+}
+
+void testLateIsrDeferred(bool keepsHalf)
+{
+    SimDma dma;
+    Consumer consumer;
+    dma.stream.start(dma.buf, sizeof(dma.buf), Consumer::onHalf, Consumer::onFull, &consumer, true);
+    for (int i = 0; i < 8; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    if (!keepsHalf)
+    {
+        dma.stream.release(consumer.held);
+    }
+    // both halves complete before the interrupt handler runs
+    for (int i = 8; i < 24; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    CHECK(dma.stream.overrunCount() == 1, keepsHalf
+        ? "Deferred release: late interrupt while holding a half counted once"
+        : "Deferred release: late interrupt counted once");
+    CHECK(consumer.halves == std::vector<char>({'h', 'f', 'h'}) && consumer.held == dma.buf,
+        "Deferred release: both completed halves handed over, in order");
+    dma.stream.release(consumer.held);
+    for (int i = 24; i < 32; i++)
+    {
+        dma.receive('A' + i);
+    }
+    dma.isr();
+    CHECK(consumer.halves.back() == 'f' && dma.stream.overrunCount() == 1,
+        "Deferred release: streaming continues after an overrun");
+}
+
+int main()
+{
+    testStreaming();
+    testLateIsr();
+    testDeferredRelease();
+    testLateIsrDeferred(false);
+    testLateIsrDeferred(true);
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -36,7 +36,7 @@ std::string dumpPage(uint16_t* page)
     return dumpPage((uint8_t*) page);
 }
 
-FlashValueStore<> store;
+KeyValueStore<> store;
 std::string values[] = {
     "this is a test message",
     "new value",
@@ -67,7 +67,7 @@ bool setString(uint8_t key, const std::string& val)
     {
         printf("WARN: setString: string length is more than 255 bytes");
     }
-    return store.setValue(key, val.c_str(), val.size(), false);
+    return store.setRawValue(key, val.c_str(), val.size(), false);
 }
 std::string getString(uint8_t key)
 {
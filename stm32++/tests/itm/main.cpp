@@ -0,0 +1,151 @@
+#include <stm32++/tprintf.hpp>
+#include <stm32++/itm.hpp>
+#include <swoDecoder.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+/** Mock of the ITM registers. Records the writes as the SWO packets that
+ * the ITM would output for them */
+struct MockRegs
+{
+    static bool enabled;
+    static uint32_t enabledPorts;
+    static int busyPolls; // number of polls for which the FIFO is full, -1 - forever
+    static int writeCount;
+    static std::vector<uint8_t> swo;
+    static bool portEnabled(uint8_t port) { return enabled && (enabledPorts & (1u << port)); }
+    static bool fifoReady(uint8_t)
+    {
+        if (!busyPolls)
+        {
+            return true;
+        }
+        if (busyPolls > 0)
+        {
+            busyPolls--;
+        }
+        return false;
+    }
+    static void write(uint8_t port, uint32_t val, uint8_t size)
+    {
+        writeCount++;
+        swo.push_back((port << 3) | (size == 4 ? 3 : size)); // software source packet header
+        for (uint8_t i = 0; i < size; i++)
+        {
+            swo.push_back(val >> (8 * i));
+        }
+    }
+    static void write8(uint8_t port, uint8_t val) { write(port, val, 1); }
+    static void write16(uint8_t port, uint16_t val) { write(port, val, 2); }
+    static void write32(uint8_t port, uint32_t val) { write(port, val, 4); }
+};
+bool MockRegs::enabled = true;
+uint32_t MockRegs::enabledPorts = 0x07;
+int MockRegs::busyPolls = 0;
+int MockRegs::writeCount = 0;
+std::vector<uint8_t> MockRegs::swo;
+
+itm::PrintSink<MockRegs, 100> sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+/** Decodes the recorded SWO output, and clears it */
+std::string decoded(uint8_t port)
+{
+    swo::Decoder decoder;
+    decoder.feed(MockRegs::swo.data(), MockRegs::swo.size());
+    MockRegs::swo.clear();
+    return decoder.takeText(port);
+}
+
+void testSink()
+{
+    MockRegs::writeCount = 0;
+    tprintf("hello, world\n");
+    CHECK(MockRegs::writeCount == 4, "13 bytes written as 3 words and a byte");
+    CHECK(decoded(1) == "hello, world\n", "tprintf() output to port 1");
+
+    ftprintf(2, "err %", 42);
+    CHECK(MockRegs::writeCount == 6, "6 bytes written as a word and a half-word");
+    CHECK(decoded(2) == "err 42", "ftprintf(2) output to port 2");
+
+    ftprintf(0, "zero");
+    tprintf("one");
+    ftprintf(2, "two");
+    auto swo = MockRegs::swo;
+    CHECK(decoded(0) == "zero", "Port 0");
+    MockRegs::swo = swo;
+    CHECK(decoded(1) == "one", "Port 1");
+    MockRegs::swo = swo;
+    CHECK(decoded(2) == "two", "Port 2");
+
+    MockRegs::writeCount = 0;
+    ftprintf(5, "disabled port");
+    MockRegs::enabled = false;
+    tprintf("ITM disabled");
+    MockRegs::enabled = true;
+    CHECK(MockRegs::writeCount == 0 && !sink.fifoFull(), "Output to disabled ports discarded");
+
+    MockRegs::busyPolls = 50;
+    tprintf("slow FIFO");
+    CHECK(decoded(1) == "slow FIFO" && !sink.fifoFull(), "Waited for the FIFO");
+
+    MockRegs::busyPolls = -1;
+    tprintf("FIFO stuck");
+    MockRegs::busyPolls = 0;
+    CHECK(MockRegs::swo.empty() && sink.fifoFull() && sink.fifoFullCount() == 1,
+        "FIFO full flagged, message dropped");
+    sink.clearFifoFull();
+    tprintf("after");
+    CHECK(decoded(1) == "after" && !sink.fifoFull(), "Output resumes after the FIFO was full");
+}
+
+void testDecoder()
+{
+    tprintf("first line\n");
+    ftprintf(3, "disabled port");
+    ftprintf(2, "stderr\n");
+    std::vector<uint8_t> sinkOutput = MockRegs::swo;
+    MockRegs::swo.clear();
+    // Interleave the output with other packets
+    std::vector<uint8_t> capture = { 0, 0, 0, 0, 0, 0x80 }; // synchronization
+    capture.insert(capture.end(), sinkOutput.begin(), sinkOutput.begin() + 5);
+    capture.insert(capture.end(), { 0x70, // overflow
+        0xc0, 0x85, 0x03, // local timestamp, with continuation bytes
+        0x30, // single-byte local timestamp
+        0x0f, 0x12, 0x34, 0x56, 0x78, // DWT hardware source packet
+        0x08, // extension
+    });
+    capture.insert(capture.end(), sinkOutput.begin() + 5, sinkOutput.end());
+
+    swo::Decoder decoder;
+    decoder.feed(capture.data(), capture.size());
+    CHECK(decoder.text(1) == "first line\n" && decoder.text(2) == "stderr\n" && decoder.text(3).empty(),
+        "Port output demultiplexed");
+    CHECK(decoder.syncCount == 1 && decoder.overflowCount == 1 && decoder.hwPacketCount == 1
+        && decoder.invalidCount == 0, "Other packets skipped");
+
+    swo::Decoder byteByByte;
+    std::string out;
+    for (auto b: capture)
+    {
+        byteByByte.feedByte(b);
+        out += byteByByte.takeText(1);
+    }
+    CHECK(out == "first line\n" && byteByByte.text(2) == "stderr\n", "Incremental decoding");
+}
+
+int main()
+{
+    testSink();
+    testDecoder();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
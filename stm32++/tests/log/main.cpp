@@ -0,0 +1,84 @@
+#include <stdint.h>
+
+/** Clock for the timestamps, counts in microseconds */
+struct MockClock
+{
+    static uint32_t now;
+    static uint32_t get() { return now; }
+    static uint32_t ticksToUs(uint32_t ticks) { return ticks; }
+};
+uint32_t MockClock::now = 0;
+
+#define STM32PP_LOG_LEVEL_VERBOSE kLogLevelDebug
+#define STM32PP_LOG_LEVEL_QUIET kLogLevelError
+#include <stm32++/log.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <stdio.h>
+
+#ifndef STM32PP_LOG_LEVEL_DEFAULT
+    #define STM32PP_LOG_LEVEL_DEFAULT STM32PP_LOG_LEVEL
+#endif
+
+uint8_t logLevelMaskInOtherUnit(); // other.cpp
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+int evaluated = 0;
+int sideEffect()
+{
+    return ++evaluated;
+}
+
+std::string take()
+{
+    std::string out;
+    out.swap(sink.output);
+    return out;
+}
+
+int main()
+{
+#ifdef STM32PP_LOG_TIMESTAMPS
+    const char* ts = "1234 ";
+    MockClock::now = 1234;
+#else
+    const char* ts = "";
+#endif
+    STM32PP_LOG(VERBOSE, Debug, "value %", 42);
+    CHECK(take() == ts + std::string("VERBOSE/Debug: value 42\n"), "Message format");
+
+    STM32PP_LOG(QUIET, Debug, "%", sideEffect());
+    STM32PP_LOG(QUIET, Info, "%", sideEffect());
+    STM32PP_LOG(QUIET, Warning, "%", sideEffect());
+    CHECK(take().empty() && evaluated == 0, "Calls below the module level are compiled out");
+    STM32PP_LOG(QUIET, Error, "error %", sideEffect());
+    CHECK(take() == ts + std::string("QUIET/Error: error 1\n"), "Call at the module level is output");
+
+    STM32PP_LOG(DEFAULT, Info, "info");
+    STM32PP_LOG(DEFAULT, Warning, "warning");
+    CHECK(take() == ts + std::string("DEFAULT/Warning: warning\n"), "Default level is Warning");
+
+    logSetMinLevel(kLogLevelWarning);
+    STM32PP_LOG(VERBOSE, Debug, "debug");
+    STM32PP_LOG(VERBOSE, Info, "info");
+    STM32PP_LOG(VERBOSE, Error, "error");
+    CHECK(take() == ts + std::string("VERBOSE/Error: error\n"), "Runtime minimum level");
+    CHECK(logLevelMaskInOtherUnit() == logLevelMask(), "Runtime level shared by all translation units");
+
+    logLevelMask() = 1 << kLogLevelDebug;
+    STM32PP_LOG(VERBOSE, Debug, "debug");
+    STM32PP_LOG(VERBOSE, Error, "error");
+    CHECK(take() == ts + std::string("VERBOSE/Debug: debug\n"), "Runtime level mask");
+    logLevelMask() = 0xff;
+
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,7 @@
+#include <stm32++/log.hpp>
+
+/** The runtime level mask, as seen from another translation unit */
+uint8_t logLevelMaskInOtherUnit()
+{
+    return logLevelMask();
+}
@@ -0,0 +1,224 @@
+#include <stm32++/tprintf.hpp>
+#include <stm32++/dmaPrint.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <stdio.h>
+
+/** DMA device mock. A transfer completes when the test calls \c complete(),
+ * which outputs the data and calls the Tx interrupt handler of the sink, as the
+ * DMA controller would */
+struct MockDma
+{
+    const char* mData = nullptr;
+    size_t mLen = 0;
+    std::atomic<bool> mBusy;
+    int txCount = 0;
+    MockDma(): mBusy(false) {}
+    void dmaTxStart(const void* data, size_t len)
+    {
+        assert(!mBusy);
+        mData = (const char*)data;
+        mLen = len;
+        txCount++;
+        mBusy.store(true, std::memory_order_release);
+    }
+    bool txBusy() const { return mBusy.load(std::memory_order_acquire); }
+    void dmaTxIsr() {}
+};
+
+template <size_t Size>
+struct TestSink: public dma::MpscPrintSink<MockDma, Size>
+{
+
+    std::string output;
+    /** Completes the current transfer, if any. Called only by the 'DMA' thread */
+    bool complete()
+    {
+        if (!this->txBusy())
+        {
+            return false;
+        }
+        output.append(this->mData, this->mLen);
+        this->mBusy.store(false, std::memory_order_release);
+        this->dmaTxIsr();
+        return true;
+    }
+    void completeAll()
+    {
+        while (complete());
+    }
+};
+
+TestSink<64> sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+void testBasic()
+{
+    tprintf("first: %\n", 1);
+    tprintf("second: %\n", fmtHex(0xabcd));
+    sink.completeAll();
+    CHECK(sink.output == "first: 1\nsecond: abcd\n", "Messages output in order");
+
+    // wrap messages at every position of the ring
+    bool ok = true;
+    for (int i = 0; i < 200; i++)
+    {
+        sink.output.clear();
+        char expected[64];
+        tsnprintf(expected, sizeof(expected), "msg % %", i, rptChar('x', i % 23));
+        tprintf("msg % %", i, rptChar('x', i % 23));
+        sink.completeAll();
+        if (sink.output != expected)
+        {
+            printf("ERROR: '%s' != '%s'\n", sink.output.c_str(), expected);
+            ok = false;
+        }
+    }
+    CHECK(ok, "Messages wrapped at all positions");
+
+    sink.output.clear();
+    tprintf("");
+    tprintf("after empty");
+    sink.completeAll();
+    CHECK(sink.output == "after empty", "Empty message");
+
+    uint32_t dropped = sink.droppedCount();
+    CHECK(tprintf("%", rptChar('x', 61)) == 0 && sink.droppedCount() == dropped + 1,
+        "Message longer than the ring is dropped");
+    // Fill the ring, while the DMA is busy with the first message
+    sink.output.clear();
+    int printed = 0;
+    while (tprintf("fill %\n", printed))
+    {
+        printed++;
+    }
+    CHECK(printed == 5 && sink.droppedCount() == dropped + 2, "Message dropped when the ring is full");
+    sink.completeAll();
+    CHECK(sink.output == "fill 0\nfill 1\nfill 2\nfill 3\nfill 4\n", "Messages before the full ring");
+
+    // A message that is not yet committed holds back the ones after it
+    sink.output.clear();
+    IMpscPrintSink::Reservation res;
+    sink.reserve(5, res);
+    tprintf("second");
+    sink.completeAll();
+    CHECK(sink.output.empty(), "Committed message waits for the older uncommitted one");
+    IRingPrintSink::copyToSpans(res.first, res.second, "first", 5);
+    sink.commit(res);
+    sink.completeAll();
+    CHECK(sink.output == "firstsecond", "Both messages output after the commit");
+}
+
+/** Several producer contexts and the DMA interrupt handler log at the same
+ * time, while the 'DMA' thread completes transfers. Each message ends with a
+ * newline, and each line is verified to be intact and in order. The producers
+ * are much faster than the 'DMA', so when a message is dropped, they yield and
+ * retry it, to keep the ring busy with concurrent reservations
+ */
+void testStress()
+{
+    enum { kProducers = 4, kMsgsPerProducer = 5000, kIsrCtx = kProducers };
+    static TestSink<1024> sink;
+    gPrintSink = &sink;
+    std::atomic<int> dropped(0);
+    std::atomic<bool> producing(true);
+    int isrMsgs = 0;
+    std::thread dma([&]()
+    {
+        int completions = 0;
+        while (producing || sink.txBusy())
+        {
+            if (sink.complete() && (++completions % 16) == 0)
+            {
+                // logging from the DMA interrupt handler itself, without retrying
+                if (tprintf("ctx % seq %: isr\n", (int)kIsrCtx, isrMsgs) == 0)
+                {
+                    dropped++;
+                }
+                else
+                {
+                    isrMsgs++;
+                }
+            }
+        }
+    });
+    std::vector<std::thread> producers;
+    for (int ctx = 0; ctx < kProducers; ctx++)
+    {
+        producers.emplace_back([ctx, &dropped]()
+        {
+            for (int seq = 0; seq < kMsgsPerProducer; seq++)
+            {
+                while (tprintf("ctx % seq %: %\n", ctx, seq, rptChar('=', (ctx * 13 + seq * 7) % 50)) == 0)
+                {
+                    dropped++;
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& thread: producers)
+    {
+        thread.join();
+    }
+    producing = false;
+    dma.join();
+    sink.completeAll();
+
+    int bad = 0, lines = 0;
+    std::vector<int> lastSeq(kProducers + 1, -1);
+    size_t start = 0;
+    for (size_t end; (end = sink.output.find('\n', start)) != std::string::npos; start = end + 1)
+    {
+        lines++;
+        std::string line = sink.output.substr(start, end - start + 1);
+        int ctx, seq;
+        if (sscanf(line.c_str(), "ctx %d seq %d", &ctx, &seq) != 2 || ctx < 0 || ctx > kIsrCtx
+         || seq <= lastSeq[ctx])
+        {
+            printf("Bad line: '%s'\n", line.c_str());
+            bad++;
+            continue;
+        }
+        lastSeq[ctx] = seq;
+        char expected[128];
+        if (ctx == kIsrCtx)
+        {
+            tsnprintf(expected, sizeof(expected), "ctx % seq %: isr\n", ctx, seq);
+        }
+        else
+        {
+            tsnprintf(expected, sizeof(expected), "ctx % seq %: %\n", ctx, seq,
+                rptChar('=', (ctx * 13 + seq * 7) % 50));
+        }
+        if (line != expected)
+        {
+            printf("Bad line: '%s'\n", line.c_str());
+            bad++;
+        }
+    }
+    int total = kProducers * kMsgsPerProducer + isrMsgs;
+    printf("Stress: %d messages, %d output, %d dropped and retried, %d DMA transfers\n",
+        total, lines, dropped.load(), sink.txCount);
+    CHECK(bad == 0 && start == sink.output.size(), "All messages intact and in order");
+    CHECK(lines == total && (int)sink.droppedCount() == dropped, "All messages output, drops counted");
+    CHECK(!sink.txBusy() && sink.output.size(), "Output drained");
+    gPrintSink = &::sink;
+}
+
+int main()
+{
+    testBasic();
+    testStress();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * Formats fixed point values via tsnprintf(). Built with -mgeneral-regs-only
+ * on x86 hosts, so that the build fails if any floating point operation gets
+ * involved. For firmware builds, the equivalent check is that
+ * `arm-none-eabi-nm firmware.elf | grep -E "__aeabi_[fd]"` finds nothing
+ */
+#include <stm32++/tsnprintf.hpp>
+#include <string.h>
+#include <stdio.h>
+
+int gFails = 0;
+
+template <typename... Args>
+void expect(const char* expected, const char* fmtStr, Args... args)
+{
+    char buf[128];
+    tsnprintf(buf, sizeof(buf), fmtStr, args...);
+    if (strcmp(buf, expected))
+    {
+        printf("ERROR: expected '%s', actual: '%s'\n", expected, buf);
+        gFails++;
+    }
+    else if (tformattedLength(fmtStr, args...) != strlen(expected))
+    {
+        printf("ERROR: tformattedLength() mismatch for '%s'\n", expected);
+        gFails++;
+    }
+    else
+    {
+        printf("PASS: %s\n", buf);
+    }
+}
+
+int main()
+{
+    int32_t centiDegrees = -1234;
+    int32_t pascals = 101325;
+    expect("temp = -12.34, press = 1013.25", "temp = %, press = %",
+        fmtScaled<100>(centiDegrees), fmtScaled<100>(pascals));
+    expect("q15: 0.5000, -0.2500", "q15: %, %", fmtQ<15>((int16_t)0x4000), fmtQ<15>((int16_t)-0x2000));
+    expect("q31: 0.500000000, -1.0000", "q31: %, %", fmtQ<31>((int32_t)0x40000000, 9), fmtQ<31>((int32_t)0x80000000));
+    expect("q16.16: 3.14159", "q16.16: %", fmtQ<16>((int32_t)205887, 5));
+    return gFails ? 1 : 0;
+}
@@ -0,0 +1,256 @@
+#include <stm32++/tprintf.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+
+enum: size_t { kBlockSize = DefaultPrintBufPool::kBlockSize, kStackBufSize = 64 };
+
+/** Synchronous sink that collects the messages. Thread-safe, as it's printed
+ * to from several contexts at once */
+struct MsgSink: public IPrintSink
+{
+    std::mutex mutex;
+    std::vector<std::string> msgs;
+    BufferInfo* waitReady() { return nullptr; }
+    void print(const char* str, size_t len, int)
+    {
+        // The buffer must be either on the stack, or a pool block
+        std::lock_guard<std::mutex> lock(mutex);
+        msgs.emplace_back(str, len);
+    }
+    std::string last() { return msgs.empty() ? std::string() : msgs.back(); }
+};
+
+/** Async sink, whose DMA transfers complete immediately */
+struct MockAsyncSink: public AsyncPrintSink
+{
+    std::string output;
+    BufferInfo* waitReady() { return &mPrintBuffer; }
+    void print(const char* str, size_t len, int bufSize)
+    {
+        mPrintBuffer.buf = str;
+        mPrintBuffer.bufSize = bufSize;
+        output.append(str, len);
+    }
+    const char* buf() const { return mPrintBuffer.buf; }
+};
+
+MsgSink sink;
+MockAsyncSink asyncSink;
+int errors = 0;
+
+bool isPrefix(const std::string& prefix, const std::string& str)
+{
+    return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+template <typename... Args>
+std::string expected(const char* fmt, Args... args)
+{
+    char buf[512];
+    tsnprintf(buf, sizeof(buf), fmt, args...);
+    return buf;
+}
+
+void testPool()
+{
+    PrintBufPool<16, 3> pool;
+    char* a = pool.tryAlloc();
+    char* b = pool.tryAlloc();
+    char* c = pool.tryAlloc();
+    CHECK(a && b && c && a != b && b != c && a != c, "Allocated all blocks");
+    CHECK(pool.owns(a) && pool.owns(c + 15) && !pool.owns(c + 16), "owns()");
+    CHECK(pool.usedCount() == 3, "Used count of full pool");
+    CHECK(!pool.tryAlloc() && pool.exhaustedCount() == 1, "Exhausted pool returns null");
+    pool.free(b);
+    CHECK(pool.tryAlloc() == b, "Freed block is reused");
+    pool.free(a);
+    pool.free(b);
+    pool.free(c);
+    CHECK(pool.usedCount() == 0, "All blocks freed");
+}
+
+void testSync()
+{
+    setPrintSink(&sink);
+    tprintf("short: %", 123);
+    CHECK(sink.last() == "short: 123" && gPrintBufPool.usedCount() == 0,
+        "Short message formatted on the stack");
+
+    // longer than the stack buffer, but fits in a block
+    auto exp = expected("medium: % %", rptChar('=', 70), "end");
+    size_t len = tprintf("medium: % %", rptChar('=', 70), "end");
+    CHECK(len == exp.size() && sink.last() == exp && gPrintBufPool.usedCount() == 0,
+        "Medium message formatted in a pool block");
+
+    // longer than a block
+    exp = expected("long: % % %", rptChar('=', 100), 1234567, "end");
+    sink.msgs.clear();
+    len = tprintf("long: % % %", rptChar('=', 100), 1234567, "end");
+    if (STM32PP_PRINT_BUF_POOL_POLICY == kPrintPoolDrop)
+    {
+        CHECK(len == 0 && sink.msgs.empty(), "Message longer than a block is dropped");
+    }
+    else
+    {
+        CHECK(len == sink.last().size() && len < kBlockSize && isPrefix(sink.last(), exp),
+            "Message longer than a block is truncated");
+    }
+    CHECK(gPrintBufPool.usedCount() == 0, "No blocks leaked");
+}
+
+void testExhausted()
+{
+    setPrintSink(&sink);
+    char* blocks[DefaultPrintBufPool::kNumBlocks];
+    for (auto& block: blocks)
+    {
+        block = gPrintBufPool.tryAlloc();
+    }
+    auto exp = expected("medium: % %", rptChar('=', 70), "end");
+    sink.msgs.clear();
+    if (STM32PP_PRINT_BUF_POOL_POLICY == kPrintPoolBlock)
+    {
+        // another context frees a block a bit later
+        std::thread other([&blocks]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            gPrintBufPool.free(blocks[0]);
+        });
+        auto start = std::chrono::steady_clock::now();
+        size_t len = tprintf("medium: % %", rptChar('=', 70), "end");
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        other.join();
+        CHECK(len == exp.size() && sink.last() == exp && elapsed >= std::chrono::milliseconds(40),
+            "Waited for a free block");
+        blocks[0] = nullptr;
+    }
+    else
+    {
+        size_t len = tprintf("medium: % %", rptChar('=', 70), "end");
+        if (STM32PP_PRINT_BUF_POOL_POLICY == kPrintPoolDrop)
+        {
+            CHECK(len == 0 && sink.msgs.empty(), "Message dropped when the pool is exhausted");
+        }
+        else
+        {
+            CHECK(len == sink.last().size() && len < kStackBufSize && isPrefix(sink.last(), exp),
+                "Message truncated to the stack buffer when the pool is exhausted");
+        }
+    }
+    for (auto block: blocks)
+    {
+        if (block)
+        {
+            gPrintBufPool.free(block);
+        }
+    }
+    CHECK(gPrintBufPool.usedCount() == 0, "No blocks leaked");
+}
+
+void testAsync()
+{
+    setPrintSink(&asyncSink);
+    tprintf("async: %\n", 1);
+    tprintf("async: % %\n", rptChar('=', 70), 2);
+    CHECK(asyncSink.output == "async: 1\n" + expected("async: % %\n", rptChar('=', 70), 2),
+        "Async sink output");
+    CHECK(gPrintBufPool.owns(asyncSink.buf()) && gPrintBufPool.usedCount() == 1,
+        "Async sink holds a single pool block");
+    setPrintSink(&sink);
+    CHECK(!asyncSink.buf() && gPrintBufPool.usedCount() == 0,
+        "Async sink buffer returned to the pool when switching sinks");
+}
+
+/** The length of the padding of message \c seq of context \c ctx, from 0 to
+ * longer than a block */
+uint16_t padLen(int ctx, int seq)
+{
+    return (ctx * 7919 + seq * 31) % 150;
+}
+
+/** Several contexts log at the same time, as the main loop and interrupts
+ * would. Threads interleave more aggressively than interrupts do, as they
+ * run in parallel. Each message is verified, and no block may be lost
+ */
+void testStress()
+{
+    enum { kContexts = 4, kMsgsPerContext = 20000 };
+    setPrintSink(&sink);
+    sink.msgs.clear();
+    std::atomic<int> returnedZero(0);
+    std::vector<std::thread> threads;
+    for (int ctx = 0; ctx < kContexts; ctx++)
+    {
+        threads.emplace_back([ctx, &returnedZero]()
+        {
+            for (int seq = 0; seq < kMsgsPerContext; seq++)
+            {
+                if (!tprintf("ctx % seq %: % end", ctx, seq, rptChar('=', padLen(ctx, seq))))
+                {
+                    returnedZero++;
+                }
+            }
+        });
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    int bad = 0, truncated = 0;
+    std::vector<int> lastSeq(kContexts, -1);
+    for (auto& msg: sink.msgs)
+    {
+        int ctx, seq;
+        if (sscanf(msg.c_str(), "ctx %d seq %d", &ctx, &seq) != 2 || ctx < 0 || ctx >= kContexts
+         || seq <= lastSeq[ctx])
+        {
+            bad++;
+            continue;
+        }
+        lastSeq[ctx] = seq;
+        auto exp = expected("ctx % seq %: % end", ctx, seq, rptChar('=', padLen(ctx, seq)));
+        if (msg == exp)
+        {
+            continue;
+        }
+        if (STM32PP_PRINT_BUF_POOL_POLICY != kPrintPoolDrop && isPrefix(msg, exp))
+        {
+            truncated++;
+        }
+        else
+        {
+            printf("Bad message: '%s'\n", msg.c_str());
+            bad++;
+        }
+    }
+    printf("Stress: %zu messages printed, %d dropped, %d truncated, pool exhausted %u times\n",
+        sink.msgs.size(), returnedZero.load(), truncated, gPrintBufPool.exhaustedCount());
+    CHECK(bad == 0, "All printed messages are intact");
+    CHECK(sink.msgs.size() + returnedZero == kContexts * kMsgsPerContext,
+        "Each message is either printed or dropped");
+    CHECK(STM32PP_PRINT_BUF_POOL_POLICY == kPrintPoolDrop || returnedZero == 0,
+        "No messages dropped");
+    CHECK(gPrintBufPool.usedCount() == 0, "No blocks leaked");
+}
+
+int main()
+{
+    testPool();
+    testSync();
+    testExhausted();
+    testAsync();
+    testStress();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,266 @@
+#include <stm32++/tprintf.hpp>
+#include <stm32++/dmaPrint.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <stdio.h>
+
+/** Mock of a ring sink, which outputs the data to a string, when told to.
+ * If autoDrain is set, waitForSpace() outputs one pending chunk, as if a DMA
+ * transfer completed */
+template <size_t Size>
+struct MockRingSink: public RingPrintSink<Size>
+{
+    typedef RingPrintSink<Size> Base;
+    std::string output;
+    bool autoDrain = false;
+    int drainCalls = 0;
+    void drain() { drainCalls++; }
+    bool waitForSpace()
+    {
+        return autoDrain && outputSome(Size);
+    }
+    bool outputSome(size_t maxLen)
+    {
+        const char* data;
+        size_t len = Base::pending(data);
+        if (!len)
+            return false;
+        if (len > maxLen)
+            len = maxLen;
+        output.append(data, len);
+        Base::consumed(len);
+        return true;
+    }
+    void outputAll()
+    {
+        while (outputSome(Size));
+    }
+    // Moves the read and write positions, to test wrapping at specific offsets
+    void setPos(size_t pos)
+    {
+        assert(Base::mReadPos == Base::mWritePos);
+        Base::mReadPos = Base::mWritePos = pos;
+    }
+};
+
+/** DMA device mock. A transfer completes when the test calls \c complete(), or
+ * with \c completeOnPoll, when the sink polls \c txBusy() while waiting */
+struct MockDma
+{
+    const char* mData = nullptr;
+    size_t mLen = 0;
+    bool mBusy = false;
+    bool completeOnPoll = false;
+    int txCount = 0;
+    std::string output;
+    void dmaTxStart(const void* data, size_t len)
+    {
+        assert(!mBusy);
+        mData = (const char*)data;
+        mLen = len;
+        mBusy = true;
+        txCount++;
+    }
+    bool txBusy()
+    {
+        if (mBusy && completeOnPoll)
+        {
+            complete();
+        }
+        return mBusy;
+    }
+    void dmaTxIsr() {}
+    virtual void txComplete() = 0;
+    bool complete()
+    {
+        if (!mBusy)
+        {
+            return false;
+        }
+        output.append(mData, mLen);
+        mBusy = false;
+        txComplete(); // the DMA interrupt
+        return true;
+    }
+    void completeAll()
+    {
+        while (complete());
+    }
+};
+
+struct PingPongSink: public dma::PingPongPrintSink<MockDma, 32>
+{
+    void txComplete() { dmaTxIsr(); }
+};
+
+MockRingSink<64> sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+template <typename F, typename... Args>
+void checkAt(size_t pos, F fmt, Args... args)
+{
+    char expected[128];
+    tsnprintf(expected, sizeof(expected), fmt, args...);
+    sink.output.clear();
+    sink.setPos(pos);
+    size_t len = tprintf(fmt, args...);
+    sink.outputAll();
+    if (len != strlen(expected) || sink.output != expected)
+    {
+        printf("ERROR: At ring pos %zu: expected '%s', got '%s' (returned len %zu)\n",
+            pos, expected, sink.output.c_str(), len);
+        errors++;
+    }
+}
+
+void testPingPong()
+{
+    PingPongSink pp;
+    auto savedSink = gPrintSink;
+    gPrintSink = &pp;
+
+    tprintf("first;");
+    CHECK(pp.txCount == 1 && pp.txBusy(), "Message sent immediately when the DMA is idle");
+    tprintf("a%;", 1);
+    tprintf("b%;", 2);
+    tprintf("c%;", 3);
+    CHECK(pp.txCount == 1, "Messages appended to the pending buffer while sending");
+    pp.complete();
+    CHECK(pp.txCount == 2 && pp.output == "first;", "Pending buffer sent on completion");
+    pp.completeAll();
+    CHECK(pp.txCount == 2 && pp.output == "first;a1;b2;c3;", "Appended messages sent with one transfer");
+
+    // Not sent by the interrupt while being written to
+    pp.output.clear();
+    tprintf("busy;");
+    tprintf("pending;");
+    IRingPrintSink::Span first, second;
+    pp.reserve(first, second, 4);
+    memcpy(first.buf, "new;", 4);
+    pp.complete();
+    CHECK(pp.txCount == 3 && !pp.txBusy(), "Buffer being written to is not sent by the interrupt");
+    pp.commit(4);
+    pp.completeAll();
+    CHECK(pp.txCount == 4 && pp.output == "busy;pending;new;", "Buffer sent on commit");
+
+    // Buffer full, the caller waits for the other one to be sent
+    pp.output.clear();
+    tprintf("%", rptChar('1', 20));
+    tprintf("%", rptChar('2', 20));
+    pp.completeOnPoll = true;
+    size_t len = tprintf("%", rptChar('3', 20));
+    pp.completeOnPoll = false;
+    pp.completeAll();
+    CHECK(len == 20 && pp.output == std::string(20, '1') + std::string(20, '2') + std::string(20, '3'),
+        "Waits for space when the buffer is full");
+
+    // Message longer than a buffer
+    pp.output.clear();
+    len = tprintf("%", rptChar('x', 40));
+    tprintf("after;");
+    pp.completeAll();
+    CHECK(len == 0 && pp.output == "after;", "Message longer than a buffer is dropped");
+
+    // Random message lengths, completing transfers at random times
+    pp.output.clear();
+    pp.completeOnPoll = true;
+    std::string expected;
+    for (int i = 0; i < 10000; i++)
+    {
+        char buf[32];
+        int rpt = rand() % 16;
+        tsnprintf(buf, sizeof(buf), "% [%]\n", i, rptChar('.', rpt));
+        expected += buf;
+        tprintf("% [%]\n", i, rptChar('.', rpt));
+        if (rand() % 3 == 0)
+        {
+            pp.complete();
+        }
+    }
+    pp.completeAll();
+    CHECK(pp.output == expected, "Random messages with concurrent output");
+    gPrintSink = savedSink;
+}
+
+int main()
+{
+    // The message and each argument wrapped at every possible position
+    for (size_t pos = 0; pos < 64; pos++)
+    {
+        checkAt(pos, "int: %, hex: %, str: '%' fp: %", -1234567, fmtHex<kNumPrefix>(0xdeadbeefu),
+            "a string", fmtFp<3>(-3.14159));
+        checkAt(pos, "%%%%%%%", 123456789u, 'c', rptChar('=', 7), fmtScaled<100>(-2345),
+            fmtQ<15>((int16_t)0x4000), (void*)0x1234, "end");
+        checkAt(pos, FMT("compiled: % and %"), 42, "text");
+        checkAt(pos, "no args, literal %");
+    }
+    printf("PASS: messages and arguments wrapped at all ring positions\n");
+
+    // Formatting into the ring doesn't call the sink's print()
+    sink.drainCalls = 0;
+    sink.output.clear();
+    tprintf("drain %\n", 1);
+    CHECK(sink.drainCalls == 1, "commit() calls drain() once per message");
+    sink.outputAll();
+
+    // Message larger than the free space, with the sink waiting for space
+    sink.autoDrain = true;
+    sink.output.clear();
+    tprintf("first message, which takes up %", "most of the ring.");
+    size_t len = tprintf("second message, % bytes", 24);
+    sink.outputAll();
+    CHECK(len == 24 && sink.output ==
+        "first message, which takes up most of the ring.second message, 24 bytes",
+        "Message waits for the sink to free space");
+
+    // Message larger than the free space, with a sink that can't wait
+    sink.autoDrain = false;
+    sink.output.clear();
+    tprintf("first message, which takes up %", "most of the ring.");
+    len = tprintf("second message, % bytes", 24);
+    sink.outputAll();
+    CHECK(len == 0 && sink.output == "first message, which takes up most of the ring.",
+        "Message that doesn't fit is dropped, if the sink can't wait");
+
+    // Message larger than the whole ring
+    sink.autoDrain = true;
+    sink.output.clear();
+    len = tprintf("%%", rptChar('x', 60), "0123456789");
+    sink.outputAll();
+    CHECK(len == 0 && sink.output.empty(), "Message larger than the ring is dropped");
+
+    // Plain print(), as used by puts() and binary logging
+    sink.output.clear();
+    sink.setPos(60);
+    puts("wrapped plain string", 20);
+    sink.outputAll();
+    CHECK(sink.output == "wrapped plain string", "print() copies into the ring");
+
+    // Random message lengths, with the sink outputting random amounts meanwhile
+    sink.output.clear();
+    std::string expected;
+    srand(1);
+    for (int i = 0; i < 10000; i++)
+    {
+        char buf[128];
+        int rpt = rand() % 40;
+        uint32_t val = rand();
+        tsnprintf(buf, sizeof(buf), "msg % [%] %\n", i, rptChar('.', rpt), fmtHex(val));
+        expected += buf;
+        tprintf("msg % [%] %\n", i, rptChar('.', rpt), fmtHex(val));
+        sink.outputSome(rand() % 64);
+    }
+    sink.outputAll();
+    CHECK(sink.output == expected, "Random messages with concurrent output");
+
+    testPingPong();
+
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include <stm32++/usart.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <stdio.h>
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+struct TestRing: public dma::RxRing<4>
+{
+    /** Sets the byte counts as if \c total bytes were received and consumed */
+    void primeCounts(uint32_t total)
+    {
+        mWritten = mRead = total;
+        mLastPos = mReadIdx = total % mSize;
+    }
+};
+
+/** Feeds the ring as a circular DMA would, \c remaining is the CNDTR */
+template <uint16_t Size=16>
+struct FakeDma
+{
+    uint8_t buf[Size];
+    uint16_t pos = 0;
+    TestRing ring;
+    FakeDma() { ring.start(buf, sizeof(buf)); }
+    uint16_t remaining() const { return sizeof(buf) - pos; }
+    void receive(const char* data, bool update=true)
+    {
+        for (; *data; data++)
+        {
+            buf[pos++] = *data;
+            if (pos == sizeof(buf))
+            {
+                pos = 0;
+            }
+            // the half and full transfer interrupts
+            if (update && (pos == 0 || pos == sizeof(buf) / 2))
+            {
+                ring.update(remaining());
+            }
+        }
+        ring.update(remaining());
+    }
+    void idle() { ring.markPacketEnd(); }
+};
+
+void testRing()
+{
+    FakeDma<> dma;
+    char buf[32];
+    dma.receive("abc");
+    CHECK(dma.ring.available() == 3, "Bytes available");
+    CHECK(dma.ring.readPacket(buf, sizeof(buf)) == 0, "No packet before the idle line");
+    dma.idle();
+    dma.receive("defg");
+    dma.idle();
+    CHECK(dma.ring.packetCount() == 2, "Two packets");
+    CHECK(dma.ring.readPacket(buf, sizeof(buf)) == 3 && memcmp(buf, "abc", 3) == 0, "First packet");
+    CHECK(dma.ring.readPacket(buf, sizeof(buf)) == 4 && memcmp(buf, "defg", 4) == 0, "Second packet");
+    dma.idle();
+    CHECK(dma.ring.packetCount() == 0, "Idle line without data is not a packet");
+
+    dma.receive("0123456789ab"); // wraps around the buffer
+    dma.idle();
+    CHECK(dma.ring.readPacket(buf, sizeof(buf)) == 12 && memcmp(buf, "0123456789ab", 12) == 0,
+        "Packet across the end of the buffer");
+    dma.receive("0123456789");
+    dma.idle();
+    CHECK(dma.ring.readPacket(buf, 4) == (size_t)-1, "Too long packet discarded");
+    CHECK(dma.ring.available() == 0, "Too long packet consumed");
+
+    dma.receive("one\r\ntwo\nthr");
+    CHECK(dma.ring.readLine(buf, sizeof(buf)) == 3 && strcmp(buf, "one") == 0, "First line");
+    CHECK(dma.ring.readLine(buf, sizeof(buf)) == 3 && strcmp(buf, "two") == 0, "\\r\\n is one line end");
+    CHECK(dma.ring.readLine(buf, sizeof(buf)) == 0, "Incomplete line not returned");
+    dma.receive("ee\n");
+    CHECK(dma.ring.readLine(buf, sizeof(buf)) == 5 && strcmp(buf, "three") == 0, "Line completed");
+    dma.receive("toolongline\n");
+    CHECK(dma.ring.readLine(buf, 5) == (size_t)-1 && strcmp(buf, "tool") == 0, "Too long line truncated");
+    dma.ring.readLine(buf, sizeof(buf));
+
+    CHECK(dma.ring.overrunBytes() == 0, "No overruns so far");
+    dma.receive("0123456789abcdefXYZ");
+    CHECK(dma.ring.overrunBytes() == 3, "Overrun when the consumer is a buffer behind");
+    CHECK(dma.ring.available() == 16, "A full buffer is available after an overrun");
+    CHECK(dma.ring.read(buf, sizeof(buf)) == 16 && memcmp(buf, "3456789abcdefXYZ", 16) == 0,
+        "The most recent data is kept");
+
+    for (int i = 0; i < 6; i++)
+    {
+        dma.receive("p");
+        dma.idle();
+    }
+    CHECK(dma.ring.packetCount() == 4, "Packet count limited");
+    dma.ring.readPacket(buf, sizeof(buf));
+    dma.ring.readPacket(buf, sizeof(buf));
+    dma.ring.readPacket(buf, sizeof(buf));
+    CHECK(dma.ring.readPacket(buf, sizeof(buf)) == 3, "Excess packets merged into the last one");
+}
+
+void testCountWrap()
+{
+    // The byte counts wrap around at 2^32, which is not a multiple of the buffer size
+    FakeDma<100> dma;
+    uint32_t start = 0xffffffff - 50 + 1;
+    dma.ring.primeCounts(start);
+    dma.pos = start % 100;
+    std::string sent, received;
+    char buf[32];
+    for (int i = 0; i < 10; i++)
+    {
+        std::string chunk = "chunk " + std::to_string(i) + "\n";
+        dma.receive(chunk.c_str());
+        sent += chunk;
+        size_t len = dma.ring.read(buf, sizeof(buf));
+        received.append(buf, len);
+    }
+    CHECK(received == sent, "Data read across the wrap-around of the byte counts");
+    dma.receive("wrapped\n");
+    CHECK(dma.ring.readLine(buf, sizeof(buf)) == 7 && strcmp(buf, "wrapped") == 0,
+        "Line read after the wrap-around of the byte counts");
+    dma.receive("packet");
+    dma.idle();
+    CHECK(dma.ring.readPacket(buf, sizeof(buf)) == 6 && memcmp(buf, "packet", 6) == 0,
+        "Packet read after the wrap-around of the byte counts");
+    CHECK(dma.ring.overrunBytes() == 0, "No overruns across the wrap-around");
+}
+
+enum: sim::Cycles { kTimeout = 10000000 };
+typedef nsusart::DmaRxRing<nsusart::Usart<USART1>> RingUsart;
+RingUsart usart;
+extern "C" void dma1_channel5_isr() { usart.dmaRxIsr(); }
+extern "C" void usart1_isr() { usart.usartRxIsr(); }
+
+void testUsart()
+{
+    sim::reset();
+    auto& model = sim::usart(USART1);
+    static uint8_t ringBuf[64];
+    usart.init(nsusart::kOptEnableRx, 115200);
+    usart.rxRingStart(ringBuf, sizeof(ringBuf));
+    char buf[64];
+    CHECK(usart.available() == 0 && usart.readPacket(buf, sizeof(buf)) == 0, "Nothing received yet");
+
+    model.rxInject("hello");
+    sim::runUntil([]() { return usart.available() == 2; }, kTimeout);
+    CHECK(usart.available() == 2 && usart.packetCount() == 0, "Data available while the packet arrives");
+    sim::runUntil([]() { return usart.packetCount() != 0; }, kTimeout);
+    CHECK(usart.readPacket(buf, sizeof(buf)) == 5 && memcmp(buf, "hello", 5) == 0,
+        "Packet ended by the idle line");
+
+    // Packets arriving back to back with idle gaps, across the end of the buffer
+    std::string sent;
+    for (int i = 0; i < 10; i++)
+    {
+        char packet[16];
+        tsnprintf(packet, sizeof(packet), "packet %", i);
+        model.rxInject(packet);
+        sim::runUntil([]() { return usart.packetCount() != 0; }, kTimeout);
+        size_t rlen = usart.readPacket(buf, sizeof(buf));
+        if (rlen != (size_t)-1)
+        {
+            sent.append(buf, rlen);
+        }
+        sent += '|';
+    }
+    CHECK(sent == "packet 0|packet 1|packet 2|packet 3|packet 4|packet 5|packet 6|"
+        "packet 7|packet 8|packet 9|", "Packets received in order");
+
+    model.rxInject("set 1\r\nget\r\n");
+    sim::runUntil([]() { return usart.packetCount() != 0; }, kTimeout);
+    CHECK(usart.readLine(buf, sizeof(buf)) == 5 && strcmp(buf, "set 1") == 0, "First command line");
+    CHECK(usart.readLine(buf, sizeof(buf)) == 3 && strcmp(buf, "get") == 0, "Second command line");
+    CHECK(usart.readLine(buf, sizeof(buf)) == 0, "No more lines");
+    CHECK(usart.packetCount() == 0, "Packet consumed by the lines");
+
+    std::string longData(100, 'x');
+    model.rxInject(longData.c_str());
+    sim::runUntil([&]() { return usart.packetCount() != 0; }, kTimeout);
+    CHECK(usart.rxOverrunBytes() == 100 - sizeof(ringBuf), "Overrun when the consumer doesn't read in time");
+    CHECK(usart.available() == sizeof(ringBuf), "The last buffer of data is kept");
+    CHECK(usart.rxHwOverrunCount() == 0, "No USART overruns with DMA");
+    usart.rxRingStop();
+}
+
+int main()
+{
+    testRing();
+    testCountWrap();
+    testUsart();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <stm32++/tprintf.hpp>
+#include <stm32++/semihostingPrint.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+struct Write
+{
+    int fd;
+    std::string data;
+};
+std::vector<Write> writes;
+
+/** Stand-in for the semihosting breakpoint, that records the writes */
+size_t shost::bkpt(size_t cmd, size_t arg1)
+{
+    assert(cmd == SYS_WRITE);
+    size_t* msg = (size_t*)arg1;
+    writes.push_back(Write{(int)msg[0], std::string((const char*)msg[1], msg[2])});
+    return 0;
+}
+
+struct NullSink: public IPrintSink
+{
+    BufferInfo* waitReady() { return nullptr; }
+    void print(const char*, size_t, int) {}
+};
+
+int errors = 0;
+
+bool wrote(const std::vector<Write>& expected)
+{
+    bool ok = writes.size() == expected.size();
+    for (size_t i = 0; ok && i < writes.size(); i++)
+    {
+        ok = writes[i].fd == expected[i].fd && writes[i].data == expected[i].data;
+    }
+    writes.clear();
+    return ok;
+}
+
+int main()
+{
+    extern IPrintSink* gPrintSink;
+    auto& sink = *static_cast<shost::BufferedPrintSink<32>*>(gPrintSink);
+
+    tprintf("abc % ", 1);
+    tprintf("def");
+    CHECK(writes.empty() && sink.bufferedLen() == 9, "Messages without a newline are buffered");
+    tprintf(" %\n", 2);
+    CHECK(wrote({{1, "abc 1 def 2\n"}}), "Newline flushes with a single write");
+
+    tprintf("%", rptChar('a', 20));
+    tprintf("%", rptChar('b', 20));
+    CHECK(wrote({{1, std::string(20, 'a')}}) && sink.bufferedLen() == 20,
+        "Buffer flushed when the next message doesn't fit");
+    tprintf("%", rptChar('c', 12));
+    CHECK(wrote({{1, std::string(20, 'b') + std::string(12, 'c')}}) && !sink.bufferedLen(),
+        "Full buffer flushed");
+
+    tprintf("short");
+    tprintf("%", rptChar('l', 40));
+    CHECK(wrote({{1, "short"}, {1, std::string(40, 'l')}}) && !sink.bufferedLen(),
+        "Message longer than the buffer written directly, after the buffered output");
+
+    tprintf("out");
+    ftprintf(2, "err");
+    CHECK(wrote({{1, "out"}}), "Printing to another file descriptor flushes");
+    sink.flush();
+    CHECK(wrote({{2, "err"}}), "Explicit flush");
+    sink.flush();
+    CHECK(writes.empty(), "Flush of an empty buffer doesn't write");
+
+    NullSink other;
+    tprintf("before switch");
+    auto prev = setPrintSink(&other);
+    CHECK(wrote({{1, "before switch"}}), "Buffer flushed when switching sinks");
+    setPrintSink(prev);
+
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
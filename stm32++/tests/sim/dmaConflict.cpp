@@ -0,0 +1,15 @@
+// Built by CMakeLists.txt with try_compile(): USART1 Tx and SPI2 Rx both use
+// DMA1 channel 4, so the registry must fail to compile, unless the channel is
+// shared by both
+#include <stm32++/usart.hpp>
+#include <stm32++/spi.hpp>
+
+#ifdef SHARED
+    enum: uint8_t { kOpts = dma::kDefaultOpts | dma::kDmaShared };
+#else
+    enum: uint8_t { kOpts = dma::kDefaultOpts };
+#endif
+
+typedef dma::Tx<nsusart::Usart<USART1>, kOpts> UsartTx;
+typedef dma::Rx<nsspi::SpiMaster<SPI2>, kOpts> SpiRx;
+STM32PP_DMA_REGISTRY(UsartTx, SpiRx);
@@ -0,0 +1,271 @@
+#include <stm32++/usart.hpp>
+#include <stm32++/spi.hpp>
+#include <stm32++/i2c.hpp>
+#include <stm32++/dmaMemCopy.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+enum: sim::Cycles { kTimeout = 10000000 };
+
+nsusart::Usart<USART1> console;
+dma::Tx<nsusart::Usart<USART2>> dmaUsart;
+dma::Rx<nsusart::Usart<USART3>, dma::kDefaultOpts | dma::kDmaCircularMode> rxUsart;
+dma::Tx<nsspi::SpiMaster<SPI2>> dmaSpi;
+nsi2c::I2c<I2C1> i2c;
+
+// The channels of the test peripherals are distinct
+STM32PP_DMA_REGISTRY(decltype(dmaUsart), decltype(rxUsart), decltype(dmaSpi));
+// USART1 Tx and SPI2 Rx both use DMA1 channel 4, which is allowed when both are shared
+typedef dma::Tx<nsusart::Usart<USART1>, dma::kDefaultOpts | dma::kDmaShared> SharedUsartTx;
+typedef dma::Rx<nsspi::SpiMaster<SPI2>, dma::kDefaultOpts | dma::kDmaShared> SharedSpiRx;
+STM32PP_DMA_REGISTRY(SharedUsartTx, SharedSpiRx, decltype(dmaUsart));
+// Without kDmaShared on both, the registry must fail to compile - see dmaConflict.cpp
+
+extern "C" void dma1_channel7_isr() { dmaUsart.dmaTxIsr(); }
+extern "C" void dma1_channel3_isr() { rxUsart.dmaRxIsr(); }
+extern "C" void dma1_channel5_isr() { dmaSpi.dmaTxIsr(); }
+
+void testUsartBlocking()
+{
+    sim::reset();
+    auto& model = sim::usart(USART1);
+    console.init(nsusart::kOptEnableTx | nsusart::kOptEnableRx, 115200);
+    CHECK(USART_BRR(USART1) == 625, "Baud rate divider from the APB2 clock");
+    sim::Cycles start = sim::now();
+    console.sendBlocking("hello");
+    CHECK(sim::runUntil([&]() { return model.txIdle(); }, kTimeout), "Transmission completes");
+    CHECK(model.takeTxData() == "hello", "Frames sent in order");
+    sim::Cycles elapsed = sim::now() - start;
+    CHECK(elapsed >= 5 * model.frameCycles() && elapsed < 6 * model.frameCycles(),
+        "Transmission takes 5 frame times");
+
+    model.rxInject("line\n");
+    char buf[16];
+    size_t len = console.recvLine(buf, sizeof(buf));
+    CHECK(len == 4 && std::string(buf) == "line", "Blocking reception");
+}
+
+std::vector<std::string> freed;
+void onTxDone(void* data) { freed.push_back((const char*)data); }
+
+void testUsartDmaTx()
+{
+    sim::reset();
+    auto& model = sim::usart(USART2);
+    dmaUsart.init(nsusart::kOptEnableTx, 115200);
+    static const char msg[] = "DMA transfer";
+    dmaUsart.dmaTxStart(msg, sizeof(msg) - 1);
+    CHECK(dmaUsart.txBusy(), "Transfer in progress");
+    CHECK(sim::runUntil([]() { return !dmaUsart.txBusy(); }, kTimeout), "DMA interrupt ends the transfer");
+    CHECK(sim::runUntil([&]() { return model.txIdle(); }, kTimeout), "Last frame shifted out");
+    CHECK(model.takeTxData() == msg, "Buffer sent");
+
+    freed.clear();
+    static const char* msgs[] = { "one", "two", "three" };
+    for (auto str: msgs)
+    {
+        CHECK(dmaUsart.dmaTxEnqueue(str, strlen(str), onTxDone), "Transfer queued");
+    }
+    CHECK(dmaUsart.txQueued() == 2, "The first transfer started, two are queued");
+    sim::runUntil([]() { return !dmaUsart.txBusy(); }, kTimeout);
+    sim::runUntil([&]() { return model.txIdle(); }, kTimeout);
+    CHECK(model.takeTxData() == "onetwothree", "Queued transfers sent back to back");
+    CHECK(freed.size() == 3 && freed[0] == "one" && freed[2] == "three", "Buffers freed in order");
+
+    freed.clear();
+    for (auto str: msgs)
+    {
+        dmaUsart.dmaTxEnqueue(str, strlen(str), onTxDone);
+    }
+    dmaUsart.dmaTxStop();
+    CHECK(!dmaUsart.txBusy() && dmaUsart.txQueued() == 0, "Stop drops the queued transfers");
+    CHECK(freed.size() == 3 && freed[0] == "one" && freed[2] == "three",
+        "Stop frees the aborted and the queued buffers");
+    sim::runUntil([&]() { return model.txIdle(); }, kTimeout);
+    model.takeTxData();
+}
+
+void testUsartDmaTxQueueFull()
+{
+    sim::reset();
+    auto& model = sim::usart(USART2);
+    dmaUsart.init(nsusart::kOptEnableTx, 115200);
+    enum { kQueueLen = 4 }; // the default of dma::Tx
+    // Long enough for the transfer in progress to outlast the enqueueing
+    static const char* msgs[] = { "msg0", "msg1", "msg2", "msg3", "msg4", "msg5" };
+    static_assert(sizeof(msgs) / sizeof(msgs[0]) == kQueueLen + 2, "");
+    freed.clear();
+    CHECK(dmaUsart.dmaTxEnqueue(msgs[0], 4, onTxDone) && dmaUsart.txQueued() == 0,
+        "First transfer started, not queued");
+    bool queued = true;
+    for (int i = 1; i <= kQueueLen; i++)
+    {
+        queued = dmaUsart.dmaTxEnqueue(msgs[i], 4, onTxDone) && dmaUsart.txQueued() == i && queued;
+    }
+    CHECK(queued, "Queue length tracks the queued transfers");
+    CHECK(!dmaUsart.dmaTxEnqueue(msgs[kQueueLen + 1], 4, onTxDone) && dmaUsart.txQueued() == kQueueLen,
+        "Transfer rejected when the queue is full");
+    sim::runUntil([]() { return !dmaUsart.txBusy(); }, kTimeout);
+    sim::runUntil([&]() { return model.txIdle(); }, kTimeout);
+    CHECK(dmaUsart.txQueued() == 0 && model.takeTxData() == "msg0msg1msg2msg3msg4", "Accepted transfers sent");
+    CHECK(freed.size() == kQueueLen + 1 && freed.back() == "msg4", "Rejected buffer is not freed");
+}
+
+std::string streamed;
+void onRxHalf(const void* data, uint16_t size, void*) { streamed.append((const char*)data, size); }
+
+void testUsartDmaRxStream()
+{
+    sim::reset();
+    auto& model = sim::usart(USART3);
+    rxUsart.init(nsusart::kOptEnableRx, 115200);
+    static char buf[16];
+    streamed.clear();
+    rxUsart.dmaRxStreamStart(buf, sizeof(buf), onRxHalf, onRxHalf, nullptr, false);
+    model.rxInject("0123456789abcdefghijklmnopqrstuvwxyz");
+    sim::runUntil([&]() { return model.rxPending() == 0; }, kTimeout);
+    CHECK(streamed == "0123456789abcdefghijklmnopqrstuv", "Halves streamed in order");
+    CHECK(rxUsart.dmaRxOverrunCount() == 0, "No overruns");
+    rxUsart.dmaRxStop();
+}
+
+void testUsartDmaRxStreamAfterOneShot()
+{
+    sim::reset();
+    auto& model = sim::usart(USART3);
+    rxUsart.init(nsusart::kOptEnableRx, 115200);
+    static char header[4];
+    static char buf[16];
+    streamed.clear();
+    rxUsart.dmaRxStart(header, sizeof(header));
+    model.rxInject("HEAD0123456789abcdefghijklmnopqrstuvwxyz");
+    // Waits for the one-shot transfer before streaming
+    rxUsart.dmaRxStreamStart(buf, sizeof(buf), onRxHalf, onRxHalf, nullptr, false);
+    CHECK(memcmp(header, "HEAD", 4) == 0 && streamed.empty(),
+        "One-shot transfer completes before the stream starts");
+    sim::runUntil([&]() { return model.rxPending() == 0; }, kTimeout);
+    CHECK(streamed == "0123456789abcdefghijklmnopqrstuv", "Stream after a one-shot transfer");
+    rxUsart.dmaRxStop();
+}
+
+void testSpi()
+{
+    sim::reset();
+    auto& model = sim::spi(SPI2);
+    model.setSlave([](uint16_t mosi) { return (uint16_t)~mosi; });
+    dmaSpi.init((uint8_t)8, nsspi::kSoftwareNSS);
+    CHECK(dmaSpi.baudrate() == 36000000 / 8, "Prescaler from the requested ratio");
+    dmaSpi.send(0x12);
+    CHECK(dmaSpi.recv() == 0xed, "Full-duplex word exchange");
+
+    model.clearMosi();
+    static const uint8_t data[] = { 1, 2, 3, 4, 5 };
+    dmaSpi.dmaTxStart(data, sizeof(data));
+    CHECK(sim::runUntil([]() { return !dmaSpi.txBusy(); }, kTimeout), "DMA transfer completes");
+    CHECK(model.mosi() == std::vector<uint16_t>({1, 2, 3, 4, 5}), "Buffer sent on MOSI");
+    CHECK(!dmaSpi.isBusy(), "Bus idle after the DMA interrupt");
+}
+
+/** A 256-byte I2C EEPROM, the first byte written sets the address */
+struct Eeprom: public sim::I2cDevice
+{
+    uint8_t mem[256] = {};
+    uint8_t addr = 0;
+    bool addrSet = false;
+    virtual bool onStart(bool read) { addrSet = read; return true; }
+    virtual bool onWrite(uint8_t byte)
+    {
+        if (!addrSet)
+        {
+            addr = byte;
+            addrSet = true;
+        }
+        else
+        {
+            mem[addr++] = byte;
+        }
+        return true;
+    }
+    virtual uint8_t onRead() { return mem[addr++]; }
+};
+
+void testI2c()
+{
+    sim::reset();
+    Eeprom eeprom;
+    sim::i2c(I2C1).attach(0x50, &eeprom);
+    i2c.init();
+    CHECK(i2c.startSend(0x50), "Device acknowledges its address");
+    i2c.sendByte(0x10, 'a', 'b', 'c');
+    i2c.stop();
+    // The stop condition is generated after the last byte is shifted out
+    sim::runUntil([]() { return !(I2C_SR2(I2C1) & I2C_SR2_BUSY); }, kTimeout);
+    CHECK(memcmp(eeprom.mem + 0x10, "abc", 3) == 0, "Bytes written");
+
+    CHECK(i2c.startSend(0x50), "Write of the read address");
+    i2c.sendByte(0x10);
+    CHECK(i2c.startRecv(0x50, true), "Repeated start for reading");
+    uint8_t buf[3];
+    i2c.recv(buf, sizeof(buf));
+    i2c.stop();
+    CHECK(memcmp(buf, "abc", 3) == 0, "Bytes read back");
+    CHECK(!i2c.isDeviceConnected(0x51), "Missing device not acknowledged");
+    sim::i2c(I2C1).attach(0x50, nullptr);
+}
+
+void testMemCopy()
+{
+    sim::reset();
+    dma::MemCopy<DMA1, 6> copier;
+    copier.init();
+    static uint32_t src[256], dst[256];
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        src[i] = i * 0x01010101;
+    }
+    sim::Cycles start = sim::now();
+    CHECK(copier.copy(dst, src, sizeof(src)), "Copy done by the DMA");
+    CHECK(copier.wait(), "No transfer error");
+    CHECK(memcmp(dst, src, sizeof(src)) == 0, "Block copied");
+    CHECK(sim::now() - start >= 256 * sim::DmaModel::kMem2MemCycles, "Copy takes time");
+    CHECK(copier.fill(dst, 0x5a, sizeof(dst)) && copier.wait() && dst[100] == 0x5a5a5a5a, "Block filled");
+}
+
+void testSharedChannel()
+{
+    sim::reset();
+    // USART2 Tx owns DMA1 channel 7, so the copier falls back to the CPU
+    dma::MemCopy<DMA1, 7> copier;
+    static uint8_t src[128], dst[128];
+    CHECK(!copier.copy(dst, src, sizeof(src)), "Owned channel not used for copying");
+    dma::ChannelArbiter::release(DMA1, 7, dmaUsart.kDmaTxOwnerId);
+    CHECK(copier.copy(dst, src, sizeof(src)) && copier.wait(), "Released channel used for copying");
+    CHECK(dma::ChannelArbiter::owner(DMA1, 7) == dma::ChannelArbiter::kNoOwner,
+        "Channel released after copying");
+}
+
+int main()
+{
+    testUsartBlocking();
+    testUsartDmaTx();
+    testUsartDmaTxQueueFull();
+    testUsartDmaRxStream();
+    testUsartDmaRxStreamAfterOneShot();
+    testSpi();
+    testI2c();
+    testMemCopy();
+    testSharedChannel();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include <stm32++/spiBus.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+enum: sim::Cycles { kTimeout = 100000000 };
+typedef nsgpio::Pin<GPIOA, GPIO4> DisplayCs;
+typedef nsgpio::Pin<GPIOB, GPIO0> FlashCs;
+typedef nsgpio::Pin<GPIOB, GPIO1> SensorCs;
+
+nsspi::SpiBus<SPI1> bus;
+nsspi::SpiDevice display, flash, sensor;
+extern "C" void dma1_channel2_isr() { bus.dmaXferIsr(); }
+extern "C" void dma1_channel3_isr() { bus.dmaXferIsr(); }
+
+/** A word on the bus, with the device that was selected while it was sent */
+struct BusWord
+{
+    char device; // 'D', 'F', 'S', '-' for none, '*' for more than one
+    uint16_t cr1;
+    uint16_t word;
+    bool operator==(const BusWord& other) const
+    {
+        return device == other.device && cr1 == other.cr1 && word == other.word;
+    }
+};
+std::vector<BusWord> words;
+int csEdges = 0;
+
+char selectedDevice()
+{
+    std::string sel;
+    if (!(sim::gpio(GPIOA).odr() & GPIO4))
+        sel += 'D';
+    if (!(sim::gpio(GPIOB).odr() & GPIO0))
+        sel += 'F';
+    if (!(sim::gpio(GPIOB).odr() & GPIO1))
+        sel += 'S';
+    return sel.empty() ? '-' : (sel.size() > 1 ? '*' : sel[0]);
+}
+
+void setup()
+{
+    sim::reset();
+    words.clear();
+    csEdges = 0;
+    sim::spi(SPI1).setSlave([](uint16_t mosi)
+    {
+        uint16_t cr1 = sim::spi(SPI1).read(sim::SpiModel::kCr1) & 0xfbb; // the config bits
+        words.push_back({selectedDevice(), cr1, mosi});
+        return (uint16_t)~mosi;
+    });
+    sim::gpio(GPIOB).setOutputCallback([](uint16_t, uint16_t changed) { csEdges += __builtin_popcount(changed); });
+    bus.init();
+    bus.initDevice<DisplayCs>(display, (uint8_t)2, nsspi::k16BitFrame);
+    bus.initDevice<FlashCs>(flash, nsspi::Baudrate(18000000), nsspi::kIdleClockIsLow | nsspi::kFirstClockTransition);
+    bus.initDevice<SensorCs>(sensor, (uint8_t)16, nsspi::kIdleClockIsHigh | nsspi::kFirstClockTransition | nsspi::kLsbFirst);
+    csEdges = 0;
+}
+
+std::vector<BusWord> wordsOf(char device, uint16_t cr1, std::vector<uint16_t> data)
+{
+    std::vector<BusWord> result;
+    for (auto word: data)
+    {
+        result.push_back({device, cr1, word});
+    }
+    return result;
+}
+
+std::vector<BusWord> operator+(std::vector<BusWord> a, const std::vector<BusWord>& b)
+{
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+void testDevices()
+{
+    setup();
+    CHECK(selectedDevice() == '-', "Chip selects deasserted after init");
+    CHECK(display.mCr1 == (SPI_CR1_BAUDRATE_FPCLK_DIV_2 | SPI_CR1_CPOL | SPI_CR1_CPHA | SPI_CR1_DFF)
+        && flash.mCr1 == SPI_CR1_BAUDRATE_FPCLK_DIV_4
+        && sensor.mCr1 == (SPI_CR1_BAUDRATE_FPCLK_DIV_16 | SPI_CR1_CPOL | SPI_CR1_LSBFIRST),
+        "Device settings");
+
+    uint8_t flashTx[3] = { 0x9f, 1, 2 };
+    uint8_t flashRx[3] = {};
+    nsspi::SpiTransaction xfer(flash, flashTx, flashRx, sizeof(flashTx));
+    CHECK(bus.transact(xfer) && xfer.ok(), "Transaction completes");
+    CHECK(words == wordsOf('F', flash.mCr1, {0x9f, 1, 2}), "Words sent with the device selected and configured");
+    CHECK(flashRx[0] == 0x60 && flashRx[2] == 0xfd, "Words received");
+    CHECK(selectedDevice() == '-' && csEdges == 2, "Chip select asserted once");
+
+    uint16_t pixels[2] = { 0xf800, 0x07e0 };
+    nsspi::SpiTransaction pix(display, pixels, nullptr, sizeof(pixels));
+    CHECK(bus.transact(pix), "Write to a 16-bit device");
+    uint8_t sample[2];
+    nsspi::SpiTransaction rd(sensor, nullptr, sample, sizeof(sample));
+    rd.mFill = 0x80;
+    CHECK(bus.transact(rd), "Read from a device");
+    CHECK(sample[0] == 0x7f && sample[1] == 0x7f, "Data of the read");
+    CHECK(words == wordsOf('F', flash.mCr1, {0x9f, 1, 2}) + wordsOf('D', display.mCr1, {0xf800, 0x07e0})
+        + wordsOf('S', sensor.mCr1, {0x80, 0x80}), "Each device gets its own settings");
+    uint32_t switches = bus.configSwitchCount();
+    CHECK(switches == 3, "CR1 programmed for each device change");
+    CHECK(bus.transact(rd), "Second read");
+    CHECK(bus.configSwitchCount() == switches, "CR1 not reprogrammed for the same device");
+    CHECK(!(SPI_SR(SPI1) & SPI_SR_OVR), "No overrun");
+}
+
+std::string doneOrder;
+void onDone(bool ok, void* userp)
+{
+    doneOrder += ok ? *(const char*)userp : '!';
+}
+
+nsspi::SpiTransaction* pollXfer;
+int pollsLeft;
+void onPoll(bool ok, void* userp)
+{
+    doneOrder += 'p';
+    if (--pollsLeft)
+    {
+        bus.enqueue(*pollXfer); // requeued from the completion interrupt
+    }
+}
+
+void testQueue()
+{
+    setup();
+    static const uint8_t readCmd[4] = { 0x03, 0, 1, 0 };
+    uint8_t flashData[4] = {};
+    nsspi::SpiTransaction cmd(flash, readCmd, nullptr, sizeof(readCmd), onDone, (void*)"c");
+    nsspi::SpiTransaction data(flash, nullptr, flashData, sizeof(flashData), onDone, (void*)"d");
+    cmd.mNext = &data;
+
+    uint16_t pixels[3] = { 1, 2, 3 };
+    nsspi::SpiTransaction pix(display, pixels, nullptr, sizeof(pixels), onDone, (void*)"x");
+    static const uint8_t wren[1] = { 0x06 };
+    nsspi::SpiTransaction flashWren(flash, wren, nullptr, 1, onDone, (void*)"w");
+    static const uint8_t erase[4] = { 0x20, 0, 0x10, 0 };
+    nsspi::SpiTransaction flashErase(flash, erase, nullptr, sizeof(erase), onDone, (void*)"e");
+
+    uint8_t sample[2];
+    nsspi::SpiTransaction poll(sensor, nullptr, sample, sizeof(sample), onPoll, nullptr);
+    pollXfer = &poll;
+    pollsLeft = 3;
+    doneOrder.clear();
+
+    // Several clients queue their transactions while the bus is busy
+    bus.enqueue(cmd);
+    CHECK(!bus.idle() && cmd.mState == nsspi::SpiTransaction::kRunning, "First transaction started immediately");
+    bus.enqueue(poll);
+    bus.enqueue(pix);
+    bus.enqueue(flashWren);
+    bus.enqueue(flashErase);
+    CHECK(pix.mState == nsspi::SpiTransaction::kQueued, "Others queued");
+    sim::runUntil([]() { return bus.idle(); }, kTimeout);
+    CHECK(bus.idle() && selectedDevice() == '-', "Queue drained");
+    CHECK(doneOrder == "cdpxwepp", "Transactions run in order, requeued ones at the end");
+    CHECK(cmd.ok() && data.ok() && pix.ok() && flashErase.ok(), "All completed");
+    CHECK(flashData[0] == 0 && flashData[3] == 0, "Chained read got the data");
+    auto expected = wordsOf('F', flash.mCr1, {0x03, 0, 1, 0, 0xff, 0xff, 0xff, 0xff})
+        + wordsOf('S', sensor.mCr1, {0xff, 0xff})
+        + wordsOf('D', display.mCr1, {1, 2, 3})
+        + wordsOf('F', flash.mCr1, {0x06})
+        + wordsOf('F', flash.mCr1, {0x20, 0, 0x10, 0})
+        + wordsOf('S', sensor.mCr1, {0xff, 0xff, 0xff, 0xff});
+    CHECK(words == expected, "Words of each transaction sent to its device");
+    // flash, sensor, display, flash, and sensor again for the requeued polls
+    CHECK(bus.configSwitchCount() == 5, "CR1 reprogrammed only on device changes");
+    // Flash: chain, wren and erase - each asserts and deasserts CS once,
+    // sensor: 3 polls
+    CHECK(csEdges == 2 * 3 + 2 * 3, "Chip select held for the whole chain");
+    CHECK(dma::ChannelArbiter::owner(DMA1, 2) == dma::ChannelArbiter::kNoOwner &&
+        dma::ChannelArbiter::owner(DMA1, 3) == dma::ChannelArbiter::kNoOwner, "Channels released");
+}
+
+void testSharedChannel()
+{
+    setup();
+    enum: uint32_t { kOtherOwner = USART1 | 1 };
+    // Another peripheral is using the Tx channel
+    CHECK(dma::ChannelArbiter::tryAcquire(DMA1, 3, kOtherOwner), "Channel taken by another peripheral");
+    static const uint8_t wren[1] = { 0x06 };
+    nsspi::SpiTransaction xfer(flash, wren, nullptr, 1);
+    uint8_t sample[2];
+    nsspi::SpiTransaction poll(sensor, nullptr, sample, sizeof(sample));
+    bus.enqueue(xfer); // must not wait for the channel
+    bus.enqueue(poll);
+    CHECK(xfer.mState == nsspi::SpiTransaction::kQueued && selectedDevice() == '-',
+        "Transaction waits for the channel, device not selected");
+    sim::runUntil([]() { return false; }, 100000);
+    CHECK(words.empty() && !xfer.isComplete(), "Nothing sent while the channel is in use");
+    dma::ChannelArbiter::release(DMA1, 3, kOtherOwner);
+    CHECK(xfer.mState == nsspi::SpiTransaction::kRunning, "Started when the channel is released");
+    sim::runUntil([]() { return bus.idle(); }, kTimeout);
+    CHECK(xfer.ok() && poll.ok(), "Queue drained");
+    CHECK(words == wordsOf('F', flash.mCr1, {0x06}) + wordsOf('S', sensor.mCr1, {0xff, 0xff}),
+        "Words of the delayed transactions");
+}
+
+int main()
+{
+    testDevices();
+    testQueue();
+    testSharedChannel();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
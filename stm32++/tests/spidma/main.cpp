@@ -0,0 +1,190 @@
+#include <stm32++/spi.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+enum: sim::Cycles { kTimeout = 100000000 };
+typedef std::vector<uint16_t> Words;
+
+nsspi::SpiMaster<SPI1> spi;
+dma::Tx<nsspi::SpiMaster<SPI2>, dma::kDefaultOpts | dma::kDmaShared> sharedSpi;
+extern "C" void dma1_channel2_isr() { spi.dmaXferIsr(); }
+extern "C" void dma1_channel3_isr() { spi.dmaXferIsr(); }
+extern "C" void dma1_channel4_isr() { sharedSpi.dmaXferIsr(); }
+extern "C" void dma1_channel5_isr()
+{
+    if (sharedSpi.dmaTxOwnsChannel())
+    {
+        sharedSpi.dmaTxIsr();
+    }
+    else
+    {
+        sharedSpi.dmaXferIsr();
+    }
+}
+
+int doneCount = 0;
+bool doneOk = false;
+void onDone(bool ok, void* userp)
+{
+    doneCount++;
+    doneOk = ok;
+    CHECK(userp == &spi, "Callback gets its user pointer");
+}
+
+void test8Bit()
+{
+    sim::reset();
+    auto& model = sim::spi(SPI1);
+    model.setSlave([](uint16_t mosi) { return (uint16_t)(mosi ^ 0xff); });
+    spi.init((uint8_t)4, nsspi::kSoftwareNSS);
+
+    uint8_t tx[100], rx[100];
+    for (int i = 0; i < 100; i++)
+    {
+        tx[i] = i;
+    }
+    memset(rx, 0, sizeof(rx));
+    doneCount = 0;
+    sim::Cycles start = sim::now();
+    spi.transfer(tx, rx, sizeof(tx), onDone, &spi);
+    CHECK(spi.transferBusy(), "Transfer runs in the background");
+    CHECK(sim::runUntil([]() { return doneCount == 1; }, kTimeout) && doneOk, "Callback called when done");
+    sim::Cycles elapsed = sim::now() - start;
+    CHECK(!spi.transferBusy() && !spi.isBusy(), "SPI idle after the callback");
+    bool rxOk = true;
+    for (int i = 0; i < 100; i++)
+    {
+        rxOk &= (rx[i] == (uint8_t)(i ^ 0xff));
+    }
+    CHECK(rxOk, "Received words match the sent ones");
+    CHECK(model.mosi().size() == 100 && model.mosi()[99] == 99, "All words sent");
+    printf("100 bytes at %u Hz: %.1f%% of the bus rate\n", (unsigned)spi.baudrate(),
+        100.0 * 100 * model.frameCycles() / elapsed);
+    // The setup and the completion interrupt are a fixed cost - the words
+    // themselves must follow each other without gaps
+    start = sim::now();
+    spi.transfer(tx, rx, 50, onDone, &spi);
+    sim::runUntil([]() { return doneCount == 2; }, kTimeout);
+    sim::Cycles elapsed50 = sim::now() - start;
+    CHECK(elapsed - elapsed50 <= 50 * model.frameCycles(), "Words sent back to back");
+
+    model.clearMosi();
+    spi.write(tx, 10);
+    spi.waitTransfer();
+    CHECK(model.mosi() == Words({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), "write() sends the buffer");
+    CHECK(!(SPI_SR(SPI1) & SPI_SR_OVR), "No overrun when the received data is discarded");
+
+    model.clearMosi();
+    memset(rx, 0, sizeof(rx));
+    spi.read(rx, 5, 0xa5);
+    spi.waitTransfer();
+    CHECK(model.mosi() == Words(5, 0xa5), "read() sends the fill word");
+    CHECK(rx[0] == 0x5a && rx[4] == 0x5a && rx[5] == 0, "read() receives exactly len bytes");
+
+    CHECK(spi.xfer(0x12) == 0xed, "Single word exchange");
+    CHECK(dma::ChannelArbiter::owner(DMA1, 2) == dma::ChannelArbiter::kNoOwner &&
+        dma::ChannelArbiter::owner(DMA1, 3) == dma::ChannelArbiter::kNoOwner, "Channels released");
+}
+
+void test16Bit()
+{
+    sim::reset();
+    auto& model = sim::spi(SPI1);
+    model.setSlave([](uint16_t mosi) { return (uint16_t)(mosi + 0x1000); });
+    spi.init((uint8_t)2, nsspi::kSoftwareNSS | nsspi::k16BitFrame);
+    uint16_t tx[4] = { 0x0102, 0xa0b0, 0x1234, 0xfffe };
+    uint16_t rx[4] = {};
+    spi.transfer(tx, rx, sizeof(tx));
+    spi.waitTransfer();
+    CHECK(model.mosi() == Words({0x0102, 0xa0b0, 0x1234, 0xfffe}), "16-bit words sent");
+    CHECK(rx[0] == 0x1102 && rx[1] == 0xb0b0 && rx[3] == 0x0ffe, "16-bit words received");
+    uint16_t in[3] = {};
+    model.clearMosi();
+    spi.read(in, sizeof(in), 0xbeef);
+    spi.waitTransfer();
+    CHECK(model.mosi() == Words(3, 0xbeef) && in[2] == 0xceef, "16-bit read with a fill word");
+}
+
+void testTxError()
+{
+    sim::reset();
+    spi.init((uint8_t)4, nsspi::kSoftwareNSS);
+    uint8_t rx[4];
+    doneCount = 0;
+    doneOk = true;
+    // The Tx channel can't read from an unmapped address, so no word is
+    // sent and the Rx channel never completes
+    spi.transfer(nullptr, rx, sizeof(rx), onDone, &spi);
+    CHECK(sim::runUntil([]() { return doneCount == 1; }, kTimeout) && !doneOk,
+        "Tx channel error completes the transaction with an error");
+    CHECK(!spi.transferBusy(), "Transaction not busy after a Tx channel error");
+    CHECK(dma::ChannelArbiter::owner(DMA1, 2) == dma::ChannelArbiter::kNoOwner &&
+        dma::ChannelArbiter::owner(DMA1, 3) == dma::ChannelArbiter::kNoOwner,
+        "Channels released after a Tx channel error");
+    uint8_t tx[4] = { 1, 2, 3, 4 };
+    spi.transfer(tx, rx, sizeof(tx), onDone, &spi);
+    CHECK(sim::runUntil([]() { return doneCount == 2; }, kTimeout) && doneOk,
+        "Transaction after a Tx channel error");
+}
+
+void testEmpty()
+{
+    sim::reset();
+    auto& model = sim::spi(SPI1);
+    spi.init((uint8_t)4, nsspi::kSoftwareNSS);
+    uint8_t buf[4] = { 1, 2, 3, 4 };
+    doneCount = 0;
+    doneOk = false;
+    spi.write(buf, 0, onDone, &spi);
+    CHECK(doneCount == 1 && doneOk && !spi.transferBusy(), "Empty write completes right away");
+    spi.read(buf, 0, 0xff, onDone, &spi);
+    spi.transfer(buf, buf, 0, onDone, &spi);
+    CHECK(doneCount == 3 && doneOk, "Empty read and transfer complete right away");
+    CHECK(dma::ChannelArbiter::owner(DMA1, 2) == dma::ChannelArbiter::kNoOwner &&
+        dma::ChannelArbiter::owner(DMA1, 3) == dma::ChannelArbiter::kNoOwner,
+        "Empty transactions don't hold the channels");
+    model.clearMosi();
+    spi.write(buf, sizeof(buf), onDone, &spi);
+    CHECK(sim::runUntil([]() { return doneCount == 4; }, kTimeout) && doneOk,
+        "Transaction after empty ones");
+    CHECK(model.mosi() == Words({1, 2, 3, 4}), "Nothing sent for the empty transactions");
+}
+
+void testShared()
+{
+    sim::reset();
+    auto& model = sim::spi(SPI2);
+    sharedSpi.init((uint8_t)2, nsspi::kSoftwareNSS);
+    static const uint8_t cmd[] = { 0x9f };
+    uint8_t id[3];
+    sharedSpi.dmaTxStart(cmd, sizeof(cmd));
+    // Waits for the Tx mixin to release the channel
+    sharedSpi.read(id, sizeof(id), 0);
+    sharedSpi.waitTransfer();
+    CHECK(model.mosi() == Words({0x9f, 0, 0, 0}), "Transaction after a shared Tx DMA transfer");
+    sharedSpi.dmaTxStart(cmd, sizeof(cmd));
+    sim::runUntil([]() { return !sharedSpi.txBusy(); }, kTimeout);
+    CHECK(model.mosi().size() == 5, "Tx mixin works after a transaction");
+}
+
+int main()
+{
+    test8Bit();
+    test16Bit();
+    testTxError();
+    testEmpty();
+    testShared();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
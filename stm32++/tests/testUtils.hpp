@@ -0,0 +1,36 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_TEST_UTILS_HPP
+#define STM32PP_TEST_UTILS_HPP
+
+/** @file Helpers shared by the host tests. Each test defines the error counter:
+ * \code
+ * int errors = 0;
+ * \endcode
+ */
+#include <stm32++/printSink.hpp>
+#include <string>
+#include <stdio.h>
+
+/** Number of failed checks, defined by the test */
+extern int errors;
+
+/** Prints the result of a check, and counts it if failed */
+#define CHECK(cond, msg) \
+    do { \
+        if (!(cond)) { printf("ERROR (line %d): %s\n", __LINE__, msg); errors++; } \
+        else { printf("PASS: %s\n", msg); } \
+    } while (0)
+
+/** A print sink that collects the output in a string */
+struct CaptureSink: public IPrintSink
+{
+    std::string output;
+    BufferInfo* waitReady() { return nullptr; }
+    void print(const char* str, size_t len, int) { output.append(str, len); }
+};
+
+#endif
@@ -5,6 +5,7 @@
 struct MyPrintSink: public IPrintSink
 {
     const char* expectedString = nullptr;
+    BufferInfo* waitReady() { return nullptr; }
     void print(const char *str, size_t len, int fd)
     {
         if (strcmp(str, expectedString))
@@ -20,9 +21,10 @@ struct MyPrintSink: public IPrintSink
 };
 
 MyPrintSink myPrintSink;
+extern IPrintSink* gPrintSink;
 
-template <typename... Args>
-void expect(const char* expected, const char* fmtString, Args... args)
+template <typename F, typename... Args>
+void expect(const char* expected, F fmtString, Args... args)
 {
     auto savedSink = gPrintSink;
     gPrintSink = &myPrintSink;
@@ -39,15 +41,101 @@ int main()
            "this is a fmtFp<prec: 6>(minDigits: 4): %",
            fmtFp<6>(123.4567, 4));
     expect("this is an int: '  001234'", "this is an int: '%'", fmtInt(1234, 6, 8));
-    expect("this is a hex8(127): 0x7f", "this is a hex8(127): %", fmtHex(127));
-    expect("this is a hex16(32767): 0x7FFF", "this is a hex16(32767): %", fmtHex<kUpperCase>(32767));
-    expect("this is a hex16(32767) no prefix: 7fff", "this is a hex16(32767) no prefix: %", fmtHex<kNoPrefix>(32767));
+    expect("this is a hex8(127): 0x7f", "this is a hex8(127): %", fmtHex<kNumPrefix>(127));
+    expect("this is a hex16(32767): 0x7FFF", "this is a hex16(32767): %", fmtHex<kUpperCase|kNumPrefix>(32767));
+    expect("this is a hex16(32767) no prefix: 7fff", "this is a hex16(32767) no prefix: %", fmtHex(32767));
 
-    expect("this is an octal: OCT4553207", "this is an octal: %", fmtInt<8>(1234567));
-    expect("this is a bin(127): 0b01111111", "this is a bin(127): %", fmtBin(127));
+    expect("this is an octal: OCT4553207", "this is an octal: %", fmtInt<kNumPrefix|8>(1234567));
+    expect("this is a bin(127): 0b01111111", "this is a bin(127): %", fmtBin<kNumPrefix>(127, 8));
     expect("this is a string: 'test message'", "this is a string: %", "'test message'");
     expect("this is a dollar: $", "this is a dollar: %", '$');
 
+    expect("compiled: 42 and 'str', end", FMT("compiled: % and '%', end"), 42, "str");
+    expect("%-first: 7", FMT("%-first: %"), "%", 7);
+    expect("no placeholders", FMT("no placeholders"));
+    expect("adjacent: 12", FMT("adjacent: %%"), 1, 2);
+    expect("float: 123.456700, hex: 0x7f", FMT("float: %, hex: %"), 123.4567, fmtHex<kNumPrefix>(127));
+    {
+        char buf[8];
+        auto ret = tsnprintf(buf, sizeof(buf), FMT("abc%defgh"), 12);
+        if (ret || strcmp(buf, "abc12de"))
+        {
+            printf("ERROR: compiled format truncation: '%s'\n", buf);
+            exit(1);
+        }
+        ret = tsnprintf(buf, sizeof(buf), FMT("abc%de"), 12);
+        if (ret != buf + 7 || strcmp(buf, "abc12de"))
+        {
+            printf("ERROR: compiled format exact fit: '%s'\n", buf);
+            exit(1);
+        }
+        ret = tsnprintf(buf, sizeof(buf), FMT("abcdef%"), 12);
+        if (ret || strcmp(buf, "abcdef"))
+        {
+            printf("ERROR: compiled format argument truncation: '%s'\n", buf);
+            exit(1);
+        }
+        printf("PASS: compiled format truncation\n");
+    }
+    {
+        char buf[12];
+        memset(buf, 'x', sizeof(buf));
+        // a value that doesn't fit is dropped entirely, and the output terminated before it
+        auto ret = tsnprintf(buf, sizeof(buf), "abc % %", 12, 1234567);
+        if (ret || strcmp(buf, "abc 12 "))
+        {
+            printf("ERROR: runtime format truncation: '%s'\n", buf);
+            exit(1);
+        }
+        // the value fits, but the terminator doesn't - it's dropped as well
+        static const int vals[] = { 1234, 12345 };
+        for (int val: vals)
+        {
+            ret = tsnprintf(buf, 11, "abc % %", 12, val);
+            if (ret || strcmp(buf, "abc 12 "))
+            {
+                printf("ERROR: runtime format truncation by one char: '%s'\n", buf);
+                exit(1);
+            }
+            ret = tsnprintf(buf, 11, FMT("abc % %"), 12, val);
+            if (ret || strcmp(buf, "abc 12 "))
+            {
+                printf("ERROR: compiled format truncation by one char: '%s'\n", buf);
+                exit(1);
+            }
+        }
+        // value fits exactly, but is followed by more text
+        ret = tsnprintf(buf, sizeof(buf), "abc %!", 1234567);
+        if (ret || strcmp(buf, "abc 1234567"))
+        {
+            printf("ERROR: runtime format exact fit of value: '%s'\n", buf);
+            exit(1);
+        }
+        ret = tsnprintf(buf, sizeof(buf), "abc %", 1234567);
+        if (ret != buf + 11 || strcmp(buf, "abc 1234567"))
+        {
+            printf("ERROR: runtime format exact fit: '%s'\n", buf);
+            exit(1);
+        }
+        printf("PASS: runtime format truncation\n");
+    }
+    {
+        // Longer than the stack buffer, formatted in a heap buffer
+        char line[301];
+        memset(line, 'x', 300);
+        line[300] = 0;
+        char expected[320];
+        snprintf(expected, sizeof(expected), "long: %s %d", line, 123456);
+        expect(expected, "long: % %", (const char*)line, 123456);
+        expect(expected, FMT("long: % %"), (const char*)line, 123456);
+        if (tformattedLength("long: % %", (const char*)line, 123456) != strlen(expected))
+        {
+            printf("ERROR: tformattedLength() mismatch\n");
+            exit(1);
+        }
+        printf("PASS: tformattedLength\n");
+    }
+
     tprintf("this is a float: %\n"
             "this is a fmtFp<prec: 6>(minDigits: 4): %\n"
             "this is a hex8(127): %\n"
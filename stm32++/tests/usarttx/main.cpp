@@ -0,0 +1,93 @@
+#include <stm32++/usart.hpp>
+#include <testUtils.hpp>
+#include <string>
+#include <stdio.h>
+
+CaptureSink sink;
+IPrintSink* gPrintSink = &sink;
+int errors = 0;
+
+enum: sim::Cycles { kTimeout = 100000000 };
+
+nsusart::IntrTx<nsusart::Usart<USART2>, 32> tx;
+nsusart::RingPrintSink<nsusart::Usart<USART3>, 32> logSink;
+extern "C" void usart2_isr() { tx.usartTxIsr(); }
+extern "C" void usart3_isr() { logSink.usartTxIsr(); }
+
+void testWrite()
+{
+    sim::reset();
+    auto& model = sim::usart(USART2);
+    tx.init(nsusart::kOptEnableTx, 115200);
+    CHECK(!tx.txBusy(), "Idle after init");
+    sim::Cycles start = sim::now();
+    CHECK(tx.write("hello ") == 6, "All bytes accepted");
+    CHECK(tx.write("world") == 5, "Written while sending");
+    CHECK(sim::now() - start < model.frameCycles(), "write() doesn't wait for the transmission");
+    CHECK(tx.txBusy(), "Transmission in progress");
+    CHECK(sim::runUntil([]() { return !tx.txBusy(); }, kTimeout), "Transmission ends");
+    CHECK(model.txIdle(), "Last byte left the shift register when txBusy() clears");
+    CHECK(model.takeTxData() == "hello world", "Data sent in order");
+    CHECK(!(USART_CR1(USART2) & (USART_CR1_TXEIE | USART_CR1_TCIE)), "Interrupts disabled when idle");
+
+    std::string data(50, 'a');
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] += i % 26;
+    }
+    size_t accepted = tx.write(data.c_str(), data.size());
+    CHECK(accepted == 31, "Only the free space of the ring is accepted");
+    std::string sent(data, 0, accepted);
+    size_t pos = accepted;
+    while (pos < data.size())
+    {
+        sim::runUntil([]() { return tx.freeSpace() != 0; }, kTimeout);
+        pos += tx.write(data.c_str() + pos, data.size() - pos);
+    }
+    sim::runUntil([]() { return !tx.txBusy(); }, kTimeout);
+    CHECK(model.takeTxData() == data, "Data written as space frees is sent in order");
+
+    // TC comes after the ring was emptied and refilled
+    tx.write("x");
+    sim::runUntil([]() { return (USART_CR1(USART2) & USART_CR1_TCIE) != 0; }, kTimeout);
+    tx.write("yz");
+    sim::runUntil([]() { return !tx.txBusy(); }, kTimeout);
+    CHECK(model.takeTxData() == "xyz", "Data written while waiting for TC is sent");
+
+    tx.write("flushed");
+    {
+        IntrDisable noIntr;
+        tx.flush();
+        CHECK(!tx.txBusy(), "flush() works with interrupts disabled");
+    }
+    CHECK(model.takeTxData() == "flushed", "Flushed data sent");
+}
+
+void testPrintSink()
+{
+    sim::reset();
+    auto& model = sim::usart(USART3);
+    logSink.init(nsusart::kOptEnableTx, 115200);
+    IPrintSink* prev = setPrintSink(&logSink);
+    tprintf("value: %\n", 42);
+    CHECK(logSink.txBusy(), "Message queued");
+    std::string longMsg(25, 'z');
+    tprintf("%\n", longMsg.c_str());
+    setPrintSink(prev);
+    sim::runUntil([]() { return !logSink.txBusy(); }, kTimeout);
+    CHECK(model.takeTxData() == "value: 42\n" + longMsg + "\n",
+        "Message larger than the free space waits for the interrupt");
+}
+
+int main()
+{
+    testWrite();
+    testPrintSink();
+    if (errors)
+    {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,371 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_BINLOG_DECODER_HPP
+#define STM32PP_BINLOG_DECODER_HPP
+
+/** @brief Host-side decoder of the records produced by \c BINLOG().
+ * Reads the format strings from the \c binlog_fmt section of the firmware ELF
+ * file, and renders the records to text, using the same toString() overloads
+ * that tprintf() uses on the target, so the output is the same as if the
+ * message was formatted on the MCU.
+ */
+
+#include <stm32++/binlog.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+namespace binlog
+{
+class Decoder
+{
+public:
+    enum Status: uint8_t { kOk = 0, kIncomplete, kInvalid };
+protected:
+    std::vector<char> mFormats;
+    struct Reader
+    {
+        const uint8_t* ptr;
+        const uint8_t* end;
+        bool ok = true;
+        Reader(const uint8_t* aPtr, const uint8_t* aEnd): ptr(aPtr), end(aEnd) {}
+        bool has(size_t n)
+        {
+            if ((size_t)(end - ptr) < n)
+            {
+                ok = false;
+            }
+            return ok;
+        }
+        uint8_t u8()
+        {
+            return has(1) ? *(ptr++) : 0;
+        }
+        template <typename T>
+        T raw()
+        {
+            T val = 0;
+            if (has(sizeof(T)))
+            {
+                memcpy(&val, ptr, sizeof(T));
+                ptr += sizeof(T);
+            }
+            return val;
+        }
+        uint32_t varint()
+        {
+            uint32_t val = 0;
+            for (uint8_t shift = 0; shift < 35; shift += 7)
+            {
+                if (!has(1))
+                    return 0;
+                uint8_t byte = *(ptr++);
+                val |= (uint32_t)(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                    return val;
+            }
+            ok = false;
+            return 0;
+        }
+    };
+    /** Reads an integer argument and calls \c func with it, as its original type */
+    template <class F>
+    static bool visitInt(Reader& rd, F&& func)
+    {
+        switch (rd.u8())
+        {
+            case kTagU8: return func(rd.raw<uint8_t>());
+            case kTagU16: return func(rd.raw<uint16_t>());
+            case kTagU32: return func(rd.raw<uint32_t>());
+            case kTagU64: return func(rd.raw<uint64_t>());
+            case kTagI8: return func(rd.raw<int8_t>());
+            case kTagI16: return func(rd.raw<int16_t>());
+            case kTagI32: return func(rd.raw<int32_t>());
+            case kTagI64: return func(rd.raw<int64_t>());
+            default: return false;
+        }
+    }
+    template <class F>
+    static bool visitFp(Reader& rd, F&& func)
+    {
+        switch (rd.u8())
+        {
+            case kTagFloat: return func(rd.raw<float>());
+            case kTagDouble: return func(rd.raw<double>());
+            default: return false;
+        }
+    }
+    static bool append(std::string& out, const char* buf, const char* end)
+    {
+        if (!end)
+            return false;
+        out.append(buf, end);
+        return true;
+    }
+    template <Flags flags, typename T>
+    static bool renderInt(std::string& out, T val, uint8_t minDigits, uint8_t minLen)
+    {
+        char buf[300];
+        return append(out, buf, toString<flags|kDontNullTerminate>(
+            buf, sizeof(buf), val, minDigits, minLen));
+    }
+    // Converts the runtime flags of an IntFmt argument to template parameters
+    template <Flags caseAndPrefix, typename T>
+    static bool renderIntBase(std::string& out, Flags flags, T val, uint8_t minDigits, uint8_t minLen)
+    {
+        switch (flags & kFlagsBaseMask)
+        {
+            case 0:
+            case 10: return renderInt<caseAndPrefix|10>(out, val, minDigits, minLen);
+            case 16: return renderInt<caseAndPrefix|16>(out, val, minDigits, minLen);
+            case 8: return renderInt<caseAndPrefix|8>(out, val, minDigits, minLen);
+            case 2: return renderInt<caseAndPrefix|2>(out, val, minDigits, minLen);
+            default: return false;
+        }
+    }
+    template <typename T>
+    static bool renderIntFmt(std::string& out, Flags flags, T val, uint8_t minDigits, uint8_t minLen)
+    {
+        switch (flags & (kUpperCase|kNumPrefix))
+        {
+            case 0: return renderIntBase<0>(out, flags, val, minDigits, minLen);
+            case kUpperCase: return renderIntBase<kUpperCase>(out, flags, val, minDigits, minLen);
+            case kNumPrefix: return renderIntBase<kNumPrefix>(out, flags, val, minDigits, minLen);
+            default: return renderIntBase<kUpperCase|kNumPrefix>(out, flags, val, minDigits, minLen);
+        }
+    }
+    template <typename T>
+    static bool renderFpFmt(std::string& out, Flags flags, T val, uint8_t minDigits, uint8_t minLen)
+    {
+        uint8_t prec = precFromFlags(flags);
+        if (prec > 9)
+            return false;
+        FpDecimal dec;
+        fpToDecimal(val, prec, flags, dec);
+        char buf[300];
+        return append(out, buf, (flags & kUpperCase)
+            ? fpDecToString<kDontNullTerminate|kUpperCase>(buf, sizeof(buf), dec, prec, minDigits, minLen)
+            : fpDecToString<kDontNullTerminate>(buf, sizeof(buf), dec, prec, minDigits, minLen));
+    }
+    static bool renderDecimal(std::string& out, const FpDecimal& dec, uint8_t prec)
+    {
+        char buf[64];
+        return append(out, buf, fixedDecToString<kDontNullTerminate>(buf, sizeof(buf), dec, prec));
+    }
+    bool renderArg(Reader& rd, std::string& out)
+    {
+        char buf[32];
+        uint8_t tag = rd.u8();
+        if (!rd.ok)
+            return false;
+        if (tag >= kTagU8 && tag <= kTagI64)
+        {
+            rd.ptr--;
+            return visitInt(rd, [&out, &buf](auto val)
+            {
+                return append(out, buf, toString<kDontNullTerminate>(buf, sizeof(buf), val));
+            });
+        }
+        switch (tag)
+        {
+        case kTagChar:
+            out += (char)rd.u8();
+            return rd.ok;
+        case kTagFloat:
+        case kTagDouble:
+            rd.ptr--;
+            return visitFp(rd, [&out](auto val)
+            {
+                char fpBuf[64];
+                return append(out, fpBuf, toString<kDontNullTerminate>(fpBuf, sizeof(fpBuf), val));
+            });
+        case kTagStr:
+        {
+            uint32_t len = rd.varint();
+            if (!rd.has(len))
+                return false;
+            out.append((const char*)rd.ptr, len);
+            rd.ptr += len;
+            return true;
+        }
+        case kTagIntFmt:
+        case kTagFpFmt:
+        {
+            Flags flags = rd.raw<uint16_t>();
+            uint8_t minDigits = rd.u8();
+            uint8_t minLen = rd.u8();
+            if (tag == kTagIntFmt)
+            {
+                return visitInt(rd, [&](auto val)
+                {
+                    return rd.ok && renderIntFmt(out, flags, val, minDigits, minLen);
+                });
+            }
+            return visitFp(rd, [&](auto val)
+            {
+                return rd.ok && renderFpFmt(out, flags, val, minDigits, minLen);
+            });
+        }
+        case kTagRptChar:
+        {
+            char ch = rd.u8();
+            uint16_t count = rd.raw<uint16_t>();
+            out.append(count, ch);
+            return rd.ok;
+        }
+        case kTagQ:
+        {
+            uint8_t fracBits = rd.u8();
+            uint8_t prec = rd.u8();
+            if (fracBits == 0 || fracBits > 59 || prec > 9)
+                return false;
+            return visitInt(rd, [&](auto val)
+            {
+                FpDecimal dec;
+                qAbsToDecimal(absUnsigned(val, dec.negative), fracBits, prec, dec);
+                return rd.ok && renderDecimal(out, dec, prec);
+            });
+        }
+        case kTagScaled:
+        {
+            uint32_t divisor = rd.raw<uint32_t>();
+            uint8_t prec = rd.u8();
+            if (divisor == 0 || prec > 9)
+                return false;
+            return visitInt(rd, [&](auto val)
+            {
+                FpDecimal dec;
+                scaledAbsToDecimal(absUnsigned(val, dec.negative), divisor, prec, dec);
+                return rd.ok && renderDecimal(out, dec, prec);
+            });
+        }
+        default:
+            return false;
+        }
+    }
+public:
+    /** Sets the contents of the \c binlog_fmt section directly */
+    void setFormatTable(const char* data, size_t size)
+    {
+        mFormats.assign(data, data + size);
+    }
+    /** Loads the format strings from the \c binlog_fmt section of an ELF file.
+     * Both 32 and 64-bit little-endian ELF files are supported
+     * @return \c false if the file can't be read or doesn't have that section
+     */
+    bool loadElf(const char* fname)
+    {
+        FILE* file = fopen(fname, "rb");
+        if (!file)
+            return false;
+        std::vector<uint8_t> elf;
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            elf.insert(elf.end(), chunk, chunk + n);
+        }
+        fclose(file);
+        return loadElf(elf.data(), elf.size());
+    }
+    bool loadElf(const uint8_t* elf, size_t size)
+    {
+        if (size < 0x40 || memcmp(elf, "\x7f" "ELF", 4) || elf[5] != 1) // not little endian
+            return false;
+        bool is64 = (elf[4] == 2);
+        Reader rd(elf, elf + size);
+        // The offsets come from the file, so they are checked before forming a pointer
+        auto seek = [&rd, elf, size](uint64_t offs)
+        {
+            if (offs > size)
+            {
+                rd.ptr = rd.end;
+                rd.ok = false;
+            }
+            else
+            {
+                rd.ptr = elf + offs;
+            }
+        };
+        auto get = [&rd, &seek, is64](uint64_t offs, bool word) -> uint64_t
+        {
+            seek(offs);
+            return (word && is64) ? rd.raw<uint64_t>()
+                : (word ? rd.raw<uint32_t>() : rd.raw<uint16_t>());
+        };
+        uint64_t shOffs = get(is64 ? 0x28 : 0x20, true);
+        uint16_t shEntSize = get(is64 ? 0x3a : 0x2e, false);
+        uint16_t shNum = get(is64 ? 0x3c : 0x30, false);
+        uint16_t shStrIdx = get(is64 ? 0x3e : 0x32, false);
+        // Section header: name(4), type(4), flags(w), addr(w), offset(w), size(w)
+        auto secOffs = [&](uint16_t idx) { return get(shOffs + idx * shEntSize + (is64 ? 0x18 : 0x10), true); };
+        auto secSize = [&](uint16_t idx) { return get(shOffs + idx * shEntSize + (is64 ? 0x20 : 0x14), true); };
+        if (shStrIdx >= shNum)
+            return false;
+        uint64_t strTab = secOffs(shStrIdx);
+        uint64_t strTabSize = secSize(shStrIdx);
+        if (!rd.ok || strTab > size || strTabSize > size - strTab)
+            return false;
+        for (uint16_t i = 0; i < shNum; i++)
+        {
+            seek(shOffs + i * shEntSize);
+            uint32_t name = rd.raw<uint32_t>();
+            if (!rd.ok)
+                return false;
+            if (name >= strTabSize
+             || strncmp((const char*)elf + strTab + name, "binlog_fmt", strTabSize - name))
+                continue;
+            uint64_t offs = secOffs(i);
+            uint64_t secsize = secSize(i);
+            if (!rd.ok || offs > size || secsize > size - offs)
+                return false;
+            setFormatTable((const char*)elf + offs, secsize);
+            return true;
+        }
+        return false;
+    }
+    const std::vector<char>& formatTable() const { return mFormats; }
+    /** Decodes one record and appends the rendered text to \c out
+     * @param recSize Set to the size of the record, if the record header could be
+     * parsed, even if the record itself is invalid, so that it can be skipped.
+     * Otherwise, it's set to 0
+     * @return \c kIncomplete if \c data doesn't contain the whole record.
+     */
+    Status decodeRecord(const uint8_t* data, size_t len, size_t& recSize, std::string& out)
+    {
+        recSize = 0;
+        Reader rd(data, data + len);
+        uint32_t payloadSize = rd.varint();
+        if (!rd.ok)
+            return (len < 5) ? kIncomplete : kInvalid;
+        if (!rd.has(payloadSize))
+            return kIncomplete;
+        recSize = rd.ptr - data + payloadSize;
+        rd.end = rd.ptr + payloadSize;
+        uint32_t fmtId = rd.varint();
+        if (!rd.ok || fmtId >= mFormats.size())
+            return kInvalid;
+        const char* fmt = mFormats.data() + fmtId;
+        const char* fmtEnd = mFormats.data() + mFormats.size();
+        // Same as tsnprintf(): each % is replaced by the next argument. If
+        // there are no more arguments, the % is printed as-is
+        for (; fmt < fmtEnd && *fmt; fmt++)
+        {
+            if (*fmt != '%' || rd.ptr >= rd.end)
+            {
+                out += *fmt;
+            }
+            else if (!renderArg(rd, out))
+            {
+                return kInvalid;
+            }
+        }
+        return kOk;
+    }
+};
+}
+
+#endif
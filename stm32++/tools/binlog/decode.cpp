@@ -0,0 +1,74 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+/** Renders a capture of BINLOG() records to text.
+ * Usage: binlog-decode <firmware.elf> [capture-file]
+ * If capture-file is not specified, the records are read from stdin, so the
+ * output of the serial port or the semihosting log can be piped to the decoder
+ */
+
+#include "binlogDecoder.hpp"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <firmware.elf> [capture-file]\n", argv[0]);
+        return 1;
+    }
+    binlog::Decoder decoder;
+    if (!decoder.loadElf(argv[1]))
+    {
+        fprintf(stderr, "Can't load format strings from the binlog_fmt section of %s\n", argv[1]);
+        return 2;
+    }
+    FILE* input = stdin;
+    if (argc > 2)
+    {
+        input = fopen(argv[2], "rb");
+        if (!input)
+        {
+            fprintf(stderr, "Can't open capture file %s\n", argv[2]);
+            return 2;
+        }
+    }
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), input)) > 0)
+    {
+        data.erase(data.begin(), data.begin() + pos);
+        pos = 0;
+        data.insert(data.end(), chunk, chunk + n);
+        for (;;)
+        {
+            std::string text;
+            size_t recSize;
+            auto status = decoder.decodeRecord(data.data() + pos, data.size() - pos, recSize, text);
+            if (status == binlog::Decoder::kIncomplete)
+            {
+                break;
+            }
+            if (status == binlog::Decoder::kInvalid)
+            {
+                if (!recSize)
+                {
+                    fprintf(stderr, "Corrupt record header at input offset %zu\n", pos);
+                    return 3;
+                }
+                fprintf(stderr, "Invalid record of size %zu, skipping it\n", recSize);
+            }
+            fwrite(text.data(), 1, text.size(), stdout);
+            pos += recSize;
+        }
+        fflush(stdout);
+    }
+    if (pos < data.size())
+    {
+        fprintf(stderr, "Input ends with an incomplete record\n");
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+/** Demultiplexes an SWO capture into the text of each ITM stimulus port.
+ * Usage: swo-decode [-o <prefix>] [capture-file]
+ * With -o, the text of port N is written to the file <prefix>N.txt. Otherwise
+ * it's written to stdout, each line prefixed with its port number.
+ * If capture-file is not specified, the capture is read from stdin, e.g. from
+ * OpenOCD's 'tpiu config internal - uart off <freq>' output
+ */
+
+#include "swoDecoder.hpp"
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char** argv)
+{
+    const char* prefix = nullptr;
+    int argi = 1;
+    if (argc > 2 && !strcmp(argv[1], "-o"))
+    {
+        prefix = argv[2];
+        argi = 3;
+    }
+    FILE* input = stdin;
+    if (argi < argc)
+    {
+        input = fopen(argv[argi], "rb");
+        if (!input)
+        {
+            fprintf(stderr, "Can't open capture file %s\n", argv[argi]);
+            return 2;
+        }
+    }
+    FILE* portFiles[swo::Decoder::kNumPorts] = {};
+    std::string lines[swo::Decoder::kNumPorts]; // incomplete lines, without -o
+    swo::Decoder decoder;
+    uint8_t chunk[4096];
+    size_t n;
+    for (bool eof = false; !eof;)
+    {
+        n = fread(chunk, 1, sizeof(chunk), input);
+        eof = (n == 0);
+        decoder.feed(chunk, n);
+        for (uint8_t port = 0; port < swo::Decoder::kNumPorts; port++)
+        {
+            std::string text = decoder.takeText(port);
+            if (prefix)
+            {
+                if (text.empty())
+                {
+                    continue;
+                }
+                if (!portFiles[port])
+                {
+                    std::string name = prefix + std::to_string(port) + ".txt";
+                    portFiles[port] = fopen(name.c_str(), "wb");
+                    if (!portFiles[port])
+                    {
+                        fprintf(stderr, "Can't create output file %s\n", name.c_str());
+                        return 2;
+                    }
+                }
+                fwrite(text.data(), 1, text.size(), portFiles[port]);
+                continue;
+            }
+            auto& line = lines[port];
+            line += text;
+            size_t start = 0;
+            for (size_t nl; (nl = line.find('\n', start)) != std::string::npos; start = nl + 1)
+            {
+                printf("%2u: %.*s\n", port, (int)(nl - start), line.data() + start);
+            }
+            line.erase(0, start);
+            if (eof && !line.empty())
+            {
+                printf("%2u: %s\n", port, line.c_str());
+            }
+        }
+        fflush(stdout);
+    }
+    for (auto file: portFiles)
+    {
+        if (file)
+        {
+            fclose(file);
+        }
+    }
+    if (decoder.overflowCount)
+    {
+        fprintf(stderr, "%u ITM overflows - data was lost on the target\n", decoder.overflowCount);
+    }
+    if (decoder.invalidCount)
+    {
+        fprintf(stderr, "%u invalid packet headers\n", decoder.invalidCount);
+    }
+    return 0;
+}
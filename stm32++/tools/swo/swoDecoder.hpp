@@ -0,0 +1,127 @@
+/**
+ * @author Alexander Vassilev
+ * @copyright BSD License
+ */
+
+#ifndef STM32PP_SWO_DECODER_HPP
+#define STM32PP_SWO_DECODER_HPP
+
+/** @brief Host-side decoder of an SWO capture - the ITM packet stream, as
+ * output by the TPIU in UART (NRZ) or Manchester mode, without TPIU formatting.
+ * The payload of the software source packets (written to the ITM stimulus
+ * ports, see itm.hpp) is demultiplexed per port. Synchronization, overflow,
+ * timestamp and extension packets, as well as the hardware source packets of
+ * the DWT, are skipped. The input can be fed in chunks of any size
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace swo
+{
+class Decoder
+{
+public:
+    enum: uint8_t { kNumPorts = 32 };
+protected:
+    enum State: uint8_t { kHeader, kPayload, kContinuation };
+    State mState = kHeader;
+    uint8_t mPort = 0;
+    uint8_t mRemaining = 0; // payload bytes of the current source packet
+    bool mSoftware = false;
+    uint8_t mZeros = 0; // consecutive zero bytes, a synchronization packet is 5 or more, then 0x80
+    std::string mText[kNumPorts];
+public:
+    uint32_t overflowCount = 0; // ITM overflow packets - data was lost on the target
+    uint32_t syncCount = 0;
+    uint32_t invalidCount = 0; // reserved headers
+    uint32_t hwPacketCount = 0;
+    void feed(const uint8_t* data, size_t len)
+    {
+        for (const uint8_t* end = data + len; data < end; data++)
+        {
+            feedByte(*data);
+        }
+    }
+    void feedByte(uint8_t b)
+    {
+        switch (mState)
+        {
+        case kPayload:
+            if (mSoftware)
+            {
+                mText[mPort] += (char)b;
+            }
+            if (--mRemaining == 0)
+            {
+                mState = kHeader;
+            }
+            return;
+        case kContinuation:
+            if ((b & 0x80) == 0)
+            {
+                mState = kHeader;
+            }
+            return;
+        case kHeader:
+            break;
+        }
+        if (b == 0)
+        {
+            if (mZeros < 0xff)
+            {
+                mZeros++;
+            }
+            return;
+        }
+        uint8_t zeros = mZeros;
+        mZeros = 0;
+        if (b == 0x80 && zeros >= 5)
+        {
+            syncCount++;
+        }
+        else if (b == 0x70)
+        {
+            overflowCount++;
+        }
+        else if ((b & 0x03) != 0) // source packet
+        {
+            static const uint8_t sizes[] = { 1, 2, 4 };
+            mRemaining = sizes[(b & 0x03) - 1];
+            mSoftware = (b & 0x04) == 0;
+            mPort = b >> 3;
+            if (!mSoftware)
+            {
+                hwPacketCount++;
+            }
+            mState = kPayload;
+        }
+        else if ((b & 0x0f) == 0 || (b & 0x0b) == 0x08) // timestamp or extension
+        {
+            if ((b & 0x0f) == 0 && (b & 0xc0) == 0x80)
+            {
+                invalidCount++; // reserved timestamp header
+            }
+            else if (b & 0x80)
+            {
+                mState = kContinuation;
+            }
+        }
+        else
+        {
+            invalidCount++;
+        }
+    }
+    /** Returns the text received on \c port so far, and clears it */
+    std::string takeText(uint8_t port)
+    {
+        std::string text;
+        text.swap(mText[port % kNumPorts]);
+        return text;
+    }
+    const std::string& text(uint8_t port) const { return mText[port % kNumPorts]; }
+};
+}
+
+#endif